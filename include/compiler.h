@@ -84,6 +84,8 @@ typedef struct compiler{
     LZOHTable       *default_natives;
     ScopeManager    *manager;
     Module          *module;
+    // Lower what it can to the register instructions
+    char            registers;
 
     LZArena         *compiler_arena;
     LZPool          *units_pool;
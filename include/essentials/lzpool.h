@@ -2,8 +2,13 @@
 #define LZPOOL_H
 
 #include <stddef.h>
+#include <stdint.h>
 
 #define LZPOOL_DEFAULT_ALIGNMENT 16
+#define LZPOOL_BITMAP_WORD_BITS 64
+#define LZPOOL_BITMAP_WORDS(_slots_count)(((_slots_count) + LZPOOL_BITMAP_WORD_BITS - 1) / LZPOOL_BITMAP_WORD_BITS)
+
+typedef void (*LZPoolSweeper)(void *ptr, void *ctx);
 
 typedef struct lzpool_allocator{
     void *ctx;
@@ -16,6 +21,9 @@ typedef struct lzsubpool{
     size_t slots_used;
     size_t slots_count;
     void *slots;
+    // One bit per slot. Only present in pools created by lzpool_init_bitmaps
+    uint64_t *live_bits;
+    uint64_t *mark_bits;
     struct lzsubpool *prev;
     struct lzsubpool *next;
 }LZSubPool;
@@ -23,6 +31,8 @@ typedef struct lzsubpool{
 typedef struct lzpool_header{
     size_t magic;
     char used;
+    // Position of the slot in its subpool
+    uint32_t idx;
     void *pool;
     LZSubPool *subpool;
     struct lzpool_header *prev;
@@ -42,6 +52,14 @@ typedef struct lzsubpool_list{
 }LZSubPoolList;
 
 typedef struct lzpool{
+    char bitmaps;
+    // Mark bits equal to the mask's bits are unmarked. It is
+    // flipped at the end of each marking cycle (see lzpool_flip_marks)
+    uint64_t mark_flip;
+    // Next subpool with garbage from the last marking cycle
+    LZSubPool *sweep_cursor;
+    LZPoolSweeper sweeper;
+    void *sweeper_ctx;
     size_t header_size;
     size_t slot_size;
     LZPoolHeaderList slots;
@@ -49,7 +67,12 @@ typedef struct lzpool{
     LZPoolAllocator *allocator;
 }LZPool;
 
+#define LZPOOL_HEADER_SIZE \
+    ((sizeof(LZPoolHeader) + LZPOOL_DEFAULT_ALIGNMENT - 1) / LZPOOL_DEFAULT_ALIGNMENT * LZPOOL_DEFAULT_ALIGNMENT)
+#define LZPOOL_SLOT_HEADER(_ptr)((LZPoolHeader *)(((char *)(_ptr)) - LZPOOL_HEADER_SIZE))
+
 void lzpool_init(size_t slot_size, LZPoolAllocator *allocator, LZPool *pool);
+void lzpool_init_bitmaps(size_t slot_size, LZPoolAllocator *allocator, LZPool *pool);
 void lzpool_destroy_deinit(LZPool *pool);
 
 LZPool *lzpool_create(size_t slot_size, LZPoolAllocator *allocator);
@@ -62,4 +85,83 @@ void *lzpool_alloc_x(size_t slots_count, LZPool *pool);
 void lzpool_dealloc(void *ptr);
 void lzpool_dealloc_release(void *ptr);
 
+// The following only apply to pools created by lzpool_init_bitmaps
+
+// Makes the slot visible to the sweeper, as unmarked.
+// Slots stop being live when deallocated
+static inline void lzpool_set_live(void *ptr){
+    LZPoolHeader *slot = LZPOOL_SLOT_HEADER(ptr);
+    LZSubPool *subpool = slot->subpool;
+    size_t idx = slot->idx / LZPOOL_BITMAP_WORD_BITS;
+    uint64_t bit = (uint64_t)1 << (slot->idx % LZPOOL_BITMAP_WORD_BITS);
+    uint64_t mark_flip = ((LZPool *)slot->pool)->mark_flip;
+
+    subpool->live_bits[idx] |= bit;
+    subpool->mark_bits[idx] = (subpool->mark_bits[idx] & ~bit) | (mark_flip & bit);
+}
+
+// Marks the slot. Returns 1 if it was already marked
+static inline int lzpool_mark(void *ptr){
+    LZPoolHeader *slot = LZPOOL_SLOT_HEADER(ptr);
+    uint64_t *word = &slot->subpool->mark_bits[slot->idx / LZPOOL_BITMAP_WORD_BITS];
+    uint64_t bit = (uint64_t)1 << (slot->idx % LZPOOL_BITMAP_WORD_BITS);
+
+    if((*word ^ ((LZPool *)slot->pool)->mark_flip) & bit){
+        return 1;
+    }
+
+    *word ^= bit;
+
+    return 0;
+}
+
+// Like lzpool_mark, but safe to use from several threads at once
+static inline int lzpool_mark_atomic(void *ptr){
+    LZPoolHeader *slot = LZPOOL_SLOT_HEADER(ptr);
+    uint64_t *word = &slot->subpool->mark_bits[slot->idx / LZPOOL_BITMAP_WORD_BITS];
+    uint64_t bit = (uint64_t)1 << (slot->idx % LZPOOL_BITMAP_WORD_BITS);
+    uint64_t mark_flip = ((LZPool *)slot->pool)->mark_flip;
+
+    if((__atomic_load_n(word, __ATOMIC_RELAXED) ^ mark_flip) & bit){
+        return 1;
+    }
+
+    // Toggling is not idempotent, so the bit is set or cleared explicitly
+    if(mark_flip){
+        return (__atomic_fetch_and(word, ~bit, __ATOMIC_RELAXED) & bit) == 0;
+    }
+
+    return (__atomic_fetch_or(word, bit, __ATOMIC_RELAXED) & bit) != 0;
+}
+
+static inline int lzpool_is_marked(void *ptr){
+    LZPoolHeader *slot = LZPOOL_SLOT_HEADER(ptr);
+    uint64_t word = slot->subpool->mark_bits[slot->idx / LZPOOL_BITMAP_WORD_BITS];
+
+    return ((word ^ ((LZPool *)slot->pool)->mark_flip) >> (slot->idx % LZPOOL_BITMAP_WORD_BITS)) & 1;
+}
+
+static inline void lzpool_unmark(void *ptr){
+    LZPoolHeader *slot = LZPOOL_SLOT_HEADER(ptr);
+    uint64_t *word = &slot->subpool->mark_bits[slot->idx / LZPOOL_BITMAP_WORD_BITS];
+    uint64_t bit = (uint64_t)1 << (slot->idx % LZPOOL_BITMAP_WORD_BITS);
+
+    *word = (*word & ~bit) | (((LZPool *)slot->pool)->mark_flip & bit);
+}
+
+// Ends a marking cycle. Flipping the meaning of the mark bits turns
+// marked slots into unmarked ones without touching them, and leaves
+// the unmarked ones as garbage. Garbage is passed to 'sweeper' a
+// subpool at a time: by lzpool_alloc_x before growing the pool, or by
+// lzpool_sweep_step and lzpool_sweep. The sweeper can dealloc the slot,
+// but must not release its subpool. Every subpool must be swept before
+// marking again, as the bits of garbage read as marked after the flip
+void lzpool_flip_marks(LZPoolSweeper sweeper, void *ctx, LZPool *pool);
+// Sweeps the next subpool with garbage. Returns 0 if there was none
+int lzpool_sweep_step(LZPool *pool);
+void lzpool_sweep(LZPool *pool);
+// Calls 'sweeper' with every live slot, marked or not.
+// Garbage waiting for a sweep is included
+void lzpool_sweep_all(LZPoolSweeper sweeper, void *ctx, LZPool *pool);
+
 #endif
\ No newline at end of file
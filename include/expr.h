@@ -31,7 +31,8 @@ typedef enum expr_type{
     DICT_EXPRTYPE,
 	RECORD_EXPRTYPE,
 	IS_EXPRTYPE,
-	TENARY_EXPRTYPE
+	TENARY_EXPRTYPE,
+	YIELD_EXPRTYPE
 }ExprType;
 
 typedef struct expr{
@@ -195,4 +196,10 @@ typedef struct tenary_expr{
     Expr *right;
 }TenaryExpr;
 
+typedef struct yield_expr{
+    Token *yield_token;
+    // NULL when nothing follows the keyword: empty is yielded
+    Expr *value_expr;
+}YieldExpr;
+
 #endif
@@ -7,6 +7,7 @@ typedef enum native_type{
 	RANDOM_NATIVE_TYPE,
 	FILE_NATIVE_TYPE,
 	NBARRAY_NATIVE_TYPE,
+	CHAN_NATIVE_TYPE,
 }NativeType;
 
 typedef void (* NativeDestroyHelper)(void *native, Allocator *allocator);
@@ -0,0 +1,80 @@
+#ifndef NATIVE_CHAN_H
+#define NATIVE_CHAN_H
+
+#include "native.h"
+
+#include "vm/vmu.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Most messages a channel can hold
+#define CHAN_CAPACITY_LENGTH (1 << 20)
+// Times a blocked send or recv retries before it parks its thread
+#define CHAN_SPINS 256
+// Most containers nested in a message. Deeper values are likely cyclic
+#define CHAN_DEPTH_LENGTH 64
+#define CHAN_PAD_SIZE 64
+
+typedef struct chan_cell{
+	// Position of the send which can fill the cell, or, once filled,
+	// that position plus one: the position of the recv which can empty it
+	size_t seq;
+	void *msg;
+}ChanCell;
+
+// Bounded queue of messages shared by the isolates. Any count of them can
+// send and receive at the same time, without locks. Who finds it full or
+// empty waits on the count of receives or sends done, which the other
+// side increases and wakes
+typedef struct channel{
+	char *name;
+	size_t mask;
+	ChanCell *cells;
+	char pad0[CHAN_PAD_SIZE];
+	size_t send_pos;
+	char pad1[CHAN_PAD_SIZE];
+	size_t recv_pos;
+	char pad2[CHAN_PAD_SIZE];
+	uint32_t sends;
+	uint32_t recvs;
+	uint32_t parked_senders;
+	uint32_t parked_receivers;
+	uint32_t closed;
+	struct channel *next;
+}Channel;
+
+typedef struct chan_native{
+	NativeHeader header;
+	Channel *channel;
+}ChanNative;
+
+// Returns the channel named 'name', creating it with room for 'capacity'
+// messages, rounded up to a power of two, if it does not exist. Channels
+// live as long as the process. Returns NULL if memory cannot be allocated
+Channel *channel_open(const char *name, size_t capacity);
+size_t channel_capacity(const Channel *channel);
+// Blocks while the channel is full. Returns 1 if it is closed
+int channel_send(void *msg, Channel *channel);
+// Blocks while the channel is empty. Returns NULL if it is closed and empty
+void *channel_recv(Channel *channel);
+// Wakes everyone waiting on the channel. Sends fail from now on,
+// and receives fail once the messages left are taken
+void channel_close(Channel *channel);
+
+// Copies 'value' out of the heap of 'vm' into a message. Strings, arrays,
+// lists, dicts and records are copied deeply. The bytes of nbarrays are
+// moved instead: the nbarrays are left empty. Other values are errors of 'vm'
+void *chan_msg_create(Value value, VM *vm);
+// Like chan_msg_create, for an array of the 'len' values, but the bytes of
+// nbarrays are copied: the values are left as they were
+void *chan_msg_copy(size_t len, const Value *values, VM *vm);
+// Creates the value of 'msg' in the heap of 'vm' and destroys the message
+Value chan_msg_open(void *msg, VM *vm);
+// Destroys a message which will not be opened, with the bytes it moved
+void chan_msg_destroy(void *msg);
+
+ChanNative *chan_native_create(Channel *channel, Allocator *allocator);
+CREATE_VALIDATE_NATIVE_DECLARATION(chan_native, ChanNative)
+
+#endif
@@ -2,15 +2,23 @@
 #define NARRAY_NATIVE_H
 
 #include "native.h"
+#include "vm/vm.h"
 #include "vm/vmu.h"
 
 typedef struct narray_native{
 	NativeHeader header;
 	size_t len;
+	// Allocated out of the heap of the VM, and counted against
+	// it, so they can be moved to the nbarrays of other isolates
 	unsigned char *bytes;
+	VM *vm;
 }NBArrayNative;
 
-NBArrayNative *nbarray_native_create(size_t len, Allocator *allocator);
+NBArrayNative *nbarray_native_create(size_t len, VM *vm);
+// Creates a nbarray owning 'bytes', which were released by another one
+NBArrayNative *nbarray_native_adopt(size_t len, unsigned char *bytes, VM *vm);
+// Takes the ownership of the bytes away from the nbarray, which is left empty
+unsigned char *nbarray_native_release(NBArrayNative *nbarray_native);
 CREATE_VALIDATE_NATIVE_DECLARATION(nbarray_native, NBArrayNative)
 
 #endif
@@ -0,0 +1,92 @@
+#ifndef NATIVE_PARALLEL_H
+#define NATIVE_PARALLEL_H
+
+#include "vm/vm.h"
+#include "value.h"
+#include "vm/isolate.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+// Chunks the values are split in for each worker. The workers which
+// are done with theirs steal the chunks left to the others
+#define PARALLEL_CHUNKS_PER_WORKER 8
+#define PARALLEL_PAD_SIZE 64
+
+typedef struct parallel_job ParallelJob;
+typedef struct parallel_pool ParallelPool;
+
+typedef struct parallel_worker{
+	char pad0[PARALLEL_PAD_SIZE];
+	// Chunks of the worker not taken yet, from 'next' to 'end'. Taken
+	// by atomic increments of 'next', by the worker and by the thieves
+	size_t next;
+	char pad1[PARALLEL_PAD_SIZE];
+	size_t end;
+	size_t id;
+	// Set when a call failed, or before the isolate is created. The
+	// state of its VM is unknown, so it is replaced before the next job
+	char failed;
+	// Last job the worker woke up for
+	size_t generation;
+	Isolate *isolate;
+	// Copy of the function to call in the program of the isolate. For
+	// closures, 'meta_closure' is set and 'out_values' is the message
+	// with the values they captured
+	Fn *fn;
+	MetaClosure *meta_closure;
+	void *out_values;
+	ParallelPool *pool;
+}ParallelWorker;
+
+struct parallel_job{
+	size_t len;
+	// The message of each chunk of the values, or NULL for ranges of integers
+	void **inputs;
+	int64_t from;
+	size_t chunk_len;
+	size_t chunks_len;
+	// The message with the results of each chunk
+	void **outputs;
+	uint32_t failed;
+	// Message of the error of the first worker which failed
+	char error_msg[ERROR_MSG_LENGTH];
+	// Workers taking part in the job, the first ones of the pool
+	size_t workers_len;
+};
+
+// Worker isolates of a VM, created by its first call and kept until it
+// is destroyed. Their threads wait for the jobs of the next calls
+struct parallel_pool{
+	pthread_mutex_t mutex;
+	// Signaled when a job is given to the workers, or when they must stop
+	pthread_cond_t job_cond;
+	// Signaled when the last worker taking part in the job is done
+	pthread_cond_t done_cond;
+	// Increased for each job
+	size_t generation;
+	size_t running;
+	char stop;
+	ParallelJob *job;
+	size_t workers_len;
+	ParallelWorker workers[ISOLATES_LENGTH];
+};
+
+// Calls 'fn', a function or closure of one parameter, with each of the
+// 'len' values, which are at least one, in the worker isolates of 'vm', one
+// per processor at most.
+// Returns an array with the results, in the order of the values. The values,
+// the values captured by closures and the results must be ones channels
+// can send. The isolates only see the globals of the program which are not
+// objects, as they are when the call starts, apart from its functions and
+// modules. Errors of the calls are thrown in 'vm', with the message of the
+// first one
+Value parallel_map(Value fn, size_t len, const Value *values, VM *vm);
+// Like parallel_map, with the integers from 'from' to 'to', which is not
+// included. Arrays cannot be empty: 'to' must be greater than 'from'
+Value parallel_range(Value fn, int64_t from, int64_t to, VM *vm);
+// Stops the threads of the workers and destroys their isolates
+void parallel_pool_destroy(ParallelPool *pool);
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef NATIVE_MODULE_CHAN_H
+#define NATIVE_MODULE_CHAN_H
+
+#include "native/native_chan.h"
+
+#include "vm/obj.h"
+#include "vm/vm_factory.h"
+#include "vm/types_utils.h"
+#include "vm/vmu.h"
+
+NativeModule *chan_native_module = NULL;
+
+Value native_fn_chan_open(uint8_t argsc, Value *values, Value target, void *context){
+	StrObj *name_str_obj = validate_value_str_arg(values[0], 1, "name", VMU_VM);
+	size_t capacity = (size_t)validate_value_int_range_arg(
+		values[1],
+		2,
+		"capacity",
+		1,
+		CHAN_CAPACITY_LENGTH,
+		VMU_VM
+	);
+	Channel *channel = channel_open(name_str_obj->buff, capacity);
+
+	if(!channel){
+		vmu_error(VMU_VM, "Failed to open channel '%s': out of memory", name_str_obj->buff);
+	}
+
+	ChanNative *chan_native = chan_native_create(channel, VMU_NATIVE_FRONT_ALLOCATOR);
+	NativeObj *native_obj = vmu_create_native(chan_native, VMU_VM);
+
+	return OBJ_VALUE(native_obj);
+}
+
+Value native_fn_chan_capacity(uint8_t argsc, Value *values, Value target, void *context){
+	ChanNative *chan_native = chan_native_validate_value_arg(values[0], 1, "channel", VMU_VM);
+	return INT_VALUE((int64_t)channel_capacity(chan_native->channel));
+}
+
+Value native_fn_chan_send(uint8_t argsc, Value *values, Value target, void *context){
+	ChanNative *chan_native = chan_native_validate_value_arg(values[0], 1, "channel", VMU_VM);
+	Channel *channel = chan_native->channel;
+
+	if(__atomic_load_n(&channel->closed, __ATOMIC_SEQ_CST)){
+		vmu_error(VMU_VM, "Failed to send: channel '%s' is closed", channel->name);
+	}
+
+	void *msg = chan_msg_create(values[1], VMU_VM);
+
+	if(channel_send(msg, channel)){
+		chan_msg_destroy(msg);
+		vmu_error(VMU_VM, "Failed to send: channel '%s' is closed", channel->name);
+	}
+
+	return EMPTY_VALUE;
+}
+
+Value native_fn_chan_recv(uint8_t argsc, Value *values, Value target, void *context){
+	ChanNative *chan_native = chan_native_validate_value_arg(values[0], 1, "channel", VMU_VM);
+	void *msg = channel_recv(chan_native->channel);
+
+	if(!msg){
+		return EMPTY_VALUE;
+	}
+
+	return chan_msg_open(msg, VMU_VM);
+}
+
+Value native_fn_chan_close(uint8_t argsc, Value *values, Value target, void *context){
+	ChanNative *chan_native = chan_native_validate_value_arg(values[0], 1, "channel", VMU_VM);
+	channel_close(chan_native->channel);
+	return EMPTY_VALUE;
+}
+
+Value native_fn_chan_is_closed(uint8_t argsc, Value *values, Value target, void *context){
+	ChanNative *chan_native = chan_native_validate_value_arg(values[0], 1, "channel", VMU_VM);
+	return BOOL_VALUE(__atomic_load_n(&chan_native->channel->closed, __ATOMIC_SEQ_CST));
+}
+
+void chan_module_init(const Allocator *allocator){
+	chan_native_module = vm_factory_native_module_create(allocator, "chan");
+
+	vm_factory_native_module_add_native_fn(chan_native_module, "open", 2, native_fn_chan_open);
+	vm_factory_native_module_add_native_fn(chan_native_module, "capacity", 1, native_fn_chan_capacity);
+	vm_factory_native_module_add_native_fn(chan_native_module, "send", 2, native_fn_chan_send);
+	vm_factory_native_module_add_native_fn(chan_native_module, "recv", 1, native_fn_chan_recv);
+	vm_factory_native_module_add_native_fn(chan_native_module, "close", 1, native_fn_chan_close);
+	vm_factory_native_module_add_native_fn(chan_native_module, "is_closed", 1, native_fn_chan_is_closed);
+}
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef NATIVE_MODULE_COROUTINE_H
+#define NATIVE_MODULE_COROUTINE_H
+
+#include "vm/obj.h"
+#include "vm/vm_factory.h"
+#include "vm/types_utils.h"
+#include "vm/vmu.h"
+
+NativeModule *coroutine_native_module = NULL;
+
+Value native_fn_coroutine_create(uint8_t argsc, Value *values, Value target, void *context){
+	CoroutineObj *coroutine_obj = vmu_create_coroutine(values[0], VMU_VM);
+	return OBJ_VALUE(coroutine_obj);
+}
+
+Value native_fn_coroutine_done(uint8_t argsc, Value *values, Value target, void *context){
+	if(!is_value_coroutine(values[0])){
+		vmu_error(VMU_VM, "Illegal type of argument 1: expect 'coroutine' of type 'coroutine'");
+	}
+
+	CoroutineObj *coroutine_obj = VALUE_TO_COROUTINE(values[0]);
+
+	return BOOL_VALUE(coroutine_obj->state == DEAD_COROUTINE_STATE);
+}
+
+void coroutine_module_init(const Allocator *allocator){
+	coroutine_native_module = vm_factory_native_module_create(allocator, "coroutine");
+
+	vm_factory_native_module_add_native_fn(coroutine_native_module, "create", 1, native_fn_coroutine_create);
+	vm_factory_native_module_add_native_fn(coroutine_native_module, "done", 1, native_fn_coroutine_done);
+}
+
+#endif
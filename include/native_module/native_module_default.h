@@ -209,6 +209,7 @@ Value native_fn_readln(uint8_t argsc, Value *values, Value target, void *context
 
 Value native_fn_gc(uint8_t argsc, Value *values, Value target, void *context){
     vmu_gc(context);
+    vmu_gc_sweep(context);
     return EMPTY_VALUE;
 }
 
@@ -152,21 +152,21 @@ void math_module_init(const Allocator *allocator){
     vm_factory_native_module_add_value(math_native_module, "PI", FLOAT_VALUE(PI));
     vm_factory_native_module_add_value(math_native_module, "E", FLOAT_VALUE(E));
 
-    vm_factory_native_module_add_native_fn(math_native_module, "min", 2, native_fn_min);
-    vm_factory_native_module_add_native_fn(math_native_module, "max", 2, native_fn_max);
-	vm_factory_native_module_add_native_fn(math_native_module, "sqrt", 1, native_fn_sqrt);
-    vm_factory_native_module_add_native_fn(math_native_module, "pow", 2, native_fn_pow);
-    vm_factory_native_module_add_native_fn(math_native_module, "cos", 1, native_fn_cos);
-    vm_factory_native_module_add_native_fn(math_native_module, "acos", 1, native_fn_acos);
-    vm_factory_native_module_add_native_fn(math_native_module, "cosh", 1, native_fn_cosh);
-    vm_factory_native_module_add_native_fn(math_native_module, "sin", 1, native_fn_sin);
-    vm_factory_native_module_add_native_fn(math_native_module, "asin", 1, native_fn_asin);
-    vm_factory_native_module_add_native_fn(math_native_module, "sinh", 1, native_fn_sinh);
-    vm_factory_native_module_add_native_fn(math_native_module, "tan", 1, native_fn_tan);
-    vm_factory_native_module_add_native_fn(math_native_module, "atan", 1, native_fn_atan);
-    vm_factory_native_module_add_native_fn(math_native_module, "tanh", 1, native_fn_tanh);
-    vm_factory_native_module_add_native_fn(math_native_module, "rad2deg", 1, native_fn_rad2deg);
-    vm_factory_native_module_add_native_fn(math_native_module, "deg2rad", 1, native_fn_deg2rad);
+    vm_factory_native_module_add_pure_native_fn(math_native_module, "min", 2, native_fn_min);
+    vm_factory_native_module_add_pure_native_fn(math_native_module, "max", 2, native_fn_max);
+	vm_factory_native_module_add_pure_native_fn(math_native_module, "sqrt", 1, native_fn_sqrt);
+    vm_factory_native_module_add_pure_native_fn(math_native_module, "pow", 2, native_fn_pow);
+    vm_factory_native_module_add_pure_native_fn(math_native_module, "cos", 1, native_fn_cos);
+    vm_factory_native_module_add_pure_native_fn(math_native_module, "acos", 1, native_fn_acos);
+    vm_factory_native_module_add_pure_native_fn(math_native_module, "cosh", 1, native_fn_cosh);
+    vm_factory_native_module_add_pure_native_fn(math_native_module, "sin", 1, native_fn_sin);
+    vm_factory_native_module_add_pure_native_fn(math_native_module, "asin", 1, native_fn_asin);
+    vm_factory_native_module_add_pure_native_fn(math_native_module, "sinh", 1, native_fn_sinh);
+    vm_factory_native_module_add_pure_native_fn(math_native_module, "tan", 1, native_fn_tan);
+    vm_factory_native_module_add_pure_native_fn(math_native_module, "atan", 1, native_fn_atan);
+    vm_factory_native_module_add_pure_native_fn(math_native_module, "tanh", 1, native_fn_tanh);
+    vm_factory_native_module_add_pure_native_fn(math_native_module, "rad2deg", 1, native_fn_rad2deg);
+    vm_factory_native_module_add_pure_native_fn(math_native_module, "deg2rad", 1, native_fn_deg2rad);
 }
 
 #endif
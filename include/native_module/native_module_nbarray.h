@@ -215,7 +215,7 @@ Value native_fn_nbarray_clone(uint8_t argsc, Value *values, Value target, void *
 	size_t nbarray_len = nbarray->len;
 	NBArrayNative *cloned_nbarray = nbarray_native_create(
 		nbarray_len,
-		VMU_NATIVE_FRONT_ALLOCATOR
+		VMU_VM
 	);
 	NativeObj *native_obj = vmu_create_native(cloned_nbarray, VMU_VM);
 
@@ -275,7 +275,7 @@ Value native_fn_nbarray_create(uint8_t argsc, Value *values, Value target, void
 	size_t len = validate_value_len_arg(values[0], 1, "len", VMU_VM);
 	NBArrayNative *nbarray_native = nbarray_native_create(
 		len,
-		VMU_NATIVE_FRONT_ALLOCATOR
+		VMU_VM
 	);
 	NativeObj *native_obj = vmu_create_native(nbarray_native, VMU_VM);
 
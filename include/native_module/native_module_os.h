@@ -39,11 +39,21 @@ Value native_fn_os_path_separator(uint8_t argsc, Value *values, Value target, vo
     return OBJ_VALUE(str_obj);
 }
 
+Value native_fn_os_isolate(uint8_t argsc, Value *values, Value target, void *context){
+    return INT_VALUE((int64_t)VMU_VM->isolate_id);
+}
+
+Value native_fn_os_isolates(uint8_t argsc, Value *values, Value target, void *context){
+    return INT_VALUE((int64_t)VMU_VM->isolates_len);
+}
+
 void os_module_init(const Allocator *allocator){
     os_native_module = vm_factory_native_module_create(allocator, "os");
 
     vm_factory_native_module_add_native_fn(os_native_module, "name", 0, native_fn_os_name);
     vm_factory_native_module_add_native_fn(os_native_module, "path_separator", 0, native_fn_os_path_separator);
+    vm_factory_native_module_add_native_fn(os_native_module, "isolate", 0, native_fn_os_isolate);
+    vm_factory_native_module_add_native_fn(os_native_module, "isolates", 0, native_fn_os_isolates);
 }
 
 #endif
@@ -0,0 +1,31 @@
+#ifndef NATIVE_MODULE_PARALLEL_H
+#define NATIVE_MODULE_PARALLEL_H
+
+#include "native/native_parallel.h"
+
+#include "vm/obj.h"
+#include "vm/vm_factory.h"
+#include "vm/types_utils.h"
+#include "vm/vmu.h"
+
+NativeModule *parallel_native_module = NULL;
+
+Value native_fn_parallel_map(uint8_t argsc, Value *values, Value target, void *context){
+	ArrayObj *array_obj = validate_value_array_arg(values[0], 1, "array", VMU_VM);
+	return parallel_map(values[1], array_obj->len, array_obj->values, VMU_VM);
+}
+
+Value native_fn_parallel_range(uint8_t argsc, Value *values, Value target, void *context){
+	int64_t from = validate_value_int_arg(values[0], 1, "from", VMU_VM);
+	int64_t to = validate_value_int_arg(values[1], 2, "to", VMU_VM);
+	return parallel_range(values[2], from, to, VMU_VM);
+}
+
+void parallel_module_init(const Allocator *allocator){
+	parallel_native_module = vm_factory_native_module_create(allocator, "parallel");
+
+	vm_factory_native_module_add_native_fn(parallel_native_module, "map", 2, native_fn_parallel_map);
+	vm_factory_native_module_add_native_fn(parallel_native_module, "range", 3, native_fn_parallel_range);
+}
+
+#endif
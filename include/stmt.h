@@ -15,6 +15,7 @@ typedef enum stmt_type{
     CONTINUE_STMT_TYPE,
     WHILE_STMT_TYPE,
     FOR_RANGE_STMT_TYPE,
+    FOR_IN_STMT_TYPE,
     THROW_STMT_TYPE,
     TRY_STMT_TYPE,
     RETURN_STMT_TYPE,
@@ -72,6 +73,14 @@ typedef struct for_range_stmt{
     DynArr *stmts;
 }ForRangeStmt;
 
+typedef struct for_in_stmt{
+    Token *for_token;
+    Token *symbol_token;
+    Token *in_token;
+    Expr *iterable_expr;
+    DynArr *stmts;
+}ForInStmt;
+
 typedef struct throw_stmt{
     Token *throw_token;
 	Expr *value_expr;
@@ -49,7 +49,8 @@ typedef enum tok_type{
     INT_TOKTYPE, STR_TOKTYPE,
     IS_TOKTYPE, TRY_TOKTYPE,
     CATCH_TOKTYPE, THROW_TOKTYPE,
-    EXPORT_TOKTYPE,
+    EXPORT_TOKTYPE, IN_TOKTYPE,
+    YIELD_TOKTYPE,
 
     //types
     INT_TYPE_TOKTYPE, FLOAT_TYPE_TOKTYPE,
@@ -11,6 +11,13 @@ typedef enum value_type{
 	OBJ_VALUE_TYPE
 }ValueType;
 
+#ifdef NAN_BOXING
+// The type is encoded inside the 64 bits of the value.
+// See vm/types_utils.h for the layout.
+typedef struct value{
+    uint64_t bits;
+}Value;
+#else
 typedef struct value{
     ValueType type;
 
@@ -21,10 +28,13 @@ typedef struct value{
 		void *obj_val;
     }content;
 }Value;
+#endif
 
 typedef enum global_value_access_type{
     PRIVATE_GLOVAL_VALUE_TYPE,
     PUBLIC_GLOBAL_VALUE_TYPE,
+    // slot reserved at compile time, but not defined yet
+    UNDEFINED_GLOBAL_VALUE_TYPE,
 }GlobalValueAccessType;
 
 typedef struct global_value{
@@ -33,7 +43,6 @@ typedef struct global_value{
 }GlobalValue;
 
 #define VALUE_SIZE sizeof(Value)
-#define VALUE_TYPE(_value)((_value)->type)
 #define IS_VALUE_MARKED(_object)(((ObjHeader *)(_object))->marked == 1)
 
 #endif
\ No newline at end of file
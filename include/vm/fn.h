@@ -5,6 +5,7 @@
 #include "essentials/dynarr.h"
 
 #include "module.h"
+#include "native_fn.h"
 
 #define NAME_LEN 256
 
@@ -14,6 +15,20 @@ typedef struct opcode_location{
     char *filepath;
 }OPCodeLocation;
 
+struct shape;
+struct jit_code;
+
+// What an access site resolved the last time. Methods of built in types
+// only depend on the type of the target, and attributes of records on
+// their shape. Sites inserting attributes also keep the shape they lead to
+typedef struct access_cache{
+    int type;
+    NativeFn *native_fn;
+    const struct shape *shape;
+    struct shape *next_shape;
+    size_t offset;
+}AccessCache;
+
 typedef struct fn{
     uint8_t arity;
     char *name;
@@ -21,6 +36,18 @@ typedef struct fn{
     DynArr *iconsts;
     DynArr *fconsts;
     DynArr *locations;
+    DynArr *caches;
+    // Most values on the stack of the function at once, counting
+    // from its first parameter. Proven by the verifier
+    size_t stack_len;
+    // Calls plus loop iterations run by the interpreter, until it is compiled
+    size_t hotness;
+    // Machine code of the function, or NULL if it was not compiled
+    struct jit_code *jit_code;
+    // The function could not be compiled, so it is not tried again
+    char jit_failed;
+    // JitLoop of the loops reached by the tracing JIT, created on demand
+    DynArr *jit_loops;
     Module *module;
     const Allocator *allocator;
 }Fn;
@@ -0,0 +1,64 @@
+#ifndef ISOLATE_H
+#define ISOLATE_H
+
+#include "essentials/memory.h"
+#include "essentials/lzflist.h"
+#include "essentials/lzohtable.h"
+#include "module.h"
+#include "vm.h"
+
+#include <stddef.h>
+#include <pthread.h>
+
+#define ISOLATES_LENGTH 256
+
+typedef struct isolate Isolate;
+// Runs in the thread of the isolate instead of its program
+typedef int (*IsolateTask)(Isolate *isolate, void *ctx);
+
+// A VM with its own heap running a compiled program in its own thread.
+// The constants, static strings, locations and names of the program, and
+// the native modules, are shared with the other isolates. The bytecode,
+// which is quickened while it runs, the access caches, the globals and the
+// machine code are copied or created for each isolate
+struct isolate{
+    size_t id;
+    int result;
+    LZFList *flist;
+    Allocator allocator;
+    // Copies of the program made for the isolate, by the original they copy
+    LZOHTable *clones;
+    // Submodules of the program copied, to update their copies
+    DynArr *submodules;
+    LZOHTable *native_fns;
+    Module *module;
+    VM *vm;
+    IsolateTask task;
+    void *task_ctx;
+    pthread_t thread;
+};
+
+// Creates the isolate 'id' out of 'len' to run 'module'. The program must
+// not be running in any other thread. If a VM ran it, the globals that VM
+// assigned objects to are left undefined in the copy: only the functions,
+// modules and values which are not objects are kept. 'native_fns' is only
+// read. Returns NULL if memory cannot be allocated. The VM can be
+// configured before the isolate starts
+Isolate *isolate_create(size_t id, size_t len, LZOHTable *native_fns, Module *module);
+// Copies of 'fn' and 'meta_closure' in the program of the isolate
+Fn *isolate_fn(const Fn *fn, Isolate *isolate);
+MetaClosure *isolate_meta_closure(MetaClosure *meta_closure, Isolate *isolate);
+// Updates the copies of the globals of the program which are not objects,
+// and of the functions and modules defined since the copies were made.
+// The isolate must not be running, nor the program in any other thread
+void isolate_sync(Isolate *isolate);
+// Runs the program in a new thread. Returns 1 if the thread cannot be created
+int isolate_start(Isolate *isolate);
+// Like isolate_start, but runs 'task' instead of the program
+int isolate_start_task(IsolateTask task, void *ctx, Isolate *isolate);
+// Waits for the program to end. Returns the result of vm_execute, or of the task
+int isolate_join(Isolate *isolate);
+// Destroys the VM and the heap of an isolate which is not running
+void isolate_destroy(Isolate *isolate);
+
+#endif
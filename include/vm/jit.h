@@ -0,0 +1,125 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include "essentials/memory.h"
+#include "essentials/dynarr.h"
+#include "fn.h"
+#include "vm.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Calls plus loop iterations a function runs in the interpreter before it is compiled
+#define JIT_HOT_THRESHOLD 1000
+// Iterations a loop runs in the interpreter before it is recorded
+#define JIT_TRACE_THRESHOLD 100
+// Recordings of a loop aborted before it is given up
+#define JIT_TRACE_ATTEMPTS 4
+// Most instructions a trace records
+#define JIT_TRACE_LEN 256
+// Most machine code runs nested in the C stack. Calls past it are left to the interpreter
+#define JIT_NESTING_LENGTH 255
+
+// Why the machine code of a function gave control back
+typedef enum jit_status{
+    // The function returned: its frame is popped and its result pushed
+    RETURNED_JIT_STATUS = 1,
+    // The interpreter must continue from the ip of the current frame
+    INTERPRET_JIT_STATUS,
+    // The last frame returned
+    HALT_JIT_STATUS,
+}JitStatus;
+
+// Executes the instruction at the ip of the current frame, for the ones
+// the machine code does not implement itself. Returns 0 to continue
+// with the next instruction, or the JitStatus the code must return
+typedef int (*JitStep)(VM *vm);
+// Called at the backward jumps of the machine code when 'gc_request' is set
+typedef void (*JitSafepoint)(VM *vm);
+
+// What jit_record tells of the recording
+typedef enum record_status{
+    RECORDING_RECORD_STATUS,
+    // The loop went back to its header: the trace is complete
+    CLOSED_RECORD_STATUS,
+    // The loop did something traces do not support
+    ABORTED_RECORD_STATUS,
+}RecordStatus;
+
+// Types a trace is specialized on
+typedef enum trace_type{
+    OTHER_TRACE_TYPE,
+    // Only the integers which are not boxed
+    INT_TRACE_TYPE,
+    FLOAT_TRACE_TYPE,
+    ARRAY_TRACE_TYPE,
+}TraceType;
+
+// Instruction executed while recording, with the TraceType of the values it
+// read, in the order the interpreter reads them. For the stack instructions
+// that is from the deepest operand, but for indexing, which reads the target,
+// then the index and then the assigned value
+typedef struct trace_op{
+    size_t offset;
+    uint8_t types[3];
+}TraceOp;
+
+// Records the instructions the interpreter executes in an iteration of a loop
+typedef struct jit_recorder{
+    const Fn *fn;
+    const Frame *frame;
+    // Offset of the first instruction of the loop: the target of its backward jump
+    size_t header;
+    DynArr *ops;
+}JitRecorder;
+
+// Machine code of a function. It can be entered at any of its instructions,
+// so the interpreter and the machine code can hand the frame to each other
+typedef struct jit_code{
+    size_t len;
+    uint8_t *code;
+    // Address of the machine code of each instruction by its offset.
+    // Traces only have one: the one of their header
+    size_t entries_len;
+    void **entries;
+    // Next code compiled by the same VM
+    struct jit_code *next;
+    const Allocator *allocator;
+}JitCode;
+
+// Loop of a function seen by the tracing JIT, by the offset of its header
+typedef struct jit_loop{
+    size_t header;
+    // Iterations run by the interpreter since the last recording
+    size_t hotness;
+    size_t aborts;
+    JitCode *trace;
+}JitLoop;
+
+// Compiles 'fn' to machine code of the host (only Linux x86-64). Values are kept in
+// the stack of the VM: the code only does by itself the stack, local and jump
+// instructions, and arithmetic and comparisons of integers. Everything else
+// calls 'step' or leaves to the interpreter. Returns NULL on unsupported
+// hosts or if memory cannot be allocated
+JitCode *jit_compile(const Fn *fn, JitStep step, JitSafepoint safepoint, const Allocator *allocator);
+void jit_destroy(JitCode *jit_code);
+// Runs the code from the ip of 'frame', which must be the current one. Returns a JitStatus
+int jit_run(const JitCode *jit_code, Frame *frame, VM *vm);
+// Maps the quickened and register arithmetic and comparison opcodes to
+// the stack opcode doing the same operation. Others are returned as is
+uint8_t jit_generic_opcode(uint8_t opcode);
+
+// Called when the interpreter fetches the instruction at the last_offset
+// of 'frame' while 'recorder' is active. Returns a RecordStatus
+int jit_record(JitRecorder *recorder, const Frame *frame, const VM *vm);
+// Compiles the recorded iteration to machine code which loops while the values
+// have the recorded types and the branches go the recorded way. Else it leaves
+// to the interpreter at the offset of the instruction which could not continue,
+// before it changed anything. The offsets are those of the bytecode, so the
+// interpreter and Fn.locations need nothing else to take over. Returns NULL
+// like jit_compile, or if the iteration has instructions traces do not support
+JitCode *jit_compile_trace(const Fn *fn, const DynArr *ops, JitStep step, JitSafepoint safepoint, const Allocator *allocator);
+// Runs the trace from its header, which must be the ip of 'frame'. Returns a JitStatus
+int jit_run_trace(const JitCode *trace, Frame *frame, VM *vm);
+
+#endif
@@ -5,6 +5,8 @@
 #include "essentials/dynarr.h"
 #include "essentials/lzohtable.h"
 
+#include "value.h"
+
 typedef struct try_block{
     size_t try;
     size_t catch;
@@ -24,9 +26,18 @@ typedef struct submodule_symbol{
     void *value;
 }SubModuleSymbol;
 
+typedef struct global_slot{
+    char        *name;
+    GlobalValue global_value;
+}GlobalSlot;
+
 typedef struct submodule{
     char            resolved;
+    // Maps globals names to its index in 'global_slots'.
+    // Only used when a global must be found by its name:
+    // compile time resolution and module access.
     LZOHTable       *globals;
+    DynArr          *global_slots;
     DynArr          *static_strs;
     DynArr          *symbols;
     const Allocator *allocator;
@@ -44,5 +55,6 @@ typedef struct module{
 #define MODULE_SYMBOLS(_module)((_module)->submodule->symbols)
 #define MODULE_STRINGS(_module)((_module)->submodule->static_strs)
 #define MODULE_GLOBALS(_module)((_module)->submodule->globals)
+#define MODULE_GLOBAL_SLOTS(_module)((_module)->submodule->global_slots)
 
 #endif
\ No newline at end of file
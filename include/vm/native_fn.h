@@ -15,6 +15,10 @@ typedef struct native_fn_info{
 typedef struct native_fn{
     uint8_t core;
     uint8_t arity;
+    // Set for the natives which neither allocate nor call back into the VM.
+    // The interpreter continues right after calling them: their result
+    // cannot have pushed a frame nor requested the garbage collector
+    uint8_t pure;
     char *name;
     RawNativeFn raw_fn;
     const Allocator *allocator;
@@ -9,8 +9,6 @@
 
 #include <stdint.h>
 
-static LZOHTable *array_symbols = NULL;
-
 Value native_fn_array_len(uint8_t argsc, Value *values, Value target, void *context){
     ArrayObj *target_array_obj = VALUE_TO_ARRAY(target);
     return INT_VALUE(vmu_array_len(target_array_obj));
@@ -48,21 +46,21 @@ Value native_fn_array_last(uint8_t argsc, Value *values, Value target, void *con
 }
 
 NativeFn *native_array_get(size_t key_size, const char *key, VM *vm){
-    if(!array_symbols){
+    if(!vm->array_symbols){
         Allocator *allocator = &vm->front_allocator;
-        array_symbols = MEMORY_LZOHTABLE(allocator);
+        vm->array_symbols = MEMORY_LZOHTABLE(allocator);
 
-        dynarr_insert_ptr(vm->native_symbols, array_symbols);
+        dynarr_insert_ptr(vm->native_symbols, vm->array_symbols);
 
-        vm_factory_native_fn_add_info(array_symbols, allocator, "len", 0, native_fn_array_len);
-        vm_factory_native_fn_add_info(array_symbols, allocator, "grow", 1, native_fn_array_make_room);
-        vm_factory_native_fn_add_info(array_symbols, allocator, "to_list", 0, native_fn_array_to_list);
-        vm_factory_native_fn_add_info(array_symbols, allocator, "first", 0, native_fn_array_first);
-        vm_factory_native_fn_add_info(array_symbols, allocator, "last", 0, native_fn_array_last);
+        vm_factory_native_fn_add_pure_info(vm->array_symbols, allocator, "len", 0, native_fn_array_len);
+        vm_factory_native_fn_add_info(vm->array_symbols, allocator, "grow", 1, native_fn_array_make_room);
+        vm_factory_native_fn_add_info(vm->array_symbols, allocator, "to_list", 0, native_fn_array_to_list);
+        vm_factory_native_fn_add_info(vm->array_symbols, allocator, "first", 0, native_fn_array_first);
+        vm_factory_native_fn_add_info(vm->array_symbols, allocator, "last", 0, native_fn_array_last);
     }
 
     NativeFn *native_fn = NULL;
-    lzohtable_lookup(key_size, key, array_symbols, (void **)(&native_fn));
+    lzohtable_lookup(key_size, key, vm->array_symbols, (void **)(&native_fn));
 
     return native_fn;
 }
@@ -4,8 +4,6 @@
 #include "vm_factory.h"
 #include "vmu.h"
 
-static LZOHTable *dict_symbols = NULL;
-
 Value native_dict_fn_len(uint8_t argsc, Value *values, Value target, void *context){
     DictObj *dict_obj = VALUE_TO_DICT(target);
     LZOHTable *key_values = dict_obj->key_values;
@@ -38,20 +36,20 @@ Value native_dict_fn_remove(uint8_t argsc, Value *values, Value target, void *co
 }
 
 NativeFn *native_dict_get(size_t key_size, const char *key, VM *vm){
-    if(!dict_symbols){
+    if(!vm->dict_symbols){
         Allocator *allocator = &vm->front_allocator;
-        dict_symbols = MEMORY_LZOHTABLE(allocator);
+        vm->dict_symbols = MEMORY_LZOHTABLE(allocator);
 
-        dynarr_insert_ptr(vm->native_symbols, dict_symbols);
+        dynarr_insert_ptr(vm->native_symbols, vm->dict_symbols);
 
-        vm_factory_native_fn_add_info(dict_symbols, allocator, "len", 0, native_dict_fn_len);
-        vm_factory_native_fn_add_info(dict_symbols, allocator, "contains", 1, native_dict_fn_contains);
-        vm_factory_native_fn_add_info(dict_symbols, allocator, "clear", 0, native_dict_fn_clear);
-        vm_factory_native_fn_add_info(dict_symbols, allocator, "remove", 1, native_dict_fn_remove);
+        vm_factory_native_fn_add_pure_info(vm->dict_symbols, allocator, "len", 0, native_dict_fn_len);
+        vm_factory_native_fn_add_info(vm->dict_symbols, allocator, "contains", 1, native_dict_fn_contains);
+        vm_factory_native_fn_add_info(vm->dict_symbols, allocator, "clear", 0, native_dict_fn_clear);
+        vm_factory_native_fn_add_info(vm->dict_symbols, allocator, "remove", 1, native_dict_fn_remove);
     }
 
     NativeFn *native_fn = NULL;
-    lzohtable_lookup(key_size, key, dict_symbols, (void **)(&native_fn));
+    lzohtable_lookup(key_size, key, vm->dict_symbols, (void **)(&native_fn));
 
     return native_fn;
 }
@@ -4,8 +4,6 @@
 #include "essentials/memory.h"
 #include "vmu.h"
 
-static LZOHTable *list_symbols = NULL;
-
 Value native_fn_list_size(uint8_t argsc, Value *values, Value target, void *context){
     ListObj *list_obj = VALUE_TO_LIST(target);
     return INT_VALUE(vmu_list_len(list_obj));
@@ -79,24 +77,24 @@ Value native_fn_list_remove(uint8_t argsc, Value *values, Value target, void *co
 }
 
 NativeFn *native_list_get(size_t key_size, const char *key, VM *vm){
-    if(!list_symbols){
+    if(!vm->list_symbols){
         Allocator *allocator = &vm->front_allocator;
-        list_symbols = MEMORY_LZOHTABLE(allocator);
-
-        dynarr_insert_ptr(vm->native_symbols, list_symbols);
-
-        vm_factory_native_fn_add_info(list_symbols, allocator, "len", 0, native_fn_list_size);
-        vm_factory_native_fn_add_info(list_symbols, allocator, "clear", 0, native_fn_list_clear);
-        vm_factory_native_fn_add_info(list_symbols, allocator, "to_array", 0, native_fn_list_to_array);
-        vm_factory_native_fn_add_info(list_symbols, allocator, "first", 0, native_fn_list_first);
-        vm_factory_native_fn_add_info(list_symbols, allocator, "last", 0, native_fn_list_last);
-        vm_factory_native_fn_add_info(list_symbols, allocator, "insert", 1, native_fn_list_insert);
-        vm_factory_native_fn_add_info(list_symbols, allocator, "insert_at", 2, native_fn_list_insert_at);
-        vm_factory_native_fn_add_info(list_symbols, allocator, "remove", 1, native_fn_list_remove);
+        vm->list_symbols = MEMORY_LZOHTABLE(allocator);
+
+        dynarr_insert_ptr(vm->native_symbols, vm->list_symbols);
+
+        vm_factory_native_fn_add_pure_info(vm->list_symbols, allocator, "len", 0, native_fn_list_size);
+        vm_factory_native_fn_add_info(vm->list_symbols, allocator, "clear", 0, native_fn_list_clear);
+        vm_factory_native_fn_add_info(vm->list_symbols, allocator, "to_array", 0, native_fn_list_to_array);
+        vm_factory_native_fn_add_info(vm->list_symbols, allocator, "first", 0, native_fn_list_first);
+        vm_factory_native_fn_add_info(vm->list_symbols, allocator, "last", 0, native_fn_list_last);
+        vm_factory_native_fn_add_info(vm->list_symbols, allocator, "insert", 1, native_fn_list_insert);
+        vm_factory_native_fn_add_info(vm->list_symbols, allocator, "insert_at", 2, native_fn_list_insert_at);
+        vm_factory_native_fn_add_info(vm->list_symbols, allocator, "remove", 1, native_fn_list_remove);
     }
 
     NativeFn *native_fn = NULL;
-    lzohtable_lookup(key_size, key, list_symbols, (void **)(&native_fn));
+    lzohtable_lookup(key_size, key, vm->list_symbols, (void **)(&native_fn));
 
     return native_fn;
 }
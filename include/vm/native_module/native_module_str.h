@@ -6,8 +6,6 @@
 #include "vmu.h"
 #include "types_utils.h"
 
-static LZOHTable *str_symbols = NULL;
-
 Value native_fn_str_len(uint8_t argsc, Value *values, Value target, void *context){
 	StrObj *target_str = VALUE_TO_STR(target);
 	return INT_VALUE(vmu_str_len(target_str));
@@ -72,23 +70,23 @@ Value native_fn_str_substr(uint8_t argsc, Value *values, Value target, void *con
 }
 
 NativeFn *native_str_get(size_t key_size, const char *key, VM *vm){
-    if(!str_symbols){
+    if(!vm->str_symbols){
         Allocator *allocator = &vm->front_allocator;
-        str_symbols = MEMORY_LZOHTABLE(allocator);
+        vm->str_symbols = MEMORY_LZOHTABLE(allocator);
 
-        dynarr_insert_ptr(vm->native_symbols, str_symbols);
+        dynarr_insert_ptr(vm->native_symbols, vm->str_symbols);
 
-        vm_factory_native_fn_add_info(str_symbols, allocator, "len", 0, native_fn_str_len);
-        vm_factory_native_fn_add_info(str_symbols, allocator, "code", 1, native_fn_str_code);
-        vm_factory_native_fn_add_info(str_symbols, allocator, "insert", 2, native_fn_str_insert);
-        vm_factory_native_fn_add_info(str_symbols, allocator, "remove", 2, native_fn_str_remove);
-        vm_factory_native_fn_add_info(str_symbols, allocator, "remove_first", 0, native_fn_str_remove_first);
-        vm_factory_native_fn_add_info(str_symbols, allocator, "remove_last", 0, native_fn_str_remove_last);
-        vm_factory_native_fn_add_info(str_symbols, allocator, "substr", 2, native_fn_str_substr);
+        vm_factory_native_fn_add_pure_info(vm->str_symbols, allocator, "len", 0, native_fn_str_len);
+        vm_factory_native_fn_add_pure_info(vm->str_symbols, allocator, "code", 1, native_fn_str_code);
+        vm_factory_native_fn_add_info(vm->str_symbols, allocator, "insert", 2, native_fn_str_insert);
+        vm_factory_native_fn_add_info(vm->str_symbols, allocator, "remove", 2, native_fn_str_remove);
+        vm_factory_native_fn_add_info(vm->str_symbols, allocator, "remove_first", 0, native_fn_str_remove_first);
+        vm_factory_native_fn_add_info(vm->str_symbols, allocator, "remove_last", 0, native_fn_str_remove_last);
+        vm_factory_native_fn_add_info(vm->str_symbols, allocator, "substr", 2, native_fn_str_substr);
     }
 
     NativeFn *native_fn = NULL;
-    lzohtable_lookup(key_size, key, str_symbols, (void **)(&native_fn));
+    lzohtable_lookup(key_size, key, vm->str_symbols, (void **)(&native_fn));
 
     return native_fn;
 }
@@ -8,13 +8,16 @@
 #include "closure.h"
 #include "native_module.h"
 #include "module.h"
+#include "shape.h"
 #include <stdio.h>
 #include <inttypes.h>
 
 typedef enum obj_type ObjType;
-typedef enum obj_color ObjColor;
+typedef enum obj_generation ObjGeneration;
 typedef struct obj Obj;
-typedef struct obj_list ObjList;
+
+struct frame;
+struct exception;
 
 enum obj_type{
 	STR_OBJ_TYPE,
@@ -28,28 +31,22 @@ enum obj_type{
     CLOSURE_OBJ_TYPE,
     NATIVE_MODULE_OBJ_TYPE,
     MODULE_OBJ_TYPE,
+    INT_OBJ_TYPE,
+    COROUTINE_OBJ_TYPE,
 };
 
-enum obj_color{
-    TRANSPARENT_OBJ_COLOR,
-    WHITE_OBJ_COLOR,
-    GRAY_OBJ_COLOR,
-    BLACK_OBJ_COLOR,
+enum obj_generation{
+    NONE_OBJ_GENERATION, // not managed by the garbage collector
+    YOUNG_OBJ_GENERATION,
+    OLD_OBJ_GENERATION,
 };
 
 struct obj{
     ObjType type;
     char marked;
-    ObjColor color;
-    Obj *prev;
-    Obj *next;
-    ObjList *list;
-};
-
-struct obj_list{
-    size_t len;
-    Obj *head;
-    Obj *tail;
+    ObjGeneration generation;
+    // Set while the object is in the remembered set
+    char remembered;
 };
 
 typedef struct str_obj{
@@ -77,7 +74,12 @@ typedef struct dict_obj{
 
 typedef struct record_obj{
     Obj header;
-	LZOHTable *attrs;
+    // Records start with the empty shape. Each attribute
+    // inserted by their literal moves them to the next one
+    Shape *shape;
+    // Count of values the record has room for
+    size_t len;
+    Value *values;
 }RecordObj;
 
 typedef struct native_obj{
@@ -111,7 +113,43 @@ typedef struct module_obj{
     Module *module;
 }ModuleObj;
 
-void obj_list_insert(Obj *obj, ObjList *list);
-void obj_list_remove(Obj *obj);
+// Only used when values are NaN boxed: integers that do not fit in 48 bits
+typedef struct int_obj{
+    Obj header;
+    int64_t value;
+}IntObj;
+
+typedef enum coroutine_state{
+    CREATED_COROUTINE_STATE,
+    SUSPENDED_COROUTINE_STATE,
+    RUNNING_COROUTINE_STATE,
+    DEAD_COROUTINE_STATE,
+}CoroutineState;
+
+// A function or closure running on stacks of its own. Each yield leaves
+// them as they are, and the next resume swaps them back into the VM
+typedef struct coroutine_obj{
+    Obj header;
+    CoroutineState state;
+    Value fn;
+    // Frames first, then the values, in a single reservation
+    void *stacks;
+    Value *stack;
+    Value *stack_top;
+    struct frame *frame_stack;
+    struct frame *frame_ptr;
+    // Try blocks still open at the last yield
+    struct exception *exceptions;
+    // Stacks of the resumer while the coroutine runs
+    Value *caller_stack;
+    Value *caller_stack_top;
+    Value *caller_stack_end;
+    struct frame *caller_frame_stack;
+    struct frame *caller_frame_ptr;
+    struct frame *caller_frame_stack_end;
+    struct exception *caller_exceptions;
+    // Coroutine which was running when this one was resumed
+    struct coroutine_obj *prev;
+}CoroutineObj;
 
 #endif
@@ -75,14 +75,63 @@ typedef enum opcode{
 	OP_JIT,
 
     OP_CALL,
+    OP_TCALL,   // call in place of the current frame, then return what it returns
     OP_ACCESS,
+    OP_INVOKE,
     OP_INDEX,
     OP_RET,
 	OP_IS,
     OP_TRYO,
     OP_TRYC,
     OP_THROW,
+    OP_YIELD,   // leave the coroutine with the value at the top of the stack
+    OP_NEXT,    // store the next value of an iterable in a local, or jump once there are none
     OP_HLT,
+
+    // SUPERINSTRUCTIONS
+    // Emitted only by the compiler's peephole pass
+    OP_INCL,         // add 1 to a local
+    OP_LGET2,        // push two locals
+    OP_LT_LL_JIF,    // jump if a local is not less than another one
+    OP_GE_LL_JIT,    // jump if a local is greater or equals than another one
+
+    // REGISTERS
+    // Registers are the stack slots of the frame, counting from its first
+    // parameter. Those past the stack top are temporaries, and only hold
+    // numbers. Emitted only when compiling with registers
+    OP_RMOV,     // copy a register into another one
+    OP_RCINT,    // load integer of 1 byte into a register
+    OP_RINT,     // load integer constant into a register
+    OP_RFLOAT,   // load float constant into a register
+    OP_RADD,     // add two registers into a third one
+    OP_RSUB,     // subtract two registers into a third one
+    OP_RMUL,     // multiply two registers into a third one
+    OP_RDIV,     // divide two registers into a third one
+    OP_RMOD,     // calculate module from two registers into a third one
+    OP_RADDK,    // add integer of 1 byte to a register into another one
+    OP_RSUBK,    // subtract integer of 1 byte to a register into another one
+    OP_RJNLT,    // jump if a register is not less than another one
+    OP_RJNGT,    // jump if a register is not greater than another one
+    OP_RJNLE,    // jump if a register is not less or equals than another one
+    OP_RJNGE,    // jump if a register is not greater or equals than another one
+
+    // QUICKENED
+    // Written by the VM over the generic opcode of an instruction once it sees
+    // the types of its operands. They put the generic one back when those change
+    OP_ADD_II,   // add two integers
+    OP_ADD_FF,   // add two floats
+    OP_SUB_II,   // subtract two integers
+    OP_SUB_FF,   // subtract two floats
+    OP_MUL_II,   // multiply two integers
+    OP_MUL_FF,   // multiply two floats
+    OP_LT_II,    // compare two integers with <
+    OP_LT_FF,    // compare two floats with <
+    OP_GT_II,    // compare two integers with >
+    OP_GT_FF,    // compare two floats with >
+    OP_LE_II,    // compare two integers with <=
+    OP_LE_FF,    // compare two floats with <=
+    OP_GE_II,    // compare two integers with >=
+    OP_GE_FF,    // compare two floats with >=
 }OPCode;
 
 #endif
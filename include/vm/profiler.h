@@ -0,0 +1,113 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "essentials/memory.h"
+#include "essentials/dynarr.h"
+#include "essentials/lzohtable.h"
+#include "fn.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+#define PROFILER_OPCODES_LENGTH 256
+// Nodes of the calling context tree, one per frame
+#define PROFILER_DEPTH_LENGTH   256
+
+#if defined(__x86_64__) || defined(__i386__)
+    #define PROFILER_TICKS_NAME "cycles"
+#else
+    #define PROFILER_TICKS_NAME "ns"
+#endif
+
+typedef struct profile_counter{
+    uint64_t count;
+    uint64_t ticks;
+}ProfileCounter;
+
+typedef struct fn_profile{
+    const Fn *fn;
+    // One counter per chunk of the function
+    size_t offsets_len;
+    ProfileCounter *offsets;
+}FnProfile;
+
+// A node of the calling context tree: a function called
+// through the path of functions from the root to it
+typedef struct profile_node{
+    FnProfile *fn_profile;
+    ProfileCounter counter;
+    struct profile_node *parent;
+    struct profile_node *children;
+    struct profile_node *next;
+}ProfileNode;
+
+typedef struct profiler{
+    uint64_t last_ticks;
+    uint8_t last_opcode;
+    size_t last_offset;
+    ProfileNode *last_node;
+    // Depth of the frame executing, and the nodes of every frame up to it
+    size_t depth;
+    ProfileNode *nodes[PROFILER_DEPTH_LENGTH];
+    ProfileNode root;
+    ProfileCounter opcodes[PROFILER_OPCODES_LENGTH];
+    DynArr *fn_profiles;
+    LZOHTable *fn_profiles_table;
+    const Allocator *allocator;
+}Profiler;
+
+Profiler *profiler_create(const Allocator *allocator);
+void profiler_destroy(Profiler *profiler);
+
+// Must be called when the function executing at 'depth' could be
+// other than the one counted last time, before profiler_count().
+// Returns 1 if out of memory
+int profiler_enter(size_t depth, const Fn *fn, Profiler *profiler);
+
+static inline uint64_t profiler_ticks(){
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+// Counts an execution of 'opcode' at 'offset' of the function entered last.
+// The ticks since the previous count are charged to the previous opcode
+static inline void profiler_count(uint8_t opcode, size_t offset, Profiler *profiler){
+    uint64_t ticks = profiler_ticks();
+    uint64_t elapsed = ticks - profiler->last_ticks;
+    ProfileNode *last_node = profiler->last_node;
+    ProfileNode *node = profiler->nodes[profiler->depth];
+
+    if(last_node){
+        profiler->opcodes[profiler->last_opcode].ticks += elapsed;
+        last_node->counter.ticks += elapsed;
+        last_node->fn_profile->offsets[profiler->last_offset].ticks += elapsed;
+    }
+
+    profiler->opcodes[opcode].count++;
+    node->counter.count++;
+    node->fn_profile->offsets[offset].count++;
+
+    profiler->last_ticks = ticks;
+    profiler->last_opcode = opcode;
+    profiler->last_offset = offset;
+    profiler->last_node = node;
+}
+
+// Returns the location of the statement the chunk at 'offset' belongs to,
+// or NULL if 'locations' has none before it
+OPCodeLocation *profiler_find_location(size_t offset, const DynArr *locations);
+
+// Prints the opcodes, functions and source lines sorted by ticks
+void profiler_report(FILE *stream, Profiler *profiler);
+// Writes the ticks of every stack in the folded format
+// used by flame graph tools. Returns 1 if the file cannot be written
+int profiler_write_stacks(const char *pathname, Profiler *profiler);
+
+#endif
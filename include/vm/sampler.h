@@ -0,0 +1,51 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include "vm.h"
+
+#include <stdint.h>
+#include <pthread.h>
+
+#define SAMPLER_DEFAULT_FREQUENCY 1000
+#define SAMPLER_MAX_FREQUENCY     10000
+// Must be a power of 2
+#define SAMPLER_RING_LENGTH       128
+// How often the writer moves the samples out of the ring
+#define SAMPLER_DRAIN_MS          20
+// Frames kept of each sample, from the outermost
+#define SAMPLER_DEPTH_LENGTH      256
+
+// The frames executing when the timer fired, from the outermost
+typedef struct sample{
+    size_t depth;
+    const Fn *fns[SAMPLER_DEPTH_LENGTH];
+    uint32_t offsets[SAMPLER_DEPTH_LENGTH];
+}Sample;
+
+// The signal handler fills the ring while the writer thread
+// empties it. Each side owns one index, so no locks are needed
+typedef struct sampler{
+    VM *vm;
+    unsigned int frequency;
+    size_t head;
+    size_t tail;
+    uint64_t taken;
+    uint64_t dropped;
+    char stop;
+    pthread_t writer;
+    // Sample counts by stack: the key is the function and line of each frame
+    LZOHTable *stacks;
+    Sample ring[SAMPLER_RING_LENGTH];
+}Sampler;
+
+// Starts sampling the frames of 'vm' 'frequency' times per second of CPU time.
+// Only one sampler can run at a time. Returns NULL on failure
+Sampler *sampler_start(unsigned int frequency, VM *vm);
+// Stops the timer and the writer. Must be called before 'vm' is destroyed
+void sampler_stop(Sampler *sampler);
+// Writes the count of every sampled stack in the folded format
+// used by flame graph tools. Returns 1 if the file cannot be written
+int sampler_write_stacks(const char *pathname, Sampler *sampler);
+void sampler_destroy(Sampler *sampler);
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef SHAPE_H
+#define SHAPE_H
+
+#include "essentials/memory.h"
+#include "essentials/lzohtable.h"
+
+#include <stddef.h>
+
+// The keys of a record, in the order they were inserted, and the offset
+// of the value of each one. Records inserting the same keys in the same
+// order share their shape, so an offset found for one of them is valid
+// for all of them. Shapes live as long as the VM
+typedef struct shape{
+    // Count of attributes: their values are at offsets 0 to 'len - 1'
+    size_t len;
+    // Key of each attribute by its offset. The last
+    // one is owned by this shape, the others by its ancestors
+    char **keys;
+    // Offset of each attribute by its key
+    LZOHTable *offsets;
+    // Shapes with one attribute more than this one, by its key
+    LZOHTable *transitions;
+    const Allocator *allocator;
+}Shape;
+
+// The shape without attributes, root of every other one
+Shape *shape_create(const Allocator *allocator);
+// Destroys 'shape' and every shape reachable from it
+void shape_destroy(Shape *shape);
+// The shape with the attributes of 'shape' followed by 'key'. Created
+// the first time it is asked for. Returns NULL on allocation failure
+Shape *shape_transition(size_t key_size, const char *key, Shape *shape);
+// Returns 1 if 'shape' does not contain 'key'
+int shape_find(size_t key_size, const char *key, const Shape *shape, size_t *out_offset);
+
+#endif
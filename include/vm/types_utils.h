@@ -6,6 +6,107 @@
 #include "value.h"
 #include "obj.h"
 
+#include <stdint.h>
+#include <string.h>
+
+#ifdef NAN_BOXING
+// The upper 16 bits of the value work as tag:
+//
+//     0x0000 | 0x000000000000       empty
+//     0x0000 | 0x00000000000(2|3)   false | true
+//     0x0000 | pointer              object
+//     0x0001 | pointer              boxed integer (does not fit in 48 bits)
+//     0x0002 | integer              48 bits integer
+//     0x0003 ... 0xffff             float (IEEE 754 bits + NAN_BOXING_FLOAT_OFFSET)
+//
+// Zero means empty, so zeroed memory is a valid array of empty values.
+// Floats are offset to make room for the tags, which is safe as long NaNs
+// are canonicalized: all the negative NaNs would overflow into the tags.
+#define NAN_BOXING_PAYLOAD_MASK   0x0000ffffffffffffULL
+#define NAN_BOXING_EMPTY          0x0000000000000000ULL
+#define NAN_BOXING_FALSE          0x0000000000000002ULL
+#define NAN_BOXING_TRUE           0x0000000000000003ULL
+#define NAN_BOXING_BOXED_INT_TAG  0x0001000000000000ULL
+#define NAN_BOXING_INT_TAG        0x0002000000000000ULL
+#define NAN_BOXING_FLOAT_OFFSET   0x0003000000000000ULL
+#define NAN_BOXING_CANONICAL_NAN  0x7ff8000000000000ULL
+#define NAN_BOXING_INT_MIN        (-((int64_t)1 << 47))
+#define NAN_BOXING_INT_MAX        (((int64_t)1 << 47) - 1)
+
+// Defined in vmu.c. Boxes integers that does not fit in 48 bits
+Value vmu_box_int(int64_t value);
+
+static inline Value nan_boxing_int(int64_t value){
+    if(__builtin_expect(value >= NAN_BOXING_INT_MIN && value <= NAN_BOXING_INT_MAX, 1)){
+        return (Value){.bits = NAN_BOXING_INT_TAG | ((uint64_t)value & NAN_BOXING_PAYLOAD_MASK)};
+    }
+
+    return vmu_box_int(value);
+}
+
+static inline Value nan_boxing_float(double value){
+    uint64_t bits = NAN_BOXING_CANONICAL_NAN;
+
+    if(value == value){
+        memcpy(&bits, &value, sizeof(double));
+    }
+
+    return (Value){.bits = bits + NAN_BOXING_FLOAT_OFFSET};
+}
+
+static inline int64_t nan_boxing_to_int(Value value){
+    if(__builtin_expect((value.bits & ~NAN_BOXING_PAYLOAD_MASK) == NAN_BOXING_INT_TAG, 1)){
+        return ((int64_t)(value.bits << 16)) >> 16;
+    }
+
+    return ((IntObj *)(uintptr_t)(value.bits & NAN_BOXING_PAYLOAD_MASK))->value;
+}
+
+static inline double nan_boxing_to_float(Value value){
+    uint64_t bits = value.bits - NAN_BOXING_FLOAT_OFFSET;
+    double float_value;
+
+    memcpy(&float_value, &bits, sizeof(double));
+
+    return float_value;
+}
+
+#define EMPTY_VALUE ((Value){.bits = NAN_BOXING_EMPTY})
+#define BOOL_VALUE(_value)((Value){.bits = (_value) ? NAN_BOXING_TRUE : NAN_BOXING_FALSE})
+#define INT_VALUE(_value)(nan_boxing_int((_value)))
+#define FLOAT_VALUE(_value)(nan_boxing_float((_value)))
+#define OBJ_VALUE(_value)((Value){.bits = (uint64_t)(uintptr_t)(_value)})
+
+#define IS_VALUE_EMPTY(_value)((_value).bits == NAN_BOXING_EMPTY)
+#define IS_VALUE_BOOL(_value)(((_value).bits | 1) == NAN_BOXING_TRUE)
+#define IS_VALUE_INT(_value)((((_value).bits >> 48) - 1) < 2)
+#define IS_VALUE_FLOAT(_value)((_value).bits >= NAN_BOXING_FLOAT_OFFSET)
+#define IS_VALUE_OBJ(_value)(((_value).bits - 8) < (NAN_BOXING_BOXED_INT_TAG - 8))
+// Objects the garbage collector must trace: objects plus boxed integers
+#define IS_VALUE_GC_OBJ(_value)(((_value).bits - 8) < (NAN_BOXING_INT_TAG - 8))
+
+#define VALUE_TO_BOOL(_value)((uint8_t)((_value).bits & 1))
+#define VALUE_TO_INT(_value)(nan_boxing_to_int((_value)))
+#define VALUE_TO_FLOAT(_value)(nan_boxing_to_float((_value)))
+#define VALUE_TO_OBJ_PTR(_value)((void *)(uintptr_t)(_value).bits)
+#define VALUE_TO_GC_OBJ(_value)((Obj *)(uintptr_t)((_value).bits & NAN_BOXING_PAYLOAD_MASK))
+
+static inline ValueType value_type(Value value){
+    if(IS_VALUE_FLOAT(value)){
+        return FLOAT_VALUE_TYPE;
+    }
+
+    if(IS_VALUE_INT(value)){
+        return INT_VALUE_TYPE;
+    }
+
+    if(IS_VALUE_OBJ(value)){
+        return OBJ_VALUE_TYPE;
+    }
+
+    return IS_VALUE_EMPTY(value) ? EMPTY_VALUE_TYPE : BOOL_VALUE_TYPE;
+}
+#else
 #define EMPTY_VALUE ((Value){.type = EMPTY_VALUE_TYPE})
 #define BOOL_VALUE(_value)((Value){.type = BOOL_VALUE_TYPE, .content.bool_val = (_value)})
 #define INT_VALUE(_value)((Value){.type = INT_VALUE_TYPE, .content.int_val = (_value)})
@@ -17,81 +118,93 @@
 #define IS_VALUE_INT(_value)((_value).type == INT_VALUE_TYPE)
 #define IS_VALUE_FLOAT(_value)((_value).type == FLOAT_VALUE_TYPE)
 #define IS_VALUE_OBJ(_value)((_value).type == OBJ_VALUE_TYPE)
+#define IS_VALUE_GC_OBJ(_value)(IS_VALUE_OBJ(_value))
+
+#define VALUE_TO_BOOL(_value)((_value).content.bool_val)
+#define VALUE_TO_INT(_value)((_value).content.int_val)
+#define VALUE_TO_FLOAT(_value)((_value).content.float_val)
+#define VALUE_TO_OBJ_PTR(_value)((_value).content.obj_val)
+#define VALUE_TO_GC_OBJ(_value)((Obj *)VALUE_TO_OBJ_PTR(_value))
+
+static inline ValueType value_type(Value value){
+    return value.type;
+}
+#endif
 
 static inline int vm_is_value_numeric(Value value){
-    return value.type == INT_VALUE_TYPE || value.type == FLOAT_VALUE_TYPE;
+    return IS_VALUE_INT(value) || IS_VALUE_FLOAT(value);
 }
 
 static inline int is_callable(Value *value){
-    ValueType type = value->type;
-
-    if(type != OBJ_VALUE_TYPE){
+    if(!IS_VALUE_OBJ(*value)){
         return 0;
     }
 
-    ObjType obj_type = ((Obj *)value->content.obj_val)->type;
+    ObjType obj_type = ((Obj *)VALUE_TO_OBJ_PTR(*value))->type;
 
     return obj_type == FN_OBJ_TYPE ||
            obj_type == CLOSURE_OBJ_TYPE;
 }
 
 static inline int is_value_str(Value value){
-    return value.type == OBJ_VALUE_TYPE && ((Obj *)(value.content.obj_val))->type == STR_OBJ_TYPE;
+    return IS_VALUE_OBJ(value) && ((Obj *)VALUE_TO_OBJ_PTR(value))->type == STR_OBJ_TYPE;
 }
 
 static inline int is_value_array(Value value){
-    return value.type == OBJ_VALUE_TYPE && ((Obj *)(value.content.obj_val))->type == ARRAY_OBJ_TYPE;
+    return IS_VALUE_OBJ(value) && ((Obj *)VALUE_TO_OBJ_PTR(value))->type == ARRAY_OBJ_TYPE;
 }
 
 static inline int is_value_list(Value value){
-    return value.type == OBJ_VALUE_TYPE && ((Obj *)(value.content.obj_val))->type == LIST_OBJ_TYPE;
+    return IS_VALUE_OBJ(value) && ((Obj *)VALUE_TO_OBJ_PTR(value))->type == LIST_OBJ_TYPE;
 }
 
 static inline int is_value_dict(Value value){
-    return value.type == OBJ_VALUE_TYPE && ((Obj *)(value.content.obj_val))->type == DICT_OBJ_TYPE;
+    return IS_VALUE_OBJ(value) && ((Obj *)VALUE_TO_OBJ_PTR(value))->type == DICT_OBJ_TYPE;
 }
 
 static inline int is_value_record(Value value){
-    return value.type == OBJ_VALUE_TYPE && ((Obj *)(value.content.obj_val))->type == RECORD_OBJ_TYPE;
+    return IS_VALUE_OBJ(value) && ((Obj *)VALUE_TO_OBJ_PTR(value))->type == RECORD_OBJ_TYPE;
 }
 
 static inline int is_value_native(Value value){
-	return value.type == OBJ_VALUE_TYPE && ((Obj *)(value.content.obj_val))->type == NATIVE_OBJ_TYPE;
+	return IS_VALUE_OBJ(value) && ((Obj *)VALUE_TO_OBJ_PTR(value))->type == NATIVE_OBJ_TYPE;
 }
 
 static inline int is_value_native_fn(Value value){
-    return value.type == OBJ_VALUE_TYPE && ((Obj *)(value.content.obj_val))->type == NATIVE_FN_OBJ_TYPE;
+    return IS_VALUE_OBJ(value) && ((Obj *)VALUE_TO_OBJ_PTR(value))->type == NATIVE_FN_OBJ_TYPE;
 }
 
 static inline int is_value_fn(Value value){
-    return value.type == OBJ_VALUE_TYPE && ((Obj *)(value.content.obj_val))->type == FN_OBJ_TYPE;
+    return IS_VALUE_OBJ(value) && ((Obj *)VALUE_TO_OBJ_PTR(value))->type == FN_OBJ_TYPE;
 }
 
 static inline int is_value_closure(Value value){
-    return value.type == OBJ_VALUE_TYPE && ((Obj *)(value.content.obj_val))->type == CLOSURE_OBJ_TYPE;
+    return IS_VALUE_OBJ(value) && ((Obj *)VALUE_TO_OBJ_PTR(value))->type == CLOSURE_OBJ_TYPE;
 }
 
 static inline int is_value_native_module(Value value){
-    return value.type == OBJ_VALUE_TYPE && ((Obj *)(value.content.obj_val))->type == NATIVE_MODULE_OBJ_TYPE;
+    return IS_VALUE_OBJ(value) && ((Obj *)VALUE_TO_OBJ_PTR(value))->type == NATIVE_MODULE_OBJ_TYPE;
 }
 
 static inline int is_value_module(Value value){
-    return value.type == OBJ_VALUE_TYPE && ((Obj *)(value.content.obj_val))->type == MODULE_OBJ_TYPE;
+    return IS_VALUE_OBJ(value) && ((Obj *)VALUE_TO_OBJ_PTR(value))->type == MODULE_OBJ_TYPE;
 }
 
-#define VALUE_TO_BOOL(_value)((_value).content.bool_val)
-#define VALUE_TO_INT(_value)((_value).content.int_val)
-#define VALUE_TO_FLOAT(_value)((_value).content.float_val)
-#define VALUE_TO_OBJ(_value)((Obj *)(_value).content.obj_val)
-#define VALUE_TO_STR(_value)((StrObj *)(_value).content.obj_val)
-#define VALUE_TO_ARRAY(_value)((ArrayObj *)(_value).content.obj_val)
-#define VALUE_TO_LIST(_value)((ListObj*)(_value).content.obj_val)
-#define VALUE_TO_DICT(_value)((DictObj *)(_value).content.obj_val)
-#define VALUE_TO_RECORD(_value)((RecordObj *)(_value).content.obj_val)
-#define VALUE_TO_NATIVE(_value)((NativeObj *)(_value).content.obj_val)
-#define VALUE_TO_NATIVE_FN(_value)((NativeFnObj *)(_value).content.obj_val)
-#define VALUE_TO_FN(_value)((FnObj *)(_value).content.obj_val)
-#define VALUE_TO_CLOSURE(_value)((ClosureObj *)(_value).content.obj_val)
+static inline int is_value_coroutine(Value value){
+    return IS_VALUE_OBJ(value) && ((Obj *)VALUE_TO_OBJ_PTR(value))->type == COROUTINE_OBJ_TYPE;
+}
+
+#define VALUE_TO_OBJ(_value)((Obj *)VALUE_TO_OBJ_PTR(_value))
+#define VALUE_TO_STR(_value)((StrObj *)VALUE_TO_OBJ_PTR(_value))
+#define VALUE_TO_ARRAY(_value)((ArrayObj *)VALUE_TO_OBJ_PTR(_value))
+#define VALUE_TO_LIST(_value)((ListObj*)VALUE_TO_OBJ_PTR(_value))
+#define VALUE_TO_DICT(_value)((DictObj *)VALUE_TO_OBJ_PTR(_value))
+#define VALUE_TO_RECORD(_value)((RecordObj *)VALUE_TO_OBJ_PTR(_value))
+#define VALUE_TO_NATIVE(_value)((NativeObj *)VALUE_TO_OBJ_PTR(_value))
+#define VALUE_TO_NATIVE_FN(_value)((NativeFnObj *)VALUE_TO_OBJ_PTR(_value))
+#define VALUE_TO_FN(_value)((FnObj *)VALUE_TO_OBJ_PTR(_value))
+#define VALUE_TO_CLOSURE(_value)((ClosureObj *)VALUE_TO_OBJ_PTR(_value))
+#define VALUE_TO_COROUTINE(_value)((CoroutineObj *)VALUE_TO_OBJ_PTR(_value))
 
 #define OBJ_TO_STR(_obj)((StrObj *)(_obj))
 #define OBJ_TO_ARRAY(_obj)((ArrayObj *)(_obj))
@@ -104,5 +217,7 @@ static inline int is_value_module(Value value){
 #define OBJ_TO_CLOSURE(_obj)((ClosureObj *)(_obj))
 #define OBJ_TO_NATIVE_MODULE(_obj)((NativeModuleObj *)(_obj))
 #define OBJ_TO_MODULE(_obj)((ModuleObj *)(_obj))
+#define OBJ_TO_INT(_obj)((IntObj *)(_obj))
+#define OBJ_TO_COROUTINE(_obj)((CoroutineObj *)(_obj))
 
 #endif
@@ -0,0 +1,26 @@
+#ifndef VERIFIER_H
+#define VERIFIER_H
+
+#include "essentials/memory.h"
+#include "fn.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct verifier_error{
+    size_t offset;
+    const char *msg;
+}VerifierError;
+
+// Bytes taken by an instruction, counting its operands,
+// or 0 if 'opcode' is not known
+size_t verifier_instruction_len(uint8_t opcode);
+
+// Proves that every instruction of 'fn' reachable from its start decodes
+// inside its chunks, that jumps land on instructions, that locals and constants
+// are in range and that the stack never underflows. On success sets the
+// 'stack_len' of 'fn'. Returns 1 if the bytecode is malformed, with the
+// reason in 'error'. 'allocator' is only used for scratch memory
+int verifier_verify(const Allocator *allocator, Fn *fn, VerifierError *error);
+
+#endif
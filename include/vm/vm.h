@@ -8,21 +8,53 @@
 #include "essentials/memory.h"
 #include "fn.h"
 #include "closure.h"
+#include "profiler.h"
 #include "essentials/dynarr.h"
 #include <setjmp.h>
 
+struct jit_recorder;
+struct parallel_pool;
+
 #define LOCALS_LENGTH              255
-#define FRAME_LENGTH               255
+// On Linux, the stacks are only reserved when the VM is created: their
+// memory is committed as the frames and values reach it. Other hosts
+// allocate them whole (see vm_reserve_stack), so they keep small stacks
+#ifdef __linux__
+    #define FRAME_LENGTH           (1 << 16)
+#else
+    #define FRAME_LENGTH           255
+#endif
 #define STACK_LENGTH               (LOCALS_LENGTH * FRAME_LENGTH)
+// Coroutines reserve their own, smaller, stacks. On Linux, the frames
+// are as many as the sampler reads at most
+#ifdef __linux__
+    #define COROUTINE_FRAME_LENGTH 256
+#else
+    #define COROUTINE_FRAME_LENGTH 32
+#endif
+#define COROUTINE_STACK_LENGTH     (LOCALS_LENGTH * COROUTINE_FRAME_LENGTH)
+#define COROUTINE_STACKS_SIZE      (sizeof(Frame) * COROUTINE_FRAME_LENGTH + sizeof(Value) * COROUTINE_STACK_LENGTH)
+// Resumed coroutines nest in the C stack
+#define COROUTINE_NESTING_LENGTH   255
 #define MODULES_LENGTH             255
+#define ERROR_MSG_LENGTH           256
 #define ALLOCATE_START_LIMIT       MEMORY_MIBIBYTES(16)
 #define GROW_ALLOCATE_LIMIT_FACTOR 2
+#define NURSERY_SIZE               MEMORY_MIBIBYTES(1)
+#define GC_MAX_THREADS             64
 
 typedef enum vm_result{
     OK_VMRESULT,
     ERR_VMRESULT,
 }VMResult;
 
+typedef enum gc_phase{
+    IDLE_GC_PHASE,
+    MARK_GC_PHASE,
+    // Garbage of the last major collection is waiting to be swept
+    SWEEP_GC_PHASE,
+}GCPhase;
+
 typedef struct frame{
     size_t ip;
     size_t last_offset;
@@ -54,27 +86,90 @@ typedef struct vm{
     char halt;
     jmp_buf exit_jmp;
     unsigned char exit_code;
+    // Message of the last error. When 'quiet_errors' is set, errors
+    // are only kept there, for the host to report them
+    char error_msg[ERROR_MSG_LENGTH];
+    char quiet_errors;
 //-----------------------------  VALUE STACK  ------------------------------//
     Value *stack_top;
-    Value stack[STACK_LENGTH];
+    // STACK_LENGTH values, or those of the running coroutine
+    Value *stack;
+    Value *stack_end;
 //-----------------------------  FRAME STACK  ------------------------------//
     Frame *frame_ptr;
-    Frame frame_stack[FRAME_LENGTH];
+    // FRAME_LENGTH frames, or those of the running coroutine
+    Frame *frame_stack;
+    Frame *frame_stack_end;
 //--------------------------------  OTHER  ---------------------------------//
     LZOHTable *native_fns;
     DynArr *native_symbols;
+    // Methods of the built in types, created on first use
+    LZOHTable *str_symbols;
+    LZOHTable *array_symbols;
+    LZOHTable *list_symbols;
+    LZOHTable *dict_symbols;
     LZOHTable *runtime_strs;
+    // Shape of the records without attributes
+    Shape *empty_shape;
+#ifdef NAN_BOXING
+    LZOHTable *boxed_ints;
+#endif
     Template *templates;
     Exception *exception_stack;
+    // Hot functions are compiled to machine code when set
+    char jit;
+    // Hot loops are recorded and compiled to machine code when set
+    char trace;
+    // Active recording of a loop, if any
+    struct jit_recorder *recorder;
+    // Machine code compiled by the VM, destroyed with it
+    struct jit_code *jit_codes;
+    // Machine code runs nested in the C stack, entered from other machine code
+    size_t jit_nesting;
+    // Innermost coroutine running, if any
+    CoroutineObj *coroutine;
+    size_t coroutine_nesting;
+//-------------------------------  ISOLATE  --------------------------------//
+    // Index of the isolate running the VM, out of 'isolates_len'.
+    // A VM run without isolates is the first out of one
+    size_t isolate_id;
+    size_t isolates_len;
+    // Worker isolates of the parallel module, created on first use
+    struct parallel_pool *parallel_pool;
 //--------------------------------  MODULE  --------------------------------//
     int modules_stack_len;
     Module *modules_stack;
+    // Counts executed opcodes when set
+    Profiler *profiler;
 //--------------------------  GARBAGE COLLECTOR  ---------------------------//
     size_t mem_use;
     size_t mem_use_limit;
-    ObjList white_objs;
-    ObjList gray_objs;
-    ObjList black_objs;
+    // Bytes allocated since the last minor collection
+    size_t nursery_mem_use;
+    char minor_gc;
+    // Set when the dispatch loop must call the garbage collector
+    char gc_request;
+    GCPhase gc_phase;
+    // Budget of each incremental marking step. When both are zero,
+    // major collections are done in a single pause
+    size_t gc_step_objs;
+    size_t gc_step_us;
+    // Threads used to mark during the pause of major collections
+    size_t gc_threads;
+    // Object being traced in chunks by incremental steps,
+    // and how many of its values are already traced
+    Obj *mark_obj;
+    size_t mark_cursor;
+    // Objects allocated since the last collection
+    DynArr *young_objs;
+    // Marked objects not traced yet
+    DynArr *gray_objs;
+    // Old objects that could point to young ones
+    DynArr *remembered_objs;
+    // Memory in use when the last major collection ended marking,
+    // and how much of it its sweep freed so far
+    size_t gc_mem_use;
+    size_t gc_freed_mem;
 //--------------------------------  POOLS  ---------------------------------//
     LZPool exceptions_pool;
     LZPool values_pool;
@@ -83,12 +178,17 @@ typedef struct vm{
     LZPool list_objs_pool;
     LZPool dict_objs_pool;
     LZPool record_objs_pool;
+    LZPool native_objs_pool;
     LZPool native_fn_objs_pool;
     LZPool fn_objs_pool;
     LZPool closures_pool;
     LZPool closure_objs_pool;
     LZPool native_module_objs_pool;
     LZPool module_objs_pool;
+    LZPool coroutine_objs_pool;
+#ifdef NAN_BOXING
+    LZPool int_objs_pool;
+#endif
 //------------------------------  ALLOCATORS  ------------------------------//
     Allocator *allocator;
     Allocator front_allocator;
@@ -98,5 +198,18 @@ VM *vm_create(Allocator *allocator);
 void vm_destroy(VM *vm);
 void vm_initialize(VM *vm);
 int vm_execute(LZOHTable *native_fns, Module *module, VM *vm);
+// Calls the value under the top 'argsc' values of the stack, as code of
+// 'module', and leaves its result in their place. The values below are kept
+// by the garbage collector. The VM must not be running. Returns like vm_execute
+int vm_invoke(LZOHTable *native_fns, Module *module, uint8_t argsc, VM *vm);
+// Count against the heap of the VM memory its objects own, but which
+// is allocated outside of it, like the bytes of the nbarrays, which
+// can be moved to other isolates. vm_charge() can collect garbage
+void vm_charge(size_t size, VM *vm);
+void vm_discharge(size_t size, VM *vm);
+// Reserves 'size' bytes followed by a page which faults when touched.
+// Pages only take memory once touched. Returns NULL on failure
+void *vm_reserve_stack(size_t size);
+void vm_release_stack(void *stack, size_t size);
 
 #endif
@@ -34,6 +34,7 @@ int vm_factory_module_add_fn(Module *module, Fn *fn, size_t *out_idx);
 int vm_factory_module_add_closure(Module *module, MetaClosure *closure, size_t *out_idx);
 int vm_factory_module_add_module(Module *target_module, Module *module);
 
+int vm_factory_module_globals_slot(Module *module, const char *name, size_t *out_idx);
 int vm_factory_module_globals_add_obj(
 	Module *module,
 	Obj *obj,
@@ -54,6 +55,13 @@ int vm_factory_native_module_add_native_fn(
     uint8_t arity,
     RawNativeFn raw_native
 );
+// Like vm_factory_native_module_add_native_fn, for natives which are NativeFn.pure
+int vm_factory_native_module_add_pure_native_fn(
+    NativeModule *module,
+    const char *name,
+    uint8_t arity,
+    RawNativeFn raw_native
+);
 
 int vm_factory_native_fn_add_info(
     LZOHTable *natives,
@@ -62,6 +70,14 @@ int vm_factory_native_fn_add_info(
     uint8_t arity,
     RawNativeFn raw_native
 );
+// Like vm_factory_native_fn_add_info, for natives which are NativeFn.pure
+int vm_factory_native_fn_add_pure_info(
+    LZOHTable *natives,
+    const Allocator *allocator,
+    const char *name,
+    uint8_t arity,
+    RawNativeFn raw_native
+);
 
 FnObj *vm_factory_fn_obj_create(const Allocator *allocator, Fn *fn);
 NativeFnObj *vm_factory_native_fn_obj_create(const Allocator *allocator, NativeFn *native_fn);
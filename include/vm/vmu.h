@@ -11,24 +11,37 @@
 
 #define VMU_VM ((VM *)context)
 
+// Errors jump out through vm->exit_jmp and never return
+#if defined(__GNUC__)
+    #define VMU_NORETURN __attribute__((noreturn))
+#else
+    #define VMU_NORETURN
+#endif
+
 #define VMU_VALUES_POOL (&(vm->values_pool))
 #define VMU_STR_OBJS_POOL (&(vm->str_objs_pool))
 #define VMU_ARRAY_OBJS_POOL (&(vm->array_objs_pool))
 #define VMU_LIST_OBJS_POOL (&(vm->list_objs_pool))
 #define VMU_DICT_OBJS_POOL (&(vm->dict_objs_pool))
 #define VMU_RECORD_OBJS_POOL (&(vm->record_objs_pool))
+#define VMU_NATIVE_OBJS_POOL (&(vm->native_objs_pool))
 #define VMU_FN_OBJS_POOL (&(vm->fn_objs_pool))
 #define VMU_NATIVE_FN_OBJS_POOL (&(vm->native_fn_objs_pool))
 #define VMU_CLOSURES_POOL (&(vm->closures_pool))
 #define VMU_CLOSURE_OBJS_POOL (&(vm->closure_objs_pool))
 #define VMU_NATIVE_MODULE_OBJS_POOL (&(vm->native_module_objs_pool))
 #define VMU_MODULE_OBJS_POOL (&(vm->module_objs_pool))
+#define VMU_COROUTINE_OBJS_POOL (&(vm->coroutine_objs_pool))
+#define VMU_INT_OBJS_POOL (&(vm->int_objs_pool))
 
 #define VMU_FRONT_ALLOCATOR (&(vm->front_allocator))
 #define VMU_NATIVE_FRONT_ALLOCATOR (&(((VM *)context)->front_allocator))
 
-int vmu_error(VM *vm, char *msg, ...);
-int vmu_internal_error(VM *vm, char *msg, ...);
+VMU_NORETURN int vmu_error(VM *vm, char *msg, ...);
+VMU_NORETURN int vmu_internal_error(VM *vm, char *msg, ...);
+// Throws 'value' to the innermost catch, as the 'throw' statement does.
+// Without one, it is an error with the message of the value, if any
+VMU_NORETURN int vmu_throw(Value value, VM *vm);
 
 size_t validate_idx(VM *vm, size_t len, int64_t idx);
 
@@ -89,6 +102,26 @@ RecordObj *validate_value_record_arg(Value value, uint8_t param, const char *nam
 
 void vmu_clean_up(VM *vm);
 void vmu_gc(VM *vm);
+void vmu_minor_gc(VM *vm);
+// Incremental major collection: vmu_gc_start() scans the roots, and each
+// vmu_gc_step() marks within the VM's step budget. Once a step returns 1
+// everything is marked, and vmu_gc() finishes the cycle
+void vmu_gc_start(VM *vm);
+int vmu_gc_step(VM *vm);
+// Major collections leave their garbage to be swept lazily: pools
+// sweep it as they need slots, vmu_gc_sweep_step() sweeps a subpool
+// (returns 0 if none was left), and vmu_gc_sweep() sweeps everything
+int vmu_gc_sweep_step(VM *vm);
+void vmu_gc_sweep(VM *vm);
+// Must be called after storing 'value' inside 'obj'
+void vmu_write_barrier(Obj *obj, Value value, VM *vm);
+// Must be called before storing 'value' in a module global
+void vmu_global_barrier(Value value, VM *vm);
+
+// Keep 'value' in the stack of the VM, where the garbage collector
+// finds it, while natives create other objects
+void vmu_push_root(Value value, VM *vm);
+void vmu_pop_root(VM *vm);
 
 Frame *vmu_current_frame(VM *vm);
 #define VMU_CURRENT_FN(_vm)(vmu_current_frame(_vm)->fn)
@@ -196,5 +229,19 @@ void vmu_destroy_native_module_obj(NativeModuleObj *native_module_obj, VM *vm);
 //---------------------------  MODULE  ---------------------------//
 ModuleObj *vmu_create_module_obj(Module *module, VM *vm);
 void vmu_destroy_module_obj(ModuleObj *module_obj, VM *vm);
+//-------------------------  COROUTINE  --------------------------//
+// 'fn' must be a function or a closure, which runs on the first resume
+CoroutineObj *vmu_create_coroutine(Value fn, VM *vm);
+// Done as soon as the coroutine ends, instead of waiting for the collector
+void vmu_release_coroutine_stacks(CoroutineObj *coroutine_obj);
+void vmu_destroy_coroutine(CoroutineObj *coroutine_obj, VM *vm);
+#ifdef NAN_BOXING
+//-------------------------  BOXED INT  --------------------------//
+// vmu_box_int (see types_utils.h) creates the boxed integers in the
+// VM set by this function
+void vmu_set_boxing_vm(VM *vm);
+IntObj *vmu_create_int(int64_t value, VM *vm);
+void vmu_destroy_int(IntObj *int_obj, VM *vm);
+#endif
 
 #endif
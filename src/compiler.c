@@ -17,6 +17,9 @@
 #include "native_module/native_module_time.h"
 #include "native_module/native_module_io.h"
 #include "native_module/native_module_nbarray.h"
+#include "native_module/native_module_chan.h"
+#include "native_module/native_module_parallel.h"
+#include "native_module/native_module_coroutine.h"
 #include "native_module/native_module_raylib.h"
 
 #include "utils.h"
@@ -34,6 +37,8 @@
 #include "vm/obj.h"
 #include "vm/vm_factory.h"
 #include "vm/opcode.h"
+#include "vm/verifier.h"
+#include "vm/types_utils.h"
 
 #include <stdio.h>
 #include <stdarg.h>
@@ -49,8 +54,21 @@ static Unit *create_unit(Compiler *compiler, Fn *fn);
 static Unit *push_unit(Compiler *compiler, Fn *fn);
 static Fn *pop_unit(Compiler *compiler);
 
-static void pop_scope_locals(Compiler *compiler, LocalScope *scope);
+// Instructions looked at once when fusing
+#define PEEPHOLE_WINDOW 5
+static size_t peephole_window(
+    size_t offset,
+    const uint8_t *chunks,
+    size_t chunks_len,
+    const uint8_t *targets,
+    size_t *starts
+);
+static int peephole_is_one(const uint8_t *chunks, size_t offset, const Fn *fn);
+static void peephole(Compiler *compiler);
+
 static void pop_locals(Compiler *compiler);
+static Scope *current_loop_scope(Compiler *compiler);
+static void pop_loop_locals(Compiler *compiler, Scope *loop_scope, uint8_t inclusive);
 
 static Loop *current_loop(Compiler *compiler);
 static void push_loop(Compiler *compiler, int32_t loop_id);
@@ -77,10 +95,13 @@ static size_t write_i16(Compiler *compiler, int16_t value);
 static size_t write_i32(Compiler *compiler, int32_t value);
 static size_t write_iconst(Compiler *compiler, int64_t value);
 static size_t write_fconst(Compiler *compiler, double value);
+static size_t write_cache(Compiler *compiler);
 static void update_i16(Compiler *compiler, size_t offset, uint16_t value);
 static void write_str(Compiler *compiler, size_t raw_str_len, char *raw_str);
 static void write_str_alloc(Compiler *compiler, size_t raw_str_len, char *raw_str);
 static void write_location(Compiler *compiler, const Token *token);
+static void write_global(Compiler *compiler, const Token *identifier_token);
+static int capture_local(Compiler *compiler, Token *identifier_token, Symbol *symbol);
 
 static void label(Compiler *compiler, const Token *ref_token, const char *fmt, ...);
 static void mark(Compiler *compiler, const Token *ref_token, const char *fmt, ...);
@@ -89,6 +110,37 @@ static void jif(Compiler *compiler, const Token *ref_token, const char *fmt, ...
 static void jit(Compiler *compiler, const Token *ref_token, const char *fmt, ...);
 static void or(Compiler *compiler, const Token *ref_token, const char *fmt, ...);
 static void and(Compiler *compiler, const Token *ref_token, const char *fmt, ...);
+static void rjn(
+    Compiler *compiler,
+    uint8_t opcode,
+    uint8_t left,
+    uint8_t right,
+    const Token *ref_token,
+    const char *fmt,
+    ...
+);
+static void next(Compiler *compiler, uint8_t which, const Token *ref_token, const char *fmt, ...);
+
+// REGISTERS
+static int registers_base(Compiler *compiler, uint8_t *out_base);
+static int register_local(Compiler *compiler, Expr *expr, uint8_t *out_register);
+static int register_nodes(Compiler *compiler, Expr *expr);
+static uint8_t compile_register_expr(
+    Compiler *compiler,
+    Expr *expr,
+    int to_dst,
+    uint8_t dst,
+    uint8_t *temps
+);
+static int compile_register_assign(Compiler *compiler, Expr *expr);
+static int compile_register_condition(
+    Compiler *compiler,
+    Expr *expr,
+    uint8_t *out_opcode,
+    uint8_t *out_left,
+    uint8_t *out_right,
+    Token **out_token
+);
 
 static void compile_expr(Compiler *compiler, Expr *expr);
 static void propagate_return(Compiler *compiler, Scope *scope);
@@ -211,6 +263,230 @@ static Unit *push_unit(Compiler *compiler, Fn *fn){
 	return unit;
 }
 
+// Offsets of the consecutive instructions from 'offset' that can be fused.
+// Stops at a jump target: nothing can be fused across it
+size_t peephole_window(
+    size_t offset,
+    const uint8_t *chunks,
+    size_t chunks_len,
+    const uint8_t *targets,
+    size_t *starts
+){
+    size_t count = 0;
+
+    while (count < PEEPHOLE_WINDOW && offset < chunks_len){
+        size_t len = verifier_instruction_len(chunks[offset]);
+
+        if(len == 0 || offset + len > chunks_len || (count > 0 && targets[offset])){
+            break;
+        }
+
+        starts[count++] = offset;
+        offset += len;
+    }
+
+    return count;
+}
+
+int peephole_is_one(const uint8_t *chunks, size_t offset, const Fn *fn){
+    if(chunks[offset] == OP_CINT){
+        return chunks[offset + 1] == 1;
+    }
+
+    if(chunks[offset] == OP_INT){
+        size_t idx = ((size_t)chunks[offset + 1] << 8) | (size_t)chunks[offset + 2];
+
+        return idx < dynarr_len(fn->iconsts) && DYNARR_GET_AS(fn->iconsts, int64_t, idx) == 1;
+    }
+
+    return 0;
+}
+
+// Fuses common instruction sequences into superinstructions. It runs
+// before the jumps are patched, and moves the labels, jumps, marks
+// and locations of the unit to the offsets of the fused chunks
+void peephole(Compiler *compiler){
+    Unit *unit = current_unit(compiler);
+    const Allocator *allocator = unit->lzflist_allocator;
+    Fn *fn = unit->fn;
+    DynArr *chunks_arr = fn->chunks;
+    size_t chunks_len = dynarr_len(chunks_arr);
+
+    if(chunks_len == 0){
+        return;
+    }
+
+    uint8_t *chunks = dynarr_get_raw(chunks_arr, 0);
+    size_t offsets_len = chunks_len + 1;
+    // New offset of every old chunk, including the end of the chunks
+    size_t *offsets = MEMORY_ALLOC(allocator, size_t, offsets_len);
+    uint8_t *targets = MEMORY_ALLOC(allocator, uint8_t, offsets_len);
+    LZOHTable *labels = unit->labels;
+
+    memset(targets, 0, offsets_len);
+
+    for (size_t i = 0; i < labels->m; i++){
+        LZOHTableSlot *slot = &labels->slots[i];
+
+        if(slot->used){
+            targets[((Label *)slot->value)->offset] = 1;
+        }
+    }
+
+    size_t from = 0;
+    size_t to = 0;
+    size_t starts[PEEPHOLE_WINDOW];
+
+    // Fused instructions are never longer than the ones they replace,
+    // so the chunks are rewritten in place
+    while (from < chunks_len){
+        size_t count = peephole_window(from, chunks, chunks_len, targets, starts);
+
+        if(count == 0){
+            // Malformed, left for the verifier to report
+            offsets[from] = to;
+            chunks[to++] = chunks[from++];
+
+            continue;
+        }
+
+        uint8_t ops[PEEPHOLE_WINDOW] = {0};
+
+        for (size_t i = 0; i < count; i++){
+            ops[i] = chunks[starts[i]];
+        }
+
+        size_t fused = 0;
+        uint8_t fused_chunks[5];
+        size_t fused_len = 0;
+        size_t jump_offset = 0;
+
+        if(count >= 5 &&
+           ops[0] == OP_LGET &&
+           peephole_is_one(chunks, starts[1], fn) &&
+           ops[2] == OP_ADD &&
+           ops[3] == OP_LSET &&
+           ops[4] == OP_POP &&
+           chunks[starts[0] + 1] == chunks[starts[3] + 1])
+        {
+            fused = 5;
+            fused_chunks[0] = OP_INCL;
+            fused_chunks[1] = chunks[starts[0] + 1];
+            fused_len = 2;
+        }else if(count >= 4 &&
+                 ops[0] == OP_LGET &&
+                 ops[1] == OP_LGET &&
+                 ((ops[2] == OP_LT && ops[3] == OP_JIF) || (ops[2] == OP_GE && ops[3] == OP_JIT)))
+        {
+            fused = 4;
+            fused_chunks[0] = ops[2] == OP_LT ? OP_LT_LL_JIF : OP_GE_LL_JIT;
+            fused_chunks[1] = chunks[starts[0] + 1];
+            fused_chunks[2] = chunks[starts[1] + 1];
+            fused_chunks[3] = chunks[starts[3] + 1];
+            fused_chunks[4] = chunks[starts[3] + 2];
+            fused_len = 5;
+            jump_offset = starts[3] + 1;
+        }else if(count >= 2 && ops[0] == OP_LGET && ops[1] == OP_LGET){
+            fused = 2;
+            fused_chunks[0] = OP_LGET2;
+            fused_chunks[1] = chunks[starts[0] + 1];
+            fused_chunks[2] = chunks[starts[1] + 1];
+            fused_len = 3;
+        }
+
+        if(fused == 0){
+            size_t len = verifier_instruction_len(ops[0]);
+
+            for (size_t i = 0; i < len; i++){
+                offsets[from + i] = to + i;
+                chunks[to + i] = chunks[from + i];
+            }
+
+            from += len;
+            to += len;
+
+            continue;
+        }
+
+        size_t end = starts[fused - 1] + verifier_instruction_len(ops[fused - 1]);
+
+        // Locations and jumps of the fused instructions move to the new one
+        for (size_t i = from; i < end; i++){
+            offsets[i] = to;
+        }
+
+        if(jump_offset){
+            offsets[jump_offset] = to + fused_len - 2;
+            offsets[jump_offset + 1] = to + fused_len - 1;
+        }
+
+        memcpy(chunks + to, fused_chunks, fused_len);
+
+        from = end;
+        to += fused_len;
+    }
+
+    offsets[chunks_len] = to;
+
+    while (dynarr_len(chunks_arr) > to){
+        dynarr_remove_index(chunks_arr, dynarr_len(chunks_arr) - 1);
+    }
+
+    for (size_t i = 0; i < labels->m; i++){
+        LZOHTableSlot *slot = &labels->slots[i];
+
+        if(slot->used){
+            Label *label = (Label *)slot->value;
+            label->offset = offsets[label->offset];
+        }
+    }
+
+    size_t jmps_len = dynarr_len(unit->jmps);
+
+    for (size_t i = 0; i < jmps_len; i++){
+        Jmp *jmp = dynarr_get_ptr(unit->jmps, i);
+
+        jmp->update_offset = offsets[jmp->update_offset];
+        jmp->jump_offset = offsets[jmp->jump_offset];
+    }
+
+    size_t marks_len = dynarr_len(unit->marks);
+
+    for (size_t i = 0; i < marks_len; i++){
+        Mark *mark = dynarr_get_ptr(unit->marks, i);
+        mark->update_offset = offsets[mark->update_offset];
+    }
+
+    // Only the first location of the fused instructions is kept
+    DynArr *locations = fn->locations;
+    size_t locations_len = dynarr_len(locations);
+    size_t kept = 0;
+
+    for (size_t i = 0; i < locations_len; i++){
+        OPCodeLocation *location = dynarr_get_raw(locations, i);
+        size_t offset = offsets[location->offset];
+
+        if(kept > 0 && ((OPCodeLocation *)dynarr_get_raw(locations, kept - 1))->offset == offset){
+            continue;
+        }
+
+        location->offset = offset;
+
+        if(kept != i){
+            dynarr_set_at(locations, kept, location);
+        }
+
+        kept++;
+    }
+
+    while (dynarr_len(locations) > kept){
+        dynarr_remove_index(locations, dynarr_len(locations) - 1);
+    }
+
+    MEMORY_DEALLOC(allocator, size_t, offsets_len, offsets);
+    MEMORY_DEALLOC(allocator, uint8_t, offsets_len, targets);
+}
+
 Fn *pop_unit(Compiler *compiler){
 	Unit *unit = compiler->units_stack;
     LZOHTable *labels = unit->labels;
@@ -218,6 +494,8 @@ Fn *pop_unit(Compiler *compiler){
     DynArr *marks = unit->marks;
 	Fn *fn = unit->fn;
 
+    peephole(compiler);
+
     size_t jmps_len = dynarr_len(jmps);
 
     for (size_t i = 0; i < jmps_len; i++){
@@ -264,6 +542,18 @@ Fn *pop_unit(Compiler *compiler){
         update_i16(compiler, mark->update_offset, (uint16_t)label->offset);
     }
 
+    VerifierError verifier_error = {0};
+
+    if(verifier_verify(unit->lzflist_allocator, fn, &verifier_error)){
+        internal_error(
+            compiler,
+            "Malformed bytecode in function '%s' at offset %zu: %s",
+            fn->name,
+            verifier_error.offset,
+            verifier_error.msg
+        );
+    }
+
 	compiler->units_stack = unit->prev;
 
     lzpool_dealloc(unit);
@@ -272,16 +562,38 @@ Fn *pop_unit(Compiler *compiler){
 	return fn;
 }
 
-inline void pop_scope_locals(Compiler *compiler, LocalScope *scope){
-    local_t locals_count = LOCAL_SCOPE_LOCALS_COUNT(scope);
+inline void pop_locals(Compiler *compiler){
+    size_t len = scope_manager_locals_count(compiler->manager);
 
-    for (size_t i = 0; i < locals_count; i++){
+    for (size_t i = 0; i < len; i++){
         write_chunk(compiler, OP_POP);
     }
 }
 
-inline void pop_locals(Compiler *compiler){
-    size_t len = scope_manager_locals_count(compiler->manager);
+// The innermost while or for scope of the current function, or NULL
+Scope *current_loop_scope(Compiler *compiler){
+    Scope *current = scope_manager_peek(compiler->manager);
+
+    while(current && current->type != FN_SCOPE_TYPE){
+        if(current->type == WHILE_SCOPE_TYPE || current->type == FOR_SCOPE_TYPE){
+            return current;
+        }
+
+        current = current->prev;
+    }
+
+    return NULL;
+}
+
+// Pops the locals of the scopes a jump out of 'loop_scope' leaves. Those
+// of the loop scope itself are only popped if 'inclusive' is set
+void pop_loop_locals(Compiler *compiler, Scope *loop_scope, uint8_t inclusive){
+    Scope *current = scope_manager_peek(compiler->manager);
+    size_t len = inclusive ? loop_scope->symbols->n : 0;
+
+    for (; current != loop_scope; current = current->prev){
+        len += current->symbols->n;
+    }
 
     for (size_t i = 0; i < len; i++){
         write_chunk(compiler, OP_POP);
@@ -464,6 +776,26 @@ size_t write_fconst(Compiler *compiler, double value){
 	return write_i16(compiler, (int16_t)(dynarr_len(fconsts) - 1));
 }
 
+// Every access site gets its own cache
+size_t write_cache(Compiler *compiler){
+	DynArr *caches = current_fn(compiler)->caches;
+	size_t caches_len = dynarr_len(caches);
+
+	if(caches_len >= UINT16_MAX){
+		internal_error(
+			compiler,
+			"Number of access caches exceeded in '%s' procedure",
+			current_fn(compiler)->name
+		);
+	}
+
+	AccessCache cache = {0};
+
+	dynarr_insert(caches, &cache);
+
+	return write_i16(compiler, (int16_t)caches_len);
+}
+
 void update_i16(Compiler *compiler, size_t offset, uint16_t value){
     DynArr *chunks = current_chunks(compiler);
     size_t chunks_len = dynarr_len(chunks);
@@ -518,6 +850,60 @@ void write_str_alloc(Compiler *compiler, size_t raw_str_len, char *raw_str){
     write_i16(compiler, (int16_t)static_strs_len);
 }
 
+void write_global(Compiler *compiler, const Token *identifier_token){
+	Module *module = current_module(compiler);
+	size_t idx;
+
+	if(vm_factory_module_globals_slot(module, identifier_token->lexeme, &idx)){
+		internal_error(compiler, "Failed to reserve global slot for '%s'", identifier_token->lexeme);
+	}
+
+	if(idx >= INT16_MAX){
+		error(compiler, identifier_token, "Number of globals exceeded in module '%s'", module->name);
+	}
+
+	write_i16(compiler, (int16_t)idx);
+}
+
+// Locals of the enclosing function are captured by the closure being
+// compiled, which reads and writes its own copy of them (OP_OGET and
+// OP_OSET). Returns 1 if 'symbol' is one of them
+int capture_local(Compiler *compiler, Token *identifier_token, Symbol *symbol){
+	Scope *current_scope = scope_manager_peek(compiler->manager);
+	const Scope *symbol_scope = symbol->scope;
+
+	if(!IS_LOCAL_SCOPE(current_scope) || !IS_LOCAL_SCOPE(symbol_scope)){
+		return 0;
+	}
+
+	LocalScope *local_current_scope = AS_LOCAL_SCOPE(current_scope);
+	const LocalScope *local_symbol_scope = AS_LOCAL_SCOPE(symbol_scope);
+
+	if(local_current_scope->depth <= local_symbol_scope->depth){
+		return 0;
+	}
+
+	if(local_current_scope->depth - local_symbol_scope->depth > 1){
+		error(
+			compiler,
+			identifier_token,
+			"Cannot capture locals with more than one jump"
+		);
+	}
+
+	Unit *unit = current_unit(compiler);
+
+	lzohtable_put(
+		identifier_token->lexeme_len,
+		identifier_token->lexeme,
+		symbol,
+		unit->captured_symbols,
+		NULL
+	);
+
+	return 1;
+}
+
 void write_location(Compiler *compiler, const Token *token){
 	DynArr *chunks = current_chunks(compiler);
 	DynArr *locations = current_locations(compiler);
@@ -742,6 +1128,377 @@ void and(Compiler *compiler, const Token *ref_token, const char *fmt, ...){
 	dynarr_insert_ptr(unit->jmps, jmp);
 }
 
+// Like 'jif', but comparing two registers
+void rjn(
+    Compiler *compiler,
+    uint8_t opcode,
+    uint8_t left,
+    uint8_t right,
+    const Token *ref_token,
+    const char *fmt,
+    ...
+){
+	write_chunk(compiler, opcode);
+	write_location(compiler, ref_token);
+	write_chunk(compiler, left);
+	write_chunk(compiler, right);
+	size_t update_offset = write_i16(compiler, 0);
+	size_t jmp_offset = chunks_len(compiler);
+
+	Unit *unit = current_unit(compiler);
+	va_list args;
+
+	va_start(args, fmt);
+
+	size_t name_len = (size_t)(vsnprintf(NULL, 0, fmt, args) + 1);
+	char *cloned_name = MEMORY_ALLOC(unit->lzarena_allocator, char, name_len);
+
+	va_end(args);
+
+	va_start(args, fmt);
+	vsnprintf(cloned_name, name_len, fmt, args);
+	va_end(args);
+
+	Jmp *jmp = lzpool_alloc_x(1024, unit->jmps_pool);
+
+	jmp->update_offset = update_offset;
+	jmp->jump_offset = jmp_offset;
+	jmp->label_name_len = name_len;
+	jmp->label_name = cloned_name;
+
+	dynarr_insert_ptr(unit->jmps, jmp);
+}
+
+// Like 'jmp', but only taken when the iteration over the local
+// 'which' ended. See OP_NEXT
+void next(Compiler *compiler, uint8_t which, const Token *ref_token, const char *fmt, ...){
+	write_chunk(compiler, OP_NEXT);
+	write_location(compiler, ref_token);
+	write_chunk(compiler, which);
+	size_t update_offset = write_i16(compiler, 0);
+	size_t jmp_offset = chunks_len(compiler);
+
+	Unit *unit = current_unit(compiler);
+	va_list args;
+
+	va_start(args, fmt);
+
+	size_t name_len = (size_t)(vsnprintf(NULL, 0, fmt, args) + 1);
+	char *cloned_name = MEMORY_ALLOC(unit->lzarena_allocator, char, name_len);
+
+	va_end(args);
+
+	va_start(args, fmt);
+	vsnprintf(cloned_name, name_len, fmt, args);
+	va_end(args);
+
+	Jmp *jmp = lzpool_alloc_x(1024, unit->jmps_pool);
+
+	jmp->update_offset = update_offset;
+	jmp->jump_offset = jmp_offset;
+	jmp->label_name_len = name_len;
+	jmp->label_name = cloned_name;
+
+	dynarr_insert_ptr(unit->jmps, jmp);
+}
+
+// At statement boundaries the stack only holds the locals of the function,
+// so the first temporary register is the one after the last local
+int registers_base(Compiler *compiler, uint8_t *out_base){
+    Scope *scope = scope_manager_peek(compiler->manager);
+
+    if(!compiler->registers || !IS_LOCAL_SCOPE(scope)){
+        return 1;
+    }
+
+    *out_base = AS_LOCAL_SCOPE(scope)->locals;
+
+    return 0;
+}
+
+// Only locals of the function being compiled are registers: captured ones
+// are read through the closure
+int register_local(Compiler *compiler, Expr *expr, uint8_t *out_register){
+    if(expr->type != IDENTIFIER_EXPRTYPE){
+        return 1;
+    }
+
+    IdentifierExpr *identifier_expr = expr->sub_expr;
+    Symbol *symbol = scope_manager_get_symbol(compiler->manager, identifier_expr->identifier_token);
+
+    if(symbol->type != LOCAL_SYMBOL_TYPE){
+        return 1;
+    }
+
+    Scope *current_scope = scope_manager_peek(compiler->manager);
+    const Scope *symbol_scope = symbol->scope;
+
+    if(IS_LOCAL_SCOPE(current_scope) &&
+       IS_LOCAL_SCOPE(symbol_scope) &&
+       AS_LOCAL_SCOPE(current_scope)->depth > AS_LOCAL_SCOPE(symbol_scope)->depth)
+    {
+        return 1;
+    }
+
+    *out_register = ((LocalSymbol *)symbol)->offset;
+
+    return 0;
+}
+
+// Count of nodes of 'expr' that could need a temporary register,
+// or -1 if 'expr' cannot be compiled to register instructions
+int register_nodes(Compiler *compiler, Expr *expr){
+    switch (expr->type){
+        case GROUP_EXPRTYPE:{
+            GroupExpr *group_expr = expr->sub_expr;
+            return register_nodes(compiler, group_expr->expr);
+        }case IDENTIFIER_EXPRTYPE:{
+            uint8_t reg;
+            return register_local(compiler, expr, &reg) ? -1 : 0;
+        }case INT_EXPRTYPE:
+         case FLOAT_EXPRTYPE:{
+            return 1;
+        }case BINARY_EXPRTYPE:{
+            BinaryExpr *binary_expr = expr->sub_expr;
+            int left = register_nodes(compiler, binary_expr->left);
+            int right = register_nodes(compiler, binary_expr->right);
+
+            if(left < 0 || right < 0){
+                return -1;
+            }
+
+            return left + right + 1;
+        }default:{
+            return -1;
+        }
+    }
+}
+
+// Returns the register holding the value of 'expr': 'dst' if 'to_dst' is set.
+// Temporaries are taken from 'temps' and given back as soon as they are read
+uint8_t compile_register_expr(
+    Compiler *compiler,
+    Expr *expr,
+    int to_dst,
+    uint8_t dst,
+    uint8_t *temps
+){
+    switch (expr->type){
+        case GROUP_EXPRTYPE:{
+            GroupExpr *group_expr = expr->sub_expr;
+            return compile_register_expr(compiler, group_expr->expr, to_dst, dst, temps);
+        }case IDENTIFIER_EXPRTYPE:{
+            IdentifierExpr *identifier_expr = expr->sub_expr;
+            uint8_t src = 0;
+
+            register_local(compiler, expr, &src);
+
+            if(!to_dst || dst == src){
+                return src;
+            }
+
+            write_chunk(compiler, OP_RMOV);
+            write_location(compiler, identifier_expr->identifier_token);
+            write_chunk(compiler, dst);
+            write_chunk(compiler, src);
+
+            return dst;
+        }case INT_EXPRTYPE:{
+            IntExpr *int_expr = expr->sub_expr;
+            Token *int_token = int_expr->token;
+            int64_t value = *(int64_t *)int_token->literal;
+            uint8_t target = to_dst ? dst : (*temps)++;
+
+            if(value >= 0 && value <= UINT8_MAX){
+                write_chunk(compiler, OP_RCINT);
+                write_location(compiler, int_token);
+                write_chunk(compiler, target);
+                write_chunk(compiler, (uint8_t)value);
+            }else{
+                write_chunk(compiler, OP_RINT);
+                write_location(compiler, int_token);
+                write_chunk(compiler, target);
+                write_iconst(compiler, value);
+            }
+
+            return target;
+        }case FLOAT_EXPRTYPE:{
+            FloatExpr *float_expr = expr->sub_expr;
+            Token *float_token = float_expr->token;
+            uint8_t target = to_dst ? dst : (*temps)++;
+
+            write_chunk(compiler, OP_RFLOAT);
+            write_location(compiler, float_token);
+            write_chunk(compiler, target);
+            write_fconst(compiler, *(double *)float_token->literal);
+
+            return target;
+        }case BINARY_EXPRTYPE:{
+            BinaryExpr *binary_expr = expr->sub_expr;
+            Token *operator = binary_expr->operator;
+            Expr *right_expr = binary_expr->right;
+            uint8_t mark = *temps;
+
+            if((operator->type == PLUS_TOKTYPE || operator->type == MINUS_TOKTYPE) &&
+               right_expr->type == INT_EXPRTYPE)
+            {
+                IntExpr *int_expr = right_expr->sub_expr;
+                int64_t value = *(int64_t *)int_expr->token->literal;
+
+                if(value >= 0 && value <= UINT8_MAX){
+                    uint8_t left = compile_register_expr(compiler, binary_expr->left, 0, 0, temps);
+                    *temps = mark;
+                    uint8_t target = to_dst ? dst : (*temps)++;
+
+                    write_chunk(compiler, operator->type == PLUS_TOKTYPE ? OP_RADDK : OP_RSUBK);
+                    write_location(compiler, operator);
+                    write_chunk(compiler, target);
+                    write_chunk(compiler, left);
+                    write_chunk(compiler, (uint8_t)value);
+
+                    return target;
+                }
+            }
+
+            uint8_t left = compile_register_expr(compiler, binary_expr->left, 0, 0, temps);
+            uint8_t right = compile_register_expr(compiler, right_expr, 0, 0, temps);
+            *temps = mark;
+            uint8_t target = to_dst ? dst : (*temps)++;
+
+            switch (operator->type){
+                case PLUS_TOKTYPE:{
+                    write_chunk(compiler, OP_RADD);
+                    break;
+                }case MINUS_TOKTYPE:{
+                    write_chunk(compiler, OP_RSUB);
+                    break;
+                }case ASTERISK_TOKTYPE:{
+                    write_chunk(compiler, OP_RMUL);
+                    break;
+                }case SLASH_TOKTYPE:{
+                    write_chunk(compiler, OP_RDIV);
+                    break;
+                }case MOD_TOKTYPE:{
+                    write_chunk(compiler, OP_RMOD);
+                    break;
+                }default:{
+                    assert("Illegal token type");
+                    break;
+                }
+            }
+
+            write_location(compiler, operator);
+            write_chunk(compiler, target);
+            write_chunk(compiler, left);
+            write_chunk(compiler, right);
+
+            return target;
+        }default:{
+            assert(0 && "Illegal register expression");
+            return 0;
+        }
+    }
+}
+
+// Compiles the assignation of a local as an statement, without leaving its
+// value in the stack. Returns 1 if it cannot be done with registers
+int compile_register_assign(Compiler *compiler, Expr *expr){
+    uint8_t base;
+
+    if(expr->type != ASSIGN_EXPRTYPE || registers_base(compiler, &base)){
+        return 1;
+    }
+
+    AssignExpr *assign_expr = expr->sub_expr;
+    Expr *left_expr = assign_expr->left_expr;
+    uint8_t dst;
+
+    if(register_local(compiler, left_expr, &dst)){
+        return 1;
+    }
+
+    int nodes = register_nodes(compiler, assign_expr->value_expr);
+
+    if(nodes < 0 || (int)base + nodes > UINT8_MAX){
+        return 1;
+    }
+
+    IdentifierExpr *identifier_expr = left_expr->sub_expr;
+    Token *identifier_token = identifier_expr->identifier_token;
+    LocalSymbol *local_symbol = (LocalSymbol *)scope_manager_get_symbol(compiler->manager, identifier_token);
+
+    if(!local_symbol->is_mutable && local_symbol->is_initialized){
+        error(
+            compiler,
+            assign_expr->equals_token,
+            "Local symbol '%s' declared as immutable and already initialized",
+            identifier_token->lexeme
+        );
+    }
+
+    compile_register_expr(compiler, assign_expr->value_expr, 1, dst, &base);
+
+    return 0;
+}
+
+// Compiles the operands of a condition that compares numbers. The caller
+// emits the jump. Returns 1, without compiling anything, if it cannot be
+// done with registers
+int compile_register_condition(
+    Compiler *compiler,
+    Expr *expr,
+    uint8_t *out_opcode,
+    uint8_t *out_left,
+    uint8_t *out_right,
+    Token **out_token
+){
+    uint8_t base;
+
+    while (expr->type == GROUP_EXPRTYPE){
+        expr = ((GroupExpr *)expr->sub_expr)->expr;
+    }
+
+    if(expr->type != COMPARISON_EXPRTYPE || registers_base(compiler, &base)){
+        return 1;
+    }
+
+    ComparisonExpr *comparison_expr = expr->sub_expr;
+    Token *operator_token = comparison_expr->operator_token;
+    uint8_t opcode;
+
+    switch (operator_token->type){
+        case LESS_TOKTYPE:{
+            opcode = OP_RJNLT;
+            break;
+        }case GREATER_TOKTYPE:{
+            opcode = OP_RJNGT;
+            break;
+        }case LESS_EQUALS_TOKTYPE:{
+            opcode = OP_RJNLE;
+            break;
+        }case GREATER_EQUALS_TOKTYPE:{
+            opcode = OP_RJNGE;
+            break;
+        }default:{
+            return 1;
+        }
+    }
+
+    int left_nodes = register_nodes(compiler, comparison_expr->left);
+    int right_nodes = register_nodes(compiler, comparison_expr->right);
+
+    if(left_nodes < 0 || right_nodes < 0 || (int)base + left_nodes + right_nodes > UINT8_MAX){
+        return 1;
+    }
+
+    *out_opcode = opcode;
+    *out_left = compile_register_expr(compiler, comparison_expr->left, 0, 0, &base);
+    *out_right = compile_register_expr(compiler, comparison_expr->right, 0, 0, &base);
+    *out_token = operator_token;
+
+    return 0;
+}
+
 void compile_expr(Compiler *compiler, Expr *expr){
     ScopeManager *manager = compiler->manager;
 
@@ -832,6 +1589,7 @@ void compile_expr(Compiler *compiler, Expr *expr){
             vm_factory_module_add_fn(current_module(compiler), fn, &symbol_idx);
             scope_manager_push(manager, FN_SCOPE_TYPE);
             push_unit(compiler, fn);
+            Block *block = push_block(compiler);
 
             for (size_t i = 0; i < params_len; i++){
                 Token *param_identifier_token = dynarr_get_ptr(params, i);
@@ -844,10 +1602,13 @@ void compile_expr(Compiler *compiler, Expr *expr){
                 );
             }
 
+            block->stmts_len = stmts_len;
             uint8_t must_return = 1;
 
             for (size_t i = 0; i < stmts_len; i++){
                 Stmt *stmt = dynarr_get_ptr(stmts, i);
+                block->current_stmt = i + 1;
+
                 compile_stmt(compiler, stmt);
 
                 if(i + 1 >= stmts_len && stmt->type == RETURN_STMT_TYPE){
@@ -894,6 +1655,7 @@ void compile_expr(Compiler *compiler, Expr *expr){
                 );
             }
 
+            pop_block(compiler);
             pop_unit(compiler);
             scope_manager_pop(manager);
 
@@ -910,44 +1672,8 @@ void compile_expr(Compiler *compiler, Expr *expr){
             switch (symbol->type){
                 case LOCAL_SYMBOL_TYPE:{
                     LocalSymbol *local_symbol = (LocalSymbol *)symbol;
-                    Scope *current_scope = scope_manager_peek(manager);
-                    const Scope *symbol_scope = symbol->scope;
-
-                    if(IS_LOCAL_SCOPE(current_scope) && IS_LOCAL_SCOPE(symbol_scope)){
-                        LocalScope *local_current_scope = AS_LOCAL_SCOPE(current_scope);
-                        const LocalScope *local_symbol_scope = AS_LOCAL_SCOPE(symbol_scope);
-
-                        if(local_current_scope->depth > local_symbol_scope->depth){
-                            depth_t depth_diff = local_current_scope->depth - local_symbol_scope->depth;
-
-                            if(depth_diff > 1){
-                                error(
-                                    compiler,
-                                    identifier_token,
-                                    "Cannot capture locals with more than one jump"
-                                );
-                            }
-
-                            Unit *unit = current_unit(compiler);
-                            LZOHTable *captured_symbols = unit->captured_symbols;
-
-                            lzohtable_put(
-                                identifier_token->lexeme_len,
-                                identifier_token->lexeme,
-                                symbol,
-                                captured_symbols,
-                                NULL
-                            );
-
-                            write_chunk(compiler, OP_OGET);
-                            write_location(compiler, identifier_token);
-                            write_chunk(compiler, local_symbol->offset);
-
-                            break;
-                        }
-                    }
 
-                    write_chunk(compiler, OP_LGET);
+                    write_chunk(compiler, capture_local(compiler, identifier_token, symbol) ? OP_OGET : OP_LGET);
                     write_location(compiler, identifier_token);
                     write_chunk(compiler, local_symbol->offset);
 
@@ -957,11 +1683,7 @@ void compile_expr(Compiler *compiler, Expr *expr){
                  case MODULE_SYMBOL_TYPE:{
                     write_chunk(compiler, OP_GGET);
                     write_location(compiler, identifier_token);
-                    write_str_alloc(
-                        compiler,
-                        identifier_token->lexeme_len,
-                        identifier_token->lexeme
-                    );
+                    write_global(compiler, identifier_token);
 
                     break;
                 }case NATIVE_FN_SYMBOL_TYPE:{
@@ -1033,6 +1755,27 @@ void compile_expr(Compiler *compiler, Expr *expr){
                 }
             }
 
+            // Calling a method: the target is passed along the
+            // arguments, so the method is never bound to it
+            if(call_expr->left_expr->type == ACCESS_EXPRTYPE){
+                AccessExpr *access_expr = call_expr->left_expr->sub_expr;
+                Token *symbol_token = access_expr->symbol_token;
+
+                compile_expr(compiler, access_expr->left_expr);
+
+                for (size_t i = 0; i < args_count; i++){
+                    compile_expr(compiler, dynarr_get_ptr(args, i));
+                }
+
+                write_chunk(compiler, OP_INVOKE);
+                write_location(compiler, call_expr->left_paren);
+                write_chunk(compiler, args_count);
+                write_str_alloc(compiler, symbol_token->lexeme_len, symbol_token->lexeme);
+                write_cache(compiler);
+
+                break;
+            }
+
             compile_expr(compiler, call_expr->left_expr);
 
             for (size_t i = 0; i < args_count; i++){
@@ -1055,6 +1798,7 @@ void compile_expr(Compiler *compiler, Expr *expr){
             write_chunk(compiler, OP_ACCESS);
 			write_location(compiler, dot_token);
             write_str_alloc(compiler, symbol_token->lexeme_len, symbol_token->lexeme);
+            write_cache(compiler);
 
             break;
         }case INDEX_EXPRTYPE:{
@@ -1285,7 +2029,7 @@ void compile_expr(Compiler *compiler, Expr *expr){
 
                             compile_expr(compiler, value_expr);
 
-                            write_chunk(compiler, OP_LSET);
+                            write_chunk(compiler, capture_local(compiler, identifier_token, symbol) ? OP_OSET : OP_LSET);
                             write_location(compiler, equals_token);
                             write_chunk(compiler, local_symbol->offset);
 
@@ -1310,7 +2054,7 @@ void compile_expr(Compiler *compiler, Expr *expr){
 
                             write_chunk(compiler, OP_GSET);
                             write_location(compiler, equals_token);
-                            write_str_alloc(compiler, identifier_token->lexeme_len, identifier_token->lexeme);
+                            write_global(compiler, identifier_token);
 
                             break;
                         }case FN_SYMBOL_TYPE:{
@@ -1368,6 +2112,7 @@ void compile_expr(Compiler *compiler, Expr *expr){
                    		symbol_token->lexeme_len,
                     	symbol_token->lexeme
                   	);
+                    write_cache(compiler);
 
                   	break;
                 }default:{
@@ -1407,7 +2152,7 @@ void compile_expr(Compiler *compiler, Expr *expr){
 	                          	);
 	                      	}
 
-                      		write_chunk(compiler, OP_LGET);
+                      		write_chunk(compiler, capture_local(compiler, identifier_token, symbol) ? OP_OGET : OP_LGET);
 		                    write_location(compiler, identifier_token);
 		                    write_chunk(compiler, local_symbol->offset);
 
@@ -1426,11 +2171,7 @@ void compile_expr(Compiler *compiler, Expr *expr){
 
                         	write_chunk(compiler, OP_GGET);
 	                        write_location(compiler, identifier_token);
-	                        write_str_alloc(
-								compiler,
-								identifier_token->lexeme_len,
-								identifier_token->lexeme
-							);
+	                        write_global(compiler, identifier_token);
 
                       		break;
                       	}default:{
@@ -1466,7 +2207,7 @@ void compile_expr(Compiler *compiler, Expr *expr){
                    		case LOCAL_SYMBOL_TYPE:{
                    			LocalSymbol *local_symbol = (LocalSymbol *)symbol;
 
-                    		write_chunk(compiler, OP_LSET);
+                    		write_chunk(compiler, capture_local(compiler, identifier_token, symbol) ? OP_OSET : OP_LSET);
                       		write_location(compiler, identifier_token);
                         	write_chunk(compiler, local_symbol->offset);
 
@@ -1474,11 +2215,7 @@ void compile_expr(Compiler *compiler, Expr *expr){
                      	}case GLOBAL_SYMBOL_TYPE:{
                         	write_chunk(compiler, OP_GSET);
                          	write_location(compiler, identifier_token);
-                         	write_str_alloc(
-                          		compiler,
-                            	identifier_token->lexeme_len,
-                             	identifier_token->lexeme
-                          	);
+                         	write_global(compiler, identifier_token);
 
                       		break;
                       	}default:{
@@ -1563,6 +2300,7 @@ void compile_expr(Compiler *compiler, Expr *expr){
                      	symbol_token->lexeme_len,
                       	symbol_token->lexeme
                     );
+                    write_cache(compiler);
 
                     break;
                 }default:{
@@ -1674,6 +2412,7 @@ void compile_expr(Compiler *compiler, Expr *expr){
                 write_chunk(compiler, OP_IRECORD);
                 write_location(compiler, record_token);
                 write_str_alloc(compiler, key->lexeme_len, key->lexeme);
+                write_cache(compiler);
             }
 
 			break;
@@ -1740,7 +2479,31 @@ void compile_expr(Compiler *compiler, Expr *expr){
             label(compiler, mark_token, "TENARY_END_%"PRId32, id);
 
 		    break;
-		}default:{
+		}case YIELD_EXPRTYPE:{
+            YieldExpr *yield_expr = expr->sub_expr;
+            Token *yield_token = yield_expr->yield_token;
+            Expr *value_expr = yield_expr->value_expr;
+
+            if(scope_manager_is_global_scope(manager)){
+                error(
+                    compiler,
+                    yield_token,
+                    "Yield expressions not allowed in global scope"
+                );
+            }
+
+            if(value_expr){
+                compile_expr(compiler, value_expr);
+            }else{
+                write_chunk(compiler, OP_EMPTY);
+                write_location(compiler, yield_token);
+            }
+
+            write_chunk(compiler, OP_YIELD);
+            write_location(compiler, yield_token);
+
+            break;
+        }default:{
             assert("Illegal expression type");
             break;
         }
@@ -1772,8 +2535,17 @@ int compile_if_branch(
     DynArr *stmts = if_branch->stmts;
     size_t stmts_len = stmts ? dynarr_len(stmts) : 0;
 
-    compile_expr(compiler, condition);
-    jif(compiler, branch_token, ".IFB(%"PRId32")_END_%"PRId32, id, which);
+    uint8_t opcode;
+    uint8_t left;
+    uint8_t right;
+    Token *operator_token;
+
+    if(compile_register_condition(compiler, condition, &opcode, &left, &right, &operator_token)){
+        compile_expr(compiler, condition);
+        jif(compiler, branch_token, ".IFB(%"PRId32")_END_%"PRId32, id, which);
+    }else{
+        rjn(compiler, opcode, left, right, operator_token, ".IFB(%"PRId32")_END_%"PRId32, id, which);
+    }
 
     Scope *scope = scope_manager_push(compiler->manager, type);
     Block *block = push_block(compiler);
@@ -1918,6 +2690,60 @@ int import_native(Compiler *compiler, const Token *name_token){
 		return 1;
 	}
 
+    if(strcmp("chan", name_token->lexeme) == 0){
+		if(!chan_native_module){
+			chan_module_init(compiler->rtallocator);
+
+			vm_factory_module_globals_add_obj(
+				current_module(compiler),
+				(Obj *)vm_factory_native_module_obj_create(
+					compiler->rtallocator,
+					chan_native_module
+				),
+				"chan",
+				PRIVATE_GLOVAL_VALUE_TYPE
+			);
+		}
+
+		return 1;
+	}
+
+    if(strcmp("parallel", name_token->lexeme) == 0){
+		if(!parallel_native_module){
+			parallel_module_init(compiler->rtallocator);
+
+			vm_factory_module_globals_add_obj(
+				current_module(compiler),
+				(Obj *)vm_factory_native_module_obj_create(
+					compiler->rtallocator,
+					parallel_native_module
+				),
+				"parallel",
+				PRIVATE_GLOVAL_VALUE_TYPE
+			);
+		}
+
+		return 1;
+	}
+
+    if(strcmp("coroutine", name_token->lexeme) == 0){
+		if(!coroutine_native_module){
+			coroutine_module_init(compiler->rtallocator);
+
+			vm_factory_module_globals_add_obj(
+				current_module(compiler),
+				(Obj *)vm_factory_native_module_obj_create(
+					compiler->rtallocator,
+					coroutine_native_module
+				),
+				"coroutine",
+				PRIVATE_GLOVAL_VALUE_TYPE
+			);
+		}
+
+		return 1;
+	}
+
 #ifdef RAYLIB
     if(strcmp("raylib", name_token->lexeme) == 0){
 		if(!raylib_native_module){
@@ -2077,6 +2903,10 @@ Module *import_module(
     Parser *parser = parser_create(ctallocator);
     Compiler *import_compiler = compiler_create(ctallocator, rtallocator);
 
+    if(import_compiler){
+        import_compiler->registers = compiler->registers;
+    }
+
     if(lexer_scan(source, tokens, keywords, pathname, lexer)){
         error(
             compiler,
@@ -2173,6 +3003,10 @@ void compile_stmt(Compiler *compiler, Stmt *stmt){
             ExprStmt *expr_stmt = stmt->sub_stmt;
             Expr *sub_expr = expr_stmt->expr;
 
+            if(!compile_register_assign(compiler, sub_expr)){
+                break;
+            }
+
             compile_expr(compiler, sub_expr);
             write_chunk(compiler, OP_POP);
 
@@ -2219,11 +3053,7 @@ void compile_stmt(Compiler *compiler, Stmt *stmt){
 
                 write_chunk(compiler, OP_GDEF);
                 write_location(compiler, identifier_token);
-                write_str_alloc(
-                    compiler,
-                    identifier_token->lexeme_len,
-                    identifier_token->lexeme
-                );
+                write_global(compiler, identifier_token);
             }else{
                 scope_manager_define_local(
                     manager,
@@ -2334,12 +3164,18 @@ void compile_stmt(Compiler *compiler, Stmt *stmt){
             StopStmt *stop_stmt = stmt->sub_stmt;
             Token *stop_token = stop_stmt->stop_token;
 
-            if(scope_manager_is_scope_type(manager, WHILE_SCOPE_TYPE)){
+            Scope *loop_scope = current_loop_scope(compiler);
+
+            // The end of while loops expects none of their locals, and the
+            // end of for loops pops their own ones
+            if(loop_scope && loop_scope->type == WHILE_SCOPE_TYPE){
+                pop_loop_locals(compiler, loop_scope, 1);
                 jmp(compiler, stop_token, ".WHILE(%"PRId32")_END", current_loop(compiler)->id);
                 break;
             }
 
-            if(scope_manager_is_scope_type(manager, FOR_SCOPE_TYPE)){
+            if(loop_scope && loop_scope->type == FOR_SCOPE_TYPE){
+                pop_loop_locals(compiler, loop_scope, 0);
                 jmp(compiler, stop_token, ".FOR(%"PRId32")_END", current_loop(compiler)->id);
                 break;
             }
@@ -2355,7 +3191,10 @@ void compile_stmt(Compiler *compiler, Stmt *stmt){
             ContinueStmt *continue_stmt = stmt->sub_stmt;
             Token *continue_token = continue_stmt->continue_token;
 
-            if(scope_manager_is_scope_type(manager, WHILE_SCOPE_TYPE)){
+            Scope *loop_scope = current_loop_scope(compiler);
+
+            if(loop_scope && loop_scope->type == WHILE_SCOPE_TYPE){
+                pop_loop_locals(compiler, loop_scope, 1);
                 jmp(
                 	compiler,
                  	continue_token,
@@ -2365,7 +3204,8 @@ void compile_stmt(Compiler *compiler, Stmt *stmt){
                 break;
             }
 
-            if(scope_manager_is_scope_type(manager, FOR_SCOPE_TYPE)){
+            if(loop_scope && loop_scope->type == FOR_SCOPE_TYPE){
+                pop_loop_locals(compiler, loop_scope, 1);
                 jmp(
                 	compiler,
                  	continue_token,
@@ -2392,9 +3232,17 @@ void compile_stmt(Compiler *compiler, Stmt *stmt){
 
             label(compiler, while_token, ".WHILE(%"PRId32")_TEST", while_id);
 
-            compile_expr(compiler, condition_expr);
+            uint8_t opcode;
+            uint8_t left;
+            uint8_t right;
+            Token *operator_token;
 
-            jif(compiler, while_token, ".WHILE(%"PRId32")_END", while_id);
+            if(compile_register_condition(compiler, condition_expr, &opcode, &left, &right, &operator_token)){
+                compile_expr(compiler, condition_expr);
+                jif(compiler, while_token, ".WHILE(%"PRId32")_END", while_id);
+            }else{
+                rjn(compiler, opcode, left, right, operator_token, ".WHILE(%"PRId32")_END", while_id);
+            }
 
             Scope *scope = scope_manager_push(manager, WHILE_SCOPE_TYPE);
             push_loop(compiler, while_id);
@@ -2529,6 +3377,81 @@ void compile_stmt(Compiler *compiler, Stmt *stmt){
             pop_locals(compiler);
             scope_manager_pop(manager);
 
+            break;
+        }case FOR_IN_STMT_TYPE:{
+            ForInStmt *for_in_stmt = stmt->sub_stmt;
+            Token *for_token = for_in_stmt->for_token;
+            Token *symbol_token = for_in_stmt->symbol_token;
+            Token *in_token = for_in_stmt->in_token;
+            Expr *iterable_expr = for_in_stmt->iterable_expr;
+            DynArr *stmts = for_in_stmt->stmts;
+            size_t stmts_len = dynarr_len(stmts);
+            int32_t for_id = generate_id(compiler);
+
+            // BLOCK_SCOPE
+            scope_manager_push(manager, BLOCK_SCOPE_TYPE);
+
+            // INITIALIZATION SECTION
+            // The iterable, the cursor over it and the value of the
+            // iteration are consecutive locals. The keywords name the first
+            // two, so they cannot be accessed from the body
+            compile_expr(compiler, iterable_expr);
+            LocalSymbol *iterable_symbol = scope_manager_define_local(manager, 0, 1, in_token);
+
+            write_chunk(compiler, OP_CINT);
+            write_location(compiler, for_token);
+            write_chunk(compiler, 0);
+            scope_manager_define_local(manager, 0, 1, for_token);
+
+            write_chunk(compiler, OP_EMPTY);
+            write_location(compiler, for_token);
+            scope_manager_define_local(manager, 0, 1, symbol_token);
+
+            // FOR IN SCOPE
+            Scope *scope = scope_manager_push(manager, FOR_SCOPE_TYPE);
+            push_loop(compiler, for_id);
+            Block *block = push_block(compiler);
+
+            block->stmts_len = stmts_len;
+
+            // TEST SECTION
+            label(compiler, for_token, ".FOR(%"PRId32")_TEST", for_id);
+            next(compiler, iterable_symbol->offset, for_token, ".FOR_IN(%"PRId32")_END", for_id);
+
+            for (size_t i = 0; i < stmts_len; i++){
+           		if(AS_LOCAL_SCOPE(scope)->returned){
+	         		error(
+	            		compiler,
+	               		for_token,
+	                 	"Cannot exists statements after the scope returned"
+	           		);
+	           	}
+
+                Stmt *stmt = dynarr_get_ptr(stmts, i);
+                block->current_stmt = i + 1;
+
+                compile_stmt(compiler, stmt);
+            }
+
+            pop_locals(compiler);
+
+            // JUMP TO TEST SECTION
+            jmp(compiler, for_token, ".FOR(%"PRId32")_TEST", for_id);
+
+            // END OF THE FOR IN STATEMENT
+            label(compiler, for_token, ".FOR(%"PRId32")_END", for_id);
+
+            // FOR IN SCOPE
+            pop_block(compiler);
+            pop_loop(compiler);
+            pop_locals(compiler);
+            scope_manager_pop(manager);
+
+            // BLOCK SCOPE
+            label(compiler, for_token, ".FOR_IN(%"PRId32")_END", for_id);
+            pop_locals(compiler);
+            scope_manager_pop(manager);
+
             break;
         }case THROW_STMT_TYPE:{
             ThrowStmt *throw_stmt = stmt->sub_stmt;
@@ -2557,6 +3480,7 @@ void compile_stmt(Compiler *compiler, Stmt *stmt){
             Token *try_token = try_stmt->try_token;
             DynArr *try_stmts = try_stmt->try_stmts;
             Token *catch_token = try_stmt->catch_token;
+            Token *err_identifier = try_stmt->err_identifier;
             DynArr *catch_stmts = try_stmt->catch_stmts;
 
             if(scope_manager_peek(manager)->type == CATCH_SCOPE_TYPE){
@@ -2598,10 +3522,7 @@ void compile_stmt(Compiler *compiler, Stmt *stmt){
                 pop_locals(compiler);
                 write_chunk(compiler, OP_TRYC);
                 write_location(compiler, try_token);
-
-                if(catch_stmts){
-                    jmp(compiler, try_token, "CATCH(%"PRId32")_END", try_id);
-                }
+                jmp(compiler, try_token, "CATCH(%"PRId32")_END", try_id);
 
                 pop_block(compiler);
             }
@@ -2609,11 +3530,18 @@ void compile_stmt(Compiler *compiler, Stmt *stmt){
             scope_manager_pop(manager);
             Scope *catch_scope = scope_manager_push(manager, CATCH_SCOPE_TYPE);
 
-            if(catch_stmts){
+            // Without a try block nothing can throw
+            if(try_stmts && catch_stmts){
            		Block *block = push_block(compiler);
 
              	label(compiler, catch_token, "CATCH(%"PRId32")", try_id);
-                pop_scope_locals(compiler, AS_LOCAL_SCOPE(try_scope));
+                // Throws restore the stack as it was before the try block,
+                // plus the thrown value: the error identifier of the catch
+                if(err_identifier){
+                    scope_manager_define_local(manager, 0, 1, err_identifier);
+                }else{
+                    write_chunk(compiler, OP_POP);
+                }
 
                 size_t len = dynarr_len(catch_stmts);
                 block->stmts_len = len;
@@ -2637,9 +3565,10 @@ void compile_stmt(Compiler *compiler, Stmt *stmt){
                 label(compiler, catch_token, "CATCH(%"PRId32")_END", try_id);
 
                 pop_block(compiler);
-            }else{
+            }else if(try_stmts){
                 label(compiler, catch_token, "CATCH(%"PRId32")", try_id);
-                pop_scope_locals(compiler, AS_LOCAL_SCOPE(try_scope));
+                write_chunk(compiler, OP_POP);
+                label(compiler, catch_token, "CATCH(%"PRId32")_END", try_id);
             }
 
             scope_manager_pop(manager);
@@ -2688,6 +3617,19 @@ void compile_stmt(Compiler *compiler, Stmt *stmt){
                 }
 
                 compile_expr(compiler, ret_expr);
+
+                // Calls in tail position reuse the frame of the function.
+                // Not inside try blocks: their catch belongs to the frame
+                if(ret_expr->type == CALL_EXPRTYPE &&
+                   ((CallExpr *)ret_expr->sub_expr)->left_expr->type != ACCESS_EXPRTYPE &&
+                   !scope_manager_is_scope_type(manager, TRY_SCOPE_TYPE))
+                {
+                    // The call was the last instruction written: OP_CALL and its arguments count
+                    uint8_t *chunks = dynarr_get_raw(current_chunks(compiler), 0);
+                    chunks[chunks_len(compiler) - 2] = OP_TCALL;
+
+                    break;
+                }
             }
 
             write_chunk(compiler, OP_RET);
@@ -2852,7 +3794,7 @@ void compile_stmt(Compiler *compiler, Stmt *stmt){
 
                 write_chunk(compiler, OP_GASET);
                 write_location(compiler, export_token);
-                write_str_alloc(compiler, symbol_token->lexeme_len, symbol_token->lexeme);
+                write_global(compiler, symbol_token);
                 write_chunk(compiler, 1);
             }
 
@@ -2875,7 +3817,7 @@ void declare_defaults(Compiler *compiler){
             continue;
         }
 
-        NativeFnObj *native_fn_obj = ((Value *)slot.value)->content.obj_val;
+        NativeFnObj *native_fn_obj = VALUE_TO_OBJ_PTR(*(Value *)slot.value);
         NativeFn *native_fn = native_fn_obj->native_fn;
 
         scope_manager_define_native_fn(
@@ -79,6 +79,18 @@ static char *read_str(Dumpper *dumpper, size_t *out_len){
     return str.buff;
 }
 
+static char *read_global(Dumpper *dumpper, size_t *out_idx){
+    DynArr *global_slots = MODULE_GLOBAL_SLOTS(CURRENT_MODULE(dumpper));
+    size_t idx = (size_t)read_i16(dumpper);
+    GlobalSlot global_slot = DYNARR_GET_AS(global_slots, GlobalSlot, idx);
+
+    if(out_idx){
+        *out_idx = idx;
+    }
+
+    return global_slot.name;
+}
+
 static void execute(uint8_t chunk, Dumpper *dumpper){
     size_t start = dumpper->ip - 1;
 	printf("%.7zu ", start);
@@ -237,6 +249,62 @@ static void execute(uint8_t chunk, Dumpper *dumpper){
 			printf("%8.8s %.7zu", "LSET", end - start);
             printf(" | slot: %d\n", slot);
 
+            break;
+        }case OP_ADD_II:{
+            size_t end = dumpper->ip;
+            printf("%8.8s %.7zu\n", "ADD_II", end - start);
+            break;
+        }case OP_ADD_FF:{
+            size_t end = dumpper->ip;
+            printf("%8.8s %.7zu\n", "ADD_FF", end - start);
+            break;
+        }case OP_SUB_II:{
+            size_t end = dumpper->ip;
+            printf("%8.8s %.7zu\n", "SUB_II", end - start);
+            break;
+        }case OP_SUB_FF:{
+            size_t end = dumpper->ip;
+            printf("%8.8s %.7zu\n", "SUB_FF", end - start);
+            break;
+        }case OP_MUL_II:{
+            size_t end = dumpper->ip;
+            printf("%8.8s %.7zu\n", "MUL_II", end - start);
+            break;
+        }case OP_MUL_FF:{
+            size_t end = dumpper->ip;
+            printf("%8.8s %.7zu\n", "MUL_FF", end - start);
+            break;
+        }case OP_LT_II:{
+            size_t end = dumpper->ip;
+            printf("%8.8s %.7zu\n", "LT_II", end - start);
+            break;
+        }case OP_LT_FF:{
+            size_t end = dumpper->ip;
+            printf("%8.8s %.7zu\n", "LT_FF", end - start);
+            break;
+        }case OP_GT_II:{
+            size_t end = dumpper->ip;
+            printf("%8.8s %.7zu\n", "GT_II", end - start);
+            break;
+        }case OP_GT_FF:{
+            size_t end = dumpper->ip;
+            printf("%8.8s %.7zu\n", "GT_FF", end - start);
+            break;
+        }case OP_LE_II:{
+            size_t end = dumpper->ip;
+            printf("%8.8s %.7zu\n", "LE_II", end - start);
+            break;
+        }case OP_LE_FF:{
+            size_t end = dumpper->ip;
+            printf("%8.8s %.7zu\n", "LE_FF", end - start);
+            break;
+        }case OP_GE_II:{
+            size_t end = dumpper->ip;
+            printf("%8.8s %.7zu\n", "GE_II", end - start);
+            break;
+        }case OP_GE_FF:{
+            size_t end = dumpper->ip;
+            printf("%8.8s %.7zu\n", "GE_FF", end - start);
             break;
         }case OP_LGET:{
 			uint8_t slot = advance(dumpper);
@@ -263,36 +331,40 @@ static void execute(uint8_t chunk, Dumpper *dumpper){
 
             break;
         }case OP_GDEF:{
-            char *value = read_str(dumpper, NULL);
+            size_t idx;
+            char *value = read_global(dumpper, &idx);
             size_t end = dumpper->ip;
 
             printf("%8.8s %.7zu", "GDEF", end - start);
-            printf(" | '%s'\n", value);
+            printf(" | slot: %zu '%s'\n", idx, value);
 
             break;
         }case OP_GSET:{
-            char *value = read_str(dumpper, NULL);
+            size_t idx;
+            char *value = read_global(dumpper, &idx);
             size_t end = dumpper->ip;
 
             printf("%8.8s %.7zu", "GSET", end - start);
-            printf(" | '%s'\n", value);
+            printf(" | slot: %zu '%s'\n", idx, value);
 
             break;
         }case OP_GGET:{
-            char *value = read_str(dumpper, NULL);
+            size_t idx;
+            char *value = read_global(dumpper, &idx);
             size_t end = dumpper->ip;
 
             printf("%8.8s %.7zu", "GGET", end - start);
-            printf(" | '%s'\n", value);
+            printf(" | slot: %zu '%s'\n", idx, value);
 
             break;
         }case OP_GASET:{
-            char *value = read_str(dumpper, NULL);
+            size_t idx;
+            char *value = read_global(dumpper, &idx);
             uint8_t access_type = advance(dumpper);
             size_t end = dumpper->ip;
 
             printf("%8.8s %.7zu", "GASET", end - start);
-            printf(" | '%s' %s\n", value, access_type == 0 ? "private" : "public");
+            printf(" | slot: %zu '%s' %s\n", idx, value, access_type == 0 ? "private" : "public");
 
             break;
         }case OP_NGET:{
@@ -317,10 +389,11 @@ static void execute(uint8_t chunk, Dumpper *dumpper){
             break;
         }case OP_RSET:{
 			char *target = read_str(dumpper, NULL);
+            int16_t cache = read_i16(dumpper);
             size_t end = dumpper->ip;
 
 			printf("%8.8s %.7zu", "RSET", end - start);
-            printf(" | target: '%s'\n", target);
+            printf(" | target: '%s' cache: %d\n", target, cache);
 
             break;
 		}case OP_OR:{
@@ -422,10 +495,11 @@ static void execute(uint8_t chunk, Dumpper *dumpper){
             break;
         }case OP_IRECORD:{
             char *key = read_str(dumpper, NULL);
+            int16_t cache = read_i16(dumpper);
             size_t end = dumpper->ip;
 
             printf("%8.8s %.7zu", "IRECORD", end - start);
-            printf(" | key: '%s'\n", key);
+            printf(" | key: '%s' cache: %d\n", key, cache);
 
             break;
         }case OP_CALL:{
@@ -435,13 +509,32 @@ static void execute(uint8_t chunk, Dumpper *dumpper){
             printf("%8.8s %.7zu", "CALL", end - start);
             printf(" | arguments: %d\n", args_count);
 
+            break;
+        }case OP_TCALL:{
+            uint8_t args_count = advance(dumpper);
+            size_t end = dumpper->ip;
+
+            printf("%8.8s %.7zu", "TCALL", end - start);
+            printf(" | arguments: %d\n", args_count);
+
             break;
         }case OP_ACCESS:{
             char *symbol = read_str(dumpper, NULL);
+            int16_t cache = read_i16(dumpper);
             size_t end = dumpper->ip;
 
             printf("%8.8s %.7zu", "ACCESS", end - start);
-            printf(" | value: %s\n", symbol);
+            printf(" | value: %s cache: %d\n", symbol, cache);
+
+            break;
+        }case OP_INVOKE:{
+            uint8_t args_count = advance(dumpper);
+            char *symbol = read_str(dumpper, NULL);
+            int16_t cache = read_i16(dumpper);
+            size_t end = dumpper->ip;
+
+            printf("%8.8s %.7zu", "INVOKE", end - start);
+            printf(" | value: %s arguments: %d cache: %d\n", symbol, args_count, cache);
 
             break;
         }case OP_INDEX:{
@@ -471,12 +564,174 @@ static void execute(uint8_t chunk, Dumpper *dumpper){
             printf("%8.8s %.7zu\n", "TRYC", end - start);
             break;
         }case OP_THROW:{
+            uint8_t has_value = advance(dumpper);
+            size_t end = dumpper->ip;
+
+            printf("%8.8s %.7zu", "THROW", end - start);
+            printf(" | value: %d\n", has_value);
+
+            break;
+        }case OP_YIELD:{
+            size_t end = dumpper->ip;
+            printf("%8.8s %.7zu\n", "YIELD", end - start);
+            break;
+        }case OP_NEXT:{
+            uint8_t slot = advance(dumpper);
+            int16_t value = read_i16(dumpper);
+            size_t to = dumpper->ip + value;
             size_t end = dumpper->ip;
-            printf("%8.8s %.7zu\n", "THROW", end - start);
+
+            printf("%8.8s %.7zu", "NEXT", end - start);
+            printf(" | slot: %d value: %d to: %zu\n", slot, value, to);
+
             break;
         }case OP_HLT:{
             size_t end = dumpper->ip;
             printf("%8.8s %.7zu\n", "HLT", end - start);
+            break;
+        }case OP_INCL:{
+            uint8_t slot = advance(dumpper);
+            size_t end = dumpper->ip;
+
+            printf("%8.8s %.7zu", "INCL", end - start);
+            printf(" | slot: %d\n", slot);
+
+            break;
+        }case OP_LGET2:{
+            uint8_t first_slot = advance(dumpper);
+            uint8_t second_slot = advance(dumpper);
+            size_t end = dumpper->ip;
+
+            printf("%8.8s %.7zu", "LGET2", end - start);
+            printf(" | slots: %d %d\n", first_slot, second_slot);
+
+            break;
+        }case OP_LT_LL_JIF:
+         case OP_GE_LL_JIT:{
+            uint8_t left_slot = advance(dumpper);
+            uint8_t right_slot = advance(dumpper);
+            int16_t value = read_i16(dumpper);
+            size_t to = dumpper->ip + value;
+            size_t end = dumpper->ip;
+
+            printf("%8.8s %.7zu", chunk == OP_LT_LL_JIF ? "LTLLJIF" : "GELLJIT", end - start);
+            printf(" | slots: %d %d value: %d to: %zu\n", left_slot, right_slot, value, to);
+
+            break;
+        }case OP_RMOV:{
+            uint8_t dst = advance(dumpper);
+            uint8_t src = advance(dumpper);
+            size_t end = dumpper->ip;
+
+            printf("%8.8s %.7zu", "RMOV", end - start);
+            printf(" | r%d = r%d\n", dst, src);
+
+            break;
+        }case OP_RCINT:{
+            uint8_t dst = advance(dumpper);
+            uint8_t value = advance(dumpper);
+            size_t end = dumpper->ip;
+
+            printf("%8.8s %.7zu", "RCINT", end - start);
+            printf(" | r%d = %d\n", dst, value);
+
+            break;
+        }case OP_RINT:{
+            uint8_t dst = advance(dumpper);
+            int64_t value = read_i64_const(dumpper);
+            size_t end = dumpper->ip;
+
+            printf("%8.8s %.7zu", "RINT", end - start);
+            printf(" | r%d = %" PRId64 "\n", dst, value);
+
+            break;
+        }case OP_RFLOAT:{
+            uint8_t dst = advance(dumpper);
+            double value = read_float_const(dumpper);
+            size_t end = dumpper->ip;
+
+            printf("%8.8s %.7zu", "RFLOAT", end - start);
+            printf(" | r%d = %.8f\n", dst, value);
+
+            break;
+        }case OP_RADD:
+         case OP_RSUB:
+         case OP_RMUL:
+         case OP_RDIV:
+         case OP_RMOD:{
+            uint8_t dst = advance(dumpper);
+            uint8_t left = advance(dumpper);
+            uint8_t right = advance(dumpper);
+            size_t end = dumpper->ip;
+            const char *name = "RMOD";
+            const char *operator = "mod";
+
+            switch (chunk){
+                case OP_RADD:{
+                    name = "RADD";
+                    operator = "+";
+                    break;
+                }case OP_RSUB:{
+                    name = "RSUB";
+                    operator = "-";
+                    break;
+                }case OP_RMUL:{
+                    name = "RMUL";
+                    operator = "*";
+                    break;
+                }case OP_RDIV:{
+                    name = "RDIV";
+                    operator = "/";
+                    break;
+                }
+            }
+
+            printf("%8.8s %.7zu", name, end - start);
+            printf(" | r%d = r%d %s r%d\n", dst, left, operator, right);
+
+            break;
+        }case OP_RADDK:
+         case OP_RSUBK:{
+            uint8_t dst = advance(dumpper);
+            uint8_t left = advance(dumpper);
+            uint8_t right = advance(dumpper);
+            size_t end = dumpper->ip;
+
+            printf("%8.8s %.7zu", chunk == OP_RADDK ? "RADDK" : "RSUBK", end - start);
+            printf(" | r%d = r%d %s %d\n", dst, left, chunk == OP_RADDK ? "+" : "-", right);
+
+            break;
+        }case OP_RJNLT:
+         case OP_RJNGT:
+         case OP_RJNLE:
+         case OP_RJNGE:{
+            uint8_t left = advance(dumpper);
+            uint8_t right = advance(dumpper);
+            int16_t value = read_i16(dumpper);
+            size_t to = dumpper->ip + value;
+            size_t end = dumpper->ip;
+            const char *name = "RJNGE";
+            const char *operator = ">=";
+
+            switch (chunk){
+                case OP_RJNLT:{
+                    name = "RJNLT";
+                    operator = "<";
+                    break;
+                }case OP_RJNGT:{
+                    name = "RJNGT";
+                    operator = ">";
+                    break;
+                }case OP_RJNLE:{
+                    name = "RJNLE";
+                    operator = "<=";
+                    break;
+                }
+            }
+
+            printf("%8.8s %.7zu", name, end - start);
+            printf(" | unless r%d %s r%d value: %d to: %zu\n", left, operator, right, value, to);
+
             break;
         }default:{
             assert("Illegal opcode\n");
@@ -1,5 +1,6 @@
 #include "lzpool.h"
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 
 //--------------------------------------------------------------------------//
@@ -17,6 +18,8 @@ static inline void lzdealloc(void *ptr, size_t size, LZPoolAllocator *allocator)
 #define MEMORY_DEALLOC(_ptr, _type, _count, _allocator)(lzdealloc((_ptr), sizeof(_type) * (_count), (_allocator)))
 
 static inline void destroy_subpool(size_t header_size, size_t slot_size, LZSubPool *subpool, LZPoolAllocator *allocator);
+static inline void clear_bits(LZPoolHeader *slot);
+static void sweep_subpool(int all, LZSubPool *subpool, LZPoolSweeper sweeper, void *ctx, LZPool *pool);
 
 static inline size_t round_size(size_t to, size_t size);
 
@@ -50,10 +53,55 @@ static inline void lzdealloc(void *ptr, size_t size, LZPoolAllocator *allocator)
 }
 
 static inline void destroy_subpool(size_t header_size, size_t slot_size, LZSubPool *subpool, LZPoolAllocator *allocator){
+    if(subpool->live_bits){
+        size_t words = LZPOOL_BITMAP_WORDS(subpool->slots_count);
+
+        MEMORY_DEALLOC(subpool->live_bits, uint64_t, words, allocator);
+        MEMORY_DEALLOC(subpool->mark_bits, uint64_t, words, allocator);
+    }
+
     MEMORY_DEALLOC(subpool->slots, char, (header_size + slot_size) * subpool->slots_count, allocator);
     MEMORY_DEALLOC(subpool, LZSubPool, 1, allocator);
 }
 
+static inline void clear_bits(LZPoolHeader *slot){
+    LZSubPool *subpool = slot->subpool;
+
+    if(!subpool->live_bits){
+        return;
+    }
+
+    uint32_t idx = slot->idx;
+    uint64_t bit = (uint64_t)1 << (idx % LZPOOL_BITMAP_WORD_BITS);
+
+    subpool->live_bits[idx / LZPOOL_BITMAP_WORD_BITS] &= ~bit;
+}
+
+static void sweep_subpool(int all, LZSubPool *subpool, LZPoolSweeper sweeper, void *ctx, LZPool *pool){
+    size_t header_size = pool->header_size;
+    size_t slot_size = pool->slot_size;
+    uint64_t *live_bits = subpool->live_bits;
+    uint64_t *mark_bits = subpool->mark_bits;
+    size_t words = LZPOOL_BITMAP_WORDS(subpool->slots_count);
+
+    assert(live_bits && "Pool without bitmaps");
+
+    uint64_t mark_flip = pool->mark_flip;
+
+    // Right after a flip, a marked slot is garbage
+    for (size_t i = 0; i < words; i++){
+        uint64_t dead = all ? live_bits[i] : live_bits[i] & (mark_bits[i] ^ mark_flip);
+
+        while (dead){
+            size_t idx = i * LZPOOL_BITMAP_WORD_BITS + (size_t)__builtin_ctzll(dead);
+            LZPoolHeader *slot = get_slot_at(idx, header_size, slot_size, subpool->slots);
+
+            dead &= dead - 1;
+            sweeper(slot_chunk(header_size, slot), ctx);
+        }
+    }
+}
+
 static inline size_t round_size(size_t to, size_t size){
     size_t mod = size % to;
     size_t padding = mod == 0 ? 0 : to - mod;
@@ -75,6 +123,9 @@ static inline LZPoolHeader *get_slot_at(size_t idx, size_t header_size, size_t s
 }
 
 static void insert_slot(LZPoolHeader *header, LZPoolHeaderList *list){
+    header->prev = NULL;
+    header->next = NULL;
+
     if(list->tail){
         list->tail->next = header;
         header->prev = list->tail;
@@ -104,6 +155,9 @@ static void remove_slot(LZPoolHeader *header, LZPoolHeaderList *list){
     if(header->next){
         header->next->prev = header->prev;
     }
+
+    header->prev = NULL;
+    header->next = NULL;
 }
 
 static void init_subpool_slots(size_t header_size, size_t slot_size, LZSubPool *subpool, LZPoolHeaderList *list, LZPool *pool){
@@ -118,6 +172,7 @@ static void init_subpool_slots(size_t header_size, size_t slot_size, LZSubPool *
 
         current->magic = MAGIC_NUMBER;
         current->used = 0;
+        current->idx = (uint32_t)i;
         current->pool = pool;
         current->subpool = subpool;
         current->prev = prev;
@@ -128,6 +183,7 @@ static void init_subpool_slots(size_t header_size, size_t slot_size, LZSubPool *
 
             next->magic = MAGIC_NUMBER;
             next->used = 0;
+            next->idx = (uint32_t)(i + 1);
             next->pool = pool;
             next->subpool = subpool;
             next->prev = current;
@@ -147,9 +203,9 @@ static void init_subpool_slots(size_t header_size, size_t slot_size, LZSubPool *
         first->prev = list->tail;
     }else{
         list->head = first;
-        list->tail = last;
     }
 
+    list->tail = last;
     list->len += slots_count;
 }
 
@@ -188,6 +244,11 @@ static void remove_subpool(LZSubPool *subpool, LZSubPoolList *list){
 //                          PUBLIC IMPLEMENTATION                           //
 //--------------------------------------------------------------------------//
 inline void lzpool_init(size_t slot_size, LZPoolAllocator *allocator, LZPool *pool){
+    pool->bitmaps = 0;
+    pool->mark_flip = 0;
+    pool->sweep_cursor = NULL;
+    pool->sweeper = NULL;
+    pool->sweeper_ctx = NULL;
     pool->header_size = round_size(LZPOOL_DEFAULT_ALIGNMENT, HEADER_SIZE);
     pool->slot_size = round_size(LZPOOL_DEFAULT_ALIGNMENT, slot_size);
     pool->slots = (LZPoolHeaderList){0};
@@ -195,6 +256,11 @@ inline void lzpool_init(size_t slot_size, LZPoolAllocator *allocator, LZPool *po
     pool->allocator = allocator;
 }
 
+void lzpool_init_bitmaps(size_t slot_size, LZPoolAllocator *allocator, LZPool *pool){
+    lzpool_init(slot_size, allocator, pool);
+    pool->bitmaps = 1;
+}
+
 void lzpool_destroy_deinit(LZPool *pool){
     if(!pool){
         return;
@@ -222,6 +288,11 @@ LZPool *lzpool_create(size_t slot_size, LZPoolAllocator *allocator){
         return NULL;
     }
 
+    pool->bitmaps = 0;
+    pool->mark_flip = 0;
+    pool->sweep_cursor = NULL;
+    pool->sweeper = NULL;
+    pool->sweeper_ctx = NULL;
     pool->header_size = round_size(LZPOOL_DEFAULT_ALIGNMENT, HEADER_SIZE);
     pool->slot_size = round_size(LZPOOL_DEFAULT_ALIGNMENT, slot_size);
     pool->slots = (LZPoolHeaderList){0};
@@ -271,9 +342,30 @@ int lzpool_prealloc(size_t slots_count, LZPool *pool){
     subpool->slots_used = 0;
     subpool->slots_count = slots_count;
     subpool->slots = slots;
+    subpool->live_bits = NULL;
+    subpool->mark_bits = NULL;
     subpool->prev = NULL;
     subpool->next = NULL;
 
+    if(pool->bitmaps){
+        size_t words = LZPOOL_BITMAP_WORDS(slots_count);
+        uint64_t *live_bits = MEMORY_ALLOC(uint64_t, words, allocator);
+        uint64_t *mark_bits = MEMORY_ALLOC(uint64_t, words, allocator);
+
+        if(!live_bits || !mark_bits){
+            MEMORY_DEALLOC(live_bits, uint64_t, words, allocator);
+            MEMORY_DEALLOC(mark_bits, uint64_t, words, allocator);
+            destroy_subpool(header_size, slot_size, subpool, allocator);
+            return 1;
+        }
+
+        memset(live_bits, 0, sizeof(uint64_t) * words);
+        memset(mark_bits, 0, sizeof(uint64_t) * words);
+
+        subpool->live_bits = live_bits;
+        subpool->mark_bits = mark_bits;
+    }
+
     init_subpool_slots(header_size, slot_size, subpool, &pool->slots, pool);
     insert_subpool(subpool, &pool->subpools);
 
@@ -299,6 +391,9 @@ void *lzpool_alloc(LZPool *pool){
 void *lzpool_alloc_x(size_t slots_count, LZPool *pool){
     LZPoolHeaderList *slots = &pool->slots;
 
+    // Garbage from the last marking cycle is reused before growing
+    while (slots->len == 0 && lzpool_sweep_step(pool));
+
     if(slots->len == 0 && lzpool_prealloc(slots_count, pool)){
         return NULL;
     }
@@ -321,7 +416,8 @@ void lzpool_dealloc(void *ptr){
     insert_slot(slot, &pool->slots);
 
     slot->used = 0;
-    subpool->slots_used++;
+    clear_bits(slot);
+    subpool->slots_used--;
 }
 
 void lzpool_dealloc_release(void *ptr){
@@ -339,6 +435,7 @@ void lzpool_dealloc_release(void *ptr){
     insert_slot(slot, &pool->slots);
 
     slot->used = 0;
+    clear_bits(slot);
     subpool->slots_used--;
 
     if(subpool->slots_used == 0){
@@ -354,4 +451,43 @@ void lzpool_dealloc_release(void *ptr){
         remove_subpool(subpool, &pool->subpools);
         destroy_subpool(header_size, slot_size, subpool, pool->allocator);
     }
-}
\ No newline at end of file
+}
+
+void lzpool_flip_marks(LZPoolSweeper sweeper, void *ctx, LZPool *pool){
+    assert(!pool->sweep_cursor && "Garbage from the previous cycle not swept");
+
+    pool->mark_flip = ~pool->mark_flip;
+    pool->sweep_cursor = pool->subpools.head;
+    pool->sweeper = sweeper;
+    pool->sweeper_ctx = ctx;
+}
+
+int lzpool_sweep_step(LZPool *pool){
+    LZSubPool *subpool = pool->sweep_cursor;
+
+    if(!subpool){
+        return 0;
+    }
+
+    // Subpools created after the flip are visited as well, but
+    // their slots are never garbage: live slots start unmarked
+    pool->sweep_cursor = subpool->next;
+    sweep_subpool(0, subpool, pool->sweeper, pool->sweeper_ctx, pool);
+
+    return 1;
+}
+
+void lzpool_sweep(LZPool *pool){
+    while (lzpool_sweep_step(pool));
+}
+
+void lzpool_sweep_all(LZPoolSweeper sweeper, void *ctx, LZPool *pool){
+    LZSubPool *current = pool->subpools.head;
+
+    pool->sweep_cursor = NULL;
+
+    while (current){
+        sweep_subpool(1, current, sweeper, ctx, pool);
+        current = current->next;
+    }
+}
@@ -18,6 +18,6 @@ void native_init_header(
 	cloned_name[name_len] = 0;
 
 	header->type = type;
-	header->name = name;
+	header->name = cloned_name;
 	header->destroy_helper = destroy_helper;
 }
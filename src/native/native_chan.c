@@ -0,0 +1,799 @@
+#include "native_chan.h"
+#include "native_nbarray.h"
+
+#include "vm/shape.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
+typedef enum msg_tag{
+	EMPTY_MSG_TAG,
+	BOOL_MSG_TAG,
+	INT_MSG_TAG,
+	FLOAT_MSG_TAG,
+	STR_MSG_TAG,
+	ARRAY_MSG_TAG,
+	LIST_MSG_TAG,
+	DICT_MSG_TAG,
+	RECORD_MSG_TAG,
+	NBARRAY_MSG_TAG,
+}MsgTag;
+
+static Channel *channels = NULL;
+static pthread_mutex_t channels_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+//----------------------------------------------------------------//
+//                       PRIVATE INTERFACE                        //
+//----------------------------------------------------------------//
+static void chan_native_destroy(void *native, Allocator *allocator);
+
+static inline void park(uint32_t *word, uint32_t value);
+static inline void wake(uint32_t *word);
+static inline void relax(void);
+static int try_send(void *msg, Channel *channel);
+static void *try_recv(Channel *channel);
+
+static size_t measure_value(Value value, size_t depth, VM *vm);
+static inline void write_raw(const void *raw, size_t size, unsigned char **cursor);
+static void write_value(Value value, int move, unsigned char **cursor);
+static inline void read_raw(void *raw, size_t size, unsigned char **cursor);
+static Value read_value(unsigned char **cursor, VM *vm);
+static void skip_value(unsigned char **cursor);
+//----------------------------------------------------------------//
+//                     PRIVATE IMPLEMENTATION                     //
+//----------------------------------------------------------------//
+void chan_native_destroy(void *native, Allocator *allocator){
+	// The channel is not destroyed: other isolates could be using it
+	MEMORY_DEALLOC(allocator, ChanNative, 1, native);
+}
+
+void park(uint32_t *word, uint32_t value){
+#ifdef __linux__
+	syscall(SYS_futex, word, FUTEX_WAIT_PRIVATE, value, NULL, NULL, 0);
+#else
+	if(__atomic_load_n(word, __ATOMIC_SEQ_CST) == value){
+		sched_yield();
+	}
+#endif
+}
+
+void wake(uint32_t *word){
+#ifdef __linux__
+	syscall(SYS_futex, word, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+#endif
+}
+
+void relax(void){
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#else
+	sched_yield();
+#endif
+}
+
+int try_send(void *msg, Channel *channel){
+	size_t pos = __atomic_load_n(&channel->send_pos, __ATOMIC_RELAXED);
+
+	while(1){
+		ChanCell *cell = &channel->cells[pos & channel->mask];
+		size_t seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+		intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+		if(diff == 0){
+			if(__atomic_compare_exchange_n(
+				&channel->send_pos,
+				&pos,
+				pos + 1,
+				1,
+				__ATOMIC_RELAXED,
+				__ATOMIC_RELAXED
+			)){
+				cell->msg = msg;
+				__atomic_store_n(&cell->seq, pos + 1, __ATOMIC_RELEASE);
+
+				return 1;
+			}
+		}else if(diff < 0){
+			// The cell still holds the message of the previous lap: full
+			return 0;
+		}else{
+			pos = __atomic_load_n(&channel->send_pos, __ATOMIC_RELAXED);
+		}
+	}
+}
+
+void *try_recv(Channel *channel){
+	size_t pos = __atomic_load_n(&channel->recv_pos, __ATOMIC_RELAXED);
+
+	while(1){
+		ChanCell *cell = &channel->cells[pos & channel->mask];
+		size_t seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+		intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+
+		if(diff == 0){
+			if(__atomic_compare_exchange_n(
+				&channel->recv_pos,
+				&pos,
+				pos + 1,
+				1,
+				__ATOMIC_RELAXED,
+				__ATOMIC_RELAXED
+			)){
+				void *msg = cell->msg;
+				// Frees the cell for the send of the next lap
+				__atomic_store_n(&cell->seq, pos + channel->mask + 1, __ATOMIC_RELEASE);
+
+				return msg;
+			}
+		}else if(diff < 0){
+			// The cell was not filled yet: empty
+			return NULL;
+		}else{
+			pos = __atomic_load_n(&channel->recv_pos, __ATOMIC_RELAXED);
+		}
+	}
+}
+
+size_t measure_value(Value value, size_t depth, VM *vm){
+	if(depth > CHAN_DEPTH_LENGTH){
+		vmu_error(
+			vm,
+			"Failed to create message: value nested more than %d levels, or cyclic",
+			CHAN_DEPTH_LENGTH
+		);
+	}
+
+	if(IS_VALUE_EMPTY(value)){
+		return 1;
+	}
+
+	if(IS_VALUE_BOOL(value)){
+		return 1 + sizeof(uint8_t);
+	}
+
+	if(IS_VALUE_INT(value)){
+		return 1 + sizeof(int64_t);
+	}
+
+	if(IS_VALUE_FLOAT(value)){
+		return 1 + sizeof(double);
+	}
+
+	Obj *obj = VALUE_TO_OBJ(value);
+
+	switch (obj->type){
+		case STR_OBJ_TYPE:{
+			return 1 + sizeof(size_t) + OBJ_TO_STR(obj)->len;
+		}case ARRAY_OBJ_TYPE:{
+			ArrayObj *array_obj = OBJ_TO_ARRAY(obj);
+			size_t size = 1 + sizeof(size_t);
+
+			for (size_t i = 0; i < array_obj->len; i++){
+				size += measure_value(array_obj->values[i], depth + 1, vm);
+			}
+
+			return size;
+		}case LIST_OBJ_TYPE:{
+			DynArr *items = OBJ_TO_LIST(obj)->items;
+			size_t len = dynarr_len(items);
+			size_t size = 1 + sizeof(size_t);
+
+			for (size_t i = 0; i < len; i++){
+				size += measure_value(DYNARR_GET_AS(items, Value, i), depth + 1, vm);
+			}
+
+			return size;
+		}case DICT_OBJ_TYPE:{
+			LZOHTable *key_values = OBJ_TO_DICT(obj)->key_values;
+			size_t size = 1 + sizeof(size_t);
+
+			for (size_t i = 0; i < key_values->m; i++){
+				LZOHTableSlot slot = key_values->slots[i];
+
+				if(!slot.used){
+					continue;
+				}
+
+				size += measure_value(*(Value *)slot.key, depth + 1, vm);
+				size += measure_value(*(Value *)slot.value, depth + 1, vm);
+			}
+
+			return size;
+		}case RECORD_OBJ_TYPE:{
+			RecordObj *record_obj = OBJ_TO_RECORD(obj);
+			Shape *shape = record_obj->shape;
+			size_t size = 1 + sizeof(size_t);
+
+			if(shape->len > UINT16_MAX){
+				vmu_error(vm, "Failed to create message: record with more than %d attributes", UINT16_MAX);
+			}
+
+			for (size_t i = 0; i < shape->len; i++){
+				size += sizeof(size_t) + strlen(shape->keys[i]);
+				size += measure_value(record_obj->values[i], depth + 1, vm);
+			}
+
+			return size;
+		}case NATIVE_OBJ_TYPE:{
+			NativeHeader *header = OBJ_TO_NATIVE(obj)->native;
+
+			if(header->type == NBARRAY_NATIVE_TYPE){
+				return 1 + sizeof(size_t) + sizeof(unsigned char *);
+			}
+
+			break;
+		}default:{
+			break;
+		}
+	}
+
+	vmu_error(
+		vm,
+		"Failed to create message: only empty, bool, int, float, str, array, list, dict, record and nbarray values can be sent"
+	);
+
+	return 0;
+}
+
+void write_raw(const void *raw, size_t size, unsigned char **cursor){
+	memcpy(*cursor, raw, size);
+	*cursor += size;
+}
+
+void write_value(Value value, int move, unsigned char **cursor){
+	uint8_t tag;
+
+	if(IS_VALUE_EMPTY(value)){
+		tag = EMPTY_MSG_TAG;
+		write_raw(&tag, 1, cursor);
+
+		return;
+	}
+
+	if(IS_VALUE_BOOL(value)){
+		uint8_t bool_value = VALUE_TO_BOOL(value);
+
+		tag = BOOL_MSG_TAG;
+		write_raw(&tag, 1, cursor);
+		write_raw(&bool_value, sizeof(uint8_t), cursor);
+
+		return;
+	}
+
+	if(IS_VALUE_INT(value)){
+		int64_t int_value = VALUE_TO_INT(value);
+
+		tag = INT_MSG_TAG;
+		write_raw(&tag, 1, cursor);
+		write_raw(&int_value, sizeof(int64_t), cursor);
+
+		return;
+	}
+
+	if(IS_VALUE_FLOAT(value)){
+		double float_value = VALUE_TO_FLOAT(value);
+
+		tag = FLOAT_MSG_TAG;
+		write_raw(&tag, 1, cursor);
+		write_raw(&float_value, sizeof(double), cursor);
+
+		return;
+	}
+
+	Obj *obj = VALUE_TO_OBJ(value);
+
+	switch (obj->type){
+		case STR_OBJ_TYPE:{
+			StrObj *str_obj = OBJ_TO_STR(obj);
+
+			tag = STR_MSG_TAG;
+			write_raw(&tag, 1, cursor);
+			write_raw(&str_obj->len, sizeof(size_t), cursor);
+			write_raw(str_obj->buff, str_obj->len, cursor);
+
+			break;
+		}case ARRAY_OBJ_TYPE:{
+			ArrayObj *array_obj = OBJ_TO_ARRAY(obj);
+
+			tag = ARRAY_MSG_TAG;
+			write_raw(&tag, 1, cursor);
+			write_raw(&array_obj->len, sizeof(size_t), cursor);
+
+			for (size_t i = 0; i < array_obj->len; i++){
+				write_value(array_obj->values[i], move, cursor);
+			}
+
+			break;
+		}case LIST_OBJ_TYPE:{
+			DynArr *items = OBJ_TO_LIST(obj)->items;
+			size_t len = dynarr_len(items);
+
+			tag = LIST_MSG_TAG;
+			write_raw(&tag, 1, cursor);
+			write_raw(&len, sizeof(size_t), cursor);
+
+			for (size_t i = 0; i < len; i++){
+				write_value(DYNARR_GET_AS(items, Value, i), move, cursor);
+			}
+
+			break;
+		}case DICT_OBJ_TYPE:{
+			LZOHTable *key_values = OBJ_TO_DICT(obj)->key_values;
+			size_t len = key_values->n;
+
+			tag = DICT_MSG_TAG;
+			write_raw(&tag, 1, cursor);
+			write_raw(&len, sizeof(size_t), cursor);
+
+			for (size_t i = 0; i < key_values->m; i++){
+				LZOHTableSlot slot = key_values->slots[i];
+
+				if(!slot.used){
+					continue;
+				}
+
+				write_value(*(Value *)slot.key, move, cursor);
+				write_value(*(Value *)slot.value, move, cursor);
+			}
+
+			break;
+		}case RECORD_OBJ_TYPE:{
+			RecordObj *record_obj = OBJ_TO_RECORD(obj);
+			Shape *shape = record_obj->shape;
+
+			tag = RECORD_MSG_TAG;
+			write_raw(&tag, 1, cursor);
+			write_raw(&shape->len, sizeof(size_t), cursor);
+
+			for (size_t i = 0; i < shape->len; i++){
+				char *key = shape->keys[i];
+				size_t key_size = strlen(key);
+
+				write_raw(&key_size, sizeof(size_t), cursor);
+				write_raw(key, key_size, cursor);
+				write_value(record_obj->values[i], move, cursor);
+			}
+
+			break;
+		}default:{
+			// Only nbarrays are left after measure_value
+			NBArrayNative *nbarray_native = OBJ_TO_NATIVE(obj)->native;
+			size_t len = nbarray_native->len;
+			unsigned char *bytes;
+
+			if(move){
+				bytes = nbarray_native_release(nbarray_native);
+			}else{
+				bytes = malloc(len ? len : 1);
+
+				if(!bytes){
+					fprintf(stderr, "It seems the system ran out of memory");
+					exit(EXIT_FAILURE);
+				}
+
+				memcpy(bytes, nbarray_native->bytes, len);
+			}
+
+			tag = NBARRAY_MSG_TAG;
+			write_raw(&tag, 1, cursor);
+			write_raw(&len, sizeof(size_t), cursor);
+			write_raw(&bytes, sizeof(unsigned char *), cursor);
+
+			break;
+		}
+	}
+}
+
+void read_raw(void *raw, size_t size, unsigned char **cursor){
+	memcpy(raw, *cursor, size);
+	*cursor += size;
+}
+
+// The values being created are kept in the stack of the VM,
+// where the garbage collector finds them, until they are stored
+Value read_value(unsigned char **cursor, VM *vm){
+	uint8_t tag;
+
+	read_raw(&tag, 1, cursor);
+
+	switch (tag){
+		case EMPTY_MSG_TAG:{
+			return EMPTY_VALUE;
+		}case BOOL_MSG_TAG:{
+			uint8_t bool_value;
+			read_raw(&bool_value, sizeof(uint8_t), cursor);
+			return BOOL_VALUE(bool_value);
+		}case INT_MSG_TAG:{
+			int64_t int_value;
+			read_raw(&int_value, sizeof(int64_t), cursor);
+			return INT_VALUE(int_value);
+		}case FLOAT_MSG_TAG:{
+			double float_value;
+			read_raw(&float_value, sizeof(double), cursor);
+			return FLOAT_VALUE(float_value);
+		}case STR_MSG_TAG:{
+			size_t len;
+			read_raw(&len, sizeof(size_t), cursor);
+
+			char *buff = MEMORY_ALLOC(VMU_FRONT_ALLOCATOR, char, len + 1);
+			StrObj *str_obj = NULL;
+
+			read_raw(buff, len, cursor);
+			buff[len] = 0;
+
+			if(vmu_create_str(1, len, buff, vm, &str_obj)){
+				MEMORY_DEALLOC(VMU_FRONT_ALLOCATOR, char, len + 1, buff);
+			}
+
+			return OBJ_VALUE(str_obj);
+		}case ARRAY_MSG_TAG:{
+			size_t len;
+			read_raw(&len, sizeof(size_t), cursor);
+
+			ArrayObj *array_obj = vmu_create_array((int64_t)len, vm);
+
+			// Its values start zeroed, which the collector skips, so it can be traced half read
+			vmu_push_root(OBJ_VALUE(array_obj), vm);
+
+			for (size_t i = 0; i < len; i++){
+				vmu_array_set_at((int64_t)i, read_value(cursor, vm), array_obj, vm);
+			}
+
+			vmu_pop_root(vm);
+
+			return OBJ_VALUE(array_obj);
+		}case LIST_MSG_TAG:{
+			size_t len;
+			read_raw(&len, sizeof(size_t), cursor);
+
+			ListObj *list_obj = vmu_create_list(vm);
+
+			vmu_push_root(OBJ_VALUE(list_obj), vm);
+
+			for (size_t i = 0; i < len; i++){
+				Value item = read_value(cursor, vm);
+
+				vmu_push_root(item, vm);
+				vmu_list_insert(item, list_obj, vm);
+				vmu_pop_root(vm);
+			}
+
+			vmu_pop_root(vm);
+
+			return OBJ_VALUE(list_obj);
+		}case DICT_MSG_TAG:{
+			size_t len;
+			read_raw(&len, sizeof(size_t), cursor);
+
+			DictObj *dict_obj = vmu_create_dict(vm);
+
+			vmu_push_root(OBJ_VALUE(dict_obj), vm);
+
+			for (size_t i = 0; i < len; i++){
+				Value key = read_value(cursor, vm);
+				vmu_push_root(key, vm);
+				Value value = read_value(cursor, vm);
+				vmu_push_root(value, vm);
+
+				vmu_dict_put(key, value, dict_obj, vm);
+
+				vmu_pop_root(vm);
+				vmu_pop_root(vm);
+			}
+
+			vmu_pop_root(vm);
+
+			return OBJ_VALUE(dict_obj);
+		}case RECORD_MSG_TAG:{
+			size_t len;
+			read_raw(&len, sizeof(size_t), cursor);
+
+			RecordObj *record_obj = vmu_create_record((uint16_t)len, vm);
+
+			vmu_push_root(OBJ_VALUE(record_obj), vm);
+
+			for (size_t i = 0; i < len; i++){
+				size_t key_size;
+				read_raw(&key_size, sizeof(size_t), cursor);
+
+				char *key = (char *)*cursor;
+				*cursor += key_size;
+
+				Value value = read_value(cursor, vm);
+
+				vmu_push_root(value, vm);
+				vmu_record_insert_attr(key_size, key, value, record_obj, vm);
+				vmu_pop_root(vm);
+			}
+
+			vmu_pop_root(vm);
+
+			return OBJ_VALUE(record_obj);
+		}default:{
+			size_t len;
+			unsigned char *bytes;
+
+			read_raw(&len, sizeof(size_t), cursor);
+			read_raw(&bytes, sizeof(unsigned char *), cursor);
+
+			NBArrayNative *nbarray_native = nbarray_native_adopt(len, bytes, vm);
+			NativeObj *native_obj = vmu_create_native(nbarray_native, vm);
+
+			return OBJ_VALUE(native_obj);
+		}
+	}
+}
+
+void skip_value(unsigned char **cursor){
+	uint8_t tag;
+	size_t len;
+
+	read_raw(&tag, 1, cursor);
+
+	switch (tag){
+		case EMPTY_MSG_TAG:{
+			break;
+		}case BOOL_MSG_TAG:{
+			*cursor += sizeof(uint8_t);
+			break;
+		}case INT_MSG_TAG:{
+			*cursor += sizeof(int64_t);
+			break;
+		}case FLOAT_MSG_TAG:{
+			*cursor += sizeof(double);
+			break;
+		}case STR_MSG_TAG:{
+			read_raw(&len, sizeof(size_t), cursor);
+			*cursor += len;
+			break;
+		}case ARRAY_MSG_TAG:
+		 case LIST_MSG_TAG:{
+			read_raw(&len, sizeof(size_t), cursor);
+
+			for (size_t i = 0; i < len; i++){
+				skip_value(cursor);
+			}
+
+			break;
+		}case DICT_MSG_TAG:{
+			read_raw(&len, sizeof(size_t), cursor);
+
+			for (size_t i = 0; i < len; i++){
+				skip_value(cursor);
+				skip_value(cursor);
+			}
+
+			break;
+		}case RECORD_MSG_TAG:{
+			read_raw(&len, sizeof(size_t), cursor);
+
+			for (size_t i = 0; i < len; i++){
+				size_t key_size;
+				read_raw(&key_size, sizeof(size_t), cursor);
+				*cursor += key_size;
+				skip_value(cursor);
+			}
+
+			break;
+		}default:{
+			unsigned char *bytes;
+
+			*cursor += sizeof(size_t);
+			read_raw(&bytes, sizeof(unsigned char *), cursor);
+			free(bytes);
+
+			break;
+		}
+	}
+}
+//----------------------------------------------------------------//
+//                     PUBLIC IMPLEMENTATION                      //
+//----------------------------------------------------------------//
+Channel *channel_open(const char *name, size_t capacity){
+	pthread_mutex_lock(&channels_mutex);
+
+	for (Channel *channel = channels; channel; channel = channel->next){
+		if(strcmp(channel->name, name) == 0){
+			pthread_mutex_unlock(&channels_mutex);
+			return channel;
+		}
+	}
+
+	size_t cells_len = 1;
+
+	while(cells_len < capacity){
+		cells_len <<= 1;
+	}
+
+	size_t name_len = strlen(name);
+	Channel *channel = calloc(1, sizeof(Channel));
+	char *cloned_name = malloc(name_len + 1);
+	ChanCell *cells = malloc(sizeof(ChanCell) * cells_len);
+
+	if(!channel || !cloned_name || !cells){
+		free(channel);
+		free(cloned_name);
+		free(cells);
+		pthread_mutex_unlock(&channels_mutex);
+
+		return NULL;
+	}
+
+	memcpy(cloned_name, name, name_len + 1);
+
+	for (size_t i = 0; i < cells_len; i++){
+		cells[i].seq = i;
+		cells[i].msg = NULL;
+	}
+
+	channel->name = cloned_name;
+	channel->mask = cells_len - 1;
+	channel->cells = cells;
+	channel->next = channels;
+	channels = channel;
+
+	pthread_mutex_unlock(&channels_mutex);
+
+	return channel;
+}
+
+size_t channel_capacity(const Channel *channel){
+	return channel->mask + 1;
+}
+
+int channel_send(void *msg, Channel *channel){
+	for (size_t spins = 0; ; spins++){
+		// Read before trying, so a receive done after the try changes it
+		uint32_t recvs = __atomic_load_n(&channel->recvs, __ATOMIC_SEQ_CST);
+
+		if(__atomic_load_n(&channel->closed, __ATOMIC_SEQ_CST)){
+			return 1;
+		}
+
+		if(try_send(msg, channel)){
+			__atomic_add_fetch(&channel->sends, 1, __ATOMIC_SEQ_CST);
+
+			if(__atomic_load_n(&channel->parked_receivers, __ATOMIC_SEQ_CST)){
+				wake(&channel->sends);
+			}
+
+			return 0;
+		}
+
+		if(spins < CHAN_SPINS){
+			relax();
+			continue;
+		}
+
+		__atomic_add_fetch(&channel->parked_senders, 1, __ATOMIC_SEQ_CST);
+		park(&channel->recvs, recvs);
+		__atomic_sub_fetch(&channel->parked_senders, 1, __ATOMIC_SEQ_CST);
+	}
+}
+
+void *channel_recv(Channel *channel){
+	for (size_t spins = 0; ; spins++){
+		uint32_t sends = __atomic_load_n(&channel->sends, __ATOMIC_SEQ_CST);
+		uint32_t closed = __atomic_load_n(&channel->closed, __ATOMIC_SEQ_CST);
+		void *msg = try_recv(channel);
+
+		if(msg){
+			__atomic_add_fetch(&channel->recvs, 1, __ATOMIC_SEQ_CST);
+
+			if(__atomic_load_n(&channel->parked_senders, __ATOMIC_SEQ_CST)){
+				wake(&channel->recvs);
+			}
+
+			return msg;
+		}
+
+		// Closed before it was found empty: nothing else will be sent
+		if(closed){
+			return NULL;
+		}
+
+		if(spins < CHAN_SPINS){
+			relax();
+			continue;
+		}
+
+		__atomic_add_fetch(&channel->parked_receivers, 1, __ATOMIC_SEQ_CST);
+		park(&channel->sends, sends);
+		__atomic_sub_fetch(&channel->parked_receivers, 1, __ATOMIC_SEQ_CST);
+	}
+}
+
+void channel_close(Channel *channel){
+	__atomic_store_n(&channel->closed, 1, __ATOMIC_SEQ_CST);
+
+	__atomic_add_fetch(&channel->sends, 1, __ATOMIC_SEQ_CST);
+	__atomic_add_fetch(&channel->recvs, 1, __ATOMIC_SEQ_CST);
+
+	wake(&channel->sends);
+	wake(&channel->recvs);
+}
+
+void *chan_msg_create(Value value, VM *vm){
+	// Measured first, so unsupported values are reported before anything is moved
+	size_t size = measure_value(value, 0, vm);
+	unsigned char *msg = malloc(size);
+
+	if(!msg){
+		vmu_error(vm, "Failed to create message: out of memory");
+	}
+
+	unsigned char *cursor = msg;
+
+	write_value(value, 1, &cursor);
+
+	return msg;
+}
+
+void *chan_msg_copy(size_t len, const Value *values, VM *vm){
+	size_t size = 1 + sizeof(size_t);
+
+	for (size_t i = 0; i < len; i++){
+		size += measure_value(values[i], 1, vm);
+	}
+
+	unsigned char *msg = malloc(size);
+
+	if(!msg){
+		vmu_error(vm, "Failed to create message: out of memory");
+	}
+
+	unsigned char *cursor = msg;
+	uint8_t tag = ARRAY_MSG_TAG;
+
+	write_raw(&tag, 1, &cursor);
+	write_raw(&len, sizeof(size_t), &cursor);
+
+	for (size_t i = 0; i < len; i++){
+		write_value(values[i], 0, &cursor);
+	}
+
+	return msg;
+}
+
+Value chan_msg_open(void *msg, VM *vm){
+	unsigned char *cursor = msg;
+	Value value = read_value(&cursor, vm);
+
+	free(msg);
+
+	return value;
+}
+
+void chan_msg_destroy(void *msg){
+	unsigned char *cursor = msg;
+
+	skip_value(&cursor);
+	free(msg);
+}
+
+ChanNative *chan_native_create(Channel *channel, Allocator *allocator){
+	ChanNative *chan_native = MEMORY_ALLOC(allocator, ChanNative, 1);
+
+	native_init_header(
+		(NativeHeader *)chan_native,
+		CHAN_NATIVE_TYPE,
+		"chan",
+		chan_native_destroy,
+		allocator
+	);
+	chan_native->channel = channel;
+
+	return chan_native;
+}
+
+CREATE_VALIDATE_NATIVE("chan", chan_native, CHAN_NATIVE_TYPE, ChanNative)
@@ -1,31 +1,53 @@
 #include "native_nbarray.h"
 
-#include <string.h>
+#include <stdlib.h>
 
 static void narray_native_destroy(void *native, Allocator *allocator){
 	NBArrayNative *buff_native = native;
 
-	MEMORY_DEALLOC(allocator, char, buff_native->len, buff_native->bytes);
+	free(buff_native->bytes);
+	vm_discharge(buff_native->len, buff_native->vm);
 	MEMORY_DEALLOC(allocator, NBArrayNative, 1, buff_native);
 }
 
-NBArrayNative *nbarray_native_create(size_t len, Allocator *allocator){
-	unsigned char *bytes = MEMORY_ALLOC(allocator, unsigned char, len);
-	NBArrayNative *nbarray_native = MEMORY_ALLOC(allocator, NBArrayNative, 1);
+NBArrayNative *nbarray_native_create(size_t len, VM *vm){
+	unsigned char *bytes = calloc(len, 1);
 
-	memset(bytes, 0, len);
+	if(!bytes && len > 0){
+		vmu_error(vm, "Failed to allocated %zu bytes: out of memory", len);
+	}
+
+	return nbarray_native_adopt(len, bytes, vm);
+}
+
+NBArrayNative *nbarray_native_adopt(size_t len, unsigned char *bytes, VM *vm){
+	vm_charge(len, vm);
+
+	NBArrayNative *nbarray_native = MEMORY_ALLOC(VMU_FRONT_ALLOCATOR, NBArrayNative, 1);
 
 	native_init_header(
 		(NativeHeader *)nbarray_native,
 		NBARRAY_NATIVE_TYPE,
 		"nbuff",
 		narray_native_destroy,
-		allocator
+		VMU_FRONT_ALLOCATOR
 	);
 	nbarray_native->len = len;
 	nbarray_native->bytes = bytes;
+	nbarray_native->vm = vm;
 
 	return nbarray_native;
 }
 
+unsigned char *nbarray_native_release(NBArrayNative *nbarray_native){
+	unsigned char *bytes = nbarray_native->bytes;
+
+	vm_discharge(nbarray_native->len, nbarray_native->vm);
+
+	nbarray_native->len = 0;
+	nbarray_native->bytes = NULL;
+
+	return bytes;
+}
+
 CREATE_VALIDATE_NATIVE("nbarray", nbarray_native, NBARRAY_NATIVE_TYPE, NBArrayNative)
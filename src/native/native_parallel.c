@@ -0,0 +1,557 @@
+#include "native_parallel.h"
+#include "native_chan.h"
+
+#include "vm/vmu.h"
+#include "vm/types_utils.h"
+#include "vm/closure.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include <unistd.h>
+#include <inttypes.h>
+
+//----------------------------------------------------------------//
+//                       PRIVATE INTERFACE                        //
+//----------------------------------------------------------------//
+static size_t count_workers(size_t len);
+static int take_chunk(ParallelWorker *worker, ParallelJob *job, size_t *out_chunk);
+static Value create_callable(ParallelWorker *worker, VM *vm);
+static int run_chunk(ParallelWorker *worker, ParallelJob *job, size_t chunk, Value callable, VM *vm);
+static int run_chunks(ParallelWorker *worker, ParallelJob *job, VM *vm);
+static int run_worker(Isolate *isolate, void *ctx);
+static void release_job(ParallelJob *job);
+static ParallelPool *get_pool(VM *vm);
+static void replace_worker(const Fn *fn, ParallelWorker *worker, VM *vm);
+static void prepare_workers(const Fn *fn, const Closure *closure, ParallelJob *job, ParallelPool *pool, VM *vm);
+static void run_workers(ParallelJob *job, ParallelPool *pool);
+static void throw_failure(const char *name, const ParallelJob *job, VM *vm);
+static Value start_job(const char *name, const Fn *fn, const Closure *closure, const Value *values, ParallelJob *job, VM *vm);
+static const Fn *validate_callable(const char *name, Value fn_value, const Closure **out_closure, VM *vm);
+static Value guard_job(const char *name, const Fn *fn, const Closure *closure, const Value *values, ParallelJob *job, VM *vm);
+static Value run_job(const char *name, Value fn_value, size_t len, const Value *values, int64_t from, VM *vm);
+//----------------------------------------------------------------//
+//                     PRIVATE IMPLEMENTATION                     //
+//----------------------------------------------------------------//
+size_t count_workers(size_t len){
+	size_t workers_len = 1;
+
+#ifdef _SC_NPROCESSORS_ONLN
+	long processors = sysconf(_SC_NPROCESSORS_ONLN);
+
+	if(processors > 1){
+		workers_len = (size_t)processors;
+	}
+#endif
+
+	if(workers_len > ISOLATES_LENGTH){
+		workers_len = ISOLATES_LENGTH;
+	}
+
+	return workers_len < len ? workers_len : len;
+}
+
+int take_chunk(ParallelWorker *worker, ParallelJob *job, size_t *out_chunk){
+	ParallelWorker *workers = worker->pool->workers;
+
+	// Its own chunks first, then the ones left to the others
+	for (size_t i = 0; i < job->workers_len; i++){
+		ParallelWorker *victim = &workers[(worker->id + i) % job->workers_len];
+
+		if(__atomic_load_n(&victim->next, __ATOMIC_RELAXED) >= victim->end){
+			continue;
+		}
+
+		size_t chunk = __atomic_fetch_add(&victim->next, 1, __ATOMIC_RELAXED);
+
+		if(chunk < victim->end){
+			*out_chunk = chunk;
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+Value create_callable(ParallelWorker *worker, VM *vm){
+	if(!worker->meta_closure){
+		return OBJ_VALUE(vmu_create_fn(worker->fn, vm));
+	}
+
+	MetaClosure *meta_closure = worker->meta_closure;
+	Value out_values = chan_msg_open(worker->out_values, vm);
+
+	worker->out_values = NULL;
+	vmu_push_root(out_values, vm);
+
+	ArrayObj *out_values_array = VALUE_TO_ARRAY(out_values);
+	ClosureObj *closure_obj = vmu_create_closure(meta_closure, vm);
+	OutValue *closure_out_values = closure_obj->closure->out_values;
+
+	for (size_t i = 0; i < meta_closure->meta_out_values_len; i++){
+		Value value = out_values_array->values[i];
+
+		closure_out_values[i].at = meta_closure->meta_out_values[i].at;
+		closure_out_values[i].value = value;
+		vmu_write_barrier((Obj *)closure_obj, value, vm);
+	}
+
+	vmu_pop_root(vm);
+
+	return OBJ_VALUE(closure_obj);
+}
+
+// The values are kept in the stack of the VM while the calls run
+int run_chunk(ParallelWorker *worker, ParallelJob *job, size_t chunk, Value callable, VM *vm){
+	Isolate *isolate = worker->isolate;
+	size_t offset = chunk * job->chunk_len;
+	size_t len = job->len - offset < job->chunk_len ? job->len - offset : job->chunk_len;
+	ArrayObj *in_array = NULL;
+
+	if(job->inputs){
+		void *msg = job->inputs[chunk];
+
+		job->inputs[chunk] = NULL;
+		in_array = VALUE_TO_ARRAY(chan_msg_open(msg, vm));
+		vmu_push_root(OBJ_VALUE(in_array), vm);
+	}
+
+	ArrayObj *out_array = vmu_create_array((int64_t)len, vm);
+
+	vmu_push_root(OBJ_VALUE(out_array), vm);
+
+	for (size_t i = 0; i < len; i++){
+		vmu_push_root(callable, vm);
+		vmu_push_root(in_array ? in_array->values[i] : INT_VALUE(job->from + (int64_t)(offset + i)), vm);
+
+		if(vm_invoke(isolate->native_fns, isolate->module, 1, vm)){
+			return 1;
+		}
+
+		vmu_array_set_at((int64_t)i, vm->stack_top[-1], out_array, vm);
+		vmu_pop_root(vm);
+	}
+
+	job->outputs[chunk] = chan_msg_create(OBJ_VALUE(out_array), vm);
+
+	vmu_pop_root(vm);
+
+	if(in_array){
+		vmu_pop_root(vm);
+	}
+
+	return 0;
+}
+
+// Returns 1 if a call failed. The stack of the VM is
+// only left as it was found if all of them succeed
+int run_chunks(ParallelWorker *worker, ParallelJob *job, VM *vm){
+#ifdef NAN_BOXING
+	vmu_set_boxing_vm(vm);
+#endif
+
+	vm->error_msg[0] = 0;
+
+	// Errors out of the calls, like those creating the messages, jump here
+	if(setjmp(vm->exit_jmp)){
+		return 1;
+	}
+
+	Value callable = create_callable(worker, vm);
+	size_t chunk;
+
+	vmu_push_root(callable, vm);
+
+	while(!__atomic_load_n(&job->failed, __ATOMIC_SEQ_CST) && take_chunk(worker, job, &chunk)){
+		if(run_chunk(worker, job, chunk, callable, vm)){
+			return 1;
+		}
+	}
+
+	vmu_pop_root(vm);
+
+	return 0;
+}
+
+// Runs in the thread of the isolate of the worker, until the pool is
+// destroyed or one of its calls fails
+int run_worker(Isolate *isolate, void *ctx){
+	ParallelWorker *worker = (ParallelWorker *)ctx;
+	ParallelPool *pool = worker->pool;
+
+	pthread_mutex_lock(&pool->mutex);
+
+	while(1){
+		while(!pool->stop && pool->generation == worker->generation){
+			pthread_cond_wait(&pool->job_cond, &pool->mutex);
+		}
+
+		if(pool->stop){
+			break;
+		}
+
+		ParallelJob *job = pool->job;
+		worker->generation = pool->generation;
+
+		if(worker->id >= job->workers_len){
+			continue;
+		}
+
+		pthread_mutex_unlock(&pool->mutex);
+
+		int failed = run_chunks(worker, job, isolate->vm);
+
+		if(failed){
+			__atomic_store_n(&job->failed, 1, __ATOMIC_SEQ_CST);
+		}
+
+		pthread_mutex_lock(&pool->mutex);
+
+		if(failed && !job->error_msg[0]){
+			memcpy(job->error_msg, isolate->vm->error_msg, ERROR_MSG_LENGTH);
+		}
+
+		if(--pool->running == 0){
+			pthread_cond_signal(&pool->done_cond);
+		}
+
+		if(failed){
+			worker->failed = 1;
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&pool->mutex);
+
+	return 0;
+}
+
+void release_job(ParallelJob *job){
+	for (size_t i = 0; i < job->chunks_len; i++){
+		if(job->inputs && job->inputs[i]){
+			chan_msg_destroy(job->inputs[i]);
+		}
+
+		if(job->outputs && job->outputs[i]){
+			chan_msg_destroy(job->outputs[i]);
+		}
+	}
+
+	free(job->inputs);
+	free(job->outputs);
+	free(job);
+}
+
+ParallelPool *get_pool(VM *vm){
+	if(vm->parallel_pool){
+		return vm->parallel_pool;
+	}
+
+	ParallelPool *pool = calloc(1, sizeof(ParallelPool));
+
+	if(!pool){
+		vmu_error(vm, "Failed to create worker isolates: out of memory");
+	}
+
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->job_cond, NULL);
+	pthread_cond_init(&pool->done_cond, NULL);
+
+	pool->workers_len = count_workers(ISOLATES_LENGTH);
+
+	// The isolates are created by the jobs which need them
+	for (size_t i = 0; i < pool->workers_len; i++){
+		ParallelWorker *worker = &pool->workers[i];
+
+		worker->id = i;
+		worker->failed = 1;
+		worker->pool = pool;
+	}
+
+	vm->parallel_pool = pool;
+
+	return pool;
+}
+
+// Creates a new isolate for the worker, which has no thread running
+void replace_worker(const Fn *fn, ParallelWorker *worker, VM *vm){
+	ParallelPool *pool = worker->pool;
+
+	if(worker->isolate){
+		isolate_join(worker->isolate);
+		isolate_destroy(worker->isolate);
+		worker->isolate = NULL;
+	}
+
+	Isolate *isolate = isolate_create(worker->id, pool->workers_len, vm->native_fns, fn->module);
+
+	if(!isolate){
+		vmu_error(vm, "Failed to create isolate: out of memory");
+	}
+
+	// Its errors are thrown by the VM which gave the job
+	isolate->vm->quiet_errors = 1;
+	// Only jobs given after it starts are for it
+	worker->generation = pool->generation;
+
+	if(isolate_start_task(run_worker, worker, isolate)){
+		isolate_destroy(isolate);
+		vmu_error(vm, "Failed to create isolate: cannot start its thread");
+	}
+
+	worker->isolate = isolate;
+	worker->failed = 0;
+}
+
+// The threads of the workers are waiting for a job,
+// so their isolates can be changed
+void prepare_workers(const Fn *fn, const Closure *closure, ParallelJob *job, ParallelPool *pool, VM *vm){
+	size_t chunks_per_worker = job->chunks_len / job->workers_len;
+	size_t chunks_left = job->chunks_len % job->workers_len;
+	size_t next = 0;
+
+	for (size_t i = 0; i < job->workers_len; i++){
+		ParallelWorker *worker = &pool->workers[i];
+		size_t worker_chunks = chunks_per_worker + (i < chunks_left);
+
+		// Left by a job which failed before its workers ran
+		if(worker->out_values){
+			chan_msg_destroy(worker->out_values);
+			worker->out_values = NULL;
+		}
+
+		if(worker->failed){
+			replace_worker(fn, worker, vm);
+		}
+
+		Isolate *isolate = worker->isolate;
+
+		worker->next = next;
+		worker->end = next + worker_chunks;
+		worker->fn = NULL;
+		worker->meta_closure = NULL;
+		next += worker_chunks;
+
+		isolate_sync(isolate);
+
+		isolate->vm->gc_step_objs = vm->gc_step_objs;
+		isolate->vm->gc_step_us = vm->gc_step_us;
+		isolate->vm->jit = vm->jit;
+		isolate->vm->trace = vm->trace;
+
+		if(!closure){
+			worker->fn = isolate_fn(fn, isolate);
+			continue;
+		}
+
+		MetaClosure *meta_closure = closure->meta;
+		Value out_values[OUT_VALUES_LENGTH];
+
+		for (size_t o = 0; o < meta_closure->meta_out_values_len; o++){
+			out_values[o] = closure->out_values[o].value;
+		}
+
+		worker->meta_closure = isolate_meta_closure(meta_closure, isolate);
+		// Each isolate takes its own copy: the bytes of nbarrays cannot be shared
+		worker->out_values = chan_msg_copy(meta_closure->meta_out_values_len, out_values, vm);
+	}
+}
+
+// Gives the job to the workers and waits for them
+void run_workers(ParallelJob *job, ParallelPool *pool){
+	pthread_mutex_lock(&pool->mutex);
+
+	pool->job = job;
+	pool->running = job->workers_len;
+	pool->generation++;
+
+	pthread_cond_broadcast(&pool->job_cond);
+
+	while(pool->running > 0){
+		pthread_cond_wait(&pool->done_cond, &pool->mutex);
+	}
+
+	pool->job = NULL;
+
+	pthread_mutex_unlock(&pool->mutex);
+
+	// Messages of closures not opened because of failures
+	for (size_t i = 0; i < job->workers_len; i++){
+		ParallelWorker *worker = &pool->workers[i];
+
+		if(worker->out_values){
+			chan_msg_destroy(worker->out_values);
+			worker->out_values = NULL;
+		}
+	}
+}
+
+void throw_failure(const char *name, const ParallelJob *job, VM *vm){
+	const char *error_msg = job->error_msg[0] ? job->error_msg : "the function failed in an isolate";
+	size_t len = (size_t)snprintf(NULL, 0, "Failed to %s: %s", name, error_msg);
+	char *buff = MEMORY_ALLOC(VMU_FRONT_ALLOCATOR, char, len + 1);
+	StrObj *str_obj = NULL;
+
+	snprintf(buff, len + 1, "Failed to %s: %s", name, error_msg);
+
+	if(vmu_create_str(1, len, buff, vm, &str_obj)){
+		MEMORY_DEALLOC(VMU_FRONT_ALLOCATOR, char, len + 1, buff);
+	}
+
+	vmu_throw(OBJ_VALUE(str_obj), vm);
+}
+
+// Runs the job in the isolates and gathers their results
+Value start_job(const char *name, const Fn *fn, const Closure *closure, const Value *values, ParallelJob *job, VM *vm){
+	if(values){
+		for (size_t i = 0; i < job->chunks_len; i++){
+			size_t offset = i * job->chunk_len;
+			size_t chunk_values_len = job->len - offset < job->chunk_len ? job->len - offset : job->chunk_len;
+
+			job->inputs[i] = chan_msg_copy(chunk_values_len, values + offset, vm);
+		}
+	}
+
+	ParallelPool *pool = get_pool(vm);
+
+	prepare_workers(fn, closure, job, pool, vm);
+	run_workers(job, pool);
+
+	if(job->failed){
+		throw_failure(name, job, vm);
+	}
+
+	ArrayObj *array_obj = vmu_create_array((int64_t)job->len, vm);
+
+	vmu_push_root(OBJ_VALUE(array_obj), vm);
+
+	for (size_t i = 0; i < job->chunks_len; i++){
+		void *msg = job->outputs[i];
+
+		job->outputs[i] = NULL;
+
+		ArrayObj *chunk_array = VALUE_TO_ARRAY(chan_msg_open(msg, vm));
+
+		for (size_t o = 0; o < chunk_array->len; o++){
+			vmu_array_set_at((int64_t)(i * job->chunk_len + o), chunk_array->values[o], array_obj, vm);
+		}
+	}
+
+	vmu_pop_root(vm);
+
+	return OBJ_VALUE(array_obj);
+}
+
+const Fn *validate_callable(const char *name, Value fn_value, const Closure **out_closure, VM *vm){
+	const Fn *fn = NULL;
+	const Closure *closure = NULL;
+
+	if(is_value_fn(fn_value)){
+		fn = VALUE_TO_FN(fn_value)->fn;
+	}else if(is_value_closure(fn_value)){
+		closure = VALUE_TO_CLOSURE(fn_value)->closure;
+		fn = closure->meta->fn;
+	}
+
+	if(!fn || fn->arity != 1){
+		vmu_error(vm, "Failed to %s: expect a function or closure of 1 parameter", name);
+	}
+
+	*out_closure = closure;
+
+	return fn;
+}
+
+// Its parameters are not modified after setjmp, so they
+// keep their values when an error jumps back here
+Value guard_job(const char *name, const Fn *fn, const Closure *closure, const Value *values, ParallelJob *job, VM *vm){
+	jmp_buf outer_jmp;
+
+	memcpy(outer_jmp, vm->exit_jmp, sizeof(jmp_buf));
+
+	// What is left of the job is released before errors leave the native
+	int jmp_value = setjmp(vm->exit_jmp);
+
+	if(jmp_value){
+		release_job(job);
+		memcpy(vm->exit_jmp, outer_jmp, sizeof(jmp_buf));
+		longjmp(vm->exit_jmp, jmp_value);
+	}
+
+	Value array = start_job(name, fn, closure, values, job, vm);
+
+	release_job(job);
+	memcpy(vm->exit_jmp, outer_jmp, sizeof(jmp_buf));
+
+	return array;
+}
+
+Value run_job(const char *name, Value fn_value, size_t len, const Value *values, int64_t from, VM *vm){
+	const Closure *closure = NULL;
+	const Fn *fn = validate_callable(name, fn_value, &closure, vm);
+
+	ParallelJob *job = calloc(1, sizeof(ParallelJob));
+	size_t workers_len = count_workers(len);
+	size_t chunks_len = workers_len * PARALLEL_CHUNKS_PER_WORKER;
+	size_t chunk_len = (len + chunks_len - 1) / chunks_len;
+
+	if(!job){
+		vmu_error(vm, "Failed to %s: out of memory", name);
+	}
+
+	job->len = len;
+	job->from = from;
+	job->workers_len = workers_len;
+	job->chunk_len = chunk_len;
+	job->chunks_len = (len + chunk_len - 1) / chunk_len;
+	job->inputs = values ? calloc(job->chunks_len, sizeof(void *)) : NULL;
+	job->outputs = calloc(job->chunks_len, sizeof(void *));
+
+	if((values && !job->inputs) || !job->outputs){
+		release_job(job);
+		vmu_error(vm, "Failed to %s: out of memory", name);
+	}
+
+	return guard_job(name, fn, closure, values, job, vm);
+}
+//----------------------------------------------------------------//
+//                     PUBLIC IMPLEMENTATION                      //
+//----------------------------------------------------------------//
+Value parallel_map(Value fn, size_t len, const Value *values, VM *vm){
+	return run_job("map", fn, len, values, 0, vm);
+}
+
+Value parallel_range(Value fn, int64_t from, int64_t to, VM *vm){
+	// Arrays cannot be empty
+	if(to <= from){
+		vmu_error(vm, "Failed to range: expect 'to' (%" PRId64 ") to be greater than 'from' (%" PRId64 ")", to, from);
+	}
+
+	return run_job("range", fn, (size_t)((uint64_t)to - (uint64_t)from), NULL, from, vm);
+}
+
+void parallel_pool_destroy(ParallelPool *pool){
+	if(!pool){
+		return;
+	}
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->stop = 1;
+	pthread_cond_broadcast(&pool->job_cond);
+	pthread_mutex_unlock(&pool->mutex);
+
+	for (size_t i = 0; i < pool->workers_len; i++){
+		Isolate *isolate = pool->workers[i].isolate;
+
+		if(isolate){
+			isolate_join(isolate);
+			isolate_destroy(isolate);
+		}
+	}
+
+	pthread_cond_destroy(&pool->job_cond);
+	pthread_cond_destroy(&pool->done_cond);
+	pthread_mutex_destroy(&pool->mutex);
+	free(pool);
+}
@@ -31,6 +31,7 @@ DynArr *record_key_values(Token *record_token, Parser *parser);
 //------------------------------  EXPRESSION  ------------------------------//
 Expr *parse_expr(Parser *paser);
 Expr *parse_assign(Parser *parser);
+Expr *parse_yield_expr(Parser *parser);
 Expr *parse_is_expr(Parser *parser);
 Expr *parse_tenary_expr(Parser *parser);
 Expr *parse_or(Parser *parser);
@@ -186,6 +187,10 @@ Expr *parse_expr(Parser *parser){
 }
 
 Expr *parse_assign(Parser *parser){
+    if(match(parser, 1, YIELD_TOKTYPE)){
+        return parse_yield_expr(parser);
+    }
+
     Expr *expr = parse_tenary_expr(parser);
 
 	if(match(parser, 4,
@@ -222,6 +227,22 @@ Expr *parse_assign(Parser *parser){
     return expr;
 }
 
+Expr *parse_yield_expr(Parser *parser){
+    Token *yield_token = previous(parser);
+    Expr *value_expr = NULL;
+
+    if(!check(parser, SEMICOLON_TOKTYPE) && !check(parser, RIGHT_PAREN_TOKTYPE)){
+        value_expr = parse_assign(parser);
+    }
+
+    YieldExpr *yield_expr = MEMORY_ALLOC(CTALLOCATOR, YieldExpr, 1);
+
+    yield_expr->yield_token = yield_token;
+    yield_expr->value_expr = value_expr;
+
+    return create_expr(YIELD_EXPRTYPE, yield_expr, parser);
+}
+
 Expr *parse_tenary_expr(Parser *parser){
     Expr *condition = parse_is_expr(parser);
 
@@ -1146,6 +1167,26 @@ Stmt *parse_for_stmt(Parser *parser){
     consume(parser, LEFT_PAREN_TOKTYPE, "Expect '(' after 'for' token");
     symbol_token = consume(parser, IDENTIFIER_TOKTYPE, "Expect placeholder symbol");
 
+    if(match(parser, 1, IN_TOKTYPE)){
+        Token *in_token = previous(parser);
+        Expr *iterable_expr = parse_expr(parser);
+
+        consume(parser, RIGHT_PAREN_TOKTYPE, "Expect ')' after iterable expression");
+        consume(parser, LEFT_BRACKET_TOKTYPE, "Expect '{' at start of for body");
+
+        stmts = parse_block_stmt(parser);
+
+        ForInStmt *for_in_stmt = MEMORY_ALLOC(CTALLOCATOR, ForInStmt, 1);
+
+        for_in_stmt->for_token = for_token;
+        for_in_stmt->symbol_token = symbol_token;
+        for_in_stmt->in_token = in_token;
+        for_in_stmt->iterable_expr = iterable_expr;
+        for_in_stmt->stmts = stmts;
+
+        return create_stmt(FOR_IN_STMT_TYPE, for_in_stmt, parser);
+    }
+
     consume(parser, EQUALS_TOKTYPE, "Expect '=' after placeholder symbol");
 
     left_expr = parse_factor(parser);
@@ -276,7 +276,9 @@ Scope *scope_manager_push(ScopeManager *manager, ScopeType type){
         }case FN_SCOPE_TYPE:{
             scope->content.fn_scope = (FnScope){
             	.depth = manager->depth += 1,
-                .locals = create_locals_counter(manager),
+                // Functions have their own frame: anonymous functions
+                // must not continue the locals of the enclosing one
+                .locals = 0,
                 .returned = 0,
                 .prev_fn = manager->fn_scope_stack
             };
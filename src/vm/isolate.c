@@ -0,0 +1,368 @@
+#include "isolate.h"
+
+#include "vm_factory.h"
+#include "types_utils.h"
+#include "closure.h"
+#include "fn.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+//----------------------------------------------------------------//
+//                       PRIVATE INTERFACE                        //
+//----------------------------------------------------------------//
+static void *lzalloc_link_isolate(size_t size, void *ctx);
+static void *lzrealloc_link_isolate(void *ptr, size_t old_size, size_t new_size, void *ctx);
+static void lzdealloc_link_isolate(void *ptr, size_t size, void *ctx);
+
+static void *find_clone(const void *original, Isolate *isolate);
+static void add_clone(const void *original, void *clone, Isolate *isolate);
+static Fn *clone_fn(const Fn *fn, Isolate *isolate);
+static MetaClosure *clone_meta_closure(MetaClosure *meta_closure, Isolate *isolate);
+static SubModule *clone_submodule(SubModule *submodule, Isolate *isolate);
+static Module *clone_module(Module *module, Isolate *isolate);
+static void clone_global_value(GlobalValue *global_value, Isolate *isolate);
+static void sync_submodule(SubModule *submodule, Isolate *isolate);
+
+static void *run_isolate(void *arg);
+//----------------------------------------------------------------//
+//                     PRIVATE IMPLEMENTATION                     //
+//----------------------------------------------------------------//
+void *lzalloc_link_isolate(size_t size, void *ctx){
+    void *ptr = lzflist_alloc(ctx, size);
+
+    if(!ptr){
+        fprintf(stderr, "It seems the system ran out of memory");
+        exit(EXIT_FAILURE);
+    }
+
+    return ptr;
+}
+
+void *lzrealloc_link_isolate(void *ptr, size_t old_size, size_t new_size, void *ctx){
+    void *new_ptr = lzflist_realloc(ctx, ptr, new_size);
+
+    if(!new_ptr){
+        fprintf(stderr, "It seems the system ran out of memory");
+        exit(EXIT_FAILURE);
+    }
+
+    return new_ptr;
+}
+
+void lzdealloc_link_isolate(void *ptr, size_t size, void *ctx){
+    lzflist_dealloc(ctx, ptr);
+}
+
+void *find_clone(const void *original, Isolate *isolate){
+    void *clone = NULL;
+    lzohtable_lookup(sizeof(void *), &original, isolate->clones, &clone);
+    return clone;
+}
+
+void add_clone(const void *original, void *clone, Isolate *isolate){
+    lzohtable_put_ck(sizeof(void *), &original, clone, isolate->clones, NULL);
+}
+
+Fn *clone_fn(const Fn *fn, Isolate *isolate){
+    Fn *clone = find_clone(fn, isolate);
+
+    if(clone){
+        return clone;
+    }
+
+    const Allocator *allocator = &isolate->allocator;
+    size_t caches_len = dynarr_len(fn->caches);
+    DynArr *chunks = MEMORY_DYNARR_TYPE(allocator, uint8_t);
+    DynArr *caches = MEMORY_DYNARR_TYPE(allocator, AccessCache);
+    AccessCache empty_cache = {0};
+
+    clone = MEMORY_ALLOC(allocator, Fn, 1);
+
+    dynarr_append(chunks, fn->chunks);
+
+    for (size_t i = 0; i < caches_len; i++){
+        dynarr_insert(caches, &empty_cache);
+    }
+
+    *clone = *fn;
+    clone->chunks = chunks;
+    clone->caches = caches;
+    clone->hotness = 0;
+    clone->jit_code = NULL;
+    clone->jit_failed = 0;
+    clone->jit_loops = NULL;
+    clone->allocator = allocator;
+
+    // Added before its module, which can lead back to it
+    add_clone(fn, clone, isolate);
+
+    if(fn->module){
+        clone->module = clone_module(fn->module, isolate);
+    }
+
+    return clone;
+}
+
+MetaClosure *clone_meta_closure(MetaClosure *meta_closure, Isolate *isolate){
+    MetaClosure *clone = find_clone(meta_closure, isolate);
+
+    if(clone){
+        return clone;
+    }
+
+    clone = MEMORY_ALLOC(&isolate->allocator, MetaClosure, 1);
+    *clone = *meta_closure;
+
+    add_clone(meta_closure, clone, isolate);
+    clone->fn = clone_fn(meta_closure->fn, isolate);
+
+    return clone;
+}
+
+SubModule *clone_submodule(SubModule *submodule, Isolate *isolate){
+    SubModule *clone = find_clone(submodule, isolate);
+
+    if(clone){
+        return clone;
+    }
+
+    const Allocator *allocator = &isolate->allocator;
+    DynArr *global_slots = submodule->global_slots;
+    DynArr *symbols = submodule->symbols;
+    size_t global_slots_len = dynarr_len(global_slots);
+    size_t symbols_len = dynarr_len(symbols);
+
+    clone = MEMORY_ALLOC(allocator, SubModule, 1);
+    *clone = *submodule;
+    // Modules a VM resolved keep the globals their code defined
+    clone->resolved = submodule->resolved;
+    clone->global_slots = MEMORY_DYNARR_TYPE(allocator, GlobalSlot);
+    clone->symbols = MEMORY_DYNARR_TYPE(allocator, SubModuleSymbol);
+    clone->allocator = allocator;
+
+    add_clone(submodule, clone, isolate);
+    dynarr_insert_ptr(isolate->submodules, submodule);
+
+    for (size_t i = 0; i < global_slots_len; i++){
+        GlobalSlot global_slot = DYNARR_GET_AS(global_slots, GlobalSlot, i);
+
+        clone_global_value(&global_slot.global_value, isolate);
+
+        dynarr_insert(clone->global_slots, &global_slot);
+    }
+
+    for (size_t i = 0; i < symbols_len; i++){
+        SubModuleSymbol symbol = DYNARR_GET_AS(symbols, SubModuleSymbol, i);
+
+        switch (symbol.type){
+            case FUNCTION_SUBMODULE_SYM_TYPE:{
+                symbol.value = clone_fn(symbol.value, isolate);
+                break;
+            }case CLOSURE_SUBMODULE_SYM_TYPE:{
+                symbol.value = clone_meta_closure(symbol.value, isolate);
+                break;
+            }case MODULE_SUBMODULE_SYM_TYPE:{
+                symbol.value = clone_module(symbol.value, isolate);
+                break;
+            }default:{
+                // Native modules are never changed after they are created
+                break;
+            }
+        }
+
+        dynarr_insert(clone->symbols, &symbol);
+    }
+
+    return clone;
+}
+
+Module *clone_module(Module *module, Isolate *isolate){
+    Module *clone = find_clone(module, isolate);
+
+    if(clone){
+        return clone;
+    }
+
+    clone = MEMORY_ALLOC(&isolate->allocator, Module, 1);
+    *clone = *module;
+    clone->prev = NULL;
+
+    add_clone(module, clone, isolate);
+
+    clone->submodule = clone_submodule(module->submodule, isolate);
+
+    if(module->entry_fn){
+        clone->entry_fn = clone_fn(module->entry_fn, isolate);
+    }
+
+    return clone;
+}
+
+void clone_global_value(GlobalValue *global_value, Isolate *isolate){
+    const Allocator *allocator = &isolate->allocator;
+    Value value = global_value->value;
+
+    // The compiler only defines functions, modules and native modules.
+    // The objects of the last ones are not changed by the VMs
+    if(is_value_fn(value)){
+        Fn *fn = clone_fn(OBJ_TO_FN(VALUE_TO_OBJ(value))->fn, isolate);
+        global_value->value = OBJ_VALUE(vm_factory_fn_obj_create(allocator, fn));
+
+        return;
+    }
+
+    if(is_value_module(value)){
+        Module *module = clone_module(OBJ_TO_MODULE(VALUE_TO_OBJ(value))->module, isolate);
+        global_value->value = OBJ_VALUE(vm_factory_module_obj_create(allocator, module));
+
+        return;
+    }
+
+    // Objects a VM defined live in its heap: the global is left undefined
+    if(IS_VALUE_GC_OBJ(value) && VALUE_TO_GC_OBJ(value)->generation != NONE_OBJ_GENERATION){
+        global_value->access = UNDEFINED_GLOBAL_VALUE_TYPE;
+        global_value->value = EMPTY_VALUE;
+    }
+}
+
+void sync_submodule(SubModule *submodule, Isolate *isolate){
+    SubModule *clone = find_clone(submodule, isolate);
+    DynArr *global_slots = submodule->global_slots;
+    DynArr *clone_global_slots = clone->global_slots;
+    size_t global_slots_len = dynarr_len(global_slots);
+
+    // The isolate could have resolved it by itself
+    clone->resolved |= submodule->resolved;
+
+    for (size_t i = 0; i < global_slots_len; i++){
+        GlobalValue global_value = DYNARR_GET_AS(global_slots, GlobalSlot, i).global_value;
+        GlobalValue *copy = &DYNARR_GET_AS(clone_global_slots, GlobalSlot, i).global_value;
+        Value value = global_value.value;
+
+        if(global_value.access == UNDEFINED_GLOBAL_VALUE_TYPE){
+            continue;
+        }
+
+        // Functions and modules are copied once, as they are never redefined
+        if(is_value_fn(value) || is_value_module(value)){
+            if(copy->access == UNDEFINED_GLOBAL_VALUE_TYPE){
+                clone_global_value(&global_value, isolate);
+                *copy = global_value;
+            }
+
+            continue;
+        }
+
+        // Objects of the heap of a VM are left as they are in the copy
+        if(IS_VALUE_GC_OBJ(value) && VALUE_TO_GC_OBJ(value)->generation != NONE_OBJ_GENERATION){
+            continue;
+        }
+
+        *copy = global_value;
+    }
+}
+
+void *run_isolate(void *arg){
+    Isolate *isolate = (Isolate *)arg;
+
+    if(isolate->task){
+        isolate->result = isolate->task(isolate, isolate->task_ctx);
+    }else{
+        isolate->result = vm_execute(isolate->native_fns, isolate->module, isolate->vm);
+    }
+
+    return NULL;
+}
+//----------------------------------------------------------------//
+//                     PUBLIC IMPLEMENTATION                      //
+//----------------------------------------------------------------//
+Isolate *isolate_create(size_t id, size_t len, LZOHTable *native_fns, Module *module){
+    LZFList *flist = lzflist_create(NULL);
+
+    if(!flist){
+        return NULL;
+    }
+
+    Isolate *isolate = lzflist_alloc(flist, sizeof(Isolate));
+
+    if(!isolate){
+        lzflist_destroy(flist);
+        return NULL;
+    }
+
+    isolate->id = id;
+    isolate->result = 0;
+    isolate->flist = flist;
+
+    MEMORY_INIT_ALLOCATOR(
+        flist,
+        lzalloc_link_isolate,
+        lzrealloc_link_isolate,
+        lzdealloc_link_isolate,
+        &isolate->allocator
+    );
+
+    isolate->clones = MEMORY_LZOHTABLE(&isolate->allocator);
+    isolate->submodules = MEMORY_DYNARR_PTR(&isolate->allocator);
+    isolate->native_fns = native_fns;
+    isolate->module = clone_module(module, isolate);
+    isolate->task = NULL;
+    isolate->task_ctx = NULL;
+    isolate->vm = vm_create(&isolate->allocator);
+
+    if(!isolate->vm){
+        lzflist_destroy(flist);
+        return NULL;
+    }
+
+    vm_initialize(isolate->vm);
+
+    isolate->vm->isolate_id = id;
+    isolate->vm->isolates_len = len;
+
+    return isolate;
+}
+
+Fn *isolate_fn(const Fn *fn, Isolate *isolate){
+    return clone_fn(fn, isolate);
+}
+
+MetaClosure *isolate_meta_closure(MetaClosure *meta_closure, Isolate *isolate){
+    return clone_meta_closure(meta_closure, isolate);
+}
+
+void isolate_sync(Isolate *isolate){
+    DynArr *submodules = isolate->submodules;
+
+    // Copying functions and modules can add submodules, which are up to date
+    for (size_t i = 0; i < dynarr_len(submodules); i++){
+        sync_submodule(dynarr_get_ptr(submodules, i), isolate);
+    }
+}
+
+int isolate_start(Isolate *isolate){
+    return pthread_create(&isolate->thread, NULL, run_isolate, isolate) != 0;
+}
+
+int isolate_start_task(IsolateTask task, void *ctx, Isolate *isolate){
+    isolate->task = task;
+    isolate->task_ctx = ctx;
+
+    return isolate_start(isolate);
+}
+
+int isolate_join(Isolate *isolate){
+    pthread_join(isolate->thread, NULL);
+    return isolate->result;
+}
+
+void isolate_destroy(Isolate *isolate){
+    if(!isolate){
+        return;
+    }
+
+    vm_destroy(isolate->vm);
+    // The copies of the program, and the isolate itself, live in its heap
+    lzflist_destroy(isolate->flist);
+}
@@ -0,0 +1,1771 @@
+#include "jit.h"
+#include "opcode.h"
+#include "verifier.h"
+#include "types_utils.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#if defined(__x86_64__) && defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+
+//----------------------------------------------------------------//
+//                       PRIVATE INTERFACE                        //
+//----------------------------------------------------------------//
+// Bytes of machine code reserved for each byte of bytecode, and for the
+// prologue and epilogue. The longest template plus its stub fits in it
+#define CODE_PER_CHUNK 256
+#define CODE_EXTRA     256
+
+#define VALUE_LEN ((int32_t)sizeof(Value))
+#ifdef NAN_BOXING
+    #define VALUE_SHIFT  3
+#else
+    #define VALUE_SHIFT  4
+    #define TYPE_DISP    ((int32_t)offsetof(Value, type))
+    #define CONTENT_DISP ((int32_t)offsetof(Value, content))
+#endif
+
+typedef enum reg{
+    RAX_REG, RCX_REG, RDX_REG, RBX_REG, RSP_REG, RBP_REG, RSI_REG, RDI_REG,
+    R8_REG, R9_REG, R10_REG, R11_REG, R12_REG, R13_REG, R14_REG, R15_REG,
+}Reg;
+
+// Registers the code keeps during its whole execution. They are
+// callee saved, so calls to the helpers of the VM preserve them
+#define VM_REG     RBX_REG
+#define FRAME_REG  R12_REG
+// Address of the first local, one value past the locals pointer of the frame
+#define LOCALS_REG R13_REG
+// Cached stack top of the VM, written back before calls and exits
+#define TOP_REG    R14_REG
+
+// Registers of the float arithmetic. Encoded like RAX and RCX
+#define XMM0_REG 0
+#define XMM1_REG 1
+
+// Condition codes of jcc and setcc
+typedef enum cond{
+    B_COND = 0x2,
+    AE_COND = 0x3,
+    E_COND = 0x4,
+    NE_COND = 0x5,
+    BE_COND = 0x6,
+    A_COND = 0x7,
+    P_COND = 0xa,
+    L_COND = 0xc,
+    GE_COND = 0xd,
+    LE_COND = 0xe,
+    G_COND = 0xf,
+}Cond;
+
+// Always taken, for emit_jump
+#define NO_COND -1
+// The condition which holds when 'cond' does not
+#define NEGATE_COND(_cond)((_cond) ^ 1)
+
+// Opcode extensions of the group instructions with immediates
+#define ADD_EXT 0
+#define OR_EXT  1
+#define AND_EXT 4
+#define SUB_EXT 5
+#define XOR_EXT 6
+#define CMP_EXT 7
+#define SHL_EXT 4
+#define SHR_EXT 5
+#define SAR_EXT 7
+
+// Opcodes of the arithmetic instructions between registers
+#define ADD_OP 0x01
+#define OR_OP  0x09
+#define AND_OP 0x21
+#define SUB_OP 0x29
+#define CMP_OP 0x39
+
+// Opcodes of the scalar double instructions, after the 0xf2 prefix
+#define ADDSD_OP 0x58
+#define MULSD_OP 0x59
+#define SUBSD_OP 0x5c
+#define DIVSD_OP 0x5e
+
+typedef int (*JitEntry)(VM *vm, Frame *frame, void *at);
+
+// A jump whose rel32 is patched once the target instruction has code
+typedef struct jump{
+    size_t at;
+    size_t target;
+}Jump;
+
+// Out of line code a guard jumps to when its value is not of the type the
+// template handles. It calls the step helper and continues with the next
+// instruction, or gives the instruction to the interpreter
+typedef struct stub{
+    size_t at;
+    size_t offset;
+    size_t next;
+    char step;
+}Stub;
+
+typedef struct assembler{
+    size_t len;
+    size_t cap;
+    uint8_t *bytes;
+    // Position of the code of each instruction by its offset, or SIZE_MAX
+    size_t *labels;
+    DynArr *jumps;
+    DynArr *stubs;
+    size_t epilogue;
+    // Offsets of the instruction being compiled and of the next one
+    size_t offset;
+    size_t next;
+    char failed;
+    JitStep step;
+    JitSafepoint safepoint;
+}Assembler;
+
+static void emit_byte(uint8_t byte, Assembler *assembler);
+static void emit_u32(uint32_t value, Assembler *assembler);
+static void emit_u64(uint64_t value, Assembler *assembler);
+static void emit_rex(int w, int reg, int rm, Assembler *assembler);
+static void emit_mem(int reg, int base, int32_t disp, Assembler *assembler);
+static void emit_op_reg(int w, uint8_t opcode, int reg, int rm, Assembler *assembler);
+static void emit_op_mem(int w, uint8_t opcode, int reg, int base, int32_t disp, Assembler *assembler);
+static void emit_op2_reg(int w, uint8_t opcode, int reg, int rm, Assembler *assembler);
+static void emit_op2_mem(int w, uint8_t opcode, int reg, int base, int32_t disp, Assembler *assembler);
+//----------     INSTRUCTIONS     ----------//
+static void emit_push(int reg, Assembler *assembler);
+static void emit_pop(int reg, Assembler *assembler);
+static void emit_load(int reg, int base, int32_t disp, Assembler *assembler);
+static void emit_store(int base, int32_t disp, int reg, Assembler *assembler);
+static void emit_store_imm32(int base, int32_t disp, uint32_t imm, Assembler *assembler);
+static void emit_store_imm64(int base, int32_t disp, int32_t imm, Assembler *assembler);
+static void emit_mov(int dst, int src, Assembler *assembler);
+static void emit_mov_imm64(int reg, uint64_t imm, Assembler *assembler);
+static void emit_alu(uint8_t opcode, int dst, int src, Assembler *assembler);
+static void emit_alu_imm(int ext, int reg, int32_t imm, Assembler *assembler);
+static void emit_imul(int dst, int src, Assembler *assembler);
+static void emit_shift(int ext, int reg, uint8_t count, Assembler *assembler);
+static void emit_setcc(int cond, int reg, Assembler *assembler);
+static void emit_movq_to_xmm(int xmm, int reg, Assembler *assembler);
+static void emit_movq_from_xmm(int reg, int xmm, Assembler *assembler);
+static void emit_sd(uint8_t opcode, int dst, int src, Assembler *assembler);
+static void emit_ucomisd(int left, int right, Assembler *assembler);
+static void emit_call(void *fn, Assembler *assembler);
+static size_t emit_jcc(int cond, Assembler *assembler);
+static void patch(size_t at, size_t to, Assembler *assembler);
+//----------     VALUES     ----------//
+static void emit_store_value(int base, int32_t disp, Value value, Assembler *assembler);
+static void emit_copy_value(int to_base, int32_t to_disp, int from_base, int32_t from_disp, Assembler *assembler);
+static void emit_guard(int cond, char step, Assembler *assembler);
+static void emit_load_int(int reg, int base, int32_t disp, char step, Assembler *assembler);
+static void emit_store_int(int base, int32_t disp, int reg, char step, Assembler *assembler);
+static void emit_load_bool(int reg, int base, int32_t disp, Assembler *assembler);
+static void emit_store_bool(int base, int32_t disp, int reg, Assembler *assembler);
+static void emit_load_float(int xmm, int base, int32_t disp, Assembler *assembler);
+static void emit_store_float(int base, int32_t disp, int xmm, Assembler *assembler);
+static void emit_load_array(int reg, int base, int32_t disp, Assembler *assembler);
+//----------     TEMPLATES     ----------//
+static void emit_prologue(Assembler *assembler);
+static void emit_epilogue(Assembler *assembler);
+static void emit_jump(int cond, size_t target, Assembler *assembler);
+static void emit_step(size_t offset, char can_leave, Assembler *assembler);
+static void emit_exit(size_t offset, Assembler *assembler);
+static void emit_safepoint(Assembler *assembler);
+static void emit_push_value(Value value, Assembler *assembler);
+static void emit_arithmetic(uint8_t opcode, int dst_base, int32_t dst_disp, int32_t left_disp, int32_t right_disp, char step, Assembler *assembler);
+static void emit_compare(int cond, char step, Assembler *assembler);
+static void emit_compare_jump(int cond, int32_t left_disp, int32_t right_disp, size_t target, Assembler *assembler);
+static int16_t operand_i16(const uint8_t *bytes);
+static size_t jump_target(const uint8_t *instruction, size_t next);
+static int int_fits(int64_t value);
+static void emit_instruction(const Fn *fn, const uint8_t *instruction, Assembler *assembler);
+static void emit_stubs(Assembler *assembler);
+static int assemble(const Fn *fn, Assembler *assembler);
+static uint8_t *map_code(const Assembler *assembler, size_t *out_len);
+//----------     TRACES     ----------//
+static uint8_t trace_type(Value value);
+static uint8_t branch_comparison(uint8_t opcode, char *jumps_when);
+static int int_cond(uint8_t comparison);
+static int emit_float_compare(uint8_t comparison, Assembler *assembler);
+static void emit_branch(int cond, size_t target, size_t next, Assembler *assembler);
+static void emit_float_arithmetic(uint8_t opcode, int base, int32_t dst_disp, int32_t left_disp, int32_t right_disp, Assembler *assembler);
+static void emit_element(int32_t target_disp, int32_t idx_disp, Assembler *assembler);
+static void emit_trace_instruction(const Fn *fn, const uint8_t *instruction, const TraceOp *op, size_t next, size_t loop, Assembler *assembler);
+static int assemble_trace(const Fn *fn, const DynArr *ops, size_t *out_loop, Assembler *assembler);
+//----------------------------------------------------------------//
+//                     PRIVATE IMPLEMENTATION                     //
+//----------------------------------------------------------------//
+// Bytes past the capacity are dropped: the compilation fails at the end
+inline void emit_byte(uint8_t byte, Assembler *assembler){
+    if(assembler->len < assembler->cap){
+        assembler->bytes[assembler->len] = byte;
+    }
+
+    assembler->len++;
+}
+
+void emit_u32(uint32_t value, Assembler *assembler){
+    for (size_t i = 0; i < 4; i++){
+        emit_byte((uint8_t)(value >> (i * 8)), assembler);
+    }
+}
+
+void emit_u64(uint64_t value, Assembler *assembler){
+    for (size_t i = 0; i < 8; i++){
+        emit_byte((uint8_t)(value >> (i * 8)), assembler);
+    }
+}
+
+void emit_rex(int w, int reg, int rm, Assembler *assembler){
+    uint8_t rex = (uint8_t)(0x40 | (w << 3) | ((reg & 8) >> 1) | ((rm & 8) >> 3));
+
+    if(rex != 0x40){
+        emit_byte(rex, assembler);
+    }
+}
+
+// Always with a 32 bits displacement, so the bases
+// needing special encodings only need the SIB byte
+void emit_mem(int reg, int base, int32_t disp, Assembler *assembler){
+    emit_byte((uint8_t)(0x80 | ((reg & 7) << 3) | (base & 7)), assembler);
+
+    if((base & 7) == RSP_REG){
+        emit_byte(0x24, assembler);
+    }
+
+    emit_u32((uint32_t)disp, assembler);
+}
+
+void emit_op_reg(int w, uint8_t opcode, int reg, int rm, Assembler *assembler){
+    emit_rex(w, reg, rm, assembler);
+    emit_byte(opcode, assembler);
+    emit_byte((uint8_t)(0xc0 | ((reg & 7) << 3) | (rm & 7)), assembler);
+}
+
+void emit_op_mem(int w, uint8_t opcode, int reg, int base, int32_t disp, Assembler *assembler){
+    emit_rex(w, reg, base, assembler);
+    emit_byte(opcode, assembler);
+    emit_mem(reg, base, disp, assembler);
+}
+
+void emit_op2_reg(int w, uint8_t opcode, int reg, int rm, Assembler *assembler){
+    emit_rex(w, reg, rm, assembler);
+    emit_byte(0x0f, assembler);
+    emit_byte(opcode, assembler);
+    emit_byte((uint8_t)(0xc0 | ((reg & 7) << 3) | (rm & 7)), assembler);
+}
+
+void emit_op2_mem(int w, uint8_t opcode, int reg, int base, int32_t disp, Assembler *assembler){
+    emit_rex(w, reg, base, assembler);
+    emit_byte(0x0f, assembler);
+    emit_byte(opcode, assembler);
+    emit_mem(reg, base, disp, assembler);
+}
+
+void emit_push(int reg, Assembler *assembler){
+    emit_rex(0, 0, reg, assembler);
+    emit_byte((uint8_t)(0x50 + (reg & 7)), assembler);
+}
+
+void emit_pop(int reg, Assembler *assembler){
+    emit_rex(0, 0, reg, assembler);
+    emit_byte((uint8_t)(0x58 + (reg & 7)), assembler);
+}
+
+void emit_load(int reg, int base, int32_t disp, Assembler *assembler){
+    emit_op_mem(1, 0x8b, reg, base, disp, assembler);
+}
+
+void emit_store(int base, int32_t disp, int reg, Assembler *assembler){
+    emit_op_mem(1, 0x89, reg, base, disp, assembler);
+}
+
+void emit_store_imm32(int base, int32_t disp, uint32_t imm, Assembler *assembler){
+    emit_op_mem(0, 0xc7, 0, base, disp, assembler);
+    emit_u32(imm, assembler);
+}
+
+void emit_store_imm64(int base, int32_t disp, int32_t imm, Assembler *assembler){
+    emit_op_mem(1, 0xc7, 0, base, disp, assembler);
+    emit_u32((uint32_t)imm, assembler);
+}
+
+void emit_mov(int dst, int src, Assembler *assembler){
+    emit_op_reg(1, 0x89, src, dst, assembler);
+}
+
+void emit_mov_imm64(int reg, uint64_t imm, Assembler *assembler){
+    emit_rex(1, 0, reg, assembler);
+    emit_byte((uint8_t)(0xb8 + (reg & 7)), assembler);
+    emit_u64(imm, assembler);
+}
+
+void emit_alu(uint8_t opcode, int dst, int src, Assembler *assembler){
+    emit_op_reg(1, opcode, src, dst, assembler);
+}
+
+void emit_alu_imm(int ext, int reg, int32_t imm, Assembler *assembler){
+    emit_op_reg(1, 0x81, ext, reg, assembler);
+    emit_u32((uint32_t)imm, assembler);
+}
+
+void emit_imul(int dst, int src, Assembler *assembler){
+    emit_op2_reg(1, 0xaf, dst, src, assembler);
+}
+
+void emit_shift(int ext, int reg, uint8_t count, Assembler *assembler){
+    emit_op_reg(1, 0xc1, ext, reg, assembler);
+    emit_byte(count, assembler);
+}
+
+// Sets the whole register to 0 or 1. Only for RAX to RBX,
+// whose low bytes do not need the REX prefix
+void emit_setcc(int cond, int reg, Assembler *assembler){
+    emit_op2_reg(0, (uint8_t)(0x90 + cond), 0, reg, assembler);
+    emit_op2_reg(0, 0xb6, reg, reg, assembler);
+}
+
+void emit_movq_to_xmm(int xmm, int reg, Assembler *assembler){
+    emit_byte(0x66, assembler);
+    emit_op2_reg(1, 0x6e, xmm, reg, assembler);
+}
+
+void emit_movq_from_xmm(int reg, int xmm, Assembler *assembler){
+    emit_byte(0x66, assembler);
+    emit_op2_reg(1, 0x7e, xmm, reg, assembler);
+}
+
+// 'dst' = 'dst' op 'src'
+void emit_sd(uint8_t opcode, int dst, int src, Assembler *assembler){
+    emit_byte(0xf2, assembler);
+    emit_op2_reg(0, opcode, dst, src, assembler);
+}
+
+// Sets the flags like an unsigned comparison of 'left' with 'right'.
+// Unordered operands (NaNs) set ZF, PF and CF
+void emit_ucomisd(int left, int right, Assembler *assembler){
+    emit_byte(0x66, assembler);
+    emit_op2_reg(0, 0x2e, left, right, assembler);
+}
+
+void emit_call(void *fn, Assembler *assembler){
+    emit_mov_imm64(RAX_REG, (uint64_t)(uintptr_t)fn, assembler);
+    emit_op_reg(0, 0xff, 2, RAX_REG, assembler);
+}
+
+// Returns where its rel32 is, to be patched
+size_t emit_jcc(int cond, Assembler *assembler){
+    if(cond == NO_COND){
+        emit_byte(0xe9, assembler);
+    }else{
+        emit_byte(0x0f, assembler);
+        emit_byte((uint8_t)(0x80 + cond), assembler);
+    }
+
+    size_t at = assembler->len;
+
+    emit_u32(0, assembler);
+
+    return at;
+}
+
+void patch(size_t at, size_t to, Assembler *assembler){
+    uint32_t rel = (uint32_t)((int64_t)to - (int64_t)(at + 4));
+
+    if(at + 4 > assembler->cap){
+        return;
+    }
+
+    for (size_t i = 0; i < 4; i++){
+        assembler->bytes[at + i] = (uint8_t)(rel >> (i * 8));
+    }
+}
+
+// Clobbers RAX
+void emit_store_value(int base, int32_t disp, Value value, Assembler *assembler){
+#ifdef NAN_BOXING
+    emit_mov_imm64(RAX_REG, value.bits, assembler);
+    emit_store(base, disp, RAX_REG, assembler);
+#else
+    // Written whole, so values compare the same as the ones the interpreter makes
+    uint64_t content = 0;
+
+    switch (value.type){
+        case BOOL_VALUE_TYPE:{
+            content = value.content.bool_val;
+            break;
+        }case INT_VALUE_TYPE:{
+            content = (uint64_t)value.content.int_val;
+            break;
+        }case FLOAT_VALUE_TYPE:{
+            memcpy(&content, &value.content.float_val, sizeof(double));
+            break;
+        }case OBJ_VALUE_TYPE:{
+            content = (uint64_t)(uintptr_t)value.content.obj_val;
+            break;
+        }default:{
+            break;
+        }
+    }
+
+    emit_store_imm32(base, disp + TYPE_DISP, (uint32_t)value.type, assembler);
+    emit_mov_imm64(RAX_REG, content, assembler);
+    emit_store(base, disp + CONTENT_DISP, RAX_REG, assembler);
+#endif
+}
+
+// Clobbers RAX
+void emit_copy_value(int to_base, int32_t to_disp, int from_base, int32_t from_disp, Assembler *assembler){
+    for (int32_t i = 0; i < VALUE_LEN; i += 8){
+        emit_load(RAX_REG, from_base, from_disp + i, assembler);
+        emit_store(to_base, to_disp + i, RAX_REG, assembler);
+    }
+}
+
+// Jumps to a stub of the current instruction when 'cond' holds
+void emit_guard(int cond, char step, Assembler *assembler){
+    Stub stub = {
+        .at = emit_jcc(cond, assembler),
+        .offset = assembler->offset,
+        .next = assembler->next,
+        .step = step
+    };
+
+    if(dynarr_insert(assembler->stubs, &stub)){
+        assembler->failed = 1;
+    }
+}
+
+// Loads the integer at [base + disp] in 'reg'. Clobbers RDX
+void emit_load_int(int reg, int base, int32_t disp, char step, Assembler *assembler){
+#ifdef NAN_BOXING
+    // Boxed integers go to the stub too
+    emit_load(reg, base, disp, assembler);
+    emit_mov(RDX_REG, reg, assembler);
+    emit_shift(SHR_EXT, RDX_REG, 48, assembler);
+    emit_alu_imm(CMP_EXT, RDX_REG, (int32_t)(NAN_BOXING_INT_TAG >> 48), assembler);
+    emit_guard(NE_COND, step, assembler);
+    emit_shift(SHL_EXT, reg, 16, assembler);
+    emit_shift(SAR_EXT, reg, 16, assembler);
+#else
+    emit_op_mem(0, 0x81, CMP_EXT, base, disp + TYPE_DISP, assembler);
+    emit_u32(INT_VALUE_TYPE, assembler);
+    emit_guard(NE_COND, step, assembler);
+    emit_load(reg, base, disp + CONTENT_DISP, assembler);
+#endif
+}
+
+// Stores the integer in 'reg' at [base + disp]. Clobbers 'reg' and RDX
+void emit_store_int(int base, int32_t disp, int reg, char step, Assembler *assembler){
+#ifdef NAN_BOXING
+    // Integers out of 48 bits need to be boxed
+    emit_mov(RDX_REG, reg, assembler);
+    emit_shift(SHL_EXT, RDX_REG, 16, assembler);
+    emit_shift(SAR_EXT, RDX_REG, 16, assembler);
+    emit_alu(CMP_OP, RDX_REG, reg, assembler);
+    emit_guard(NE_COND, step, assembler);
+    emit_mov_imm64(RDX_REG, NAN_BOXING_PAYLOAD_MASK, assembler);
+    emit_alu(AND_OP, reg, RDX_REG, assembler);
+    emit_mov_imm64(RDX_REG, NAN_BOXING_INT_TAG, assembler);
+    emit_alu(OR_OP, reg, RDX_REG, assembler);
+    emit_store(base, disp, reg, assembler);
+#else
+    emit_store_imm32(base, disp + TYPE_DISP, INT_VALUE_TYPE, assembler);
+    emit_store(base, disp + CONTENT_DISP, reg, assembler);
+#endif
+}
+
+// Loads the boolean at [base + disp] in 'reg' as 0 or 1. Other
+// values leave to the interpreter, which reports them. Clobbers RDX
+void emit_load_bool(int reg, int base, int32_t disp, Assembler *assembler){
+#ifdef NAN_BOXING
+    emit_load(reg, base, disp, assembler);
+    emit_mov(RDX_REG, reg, assembler);
+    emit_alu_imm(OR_EXT, RDX_REG, 1, assembler);
+    emit_alu_imm(CMP_EXT, RDX_REG, (int32_t)NAN_BOXING_TRUE, assembler);
+    emit_guard(NE_COND, 0, assembler);
+    emit_alu_imm(AND_EXT, reg, 1, assembler);
+#else
+    emit_op_mem(0, 0x81, CMP_EXT, base, disp + TYPE_DISP, assembler);
+    emit_u32(BOOL_VALUE_TYPE, assembler);
+    emit_guard(NE_COND, 0, assembler);
+    emit_op2_mem(0, 0xb6, reg, base, disp + CONTENT_DISP, assembler);
+#endif
+}
+
+// Stores 'reg', which must be 0 or 1, as a boolean at [base + disp]
+void emit_store_bool(int base, int32_t disp, int reg, Assembler *assembler){
+#ifdef NAN_BOXING
+    emit_alu_imm(OR_EXT, reg, (int32_t)NAN_BOXING_FALSE, assembler);
+    emit_store(base, disp, reg, assembler);
+#else
+    emit_store_imm32(base, disp + TYPE_DISP, BOOL_VALUE_TYPE, assembler);
+    emit_store(base, disp + CONTENT_DISP, reg, assembler);
+#endif
+}
+
+// Loads the float at [base + disp] in 'xmm'. Anything else leaves to the interpreter. Clobbers RAX and RDX
+void emit_load_float(int xmm, int base, int32_t disp, Assembler *assembler){
+#ifdef NAN_BOXING
+    emit_load(RAX_REG, base, disp, assembler);
+    emit_mov_imm64(RDX_REG, NAN_BOXING_FLOAT_OFFSET, assembler);
+    emit_alu(CMP_OP, RAX_REG, RDX_REG, assembler);
+    emit_guard(B_COND, 0, assembler);
+    emit_alu(SUB_OP, RAX_REG, RDX_REG, assembler);
+#else
+    emit_op_mem(0, 0x81, CMP_EXT, base, disp + TYPE_DISP, assembler);
+    emit_u32(FLOAT_VALUE_TYPE, assembler);
+    emit_guard(NE_COND, 0, assembler);
+    emit_load(RAX_REG, base, disp + CONTENT_DISP, assembler);
+#endif
+    emit_movq_to_xmm(xmm, RAX_REG, assembler);
+}
+
+// Stores the float in 'xmm' at [base + disp]. Clobbers RAX and RDX
+void emit_store_float(int base, int32_t disp, int xmm, Assembler *assembler){
+#ifdef NAN_BOXING
+    // NaNs must be made canonical: the interpreter does it
+    emit_ucomisd(xmm, xmm, assembler);
+    emit_guard(P_COND, 0, assembler);
+    emit_movq_from_xmm(RAX_REG, xmm, assembler);
+    emit_mov_imm64(RDX_REG, NAN_BOXING_FLOAT_OFFSET, assembler);
+    emit_alu(ADD_OP, RAX_REG, RDX_REG, assembler);
+    emit_store(base, disp, RAX_REG, assembler);
+#else
+    emit_store_imm32(base, disp + TYPE_DISP, FLOAT_VALUE_TYPE, assembler);
+    emit_movq_from_xmm(RAX_REG, xmm, assembler);
+    emit_store(base, disp + CONTENT_DISP, RAX_REG, assembler);
+#endif
+}
+
+// Loads the pointer to the ArrayObj at [base + disp] in 'reg'. Anything
+// else leaves to the interpreter. Clobbers RDX
+void emit_load_array(int reg, int base, int32_t disp, Assembler *assembler){
+#ifdef NAN_BOXING
+    // Objects go from 8 up to the first tag
+    emit_load(reg, base, disp, assembler);
+    emit_mov(RDX_REG, reg, assembler);
+    emit_shift(SHR_EXT, RDX_REG, 48, assembler);
+    emit_op_reg(1, 0x85, RDX_REG, RDX_REG, assembler);
+    emit_guard(NE_COND, 0, assembler);
+    emit_alu_imm(CMP_EXT, reg, 8, assembler);
+    emit_guard(B_COND, 0, assembler);
+#else
+    emit_op_mem(0, 0x81, CMP_EXT, base, disp + TYPE_DISP, assembler);
+    emit_u32(OBJ_VALUE_TYPE, assembler);
+    emit_guard(NE_COND, 0, assembler);
+    emit_load(reg, base, disp + CONTENT_DISP, assembler);
+#endif
+    emit_op_mem(0, 0x81, CMP_EXT, reg, (int32_t)offsetof(Obj, type), assembler);
+    emit_u32(ARRAY_OBJ_TYPE, assembler);
+    emit_guard(NE_COND, 0, assembler);
+}
+
+// Entered as a JitEntry: jumps to the code of the instruction 'at'
+void emit_prologue(Assembler *assembler){
+    emit_push(RBX_REG, assembler);
+    emit_push(R12_REG, assembler);
+    emit_push(R13_REG, assembler);
+    emit_push(R14_REG, assembler);
+    // Keeps the stack aligned to 16 bytes for the calls
+    emit_alu_imm(SUB_EXT, RSP_REG, 8, assembler);
+
+    emit_mov(VM_REG, RDI_REG, assembler);
+    emit_mov(FRAME_REG, RSI_REG, assembler);
+    emit_load(LOCALS_REG, FRAME_REG, (int32_t)offsetof(Frame, locals), assembler);
+    emit_alu_imm(ADD_EXT, LOCALS_REG, VALUE_LEN, assembler);
+    emit_load(TOP_REG, VM_REG, (int32_t)offsetof(VM, stack_top), assembler);
+
+    emit_op_reg(0, 0xff, 4, RDX_REG, assembler);
+}
+
+// Jumped to with the status in EAX
+void emit_epilogue(Assembler *assembler){
+    assembler->epilogue = assembler->len;
+
+    emit_store(VM_REG, (int32_t)offsetof(VM, stack_top), TOP_REG, assembler);
+    emit_alu_imm(ADD_EXT, RSP_REG, 8, assembler);
+    emit_pop(R14_REG, assembler);
+    emit_pop(R13_REG, assembler);
+    emit_pop(R12_REG, assembler);
+    emit_pop(RBX_REG, assembler);
+    emit_byte(0xc3, assembler);
+}
+
+void emit_jump(int cond, size_t target, Assembler *assembler){
+    Jump jump = {
+        .at = emit_jcc(cond, assembler),
+        .target = target
+    };
+
+    if(dynarr_insert(assembler->jumps, &jump)){
+        assembler->failed = 1;
+    }
+}
+
+// The helper reads the instruction from the ip of the frame, like the interpreter
+void emit_step(size_t offset, char can_leave, Assembler *assembler){
+    emit_store(VM_REG, (int32_t)offsetof(VM, stack_top), TOP_REG, assembler);
+    emit_store_imm64(FRAME_REG, (int32_t)offsetof(Frame, ip), (int32_t)offset, assembler);
+    emit_mov(RDI_REG, VM_REG, assembler);
+    emit_call((void *)assembler->step, assembler);
+    emit_load(TOP_REG, VM_REG, (int32_t)offsetof(VM, stack_top), assembler);
+
+    if(can_leave){
+        emit_op_reg(0, 0x85, RAX_REG, RAX_REG, assembler);
+        patch(emit_jcc(NE_COND, assembler), assembler->epilogue, assembler);
+    }
+}
+
+void emit_exit(size_t offset, Assembler *assembler){
+    emit_store_imm64(FRAME_REG, (int32_t)offsetof(Frame, ip), (int32_t)offset, assembler);
+    emit_byte(0xb8, assembler);
+    emit_u32(INTERPRET_JIT_STATUS, assembler);
+    patch(emit_jcc(NO_COND, assembler), assembler->epilogue, assembler);
+}
+
+// Loops only let the garbage collector run here
+void emit_safepoint(Assembler *assembler){
+    emit_op_mem(0, 0x80, CMP_EXT, VM_REG, (int32_t)offsetof(VM, gc_request), assembler);
+    emit_byte(0, assembler);
+
+    size_t skip = emit_jcc(E_COND, assembler);
+
+    emit_store(VM_REG, (int32_t)offsetof(VM, stack_top), TOP_REG, assembler);
+    emit_mov(RDI_REG, VM_REG, assembler);
+    emit_call((void *)assembler->safepoint, assembler);
+    patch(skip, assembler->len, assembler);
+}
+
+void emit_push_value(Value value, Assembler *assembler){
+    emit_store_value(TOP_REG, 0, value, assembler);
+    emit_alu_imm(ADD_EXT, TOP_REG, VALUE_LEN, assembler);
+}
+
+// Of two values based on the same register. Integers are
+// done here, anything else by the step helper
+void emit_arithmetic(uint8_t opcode, int dst_base, int32_t dst_disp, int32_t left_disp, int32_t right_disp, char step, Assembler *assembler){
+    emit_load_int(RAX_REG, dst_base, left_disp, step, assembler);
+    emit_load_int(RCX_REG, dst_base, right_disp, step, assembler);
+
+    switch (opcode){
+        case OP_ADD:{
+            emit_alu(ADD_OP, RAX_REG, RCX_REG, assembler);
+            break;
+        }case OP_SUB:{
+            emit_alu(SUB_OP, RAX_REG, RCX_REG, assembler);
+            break;
+        }default:{
+            emit_imul(RAX_REG, RCX_REG, assembler);
+            break;
+        }
+    }
+
+    emit_store_int(dst_base, dst_disp, RAX_REG, step, assembler);
+}
+
+// Of the two values at the top of the stack
+void emit_compare(int cond, char step, Assembler *assembler){
+    emit_load_int(RAX_REG, TOP_REG, -2 * VALUE_LEN, step, assembler);
+    emit_load_int(RCX_REG, TOP_REG, -VALUE_LEN, step, assembler);
+    emit_alu(CMP_OP, RAX_REG, RCX_REG, assembler);
+    emit_setcc(cond, RAX_REG, assembler);
+    emit_store_bool(TOP_REG, -2 * VALUE_LEN, RAX_REG, assembler);
+    emit_alu_imm(SUB_EXT, TOP_REG, VALUE_LEN, assembler);
+}
+
+// Of two locals. Anything but integers leaves to the interpreter
+void emit_compare_jump(int cond, int32_t left_disp, int32_t right_disp, size_t target, Assembler *assembler){
+    emit_load_int(RAX_REG, LOCALS_REG, left_disp, 0, assembler);
+    emit_load_int(RCX_REG, LOCALS_REG, right_disp, 0, assembler);
+    emit_alu(CMP_OP, RAX_REG, RCX_REG, assembler);
+    emit_jump(cond, target, assembler);
+}
+
+inline int16_t operand_i16(const uint8_t *bytes){
+    return (int16_t)(((uint16_t)bytes[0] << 8) | (uint16_t)bytes[1]);
+}
+
+// Of the instructions which jump, else SIZE_MAX
+size_t jump_target(const uint8_t *instruction, size_t next){
+    switch (instruction[0]){
+        case OP_JMP:
+        case OP_JIF:
+        case OP_JIT:
+        case OP_OR:
+        case OP_AND:{
+            return (size_t)((int64_t)next + operand_i16(instruction + 1));
+        }case OP_LT_LL_JIF:
+         case OP_GE_LL_JIT:
+         case OP_RJNLT:
+         case OP_RJNGT:
+         case OP_RJNLE:
+         case OP_RJNGE:{
+            return (size_t)((int64_t)next + operand_i16(instruction + 3));
+        }default:{
+            return SIZE_MAX;
+        }
+    }
+}
+
+// Tells if the integer does not need to be boxed
+inline int int_fits(int64_t value){
+#ifdef NAN_BOXING
+    return value >= NAN_BOXING_INT_MIN && value <= NAN_BOXING_INT_MAX;
+#else
+    return 1;
+#endif
+}
+
+void emit_instruction(const Fn *fn, const uint8_t *instruction, Assembler *assembler){
+    uint8_t opcode = instruction[0];
+    size_t offset = assembler->offset;
+    size_t target = jump_target(instruction, assembler->next);
+
+    if(target <= offset){
+        emit_safepoint(assembler);
+    }
+
+    switch (opcode){
+        case OP_EMPTY:{
+            emit_push_value(EMPTY_VALUE, assembler);
+            break;
+        }case OP_FALSE:
+         case OP_TRUE:{
+            emit_push_value(BOOL_VALUE(opcode == OP_TRUE), assembler);
+            break;
+        }case OP_CINT:{
+            emit_push_value(INT_VALUE((int64_t)instruction[1]), assembler);
+            break;
+        }case OP_INT:{
+            size_t idx = (size_t)operand_i16(instruction + 1);
+
+            if(idx >= dynarr_len(fn->iconsts) || !int_fits(DYNARR_GET_AS(fn->iconsts, int64_t, idx))){
+                emit_exit(offset, assembler);
+                break;
+            }
+
+            emit_push_value(INT_VALUE(DYNARR_GET_AS(fn->iconsts, int64_t, idx)), assembler);
+
+            break;
+        }case OP_FLOAT:{
+            size_t idx = (size_t)operand_i16(instruction + 1);
+
+            if(idx >= dynarr_len(fn->fconsts)){
+                emit_exit(offset, assembler);
+                break;
+            }
+
+            emit_push_value(FLOAT_VALUE(DYNARR_GET_AS(fn->fconsts, double, idx)), assembler);
+
+            break;
+        }case OP_LSET:{
+            emit_copy_value(LOCALS_REG, instruction[1] * VALUE_LEN, TOP_REG, -VALUE_LEN, assembler);
+            break;
+        }case OP_LGET:{
+            emit_copy_value(TOP_REG, 0, LOCALS_REG, instruction[1] * VALUE_LEN, assembler);
+            emit_alu_imm(ADD_EXT, TOP_REG, VALUE_LEN, assembler);
+            break;
+        }case OP_LGET2:{
+            emit_copy_value(TOP_REG, 0, LOCALS_REG, instruction[1] * VALUE_LEN, assembler);
+            emit_copy_value(TOP_REG, VALUE_LEN, LOCALS_REG, instruction[2] * VALUE_LEN, assembler);
+            emit_alu_imm(ADD_EXT, TOP_REG, 2 * VALUE_LEN, assembler);
+            break;
+        }case OP_POP:{
+            emit_alu_imm(SUB_EXT, TOP_REG, VALUE_LEN, assembler);
+            break;
+        }case OP_JMP:{
+            emit_jump(NO_COND, target, assembler);
+            break;
+        }case OP_JIF:
+         case OP_JIT:{
+            emit_load_bool(RAX_REG, TOP_REG, -VALUE_LEN, assembler);
+            emit_alu_imm(SUB_EXT, TOP_REG, VALUE_LEN, assembler);
+            emit_op_reg(0, 0x85, RAX_REG, RAX_REG, assembler);
+            emit_jump(opcode == OP_JIF ? E_COND : NE_COND, target, assembler);
+            break;
+        }case OP_OR:
+         case OP_AND:{
+            // The value stays when jumping
+            emit_load_bool(RAX_REG, TOP_REG, -VALUE_LEN, assembler);
+            emit_op_reg(0, 0x85, RAX_REG, RAX_REG, assembler);
+            emit_jump(opcode == OP_OR ? NE_COND : E_COND, target, assembler);
+            emit_alu_imm(SUB_EXT, TOP_REG, VALUE_LEN, assembler);
+            break;
+        }case OP_NOT:{
+            emit_load_bool(RAX_REG, TOP_REG, -VALUE_LEN, assembler);
+            emit_alu_imm(XOR_EXT, RAX_REG, 1, assembler);
+            emit_store_bool(TOP_REG, -VALUE_LEN, RAX_REG, assembler);
+            break;
+        }case OP_ADD:
+         case OP_ADD_II:
+         case OP_SUB:
+         case OP_SUB_II:
+         case OP_MUL:
+         case OP_MUL_II:{
+            uint8_t generic = opcode == OP_ADD_II ? OP_ADD : opcode == OP_SUB_II ? OP_SUB : opcode == OP_MUL_II ? OP_MUL : opcode;
+
+            emit_arithmetic(generic, TOP_REG, -2 * VALUE_LEN, -2 * VALUE_LEN, -VALUE_LEN, 1, assembler);
+            emit_alu_imm(SUB_EXT, TOP_REG, VALUE_LEN, assembler);
+
+            break;
+        }case OP_LT:
+         case OP_LT_II:{
+            emit_compare(L_COND, 1, assembler);
+            break;
+        }case OP_GT:
+         case OP_GT_II:{
+            emit_compare(G_COND, 1, assembler);
+            break;
+        }case OP_LE:
+         case OP_LE_II:{
+            emit_compare(LE_COND, 1, assembler);
+            break;
+        }case OP_GE:
+         case OP_GE_II:{
+            emit_compare(GE_COND, 1, assembler);
+            break;
+        }case OP_EQ:{
+            emit_compare(E_COND, 1, assembler);
+            break;
+        }case OP_NE:{
+            emit_compare(NE_COND, 1, assembler);
+            break;
+        }case OP_INCL:{
+            int32_t disp = instruction[1] * VALUE_LEN;
+
+            emit_load_int(RAX_REG, LOCALS_REG, disp, 1, assembler);
+            emit_alu_imm(ADD_EXT, RAX_REG, 1, assembler);
+            emit_store_int(LOCALS_REG, disp, RAX_REG, 1, assembler);
+
+            break;
+        }case OP_LT_LL_JIF:{
+            emit_compare_jump(GE_COND, instruction[1] * VALUE_LEN, instruction[2] * VALUE_LEN, target, assembler);
+            break;
+        }case OP_GE_LL_JIT:{
+            emit_compare_jump(GE_COND, instruction[1] * VALUE_LEN, instruction[2] * VALUE_LEN, target, assembler);
+            break;
+        }case OP_RMOV:{
+            emit_copy_value(LOCALS_REG, instruction[1] * VALUE_LEN, LOCALS_REG, instruction[2] * VALUE_LEN, assembler);
+            break;
+        }case OP_RCINT:{
+            emit_store_value(LOCALS_REG, instruction[1] * VALUE_LEN, INT_VALUE((int64_t)instruction[2]), assembler);
+            break;
+        }case OP_RINT:{
+            size_t idx = (size_t)operand_i16(instruction + 2);
+
+            if(idx >= dynarr_len(fn->iconsts) || !int_fits(DYNARR_GET_AS(fn->iconsts, int64_t, idx))){
+                emit_exit(offset, assembler);
+                break;
+            }
+
+            emit_store_value(
+                LOCALS_REG,
+                instruction[1] * VALUE_LEN,
+                INT_VALUE(DYNARR_GET_AS(fn->iconsts, int64_t, idx)),
+                assembler
+            );
+
+            break;
+        }case OP_RFLOAT:{
+            size_t idx = (size_t)operand_i16(instruction + 2);
+
+            if(idx >= dynarr_len(fn->fconsts)){
+                emit_exit(offset, assembler);
+                break;
+            }
+
+            emit_store_value(
+                LOCALS_REG,
+                instruction[1] * VALUE_LEN,
+                FLOAT_VALUE(DYNARR_GET_AS(fn->fconsts, double, idx)),
+                assembler
+            );
+
+            break;
+        }case OP_RADD:
+         case OP_RSUB:
+         case OP_RMUL:{
+            uint8_t generic = opcode == OP_RADD ? OP_ADD : opcode == OP_RSUB ? OP_SUB : OP_MUL;
+
+            emit_arithmetic(
+                generic,
+                LOCALS_REG,
+                instruction[1] * VALUE_LEN,
+                instruction[2] * VALUE_LEN,
+                instruction[3] * VALUE_LEN,
+                1,
+                assembler
+            );
+
+            break;
+        }case OP_RADDK:
+         case OP_RSUBK:{
+            emit_load_int(RAX_REG, LOCALS_REG, instruction[2] * VALUE_LEN, 1, assembler);
+            emit_alu_imm(opcode == OP_RADDK ? ADD_EXT : SUB_EXT, RAX_REG, instruction[3], assembler);
+            emit_store_int(LOCALS_REG, instruction[1] * VALUE_LEN, RAX_REG, 1, assembler);
+            break;
+        }case OP_RJNLT:{
+            emit_compare_jump(GE_COND, instruction[1] * VALUE_LEN, instruction[2] * VALUE_LEN, target, assembler);
+            break;
+        }case OP_RJNGT:{
+            emit_compare_jump(LE_COND, instruction[1] * VALUE_LEN, instruction[2] * VALUE_LEN, target, assembler);
+            break;
+        }case OP_RJNLE:{
+            emit_compare_jump(G_COND, instruction[1] * VALUE_LEN, instruction[2] * VALUE_LEN, target, assembler);
+            break;
+        }case OP_RJNGE:{
+            emit_compare_jump(L_COND, instruction[1] * VALUE_LEN, instruction[2] * VALUE_LEN, target, assembler);
+            break;
+        }case OP_ADD_FF:
+         case OP_SUB_FF:
+         case OP_MUL_FF:
+         case OP_DIV:
+         case OP_MOD:
+         case OP_LT_FF:
+         case OP_GT_FF:
+         case OP_LE_FF:
+         case OP_GE_FF:
+         case OP_RDIV:
+         case OP_RMOD:
+         case OP_GGET:
+         case OP_GSET:
+         case OP_INDEX:
+         case OP_ASET:
+         case OP_ACCESS:{
+            emit_step(offset, 0, assembler);
+            break;
+        }case OP_CALL:
+         case OP_TCALL:
+         case OP_INVOKE:
+         case OP_RET:
+         case OP_NEXT:{
+            emit_step(offset, 1, assembler);
+            break;
+        }default:{
+            emit_exit(offset, assembler);
+            break;
+        }
+    }
+}
+
+// The guards of an instruction share their stub
+void emit_stubs(Assembler *assembler){
+    DynArr *stubs = assembler->stubs;
+    size_t stubs_len = dynarr_len(stubs);
+    size_t position = 0;
+
+    for (size_t i = 0; i < stubs_len; i++){
+        Stub *stub = (Stub *)dynarr_get_raw(stubs, i);
+        Stub *prev = i == 0 ? NULL : (Stub *)dynarr_get_raw(stubs, i - 1);
+
+        if(!prev || prev->offset != stub->offset || prev->step != stub->step){
+            position = assembler->len;
+
+            if(stub->step){
+                emit_step(stub->offset, 0, assembler);
+                emit_jump(NO_COND, stub->next, assembler);
+            }else{
+                emit_exit(stub->offset, assembler);
+            }
+        }
+
+        patch(stub->at, position, assembler);
+    }
+}
+
+int assemble(const Fn *fn, Assembler *assembler){
+    size_t chunks_len = dynarr_len(fn->chunks);
+    const uint8_t *chunks = dynarr_get_raw(fn->chunks, 0);
+
+    emit_prologue(assembler);
+    emit_epilogue(assembler);
+
+    for (size_t offset = 0; offset < chunks_len; offset++){
+        assembler->labels[offset] = SIZE_MAX;
+    }
+
+    for (size_t offset = 0; offset < chunks_len;){
+        size_t len = verifier_instruction_len(chunks[offset]);
+
+        if(len == 0 || offset + len > chunks_len){
+            return 1;
+        }
+
+        assembler->labels[offset] = assembler->len;
+        assembler->offset = offset;
+        assembler->next = offset + len;
+
+        emit_instruction(fn, chunks + offset, assembler);
+
+        offset += len;
+    }
+
+    emit_stubs(assembler);
+
+    DynArr *jumps = assembler->jumps;
+    size_t jumps_len = dynarr_len(jumps);
+
+    for (size_t i = 0; i < jumps_len; i++){
+        Jump *jump = (Jump *)dynarr_get_raw(jumps, i);
+
+        // Unreachable instructions are not verified
+        if(jump->target >= chunks_len || assembler->labels[jump->target] == SIZE_MAX){
+            return 1;
+        }
+
+        patch(jump->at, assembler->labels[jump->target], assembler);
+    }
+
+    return assembler->failed || assembler->len > assembler->cap;
+}
+
+// Copies the assembled code to executable memory. Returns MAP_FAILED on failure
+uint8_t *map_code(const Assembler *assembler, size_t *out_len){
+    size_t page_len = (size_t)sysconf(_SC_PAGESIZE);
+    size_t len = (assembler->len + page_len - 1) / page_len * page_len;
+    uint8_t *code = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if(code == MAP_FAILED){
+        return MAP_FAILED;
+    }
+
+    memcpy(code, assembler->bytes, assembler->len);
+
+    if(mprotect(code, len, PROT_READ | PROT_EXEC)){
+        munmap(code, len);
+        return MAP_FAILED;
+    }
+
+    *out_len = len;
+
+    return code;
+}
+
+uint8_t trace_type(Value value){
+#ifdef NAN_BOXING
+    if((value.bits & ~NAN_BOXING_PAYLOAD_MASK) == NAN_BOXING_INT_TAG){
+        return INT_TRACE_TYPE;
+    }
+#else
+    if(IS_VALUE_INT(value)){
+        return INT_TRACE_TYPE;
+    }
+#endif
+
+    if(IS_VALUE_FLOAT(value)){
+        return FLOAT_TRACE_TYPE;
+    }
+
+    if(is_value_array(value)){
+        return ARRAY_TRACE_TYPE;
+    }
+
+    return OTHER_TRACE_TYPE;
+}
+
+// Comparison of the instructions which compare two locals and jump,
+// and if they jump when it holds (1) or when it does not (0)
+uint8_t branch_comparison(uint8_t opcode, char *jumps_when){
+    *jumps_when = opcode == OP_GE_LL_JIT;
+
+    switch (opcode){
+        case OP_LT_LL_JIF:
+        case OP_RJNLT:{
+            return OP_LT;
+        }case OP_RJNGT:{
+            return OP_GT;
+        }case OP_RJNLE:{
+            return OP_LE;
+        }default:{
+            return OP_GE;
+        }
+    }
+}
+
+// Holds after comparing the left integer with the right one when 'comparison' does
+int int_cond(uint8_t comparison){
+    switch (comparison){
+        case OP_LT:{
+            return L_COND;
+        }case OP_GT:{
+            return G_COND;
+        }case OP_LE:{
+            return LE_COND;
+        }case OP_GE:{
+            return GE_COND;
+        }case OP_EQ:{
+            return E_COND;
+        }default:{
+            return NE_COND;
+        }
+    }
+}
+
+// Compares the left float in XMM0 with the right one in XMM1. Returns the
+// condition which holds when 'comparison' does. Only the 'above' conditions
+// are false for NaNs, like the comparisons of the interpreter, so < and <=
+// are done with the operands swapped
+int emit_float_compare(uint8_t comparison, Assembler *assembler){
+    if(comparison == OP_LT || comparison == OP_LE){
+        emit_ucomisd(XMM1_REG, XMM0_REG, assembler);
+    }else{
+        emit_ucomisd(XMM0_REG, XMM1_REG, assembler);
+    }
+
+    return comparison == OP_LT || comparison == OP_GT ? A_COND : AE_COND;
+}
+
+// With the flags set so 'cond' holds when the branch jumps to 'target'.
+// Leaves to the interpreter if it does not go to 'next', the instruction
+// recorded after it
+void emit_branch(int cond, size_t target, size_t next, Assembler *assembler){
+    emit_guard(next == target ? NEGATE_COND(cond) : cond, 0, assembler);
+}
+
+void emit_float_arithmetic(uint8_t opcode, int base, int32_t dst_disp, int32_t left_disp, int32_t right_disp, Assembler *assembler){
+    uint8_t sd_opcode = DIVSD_OP;
+
+    switch (opcode){
+        case OP_ADD:{
+            sd_opcode = ADDSD_OP;
+            break;
+        }case OP_SUB:{
+            sd_opcode = SUBSD_OP;
+            break;
+        }case OP_MUL:{
+            sd_opcode = MULSD_OP;
+            break;
+        }
+    }
+
+    emit_load_float(XMM0_REG, base, left_disp, assembler);
+    emit_load_float(XMM1_REG, base, right_disp, assembler);
+    emit_sd(sd_opcode, XMM0_REG, XMM1_REG, assembler);
+    emit_store_float(base, dst_disp, XMM0_REG, assembler);
+}
+
+// Leaves in RCX the address of the element of the array at [TOP + target_disp]
+// indexed by the integer at [TOP + idx_disp]. Indexes out of bounds leave to
+// the interpreter, which reports them. Clobbers RAX and RDX
+void emit_element(int32_t target_disp, int32_t idx_disp, Assembler *assembler){
+    emit_load_array(RCX_REG, TOP_REG, target_disp, assembler);
+    emit_load_int(RAX_REG, TOP_REG, idx_disp, 0, assembler);
+    // Negative indexes are too big as unsigned
+    emit_op_mem(1, 0x3b, RAX_REG, RCX_REG, (int32_t)offsetof(ArrayObj, len), assembler);
+    emit_guard(AE_COND, 0, assembler);
+    emit_load(RCX_REG, RCX_REG, (int32_t)offsetof(ArrayObj, values), assembler);
+    emit_shift(SHL_EXT, RAX_REG, VALUE_SHIFT, assembler);
+    emit_alu(ADD_OP, RCX_REG, RAX_REG, assembler);
+}
+
+// Like emit_instruction, but for the types in 'op' and along the recorded
+// path: every guard leaves to the interpreter. 'next' is the offset of the
+// instruction recorded after this one, and 'loop' the position of the header
+void emit_trace_instruction(const Fn *fn, const uint8_t *instruction, const TraceOp *op, size_t next, size_t loop, Assembler *assembler){
+    uint8_t opcode = instruction[0];
+    uint8_t generic = jit_generic_opcode(opcode);
+    size_t offset = assembler->offset;
+    size_t target = jump_target(instruction, assembler->next);
+    int ints = op->types[0] == INT_TRACE_TYPE && op->types[1] == INT_TRACE_TYPE;
+    int floats = op->types[0] == FLOAT_TRACE_TYPE && op->types[1] == FLOAT_TRACE_TYPE;
+
+    switch (opcode){
+        case OP_EMPTY:
+        case OP_FALSE:
+        case OP_TRUE:
+        case OP_CINT:
+        case OP_INT:
+        case OP_FLOAT:
+        case OP_LSET:
+        case OP_LGET:
+        case OP_LGET2:
+        case OP_POP:
+        case OP_NOT:
+        case OP_RMOV:
+        case OP_RCINT:
+        case OP_RINT:
+        case OP_RFLOAT:{
+            emit_instruction(fn, instruction, assembler);
+            break;
+        }case OP_JMP:{
+            // Only the last instruction jumps back: to the header
+            if(target < offset){
+                emit_safepoint(assembler);
+                patch(emit_jcc(NO_COND, assembler), loop, assembler);
+            }
+
+            break;
+        }case OP_JIF:
+         case OP_JIT:{
+            emit_load_bool(RAX_REG, TOP_REG, -VALUE_LEN, assembler);
+            emit_op_reg(0, 0x85, RAX_REG, RAX_REG, assembler);
+            emit_branch(opcode == OP_JIF ? E_COND : NE_COND, target, next, assembler);
+            emit_alu_imm(SUB_EXT, TOP_REG, VALUE_LEN, assembler);
+            break;
+        }case OP_OR:
+         case OP_AND:{
+            emit_load_bool(RAX_REG, TOP_REG, -VALUE_LEN, assembler);
+            emit_op_reg(0, 0x85, RAX_REG, RAX_REG, assembler);
+            emit_branch(opcode == OP_OR ? NE_COND : E_COND, target, next, assembler);
+
+            // The value stays when jumping
+            if(next != target){
+                emit_alu_imm(SUB_EXT, TOP_REG, VALUE_LEN, assembler);
+            }
+
+            break;
+        }case OP_ADD:
+         case OP_ADD_II:
+         case OP_ADD_FF:
+         case OP_SUB:
+         case OP_SUB_II:
+         case OP_SUB_FF:
+         case OP_MUL:
+         case OP_MUL_II:
+         case OP_MUL_FF:
+         case OP_DIV:
+         case OP_MOD:{
+            if(ints && generic != OP_DIV && generic != OP_MOD){
+                emit_arithmetic(generic, TOP_REG, -2 * VALUE_LEN, -2 * VALUE_LEN, -VALUE_LEN, 0, assembler);
+            }else if(floats && generic != OP_MOD){
+                emit_float_arithmetic(generic, TOP_REG, -2 * VALUE_LEN, -2 * VALUE_LEN, -VALUE_LEN, assembler);
+            }else{
+                emit_step(offset, 0, assembler);
+                break;
+            }
+
+            emit_alu_imm(SUB_EXT, TOP_REG, VALUE_LEN, assembler);
+
+            break;
+        }case OP_LT:
+         case OP_LT_II:
+         case OP_LT_FF:
+         case OP_GT:
+         case OP_GT_II:
+         case OP_GT_FF:
+         case OP_LE:
+         case OP_LE_II:
+         case OP_LE_FF:
+         case OP_GE:
+         case OP_GE_II:
+         case OP_GE_FF:{
+            if(ints){
+                emit_compare(int_cond(generic), 0, assembler);
+            }else if(floats){
+                emit_load_float(XMM0_REG, TOP_REG, -2 * VALUE_LEN, assembler);
+                emit_load_float(XMM1_REG, TOP_REG, -VALUE_LEN, assembler);
+                emit_setcc(emit_float_compare(generic, assembler), RAX_REG, assembler);
+                emit_store_bool(TOP_REG, -2 * VALUE_LEN, RAX_REG, assembler);
+                emit_alu_imm(SUB_EXT, TOP_REG, VALUE_LEN, assembler);
+            }else{
+                emit_step(offset, 0, assembler);
+            }
+
+            break;
+        }case OP_EQ:
+         case OP_NE:{
+            if(ints){
+                emit_compare(int_cond(opcode), 0, assembler);
+            }else{
+                emit_step(offset, 0, assembler);
+            }
+
+            break;
+        }case OP_INCL:{
+            int32_t disp = instruction[1] * VALUE_LEN;
+
+            if(op->types[0] != INT_TRACE_TYPE){
+                emit_step(offset, 0, assembler);
+                break;
+            }
+
+            emit_load_int(RAX_REG, LOCALS_REG, disp, 0, assembler);
+            emit_alu_imm(ADD_EXT, RAX_REG, 1, assembler);
+            emit_store_int(LOCALS_REG, disp, RAX_REG, 0, assembler);
+
+            break;
+        }case OP_RADD:
+         case OP_RSUB:
+         case OP_RMUL:
+         case OP_RDIV:
+         case OP_RMOD:{
+            int32_t dst_disp = instruction[1] * VALUE_LEN;
+            int32_t left_disp = instruction[2] * VALUE_LEN;
+            int32_t right_disp = instruction[3] * VALUE_LEN;
+
+            if(ints && generic != OP_DIV && generic != OP_MOD){
+                emit_arithmetic(generic, LOCALS_REG, dst_disp, left_disp, right_disp, 0, assembler);
+            }else if(floats && generic != OP_MOD){
+                emit_float_arithmetic(generic, LOCALS_REG, dst_disp, left_disp, right_disp, assembler);
+            }else{
+                emit_step(offset, 0, assembler);
+            }
+
+            break;
+        }case OP_RADDK:
+         case OP_RSUBK:{
+            if(op->types[0] != INT_TRACE_TYPE){
+                emit_step(offset, 0, assembler);
+                break;
+            }
+
+            emit_load_int(RAX_REG, LOCALS_REG, instruction[2] * VALUE_LEN, 0, assembler);
+            emit_alu_imm(opcode == OP_RADDK ? ADD_EXT : SUB_EXT, RAX_REG, instruction[3], assembler);
+            emit_store_int(LOCALS_REG, instruction[1] * VALUE_LEN, RAX_REG, 0, assembler);
+
+            break;
+        }case OP_LT_LL_JIF:
+         case OP_GE_LL_JIT:
+         case OP_RJNLT:
+         case OP_RJNGT:
+         case OP_RJNLE:
+         case OP_RJNGE:{
+            char jumps_when;
+            uint8_t comparison = branch_comparison(opcode, &jumps_when);
+            int32_t left_disp = instruction[1] * VALUE_LEN;
+            int32_t right_disp = instruction[2] * VALUE_LEN;
+            int cond;
+
+            if(ints){
+                emit_load_int(RAX_REG, LOCALS_REG, left_disp, 0, assembler);
+                emit_load_int(RCX_REG, LOCALS_REG, right_disp, 0, assembler);
+                emit_alu(CMP_OP, RAX_REG, RCX_REG, assembler);
+                cond = int_cond(comparison);
+            }else if(floats){
+                emit_load_float(XMM0_REG, LOCALS_REG, left_disp, assembler);
+                emit_load_float(XMM1_REG, LOCALS_REG, right_disp, assembler);
+                cond = emit_float_compare(comparison, assembler);
+            }else{
+                // Not recorded
+                assembler->failed = 1;
+                break;
+            }
+
+            emit_branch(jumps_when ? cond : NEGATE_COND(cond), target, next, assembler);
+
+            break;
+        }case OP_INDEX:{
+            if(op->types[0] != ARRAY_TRACE_TYPE || op->types[1] != INT_TRACE_TYPE){
+                emit_step(offset, 0, assembler);
+                break;
+            }
+
+            emit_element(-VALUE_LEN, -2 * VALUE_LEN, assembler);
+            emit_copy_value(TOP_REG, -2 * VALUE_LEN, RCX_REG, 0, assembler);
+            emit_alu_imm(SUB_EXT, TOP_REG, VALUE_LEN, assembler);
+
+            break;
+        }case OP_ASET:{
+            uint8_t value_type = op->types[2];
+
+            // Numbers do not need the write barrier
+            if(op->types[0] != ARRAY_TRACE_TYPE ||
+               op->types[1] != INT_TRACE_TYPE ||
+               (value_type != INT_TRACE_TYPE && value_type != FLOAT_TRACE_TYPE))
+            {
+                emit_step(offset, 0, assembler);
+                break;
+            }
+
+            if(value_type == INT_TRACE_TYPE){
+                emit_load_int(RAX_REG, TOP_REG, -3 * VALUE_LEN, 0, assembler);
+            }else{
+                emit_load_float(XMM0_REG, TOP_REG, -3 * VALUE_LEN, assembler);
+            }
+
+            emit_element(-VALUE_LEN, -2 * VALUE_LEN, assembler);
+            emit_copy_value(RCX_REG, 0, TOP_REG, -3 * VALUE_LEN, assembler);
+            emit_alu_imm(SUB_EXT, TOP_REG, 2 * VALUE_LEN, assembler);
+
+            break;
+        }case OP_GGET:
+         case OP_GSET:
+         case OP_ACCESS:{
+            emit_step(offset, 0, assembler);
+            break;
+        }case OP_CALL:
+         case OP_INVOKE:{
+            emit_step(offset, 1, assembler);
+            break;
+        }default:{
+            assembler->failed = 1;
+            break;
+        }
+    }
+}
+
+int assemble_trace(const Fn *fn, const DynArr *ops, size_t *out_loop, Assembler *assembler){
+    size_t chunks_len = dynarr_len(fn->chunks);
+    const uint8_t *chunks = dynarr_get_raw(fn->chunks, 0);
+    size_t ops_len = dynarr_len(ops);
+    size_t header = ((TraceOp *)dynarr_get_raw(ops, 0))->offset;
+
+    emit_prologue(assembler);
+    emit_epilogue(assembler);
+
+    *out_loop = assembler->len;
+
+    for (size_t i = 0; i < ops_len; i++){
+        const TraceOp *op = (TraceOp *)dynarr_get_raw(ops, i);
+        size_t next = i + 1 < ops_len ? ((TraceOp *)dynarr_get_raw(ops, i + 1))->offset : header;
+        size_t len = op->offset < chunks_len ? verifier_instruction_len(chunks[op->offset]) : 0;
+
+        if(len == 0 || op->offset + len > chunks_len){
+            return 1;
+        }
+
+        assembler->offset = op->offset;
+        assembler->next = op->offset + len;
+
+        emit_trace_instruction(fn, chunks + op->offset, op, next, *out_loop, assembler);
+    }
+
+    emit_stubs(assembler);
+
+    // Traces have no labels to patch jumps with
+    return assembler->failed || assembler->len > assembler->cap || dynarr_len(assembler->jumps) > 0;
+}
+//----------------------------------------------------------------//
+//                      PUBLIC IMPLEMENTATION                     //
+//----------------------------------------------------------------//
+JitCode *jit_compile(const Fn *fn, JitStep step, JitSafepoint safepoint, const Allocator *allocator){
+    size_t chunks_len = dynarr_len(fn->chunks);
+    size_t cap = chunks_len * CODE_PER_CHUNK + CODE_EXTRA;
+    uint8_t *bytes = MEMORY_ALLOC(allocator, uint8_t, cap);
+    size_t *labels = MEMORY_ALLOC(allocator, size_t, chunks_len);
+    DynArr *jumps = MEMORY_DYNARR_TYPE(allocator, Jump);
+    DynArr *stubs = MEMORY_DYNARR_TYPE(allocator, Stub);
+    void **entries = MEMORY_ALLOC(allocator, void *, chunks_len);
+    JitCode *jit_code = MEMORY_ALLOC(allocator, JitCode, 1);
+    uint8_t *code = MAP_FAILED;
+    size_t len = 0;
+
+    if(bytes && labels && jumps && stubs && entries && jit_code){
+        Assembler assembler = {
+            .len = 0,
+            .cap = cap,
+            .bytes = bytes,
+            .labels = labels,
+            .jumps = jumps,
+            .stubs = stubs,
+            .failed = 0,
+            .step = step,
+            .safepoint = safepoint
+        };
+
+        if(chunks_len > 0 && !assemble(fn, &assembler)){
+            code = map_code(&assembler, &len);
+        }
+    }
+
+    if(code != MAP_FAILED){
+        for (size_t offset = 0; offset < chunks_len; offset++){
+            entries[offset] = labels[offset] == SIZE_MAX ? NULL : code + labels[offset];
+        }
+
+        *jit_code = (JitCode){
+            .len = len,
+            .code = code,
+            .entries_len = chunks_len,
+            .entries = entries,
+            .next = NULL,
+            .allocator = allocator
+        };
+    }else{
+        MEMORY_DEALLOC(allocator, void *, chunks_len, entries);
+        MEMORY_DEALLOC(allocator, JitCode, 1, jit_code);
+        jit_code = NULL;
+    }
+
+    MEMORY_DEALLOC(allocator, uint8_t, cap, bytes);
+    MEMORY_DEALLOC(allocator, size_t, chunks_len, labels);
+    dynarr_destroy(jumps);
+    dynarr_destroy(stubs);
+
+    return jit_code;
+}
+
+void jit_destroy(JitCode *jit_code){
+    if(!jit_code){
+        return;
+    }
+
+    const Allocator *allocator = jit_code->allocator;
+
+    munmap(jit_code->code, jit_code->len);
+    MEMORY_DEALLOC(allocator, void *, jit_code->entries_len, jit_code->entries);
+    MEMORY_DEALLOC(allocator, JitCode, 1, jit_code);
+}
+
+int jit_run(const JitCode *jit_code, Frame *frame, VM *vm){
+    JitEntry entry = (JitEntry)(void *)jit_code->code;
+    return entry(vm, frame, jit_code->entries[frame->ip]);
+}
+
+int jit_record(JitRecorder *recorder, const Frame *frame, const VM *vm){
+    // Calls to functions are not traced
+    if(frame != recorder->frame){
+        return ABORTED_RECORD_STATUS;
+    }
+
+    const uint8_t *chunks = dynarr_get_raw(recorder->fn->chunks, 0);
+    DynArr *ops = recorder->ops;
+    size_t ops_len = dynarr_len(ops);
+    size_t offset = frame->last_offset;
+    const uint8_t *instruction = chunks + offset;
+    uint8_t opcode = instruction[0];
+    size_t target = jump_target(instruction, offset + verifier_instruction_len(opcode));
+    const Value *top = vm->stack_top;
+    const Value *locals = frame->locals + 1;
+    TraceOp op = {
+        .offset = offset,
+        .types = {OTHER_TRACE_TYPE, OTHER_TRACE_TYPE, OTHER_TRACE_TYPE}
+    };
+
+    // The instruction must follow the previous one. It does not after a catch
+    if(ops_len == 0){
+        if(offset != recorder->header){
+            return ABORTED_RECORD_STATUS;
+        }
+    }else{
+        const TraceOp *prev = (TraceOp *)dynarr_get_raw(ops, ops_len - 1);
+        const uint8_t *prev_instruction = chunks + prev->offset;
+        size_t prev_next = prev->offset + verifier_instruction_len(prev_instruction[0]);
+
+        if(offset != prev_next && offset != jump_target(prev_instruction, prev_next)){
+            return ABORTED_RECORD_STATUS;
+        }
+    }
+
+    // Inner loops are traced by themselves
+    if(ops_len == JIT_TRACE_LEN || (target <= offset && (opcode != OP_JMP || target != recorder->header))){
+        return ABORTED_RECORD_STATUS;
+    }
+
+    switch (opcode){
+        case OP_EMPTY:
+        case OP_FALSE:
+        case OP_TRUE:
+        case OP_CINT:
+        case OP_INT:
+        case OP_FLOAT:
+        case OP_LSET:
+        case OP_LGET:
+        case OP_LGET2:
+        case OP_POP:
+        case OP_JMP:
+        case OP_JIF:
+        case OP_JIT:
+        case OP_OR:
+        case OP_AND:
+        case OP_NOT:
+        case OP_RMOV:
+        case OP_RCINT:
+        case OP_RINT:
+        case OP_RFLOAT:
+        case OP_GGET:
+        case OP_GSET:
+        case OP_ACCESS:
+        case OP_CALL:
+        case OP_INVOKE:{
+            break;
+        }case OP_ADD:
+         case OP_ADD_II:
+         case OP_ADD_FF:
+         case OP_SUB:
+         case OP_SUB_II:
+         case OP_SUB_FF:
+         case OP_MUL:
+         case OP_MUL_II:
+         case OP_MUL_FF:
+         case OP_DIV:
+         case OP_MOD:
+         case OP_LT:
+         case OP_LT_II:
+         case OP_LT_FF:
+         case OP_GT:
+         case OP_GT_II:
+         case OP_GT_FF:
+         case OP_LE:
+         case OP_LE_II:
+         case OP_LE_FF:
+         case OP_GE:
+         case OP_GE_II:
+         case OP_GE_FF:
+         case OP_EQ:
+         case OP_NE:{
+            op.types[0] = trace_type(top[-2]);
+            op.types[1] = trace_type(top[-1]);
+            break;
+        }case OP_INCL:{
+            op.types[0] = trace_type(locals[instruction[1]]);
+            break;
+        }case OP_RADD:
+         case OP_RSUB:
+         case OP_RMUL:
+         case OP_RDIV:
+         case OP_RMOD:{
+            op.types[0] = trace_type(locals[instruction[2]]);
+            op.types[1] = trace_type(locals[instruction[3]]);
+            break;
+        }case OP_RADDK:
+         case OP_RSUBK:{
+            op.types[0] = trace_type(locals[instruction[2]]);
+            break;
+        }case OP_LT_LL_JIF:
+         case OP_GE_LL_JIT:
+         case OP_RJNLT:
+         case OP_RJNGT:
+         case OP_RJNLE:
+         case OP_RJNGE:{
+            op.types[0] = trace_type(locals[instruction[1]]);
+            op.types[1] = trace_type(locals[instruction[2]]);
+
+            // Traces only branch on two integers or two floats
+            if(op.types[0] != op.types[1] || (op.types[0] != INT_TRACE_TYPE && op.types[0] != FLOAT_TRACE_TYPE)){
+                return ABORTED_RECORD_STATUS;
+            }
+
+            break;
+        }case OP_INDEX:{
+            op.types[0] = trace_type(top[-1]);
+            op.types[1] = trace_type(top[-2]);
+            break;
+        }case OP_ASET:{
+            op.types[0] = trace_type(top[-1]);
+            op.types[1] = trace_type(top[-2]);
+            op.types[2] = trace_type(top[-3]);
+            break;
+        }default:{
+            return ABORTED_RECORD_STATUS;
+        }
+    }
+
+    if(dynarr_insert(ops, &op)){
+        return ABORTED_RECORD_STATUS;
+    }
+
+    return target <= offset ? CLOSED_RECORD_STATUS : RECORDING_RECORD_STATUS;
+}
+
+JitCode *jit_compile_trace(const Fn *fn, const DynArr *ops, JitStep step, JitSafepoint safepoint, const Allocator *allocator){
+    size_t ops_len = dynarr_len(ops);
+    size_t cap = ops_len * CODE_PER_CHUNK + CODE_EXTRA;
+    uint8_t *bytes = MEMORY_ALLOC(allocator, uint8_t, cap);
+    DynArr *jumps = MEMORY_DYNARR_TYPE(allocator, Jump);
+    DynArr *stubs = MEMORY_DYNARR_TYPE(allocator, Stub);
+    void **entries = MEMORY_ALLOC(allocator, void *, 1);
+    JitCode *trace = MEMORY_ALLOC(allocator, JitCode, 1);
+    uint8_t *code = MAP_FAILED;
+    size_t len = 0;
+    size_t loop = 0;
+
+    if(bytes && jumps && stubs && entries && trace){
+        Assembler assembler = {
+            .len = 0,
+            .cap = cap,
+            .bytes = bytes,
+            .labels = NULL,
+            .jumps = jumps,
+            .stubs = stubs,
+            .failed = 0,
+            .step = step,
+            .safepoint = safepoint
+        };
+
+        if(ops_len > 0 && !assemble_trace(fn, ops, &loop, &assembler)){
+            code = map_code(&assembler, &len);
+        }
+    }
+
+    if(code != MAP_FAILED){
+        entries[0] = code + loop;
+
+        *trace = (JitCode){
+            .len = len,
+            .code = code,
+            .entries_len = 1,
+            .entries = entries,
+            .next = NULL,
+            .allocator = allocator
+        };
+    }else{
+        MEMORY_DEALLOC(allocator, void *, 1, entries);
+        MEMORY_DEALLOC(allocator, JitCode, 1, trace);
+        trace = NULL;
+    }
+
+    MEMORY_DEALLOC(allocator, uint8_t, cap, bytes);
+    dynarr_destroy(jumps);
+    dynarr_destroy(stubs);
+
+    return trace;
+}
+
+int jit_run_trace(const JitCode *trace, Frame *frame, VM *vm){
+    JitEntry entry = (JitEntry)(void *)trace->code;
+    return entry(vm, frame, trace->entries[0]);
+}
+#else
+JitCode *jit_compile(const Fn *fn, JitStep step, JitSafepoint safepoint, const Allocator *allocator){
+    return NULL;
+}
+
+void jit_destroy(JitCode *jit_code){}
+
+int jit_run(const JitCode *jit_code, Frame *frame, VM *vm){
+    return INTERPRET_JIT_STATUS;
+}
+
+int jit_record(JitRecorder *recorder, const Frame *frame, const VM *vm){
+    return ABORTED_RECORD_STATUS;
+}
+
+JitCode *jit_compile_trace(const Fn *fn, const DynArr *ops, JitStep step, JitSafepoint safepoint, const Allocator *allocator){
+    return NULL;
+}
+
+int jit_run_trace(const JitCode *trace, Frame *frame, VM *vm){
+    return INTERPRET_JIT_STATUS;
+}
+#endif
+
+uint8_t jit_generic_opcode(uint8_t opcode){
+    switch (opcode){
+        case OP_ADD_II:
+        case OP_ADD_FF:
+        case OP_RADD:
+        case OP_RADDK:{
+            return OP_ADD;
+        }case OP_SUB_II:
+         case OP_SUB_FF:
+         case OP_RSUB:
+         case OP_RSUBK:{
+            return OP_SUB;
+        }case OP_MUL_II:
+         case OP_MUL_FF:
+         case OP_RMUL:{
+            return OP_MUL;
+        }case OP_RDIV:{
+            return OP_DIV;
+        }case OP_RMOD:{
+            return OP_MOD;
+        }case OP_LT_II:
+         case OP_LT_FF:{
+            return OP_LT;
+        }case OP_GT_II:
+         case OP_GT_FF:{
+            return OP_GT;
+        }case OP_LE_II:
+         case OP_LE_FF:{
+            return OP_LE;
+        }case OP_GE_II:
+         case OP_GE_FF:{
+            return OP_GE;
+        }default:{
+            return opcode;
+        }
+    }
+}
@@ -0,0 +1,539 @@
+#include "profiler.h"
+#include "opcode.h"
+
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+
+//----------------------------------------------------------------//
+//                       PRIVATE INTERFACE                        //
+//----------------------------------------------------------------//
+#define REPORT_LINES_LENGTH 20
+
+typedef struct line_profile{
+    const char *filepath;
+    int line;
+    const Fn *fn;
+    ProfileCounter counter;
+}LineProfile;
+
+static const char *opcode_names[PROFILER_OPCODES_LENGTH] = {
+    [OP_EMPTY] = "EMPTY",
+    [OP_FALSE] = "FALSE",
+    [OP_TRUE] = "TRUE",
+    [OP_CINT] = "CINT",
+    [OP_INT] = "INT",
+    [OP_FLOAT] = "FLOAT",
+    [OP_STRING] = "STRING",
+    [OP_STTE] = "STTE",
+    [OP_ETTE] = "ETTE",
+    [OP_ARRAY] = "ARRAY",
+    [OP_LIST] = "LIST",
+    [OP_DICT] = "DICT",
+    [OP_RECORD] = "RECORD",
+    [OP_WTTE] = "WTTE",
+    [OP_IARRAY] = "IARRAY",
+    [OP_ILIST] = "ILIST",
+    [OP_IDICT] = "IDICT",
+    [OP_IRECORD] = "IRECORD",
+    [OP_CONCAT] = "CONCAT",
+    [OP_MULSTR] = "MULSTR",
+    [OP_ADD] = "ADD",
+    [OP_SUB] = "SUB",
+    [OP_MUL] = "MUL",
+    [OP_DIV] = "DIV",
+    [OP_MOD] = "MOD",
+    [OP_BNOT] = "BNOT",
+    [OP_LSH] = "LSH",
+    [OP_RSH] = "RSH",
+    [OP_BAND] = "BAND",
+    [OP_BXOR] = "BXOR",
+    [OP_BOR] = "BOR",
+    [OP_LT] = "LT",
+    [OP_GT] = "GT",
+    [OP_LE] = "LE",
+    [OP_GE] = "GE",
+    [OP_EQ] = "EQ",
+    [OP_NE] = "NE",
+    [OP_OR] = "OR",
+    [OP_AND] = "AND",
+    [OP_NOT] = "NOT",
+    [OP_NNOT] = "NNOT",
+    [OP_LSET] = "LSET",
+    [OP_LGET] = "LGET",
+    [OP_OSET] = "OSET",
+    [OP_OGET] = "OGET",
+    [OP_GDEF] = "GDEF",
+    [OP_GASET] = "GASET",
+    [OP_GSET] = "GSET",
+    [OP_GGET] = "GGET",
+    [OP_NGET] = "NGET",
+    [OP_SGET] = "SGET",
+    [OP_ASET] = "ASET",
+    [OP_RSET] = "RSET",
+    [OP_POP] = "POP",
+    [OP_JMP] = "JMP",
+    [OP_JIF] = "JIF",
+    [OP_JIT] = "JIT",
+    [OP_CALL] = "CALL",
+    [OP_TCALL] = "TCALL",
+    [OP_ACCESS] = "ACCESS",
+    [OP_INVOKE] = "INVOKE",
+    [OP_INDEX] = "INDEX",
+    [OP_RET] = "RET",
+    [OP_IS] = "IS",
+    [OP_TRYO] = "TRYO",
+    [OP_TRYC] = "TRYC",
+    [OP_THROW] = "THROW",
+    [OP_YIELD] = "YIELD",
+    [OP_NEXT] = "NEXT",
+    [OP_HLT] = "HLT",
+    [OP_INCL] = "INCL",
+    [OP_LGET2] = "LGET2",
+    [OP_LT_LL_JIF] = "LTLLJIF",
+    [OP_GE_LL_JIT] = "GELLJIT",
+    [OP_RMOV] = "RMOV",
+    [OP_RCINT] = "RCINT",
+    [OP_RINT] = "RINT",
+    [OP_RFLOAT] = "RFLOAT",
+    [OP_RADD] = "RADD",
+    [OP_RSUB] = "RSUB",
+    [OP_RMUL] = "RMUL",
+    [OP_RDIV] = "RDIV",
+    [OP_RMOD] = "RMOD",
+    [OP_RADDK] = "RADDK",
+    [OP_RSUBK] = "RSUBK",
+    [OP_RJNLT] = "RJNLT",
+    [OP_RJNGT] = "RJNGT",
+    [OP_RJNLE] = "RJNLE",
+    [OP_RJNGE] = "RJNGE",
+    [OP_ADD_II] = "ADD_II",
+    [OP_ADD_FF] = "ADD_FF",
+    [OP_SUB_II] = "SUB_II",
+    [OP_SUB_FF] = "SUB_FF",
+    [OP_MUL_II] = "MUL_II",
+    [OP_MUL_FF] = "MUL_FF",
+    [OP_LT_II] = "LT_II",
+    [OP_LT_FF] = "LT_FF",
+    [OP_GT_II] = "GT_II",
+    [OP_GT_FF] = "GT_FF",
+    [OP_LE_II] = "LE_II",
+    [OP_LE_FF] = "LE_FF",
+    [OP_GE_II] = "GE_II",
+    [OP_GE_FF] = "GE_FF",
+};
+
+static FnProfile *get_fn_profile(const Fn *fn, Profiler *profiler);
+static ProfileNode *get_child_node(const Fn *fn, ProfileNode *parent, Profiler *profiler);
+static void destroy_nodes(ProfileNode *node, const Allocator *allocator);
+
+static double percent(uint64_t ticks, uint64_t total_ticks);
+static int compare_counters(const ProfileCounter *a, const ProfileCounter *b);
+static int compare_opcodes(const void *a, const void *b);
+static int compare_fn_profiles(const void *a, const void *b);
+static int compare_line_profiles(const void *a, const void *b);
+static ProfileCounter fn_profile_total(const FnProfile *fn_profile);
+static size_t fn_lines(const FnProfile *fn_profile, LineProfile *lines);
+
+static void report_opcodes(FILE *stream, uint64_t total_ticks, Profiler *profiler);
+static void report_fns(FILE *stream, uint64_t total_ticks, Profiler *profiler);
+static void report_lines(FILE *stream, uint64_t total_ticks, Profiler *profiler);
+static void write_stacks(FILE *stream, size_t depth, const char **names, ProfileNode *node);
+
+// Used by compare_opcodes
+static const ProfileCounter *sorting_opcodes = NULL;
+//----------------------------------------------------------------//
+//                     PRIVATE IMPLEMENTATION                     //
+//----------------------------------------------------------------//
+FnProfile *get_fn_profile(const Fn *fn, Profiler *profiler){
+    const Allocator *allocator = profiler->allocator;
+    FnProfile *fn_profile = NULL;
+
+    if(lzohtable_lookup(sizeof(Fn *), &fn, profiler->fn_profiles_table, (void **)(&fn_profile))){
+        return fn_profile;
+    }
+
+    size_t offsets_len = dynarr_len(fn->chunks);
+
+    fn_profile = MEMORY_ALLOC(allocator, FnProfile, 1);
+    ProfileCounter *offsets = MEMORY_ALLOC(allocator, ProfileCounter, offsets_len);
+
+    if(!fn_profile || !offsets){
+        MEMORY_DEALLOC(allocator, FnProfile, 1, fn_profile);
+        MEMORY_DEALLOC(allocator, ProfileCounter, offsets_len, offsets);
+
+        return NULL;
+    }
+
+    memset(offsets, 0, sizeof(ProfileCounter) * offsets_len);
+
+    fn_profile->fn = fn;
+    fn_profile->offsets_len = offsets_len;
+    fn_profile->offsets = offsets;
+
+    if(dynarr_insert_ptr(profiler->fn_profiles, fn_profile) ||
+       lzohtable_put_ck(sizeof(Fn *), &fn, fn_profile, profiler->fn_profiles_table, NULL)
+    ){
+        MEMORY_DEALLOC(allocator, ProfileCounter, offsets_len, offsets);
+        MEMORY_DEALLOC(allocator, FnProfile, 1, fn_profile);
+
+        return NULL;
+    }
+
+    return fn_profile;
+}
+
+ProfileNode *get_child_node(const Fn *fn, ProfileNode *parent, Profiler *profiler){
+    for (ProfileNode *child = parent->children; child; child = child->next){
+        if(child->fn_profile->fn == fn){
+            return child;
+        }
+    }
+
+    FnProfile *fn_profile = get_fn_profile(fn, profiler);
+    ProfileNode *node = fn_profile ? MEMORY_ALLOC(profiler->allocator, ProfileNode, 1) : NULL;
+
+    if(!node){
+        return NULL;
+    }
+
+    node->fn_profile = fn_profile;
+    node->counter = (ProfileCounter){0};
+    node->parent = parent;
+    node->children = NULL;
+    node->next = parent->children;
+    parent->children = node;
+
+    return node;
+}
+
+void destroy_nodes(ProfileNode *node, const Allocator *allocator){
+    ProfileNode *child = node->children;
+
+    while (child){
+        ProfileNode *next = child->next;
+
+        destroy_nodes(child, allocator);
+        MEMORY_DEALLOC(allocator, ProfileNode, 1, child);
+
+        child = next;
+    }
+}
+
+inline double percent(uint64_t ticks, uint64_t total_ticks){
+    return total_ticks == 0 ? 0.0 : (double)ticks * 100.0 / (double)total_ticks;
+}
+
+int compare_counters(const ProfileCounter *a, const ProfileCounter *b){
+    if(a->ticks != b->ticks){
+        return a->ticks < b->ticks ? 1 : -1;
+    }
+
+    if(a->count != b->count){
+        return a->count < b->count ? 1 : -1;
+    }
+
+    return 0;
+}
+
+int compare_opcodes(const void *a, const void *b){
+    return compare_counters(
+        &sorting_opcodes[*(const uint8_t *)a],
+        &sorting_opcodes[*(const uint8_t *)b]
+    );
+}
+
+int compare_fn_profiles(const void *a, const void *b){
+    ProfileCounter counter_a = fn_profile_total(*(FnProfile * const *)a);
+    ProfileCounter counter_b = fn_profile_total(*(FnProfile * const *)b);
+
+    return compare_counters(&counter_a, &counter_b);
+}
+
+int compare_line_profiles(const void *a, const void *b){
+    return compare_counters(&((const LineProfile *)a)->counter, &((const LineProfile *)b)->counter);
+}
+
+ProfileCounter fn_profile_total(const FnProfile *fn_profile){
+    ProfileCounter total = {0};
+
+    for (size_t i = 0; i < fn_profile->offsets_len; i++){
+        total.count += fn_profile->offsets[i].count;
+        total.ticks += fn_profile->offsets[i].ticks;
+    }
+
+    return total;
+}
+
+size_t fn_lines(const FnProfile *fn_profile, LineProfile *lines){
+    const Fn *fn = fn_profile->fn;
+    size_t lines_len = 0;
+
+    for (size_t i = 0; i < fn_profile->offsets_len; i++){
+        ProfileCounter *counter = &fn_profile->offsets[i];
+
+        if(counter->count == 0){
+            continue;
+        }
+
+        OPCodeLocation *location = profiler_find_location(i, fn->locations);
+        const char *filepath = location ? location->filepath : NULL;
+        int line = location ? location->line : -1;
+        size_t j = 0;
+
+        for (; j < lines_len && lines[j].line != line; j++);
+
+        if(j == lines_len){
+            lines[lines_len++] = (LineProfile){
+                .filepath = filepath,
+                .line = line,
+                .fn = fn,
+                .counter = {0}
+            };
+        }
+
+        lines[j].counter.count += counter->count;
+        lines[j].counter.ticks += counter->ticks;
+    }
+
+    return lines_len;
+}
+
+void report_opcodes(FILE *stream, uint64_t total_ticks, Profiler *profiler){
+    uint8_t opcodes[PROFILER_OPCODES_LENGTH];
+
+    for (size_t i = 0; i < PROFILER_OPCODES_LENGTH; i++){
+        opcodes[i] = (uint8_t)i;
+    }
+
+    sorting_opcodes = profiler->opcodes;
+    qsort(opcodes, PROFILER_OPCODES_LENGTH, sizeof(uint8_t), compare_opcodes);
+
+    fprintf(stream, "%-12s %14s %16s %12s %8s\n", "OPCODE", "COUNT", PROFILER_TICKS_NAME, "PER OPCODE", "%");
+
+    for (size_t i = 0; i < PROFILER_OPCODES_LENGTH; i++){
+        uint8_t opcode = opcodes[i];
+        ProfileCounter *counter = &profiler->opcodes[opcode];
+
+        if(counter->count == 0){
+            continue;
+        }
+
+        fprintf(
+            stream,
+            "%-12s %14" PRIu64 " %16" PRIu64 " %12.1f %7.2f%%\n",
+            opcode_names[opcode] ? opcode_names[opcode] : "UNKNOWN",
+            counter->count,
+            counter->ticks,
+            (double)counter->ticks / (double)counter->count,
+            percent(counter->ticks, total_ticks)
+        );
+    }
+}
+
+void report_fns(FILE *stream, uint64_t total_ticks, Profiler *profiler){
+    DynArr *fn_profiles = profiler->fn_profiles;
+    size_t fn_profiles_len = dynarr_len(fn_profiles);
+    FnProfile **sorted = dynarr_get_raw(fn_profiles, 0);
+
+    if(fn_profiles_len > 0){
+        qsort(sorted, fn_profiles_len, sizeof(FnProfile *), compare_fn_profiles);
+    }
+
+    fprintf(stream, "%-24s %14s %16s %8s\n", "FUNCTION", "OPCODES", PROFILER_TICKS_NAME, "%");
+
+    for (size_t i = 0; i < fn_profiles_len; i++){
+        FnProfile *fn_profile = sorted[i];
+        ProfileCounter total = fn_profile_total(fn_profile);
+
+        fprintf(
+            stream,
+            "%-24s %14" PRIu64 " %16" PRIu64 " %7.2f%%\n",
+            fn_profile->fn->name,
+            total.count,
+            total.ticks,
+            percent(total.ticks, total_ticks)
+        );
+    }
+}
+
+void report_lines(FILE *stream, uint64_t total_ticks, Profiler *profiler){
+    const Allocator *allocator = profiler->allocator;
+    DynArr *fn_profiles = profiler->fn_profiles;
+    size_t fn_profiles_len = dynarr_len(fn_profiles);
+    size_t lines_cap = 0;
+
+    // A function has at most a line per chunk
+    for (size_t i = 0; i < fn_profiles_len; i++){
+        lines_cap += ((FnProfile *)dynarr_get_ptr(fn_profiles, i))->offsets_len;
+    }
+
+    LineProfile *lines = lines_cap == 0 ? NULL : MEMORY_ALLOC(allocator, LineProfile, lines_cap);
+    size_t lines_len = 0;
+
+    if(!lines){
+        return;
+    }
+
+    for (size_t i = 0; i < fn_profiles_len; i++){
+        lines_len += fn_lines(dynarr_get_ptr(fn_profiles, i), lines + lines_len);
+    }
+
+    qsort(lines, lines_len, sizeof(LineProfile), compare_line_profiles);
+
+    fprintf(stream, "%-40s %14s %16s %8s\n", "LINE", "OPCODES", PROFILER_TICKS_NAME, "%");
+
+    for (size_t i = 0; i < lines_len && i < REPORT_LINES_LENGTH; i++){
+        LineProfile *line = &lines[i];
+        char label[256];
+
+        if(line->filepath){
+            snprintf(label, sizeof(label), "%s:%d (%s)", line->filepath, line->line, line->fn->name);
+        }else{
+            snprintf(label, sizeof(label), "? (%s)", line->fn->name);
+        }
+
+        fprintf(
+            stream,
+            "%-40s %14" PRIu64 " %16" PRIu64 " %7.2f%%\n",
+            label,
+            line->counter.count,
+            line->counter.ticks,
+            percent(line->counter.ticks, total_ticks)
+        );
+    }
+
+    MEMORY_DEALLOC(allocator, LineProfile, lines_cap, lines);
+}
+
+void write_stacks(FILE *stream, size_t depth, const char **names, ProfileNode *node){
+    names[depth] = node->fn_profile->fn->name;
+
+    if(node->counter.ticks > 0){
+        for (size_t i = 0; i <= depth; i++){
+            fprintf(stream, i == 0 ? "%s" : ";%s", names[i]);
+        }
+
+        fprintf(stream, " %" PRIu64 "\n", node->counter.ticks);
+    }
+
+    for (ProfileNode *child = node->children; child; child = child->next){
+        write_stacks(stream, depth + 1, names, child);
+    }
+}
+//----------------------------------------------------------------//
+//                     PUBLIC IMPLEMENTATION                      //
+//----------------------------------------------------------------//
+Profiler *profiler_create(const Allocator *allocator){
+    Profiler *profiler = MEMORY_ALLOC(allocator, Profiler, 1);
+    DynArr *fn_profiles = MEMORY_DYNARR_PTR(allocator);
+    LZOHTable *fn_profiles_table = MEMORY_LZOHTABLE(allocator);
+
+    if(!profiler || !fn_profiles || !fn_profiles_table){
+        MEMORY_DEALLOC(allocator, Profiler, 1, profiler);
+        dynarr_destroy(fn_profiles);
+        LZOHTABLE_DESTROY(fn_profiles_table);
+
+        return NULL;
+    }
+
+    memset(profiler, 0, sizeof(Profiler));
+
+    profiler->fn_profiles = fn_profiles;
+    profiler->fn_profiles_table = fn_profiles_table;
+    profiler->allocator = allocator;
+
+    return profiler;
+}
+
+void profiler_destroy(Profiler *profiler){
+    if(!profiler){
+        return;
+    }
+
+    const Allocator *allocator = profiler->allocator;
+    DynArr *fn_profiles = profiler->fn_profiles;
+    size_t fn_profiles_len = dynarr_len(fn_profiles);
+
+    for (size_t i = 0; i < fn_profiles_len; i++){
+        FnProfile *fn_profile = (FnProfile *)dynarr_get_ptr(fn_profiles, i);
+
+        MEMORY_DEALLOC(allocator, ProfileCounter, fn_profile->offsets_len, fn_profile->offsets);
+        MEMORY_DEALLOC(allocator, FnProfile, 1, fn_profile);
+    }
+
+    destroy_nodes(&profiler->root, allocator);
+    dynarr_destroy(fn_profiles);
+    LZOHTABLE_DESTROY(profiler->fn_profiles_table);
+    MEMORY_DEALLOC(allocator, Profiler, 1, profiler);
+}
+
+int profiler_enter(size_t depth, const Fn *fn, Profiler *profiler){
+    ProfileNode *parent = depth == 0 ? &profiler->root : profiler->nodes[depth - 1];
+    ProfileNode *node = depth <= profiler->depth ? profiler->nodes[depth] : NULL;
+
+    // Returning to a frame finds its node as it was left
+    if(!node || node->parent != parent || node->fn_profile->fn != fn){
+        node = get_child_node(fn, parent, profiler);
+
+        if(!node){
+            return 1;
+        }
+    }
+
+    profiler->nodes[depth] = node;
+    profiler->depth = depth;
+
+    return 0;
+}
+
+OPCodeLocation *profiler_find_location(size_t offset, const DynArr *locations){
+    size_t low = 0;
+    size_t high = dynarr_len(locations);
+
+    // Not every chunk has a location: the last one before
+    // the offset is the statement the chunk belongs to
+    while (low < high){
+        size_t middle = low + (high - low) / 2;
+        OPCodeLocation *location = (OPCodeLocation *)dynarr_get_raw(locations, middle);
+
+        if(location->offset <= offset){
+            low = middle + 1;
+        }else{
+            high = middle;
+        }
+    }
+
+    return low == 0 ? NULL : (OPCodeLocation *)dynarr_get_raw(locations, low - 1);
+}
+
+void profiler_report(FILE *stream, Profiler *profiler){
+    uint64_t total_ticks = 0;
+
+    for (size_t i = 0; i < PROFILER_OPCODES_LENGTH; i++){
+        total_ticks += profiler->opcodes[i].ticks;
+    }
+
+    fprintf(stream, "\n");
+    report_opcodes(stream, total_ticks, profiler);
+    fprintf(stream, "\n");
+    report_fns(stream, total_ticks, profiler);
+    fprintf(stream, "\n");
+    report_lines(stream, total_ticks, profiler);
+}
+
+int profiler_write_stacks(const char *pathname, Profiler *profiler){
+    FILE *stream = fopen(pathname, "w");
+
+    if(!stream){
+        return 1;
+    }
+
+    const char *names[PROFILER_DEPTH_LENGTH];
+
+    for (ProfileNode *child = profiler->root.children; child; child = child->next){
+        write_stacks(stream, 0, names, child);
+    }
+
+    return fclose(stream) != 0;
+}
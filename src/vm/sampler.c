@@ -0,0 +1,275 @@
+#include "sampler.h"
+#include "profiler.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/time.h>
+
+//----------------------------------------------------------------//
+//                       PRIVATE INTERFACE                        //
+//----------------------------------------------------------------//
+// A stack key holds the function and line of each frame
+#define KEY_FRAME_LENGTH 2
+
+static Sampler *running_sampler = NULL;
+// Set while a handler is taking a sample. Signals can
+// be delivered to any thread, including the marking ones
+static char sampling = 0;
+static struct sigaction old_action;
+
+static void handle_sigprof(int signum);
+static void drain_ring(Sampler *sampler);
+static void *run_writer(void *arg);
+static void write_stack(FILE *stream, const LZOHTableSlot *slot);
+//----------------------------------------------------------------//
+//                     PRIVATE IMPLEMENTATION                     //
+//----------------------------------------------------------------//
+void handle_sigprof(int signum){
+    Sampler *sampler = __atomic_load_n(&running_sampler, __ATOMIC_ACQUIRE);
+
+    if(!sampler || __atomic_exchange_n(&sampling, 1, __ATOMIC_ACQUIRE)){
+        return;
+    }
+
+    size_t head = sampler->head;
+
+    if(head - __atomic_load_n(&sampler->tail, __ATOMIC_ACQUIRE) == SAMPLER_RING_LENGTH){
+        __atomic_add_fetch(&sampler->dropped, 1, __ATOMIC_RELAXED);
+        __atomic_store_n(&sampling, 0, __ATOMIC_RELEASE);
+
+        return;
+    }
+
+    VM *vm = sampler->vm;
+    Sample *sample = &sampler->ring[head & (SAMPLER_RING_LENGTH - 1)];
+    Frame *frame_ptr = __atomic_load_n(&vm->frame_ptr, __ATOMIC_RELAXED);
+    size_t depth = (size_t)(frame_ptr - vm->frame_stack);
+
+    if(depth > SAMPLER_DEPTH_LENGTH){
+        depth = SAMPLER_DEPTH_LENGTH;
+    }
+
+    // A frame just pushed could still miss its function
+    for (size_t i = 0; i < depth; i++){
+        Frame *frame = &vm->frame_stack[i];
+
+        sample->fns[i] = frame->fn;
+        sample->offsets[i] = (uint32_t)frame->last_offset;
+    }
+
+    sample->depth = depth;
+    sampler->taken++;
+
+    __atomic_store_n(&sampler->head, head + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&sampling, 0, __ATOMIC_RELEASE);
+}
+
+void drain_ring(Sampler *sampler){
+    uintptr_t key[SAMPLER_DEPTH_LENGTH * KEY_FRAME_LENGTH];
+    size_t tail = sampler->tail;
+    size_t head = __atomic_load_n(&sampler->head, __ATOMIC_ACQUIRE);
+
+    for (; tail < head; tail++){
+        Sample *sample = &sampler->ring[tail & (SAMPLER_RING_LENGTH - 1)];
+        size_t key_len = 0;
+
+        for (size_t i = 0; i < sample->depth; i++){
+            const Fn *fn = sample->fns[i];
+
+            if(!fn){
+                continue;
+            }
+
+            OPCodeLocation *location = profiler_find_location(sample->offsets[i], fn->locations);
+
+            key[key_len++] = (uintptr_t)fn;
+            key[key_len++] = (uintptr_t)(location ? location->line : -1);
+        }
+
+        if(key_len == 0){
+            continue;
+        }
+
+        size_t key_size = sizeof(uintptr_t) * key_len;
+        uint64_t *count = NULL;
+
+        if(lzohtable_lookup(key_size, key, sampler->stacks, (void **)(&count))){
+            (*count)++;
+            continue;
+        }
+
+        uint64_t first = 1;
+
+        if(lzohtable_put_ckv(key_size, key, sizeof(uint64_t), &first, sampler->stacks, NULL)){
+            __atomic_add_fetch(&sampler->dropped, 1, __ATOMIC_RELAXED);
+        }
+    }
+
+    __atomic_store_n(&sampler->tail, tail, __ATOMIC_RELEASE);
+}
+
+void *run_writer(void *arg){
+    Sampler *sampler = (Sampler *)arg;
+    struct timespec delay = {
+        .tv_sec = 0,
+        .tv_nsec = SAMPLER_DRAIN_MS * 1000000L
+    };
+
+    while (!__atomic_load_n(&sampler->stop, __ATOMIC_ACQUIRE)){
+        nanosleep(&delay, NULL);
+        drain_ring(sampler);
+    }
+
+    return NULL;
+}
+
+void write_stack(FILE *stream, const LZOHTableSlot *slot){
+    const uintptr_t *key = (const uintptr_t *)slot->key;
+    size_t key_len = slot->key_size / sizeof(uintptr_t);
+
+    for (size_t i = 0; i < key_len; i += KEY_FRAME_LENGTH){
+        const Fn *fn = (const Fn *)key[i];
+        int line = (int)(intptr_t)key[i + 1];
+
+        if(i > 0){
+            fputc(';', stream);
+        }
+
+        if(line < 0){
+            fprintf(stream, "%s", fn->name);
+        }else{
+            fprintf(stream, "%s:%d", fn->name, line);
+        }
+    }
+
+    fprintf(stream, " %" PRIu64 "\n", *(uint64_t *)slot->value);
+}
+//----------------------------------------------------------------//
+//                      PUBLIC IMPLEMENTATION                     //
+//----------------------------------------------------------------//
+Sampler *sampler_start(unsigned int frequency, VM *vm){
+    if(running_sampler || frequency == 0 || frequency > SAMPLER_MAX_FREQUENCY){
+        return NULL;
+    }
+
+    // The writer thread grows the table while the VM allocates,
+    // and the runtime allocator is not thread safe
+    Sampler *sampler = malloc(sizeof(Sampler));
+    LZOHTable *stacks = lzohtable_create(64, 0.8f, NULL);
+
+    if(!sampler || !stacks){
+        free(sampler);
+        LZOHTABLE_DESTROY(stacks);
+
+        return NULL;
+    }
+
+    sampler->vm = vm;
+    sampler->frequency = frequency;
+    sampler->head = 0;
+    sampler->tail = 0;
+    sampler->taken = 0;
+    sampler->dropped = 0;
+    sampler->stop = 0;
+    sampler->stacks = stacks;
+
+    sigset_t prof_set;
+    sigset_t old_set;
+
+    sigemptyset(&prof_set);
+    sigaddset(&prof_set, SIGPROF);
+
+    // The writer inherits the mask, so it never runs the handler
+    pthread_sigmask(SIG_BLOCK, &prof_set, &old_set);
+    int failed = pthread_create(&sampler->writer, NULL, run_writer, sampler);
+    pthread_sigmask(SIG_SETMASK, &old_set, NULL);
+
+    if(failed){
+        LZOHTABLE_DESTROY(stacks);
+        free(sampler);
+
+        return NULL;
+    }
+
+    struct sigaction action;
+
+    memset(&action, 0, sizeof(struct sigaction));
+    action.sa_handler = handle_sigprof;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+
+    __atomic_store_n(&running_sampler, sampler, __ATOMIC_RELEASE);
+
+    long interval_us = 1000000L / (long)frequency;
+    struct itimerval timer = {
+        .it_interval = {.tv_sec = interval_us / 1000000L, .tv_usec = interval_us % 1000000L},
+        .it_value = {.tv_sec = interval_us / 1000000L, .tv_usec = interval_us % 1000000L}
+    };
+
+    if(sigaction(SIGPROF, &action, &old_action) || setitimer(ITIMER_PROF, &timer, NULL)){
+        sampler_stop(sampler);
+        sampler_destroy(sampler);
+
+        return NULL;
+    }
+
+    return sampler;
+}
+
+void sampler_stop(Sampler *sampler){
+    if(!sampler || __atomic_load_n(&sampler->stop, __ATOMIC_ACQUIRE)){
+        return;
+    }
+
+    struct itimerval timer;
+
+    memset(&timer, 0, sizeof(struct itimerval));
+    setitimer(ITIMER_PROF, &timer, NULL);
+    sigaction(SIGPROF, &old_action, NULL);
+
+    // A handler could still be running in another thread
+    __atomic_store_n(&running_sampler, NULL, __ATOMIC_RELEASE);
+
+    while (__atomic_load_n(&sampling, __ATOMIC_ACQUIRE)){
+        sched_yield();
+    }
+
+    __atomic_store_n(&sampler->stop, 1, __ATOMIC_RELEASE);
+    pthread_join(sampler->writer, NULL);
+
+    drain_ring(sampler);
+}
+
+int sampler_write_stacks(const char *pathname, Sampler *sampler){
+    FILE *stream = fopen(pathname, "w");
+
+    if(!stream){
+        return 1;
+    }
+
+    LZOHTable *stacks = sampler->stacks;
+
+    for (size_t i = 0; i < stacks->m; i++){
+        LZOHTableSlot *slot = &stacks->slots[i];
+
+        if(slot->used){
+            write_stack(stream, slot);
+        }
+    }
+
+    return fclose(stream) != 0;
+}
+
+void sampler_destroy(Sampler *sampler){
+    if(!sampler){
+        return;
+    }
+
+    sampler_stop(sampler);
+    LZOHTABLE_DESTROY(sampler->stacks);
+    free(sampler);
+}
@@ -0,0 +1,145 @@
+#include "shape.h"
+
+#include <string.h>
+
+//----------------------------------------------------------------//
+//                       PRIVATE INTERFACE                        //
+//----------------------------------------------------------------//
+#define TRANSITIONS_LENGTH 16
+
+static Shape *create_shape(size_t len, const Allocator *allocator);
+static void destroy_shape(Shape *shape);
+//----------------------------------------------------------------//
+//                     PRIVATE IMPLEMENTATION                     //
+//----------------------------------------------------------------//
+Shape *create_shape(size_t len, const Allocator *allocator){
+    char **keys = len == 0 ? NULL : MEMORY_ALLOC(allocator, char *, len);
+    LZOHTable *offsets = MEMORY_LZOHTABLE(allocator);
+    LZOHTable *transitions = MEMORY_LZOHTABLE_LEN(allocator, TRANSITIONS_LENGTH);
+    Shape *shape = MEMORY_ALLOC(allocator, Shape, 1);
+
+    if((len > 0 && !keys) || !offsets || !transitions || !shape){
+        MEMORY_DEALLOC(allocator, char *, len, keys);
+        LZOHTABLE_DESTROY(offsets);
+        LZOHTABLE_DESTROY(transitions);
+        MEMORY_DEALLOC(allocator, Shape, 1, shape);
+
+        return NULL;
+    }
+
+    *shape = (Shape){
+        .len = len,
+        .keys = keys,
+        .offsets = offsets,
+        .transitions = transitions,
+        .allocator = allocator
+    };
+
+    return shape;
+}
+
+// Only destroys what 'shape' owns
+void destroy_shape(Shape *shape){
+    const Allocator *allocator = shape->allocator;
+    size_t len = shape->len;
+
+    if(len > 0){
+        memory_destroy_cstr(allocator, shape->keys[len - 1]);
+    }
+
+    MEMORY_DEALLOC(allocator, char *, len, shape->keys);
+    LZOHTABLE_DESTROY(shape->offsets);
+    LZOHTABLE_DESTROY(shape->transitions);
+    MEMORY_DEALLOC(allocator, Shape, 1, shape);
+}
+//----------------------------------------------------------------//
+//                      PUBLIC IMPLEMENTATION                     //
+//----------------------------------------------------------------//
+Shape *shape_create(const Allocator *allocator){
+    return create_shape(0, allocator);
+}
+
+void shape_destroy(Shape *shape){
+    if(!shape){
+        return;
+    }
+
+    LZOHTable *transitions = shape->transitions;
+
+    for (size_t i = 0; i < transitions->m; i++){
+        LZOHTableSlot *slot = &transitions->slots[i];
+
+        if(slot->used){
+            shape_destroy((Shape *)slot->value);
+        }
+    }
+
+    destroy_shape(shape);
+}
+
+Shape *shape_transition(size_t key_size, const char *key, Shape *shape){
+    Shape *next_shape = NULL;
+
+    if(lzohtable_lookup(key_size, key, shape->transitions, (void **)(&next_shape))){
+        return next_shape;
+    }
+
+    const Allocator *allocator = shape->allocator;
+    size_t len = shape->len + 1;
+    char *cloned_key = MEMORY_ALLOC(allocator, char, key_size + 1);
+
+    if(!cloned_key){
+        return NULL;
+    }
+
+    memcpy(cloned_key, key, key_size);
+    cloned_key[key_size] = '\0';
+
+    next_shape = create_shape(len, allocator);
+
+    if(!next_shape){
+        MEMORY_DEALLOC(allocator, char, key_size + 1, cloned_key);
+        return NULL;
+    }
+
+    if(shape->len > 0){
+        memcpy(next_shape->keys, shape->keys, sizeof(char *) * shape->len);
+    }
+
+    next_shape->keys[len - 1] = cloned_key;
+
+    for (size_t offset = 0; offset < len; offset++){
+        char *offset_key = next_shape->keys[offset];
+
+        if(lzohtable_put_ckv(
+            strlen(offset_key),
+            offset_key,
+            sizeof(size_t),
+            &offset,
+            next_shape->offsets,
+            NULL
+        )){
+            destroy_shape(next_shape);
+            return NULL;
+        }
+    }
+
+    if(lzohtable_put_ck(key_size, key, next_shape, shape->transitions, NULL)){
+        destroy_shape(next_shape);
+        return NULL;
+    }
+
+    return next_shape;
+}
+
+int shape_find(size_t key_size, const char *key, const Shape *shape, size_t *out_offset){
+    size_t *offset = NULL;
+
+    if(!lzohtable_lookup(key_size, key, shape->offsets, (void **)(&offset))){
+        return 1;
+    }
+
+    *out_offset = *offset;
+
+    return 0;
+}
@@ -0,0 +1,556 @@
+#include "verifier.h"
+#include "opcode.h"
+#include "module.h"
+
+#include <stdint.h>
+
+//----------------------------------------------------------------//
+//                       PRIVATE INTERFACE                        //
+//----------------------------------------------------------------//
+#define UNVISITED_HEIGHT -1
+#define OPERAND_HEIGHT   -2
+
+typedef enum operand_type{
+    NONE_OPERAND_TYPE,
+    BYTE_OPERAND_TYPE,
+    LOCAL_OPERAND_TYPE,
+    JUMP_OPERAND_TYPE,
+    ICONST_OPERAND_TYPE,
+    FCONST_OPERAND_TYPE,
+    STR_OPERAND_TYPE,
+    GLOBAL_OPERAND_TYPE,
+    GLOBAL_ACCESS_OPERAND_TYPE,
+    I16_OPERAND_TYPE,
+    I32_OPERAND_TYPE,
+    // Static string followed by an access cache index
+    STR_CACHE_OPERAND_TYPE,
+    // Arguments count, static string and access cache index
+    INVOKE_OPERAND_TYPE,
+    // Two local indexes
+    LOCALS_OPERAND_TYPE,
+    // Two local indexes followed by a jump
+    LOCALS_JUMP_OPERAND_TYPE,
+    // Local index followed by a jump
+    LOCAL_JUMP_OPERAND_TYPE,
+    // Destination and source registers
+    REGISTERS2_OPERAND_TYPE,
+    // Destination register and an integer of 1 byte
+    REGISTER_BYTE_OPERAND_TYPE,
+    // Destination register and a constant index
+    REGISTER_ICONST_OPERAND_TYPE,
+    REGISTER_FCONST_OPERAND_TYPE,
+    // Destination and two source registers
+    REGISTERS3_OPERAND_TYPE,
+    // Destination, source register and an integer of 1 byte
+    REGISTERS2_BYTE_OPERAND_TYPE,
+    // Two source registers followed by a jump
+    REGISTERS_JUMP_OPERAND_TYPE,
+}OperandType;
+
+// How an opcode is encoded and how it changes the stack. Opcodes
+// that pop a variable count of values are handled apart
+typedef struct opcode_info{
+    char valid;
+    OperandType operand;
+    uint8_t pops;
+    uint8_t pushes;
+}OPCodeInfo;
+
+#define INFO(_operand, _pops, _pushes){1, (_operand), (_pops), (_pushes)}
+
+static const OPCodeInfo opcodes_info[256] = {
+    [OP_EMPTY] = INFO(NONE_OPERAND_TYPE, 0, 1),
+    [OP_FALSE] = INFO(NONE_OPERAND_TYPE, 0, 1),
+    [OP_TRUE] = INFO(NONE_OPERAND_TYPE, 0, 1),
+    [OP_CINT] = INFO(BYTE_OPERAND_TYPE, 0, 1),
+    [OP_INT] = INFO(ICONST_OPERAND_TYPE, 0, 1),
+    [OP_FLOAT] = INFO(FCONST_OPERAND_TYPE, 0, 1),
+    [OP_STRING] = INFO(STR_OPERAND_TYPE, 0, 1),
+    [OP_STTE] = INFO(NONE_OPERAND_TYPE, 0, 0),
+    [OP_ETTE] = INFO(NONE_OPERAND_TYPE, 0, 1),
+    [OP_ARRAY] = INFO(NONE_OPERAND_TYPE, 1, 1),
+    [OP_LIST] = INFO(NONE_OPERAND_TYPE, 0, 1),
+    [OP_DICT] = INFO(NONE_OPERAND_TYPE, 0, 1),
+    [OP_RECORD] = INFO(I16_OPERAND_TYPE, 0, 1),
+    [OP_WTTE] = INFO(NONE_OPERAND_TYPE, 1, 0),
+    [OP_IARRAY] = INFO(I16_OPERAND_TYPE, 2, 1),
+    [OP_ILIST] = INFO(NONE_OPERAND_TYPE, 2, 1),
+    [OP_IDICT] = INFO(NONE_OPERAND_TYPE, 3, 1),
+    [OP_IRECORD] = INFO(STR_CACHE_OPERAND_TYPE, 2, 1),
+    [OP_CONCAT] = INFO(NONE_OPERAND_TYPE, 2, 1),
+    [OP_MULSTR] = INFO(NONE_OPERAND_TYPE, 2, 1),
+    [OP_ADD] = INFO(NONE_OPERAND_TYPE, 2, 1),
+    [OP_SUB] = INFO(NONE_OPERAND_TYPE, 2, 1),
+    [OP_MUL] = INFO(NONE_OPERAND_TYPE, 2, 1),
+    [OP_DIV] = INFO(NONE_OPERAND_TYPE, 2, 1),
+    [OP_MOD] = INFO(NONE_OPERAND_TYPE, 2, 1),
+    [OP_BNOT] = INFO(NONE_OPERAND_TYPE, 1, 1),
+    [OP_LSH] = INFO(NONE_OPERAND_TYPE, 2, 1),
+    [OP_RSH] = INFO(NONE_OPERAND_TYPE, 2, 1),
+    [OP_BAND] = INFO(NONE_OPERAND_TYPE, 2, 1),
+    [OP_BXOR] = INFO(NONE_OPERAND_TYPE, 2, 1),
+    [OP_BOR] = INFO(NONE_OPERAND_TYPE, 2, 1),
+    [OP_LT] = INFO(NONE_OPERAND_TYPE, 2, 1),
+    [OP_GT] = INFO(NONE_OPERAND_TYPE, 2, 1),
+    [OP_LE] = INFO(NONE_OPERAND_TYPE, 2, 1),
+    [OP_GE] = INFO(NONE_OPERAND_TYPE, 2, 1),
+    [OP_EQ] = INFO(NONE_OPERAND_TYPE, 2, 1),
+    [OP_NE] = INFO(NONE_OPERAND_TYPE, 2, 1),
+    // The value stays when jumping, and is popped otherwise
+    [OP_OR] = INFO(JUMP_OPERAND_TYPE, 1, 1),
+    [OP_AND] = INFO(JUMP_OPERAND_TYPE, 1, 1),
+    [OP_NOT] = INFO(NONE_OPERAND_TYPE, 1, 1),
+    [OP_NNOT] = INFO(NONE_OPERAND_TYPE, 1, 1),
+    [OP_LSET] = INFO(LOCAL_OPERAND_TYPE, 1, 1),
+    [OP_LGET] = INFO(LOCAL_OPERAND_TYPE, 0, 1),
+    [OP_OSET] = INFO(BYTE_OPERAND_TYPE, 1, 1),
+    [OP_OGET] = INFO(BYTE_OPERAND_TYPE, 0, 1),
+    [OP_GDEF] = INFO(GLOBAL_OPERAND_TYPE, 1, 0),
+    [OP_GASET] = INFO(GLOBAL_ACCESS_OPERAND_TYPE, 0, 0),
+    [OP_GSET] = INFO(GLOBAL_OPERAND_TYPE, 1, 1),
+    [OP_GGET] = INFO(GLOBAL_OPERAND_TYPE, 0, 1),
+    [OP_NGET] = INFO(STR_OPERAND_TYPE, 0, 1),
+    [OP_SGET] = INFO(I32_OPERAND_TYPE, 0, 1),
+    [OP_ASET] = INFO(NONE_OPERAND_TYPE, 3, 1),
+    [OP_RSET] = INFO(STR_CACHE_OPERAND_TYPE, 2, 1),
+    [OP_POP] = INFO(NONE_OPERAND_TYPE, 1, 0),
+    [OP_JMP] = INFO(JUMP_OPERAND_TYPE, 0, 0),
+    [OP_JIF] = INFO(JUMP_OPERAND_TYPE, 1, 0),
+    [OP_JIT] = INFO(JUMP_OPERAND_TYPE, 1, 0),
+    // Pops the callable and its arguments, pushes the result
+    [OP_CALL] = INFO(BYTE_OPERAND_TYPE, 1, 1),
+    // Pops the callable and its arguments. Like OP_RET, nothing follows it
+    [OP_TCALL] = INFO(BYTE_OPERAND_TYPE, 1, 0),
+    [OP_ACCESS] = INFO(STR_CACHE_OPERAND_TYPE, 1, 1),
+    // Pops the target and the arguments, pushes the result
+    [OP_INVOKE] = INFO(INVOKE_OPERAND_TYPE, 1, 1),
+    [OP_INDEX] = INFO(NONE_OPERAND_TYPE, 2, 1),
+    [OP_RET] = INFO(NONE_OPERAND_TYPE, 1, 0),
+    [OP_IS] = INFO(BYTE_OPERAND_TYPE, 1, 1),
+    // Its operand is the offset of the catch block
+    [OP_TRYO] = INFO(I16_OPERAND_TYPE, 0, 0),
+    [OP_TRYC] = INFO(NONE_OPERAND_TYPE, 0, 0),
+    // Pops the thrown value only if its operand is set
+    [OP_THROW] = INFO(BYTE_OPERAND_TYPE, 0, 0),
+    // Pops the yielded value, pushes the one the coroutine is resumed with
+    [OP_YIELD] = INFO(NONE_OPERAND_TYPE, 1, 1),
+    // Uses the local of its operand and the two after it
+    [OP_NEXT] = INFO(LOCAL_JUMP_OPERAND_TYPE, 0, 0),
+    [OP_HLT] = INFO(NONE_OPERAND_TYPE, 0, 0),
+    [OP_INCL] = INFO(LOCAL_OPERAND_TYPE, 0, 0),
+    [OP_LGET2] = INFO(LOCALS_OPERAND_TYPE, 0, 2),
+    [OP_LT_LL_JIF] = INFO(LOCALS_JUMP_OPERAND_TYPE, 0, 0),
+    [OP_GE_LL_JIT] = INFO(LOCALS_JUMP_OPERAND_TYPE, 0, 0),
+    [OP_RMOV] = INFO(REGISTERS2_OPERAND_TYPE, 0, 0),
+    [OP_RCINT] = INFO(REGISTER_BYTE_OPERAND_TYPE, 0, 0),
+    [OP_RINT] = INFO(REGISTER_ICONST_OPERAND_TYPE, 0, 0),
+    [OP_RFLOAT] = INFO(REGISTER_FCONST_OPERAND_TYPE, 0, 0),
+    [OP_RADD] = INFO(REGISTERS3_OPERAND_TYPE, 0, 0),
+    [OP_RSUB] = INFO(REGISTERS3_OPERAND_TYPE, 0, 0),
+    [OP_RMUL] = INFO(REGISTERS3_OPERAND_TYPE, 0, 0),
+    [OP_RDIV] = INFO(REGISTERS3_OPERAND_TYPE, 0, 0),
+    [OP_RMOD] = INFO(REGISTERS3_OPERAND_TYPE, 0, 0),
+    [OP_RADDK] = INFO(REGISTERS2_BYTE_OPERAND_TYPE, 0, 0),
+    [OP_RSUBK] = INFO(REGISTERS2_BYTE_OPERAND_TYPE, 0, 0),
+    [OP_RJNLT] = INFO(REGISTERS_JUMP_OPERAND_TYPE, 0, 0),
+    [OP_RJNGT] = INFO(REGISTERS_JUMP_OPERAND_TYPE, 0, 0),
+    [OP_RJNLE] = INFO(REGISTERS_JUMP_OPERAND_TYPE, 0, 0),
+    [OP_RJNGE] = INFO(REGISTERS_JUMP_OPERAND_TYPE, 0, 0),
+    [OP_ADD_II] = INFO(NONE_OPERAND_TYPE, 2, 1),
+    [OP_ADD_FF] = INFO(NONE_OPERAND_TYPE, 2, 1),
+    [OP_SUB_II] = INFO(NONE_OPERAND_TYPE, 2, 1),
+    [OP_SUB_FF] = INFO(NONE_OPERAND_TYPE, 2, 1),
+    [OP_MUL_II] = INFO(NONE_OPERAND_TYPE, 2, 1),
+    [OP_MUL_FF] = INFO(NONE_OPERAND_TYPE, 2, 1),
+    [OP_LT_II] = INFO(NONE_OPERAND_TYPE, 2, 1),
+    [OP_LT_FF] = INFO(NONE_OPERAND_TYPE, 2, 1),
+    [OP_GT_II] = INFO(NONE_OPERAND_TYPE, 2, 1),
+    [OP_GT_FF] = INFO(NONE_OPERAND_TYPE, 2, 1),
+    [OP_LE_II] = INFO(NONE_OPERAND_TYPE, 2, 1),
+    [OP_LE_FF] = INFO(NONE_OPERAND_TYPE, 2, 1),
+    [OP_GE_II] = INFO(NONE_OPERAND_TYPE, 2, 1),
+    [OP_GE_FF] = INFO(NONE_OPERAND_TYPE, 2, 1),
+};
+
+static const size_t operands_len[] = {
+    [NONE_OPERAND_TYPE] = 0,
+    [BYTE_OPERAND_TYPE] = 1,
+    [LOCAL_OPERAND_TYPE] = 1,
+    [JUMP_OPERAND_TYPE] = 2,
+    [ICONST_OPERAND_TYPE] = 2,
+    [FCONST_OPERAND_TYPE] = 2,
+    [STR_OPERAND_TYPE] = 2,
+    [GLOBAL_OPERAND_TYPE] = 2,
+    [GLOBAL_ACCESS_OPERAND_TYPE] = 3,
+    [I16_OPERAND_TYPE] = 2,
+    [I32_OPERAND_TYPE] = 4,
+    [STR_CACHE_OPERAND_TYPE] = 4,
+    [INVOKE_OPERAND_TYPE] = 5,
+    [LOCALS_OPERAND_TYPE] = 2,
+    [LOCALS_JUMP_OPERAND_TYPE] = 4,
+    [LOCAL_JUMP_OPERAND_TYPE] = 3,
+    [REGISTERS2_OPERAND_TYPE] = 2,
+    [REGISTER_BYTE_OPERAND_TYPE] = 2,
+    [REGISTER_ICONST_OPERAND_TYPE] = 3,
+    [REGISTER_FCONST_OPERAND_TYPE] = 3,
+    [REGISTERS3_OPERAND_TYPE] = 3,
+    [REGISTERS2_BYTE_OPERAND_TYPE] = 3,
+    [REGISTERS_JUMP_OPERAND_TYPE] = 4,
+};
+
+typedef struct verifier{
+    size_t chunks_len;
+    const uint8_t *chunks;
+    // Stack height before each instruction, UNVISITED_HEIGHT
+    // if not reached yet or OPERAND_HEIGHT for operand bytes
+    int32_t *heights;
+    // Offsets of the instructions whose successors are not visited yet
+    size_t worklist_len;
+    size_t *worklist;
+    size_t stack_len;
+    const Fn *fn;
+    VerifierError *error;
+}Verifier;
+
+static int fail(size_t offset, const char *msg, Verifier *verifier);
+static int16_t read_i16(size_t offset, const Verifier *verifier);
+static int decode(Verifier *verifier);
+static int visit(size_t offset, int32_t height, Verifier *verifier);
+static void use_registers(size_t offset, size_t count, Verifier *verifier);
+static int check_operand(size_t offset, int32_t height, const OPCodeInfo *info, Verifier *verifier);
+static int flow(size_t offset, Verifier *verifier);
+//----------------------------------------------------------------//
+//                     PRIVATE IMPLEMENTATION                     //
+//----------------------------------------------------------------//
+int fail(size_t offset, const char *msg, Verifier *verifier){
+    verifier->error->offset = offset;
+    verifier->error->msg = msg;
+
+    return 1;
+}
+
+int16_t read_i16(size_t offset, const Verifier *verifier){
+    const uint8_t *chunks = verifier->chunks;
+    return (int16_t)(((uint16_t)chunks[offset] << 8) | (uint16_t)chunks[offset + 1]);
+}
+
+// Every instruction, reachable or not, must be a known opcode
+// with its operands inside the chunks
+int decode(Verifier *verifier){
+    size_t chunks_len = verifier->chunks_len;
+    const uint8_t *chunks = verifier->chunks;
+
+    for (size_t offset = 0; offset < chunks_len; offset++){
+        verifier->heights[offset] = OPERAND_HEIGHT;
+    }
+
+    for (size_t offset = 0; offset < chunks_len;){
+        const OPCodeInfo *info = &opcodes_info[chunks[offset]];
+
+        if(!info->valid){
+            return fail(offset, "unknown opcode", verifier);
+        }
+
+        size_t len = 1 + operands_len[info->operand];
+
+        if(offset + len > chunks_len){
+            return fail(offset, "operands past the end of the function", verifier);
+        }
+
+        verifier->heights[offset] = UNVISITED_HEIGHT;
+        offset += len;
+    }
+
+    return 0;
+}
+
+int visit(size_t offset, int32_t height, Verifier *verifier){
+    if(offset >= verifier->chunks_len){
+        return fail(offset, "execution past the end of the function", verifier);
+    }
+
+    int32_t old_height = verifier->heights[offset];
+
+    if(old_height == OPERAND_HEIGHT){
+        return fail(offset, "jump into the operands of an instruction", verifier);
+    }
+
+    if(old_height == UNVISITED_HEIGHT){
+        verifier->heights[offset] = height;
+        verifier->worklist[verifier->worklist_len++] = offset;
+
+        return 0;
+    }
+
+    if(old_height == height){
+        return 0;
+    }
+
+    return fail(offset, "paths reach the instruction with different stack heights", verifier);
+}
+
+// Registers past the stack top are temporaries: the
+// function needs stack for them, but they are not pushed
+void use_registers(size_t offset, size_t count, Verifier *verifier){
+    for (size_t i = 0; i < count; i++){
+        size_t len = (size_t)verifier->chunks[offset + 1 + i] + 1;
+
+        if(len > verifier->stack_len){
+            verifier->stack_len = len;
+        }
+    }
+}
+
+int check_operand(size_t offset, int32_t height, const OPCodeInfo *info, Verifier *verifier){
+    const Fn *fn = verifier->fn;
+    const uint8_t *chunks = verifier->chunks;
+
+    switch (info->operand){
+        case LOCAL_OPERAND_TYPE:{
+            if((int32_t)chunks[offset + 1] >= height){
+                return fail(offset, "local index past the stack top", verifier);
+            }
+
+            return 0;
+        }case LOCALS_OPERAND_TYPE:{
+            // The second local is read after the first is pushed
+            if((int32_t)chunks[offset + 1] >= height || (int32_t)chunks[offset + 2] > height){
+                return fail(offset, "local index past the stack top", verifier);
+            }
+
+            return 0;
+        }case LOCALS_JUMP_OPERAND_TYPE:{
+            if((int32_t)chunks[offset + 1] >= height || (int32_t)chunks[offset + 2] >= height){
+                return fail(offset, "local index past the stack top", verifier);
+            }
+
+            return 0;
+        }case LOCAL_JUMP_OPERAND_TYPE:{
+            if((int32_t)chunks[offset + 1] + 2 >= height){
+                return fail(offset, "local index past the stack top", verifier);
+            }
+
+            return 0;
+        }case REGISTERS2_OPERAND_TYPE:{
+            // Temporaries could hold stale values: only locals can be copied
+            if((int32_t)chunks[offset + 2] >= height){
+                return fail(offset, "copy from a register past the stack top", verifier);
+            }
+
+            use_registers(offset, 1, verifier);
+
+            return 0;
+        }case REGISTER_BYTE_OPERAND_TYPE:{
+            use_registers(offset, 1, verifier);
+            return 0;
+        }case REGISTER_ICONST_OPERAND_TYPE:{
+            size_t idx = (size_t)read_i16(offset + 2, verifier);
+
+            if(idx >= dynarr_len(fn->iconsts)){
+                return fail(offset, "integer constant index out of bounds", verifier);
+            }
+
+            use_registers(offset, 1, verifier);
+
+            return 0;
+        }case REGISTER_FCONST_OPERAND_TYPE:{
+            size_t idx = (size_t)read_i16(offset + 2, verifier);
+
+            if(idx >= dynarr_len(fn->fconsts)){
+                return fail(offset, "float constant index out of bounds", verifier);
+            }
+
+            use_registers(offset, 1, verifier);
+
+            return 0;
+        }case REGISTERS3_OPERAND_TYPE:{
+            use_registers(offset, 3, verifier);
+            return 0;
+        }case REGISTERS2_BYTE_OPERAND_TYPE:
+         case REGISTERS_JUMP_OPERAND_TYPE:{
+            use_registers(offset, 2, verifier);
+            return 0;
+        }case ICONST_OPERAND_TYPE:{
+            size_t idx = (size_t)read_i16(offset + 1, verifier);
+
+            if(idx >= dynarr_len(fn->iconsts)){
+                return fail(offset, "integer constant index out of bounds", verifier);
+            }
+
+            return 0;
+        }case FCONST_OPERAND_TYPE:{
+            size_t idx = (size_t)read_i16(offset + 1, verifier);
+
+            if(idx >= dynarr_len(fn->fconsts)){
+                return fail(offset, "float constant index out of bounds", verifier);
+            }
+
+            return 0;
+        }case STR_OPERAND_TYPE:{
+            size_t idx = (size_t)read_i16(offset + 1, verifier);
+
+            if(idx >= dynarr_len(MODULE_STRINGS(fn->module))){
+                return fail(offset, "static string index out of bounds", verifier);
+            }
+
+            return 0;
+        }case STR_CACHE_OPERAND_TYPE:
+         case INVOKE_OPERAND_TYPE:{
+            size_t str_offset = info->operand == INVOKE_OPERAND_TYPE ? offset + 2 : offset + 1;
+            size_t idx = (size_t)read_i16(str_offset, verifier);
+
+            if(idx >= dynarr_len(MODULE_STRINGS(fn->module))){
+                return fail(offset, "static string index out of bounds", verifier);
+            }
+
+            idx = (size_t)read_i16(str_offset + 2, verifier);
+
+            if(idx >= dynarr_len(fn->caches)){
+                return fail(offset, "access cache index out of bounds", verifier);
+            }
+
+            return 0;
+        }case GLOBAL_OPERAND_TYPE:
+         case GLOBAL_ACCESS_OPERAND_TYPE:{
+            size_t idx = (size_t)read_i16(offset + 1, verifier);
+
+            if(idx >= dynarr_len(MODULE_GLOBAL_SLOTS(fn->module))){
+                return fail(offset, "global slot index out of bounds", verifier);
+            }
+
+            return 0;
+        }default:{
+            return 0;
+        }
+    }
+}
+
+int flow(size_t offset, Verifier *verifier){
+    const uint8_t *chunks = verifier->chunks;
+    uint8_t opcode = chunks[offset];
+    const OPCodeInfo *info = &opcodes_info[opcode];
+    int32_t height = verifier->heights[offset];
+    int32_t pops = info->pops;
+    int32_t pushes = info->pushes;
+    size_t next = offset + 1 + operands_len[info->operand];
+
+    if(opcode == OP_CALL || opcode == OP_TCALL || opcode == OP_INVOKE){
+        pops += chunks[offset + 1];
+    }else if(opcode == OP_THROW){
+        pops = chunks[offset + 1] ? 1 : 0;
+    }
+
+    if(height < pops){
+        return fail(offset, "stack underflow", verifier);
+    }
+
+    if(check_operand(offset, height, info, verifier)){
+        return 1;
+    }
+
+    int32_t new_height = height - pops + pushes;
+
+    if((size_t)new_height > verifier->stack_len){
+        verifier->stack_len = (size_t)new_height;
+    }
+
+    switch (opcode){
+        case OP_JMP:{
+            return visit(next + read_i16(offset + 1, verifier), height, verifier);
+        }case OP_JIF:
+         case OP_JIT:{
+            return visit(next + read_i16(offset + 1, verifier), new_height, verifier) ||
+                   visit(next, new_height, verifier);
+        }case OP_LT_LL_JIF:
+         case OP_GE_LL_JIT:
+         case OP_RJNLT:
+         case OP_RJNGT:
+         case OP_RJNLE:
+         case OP_RJNGE:{
+            return visit(next + read_i16(offset + 3, verifier), height, verifier) ||
+                   visit(next, height, verifier);
+        }case OP_NEXT:{
+            return visit(next + read_i16(offset + 2, verifier), height, verifier) ||
+                   visit(next, height, verifier);
+        }case OP_OR:
+         case OP_AND:{
+            return visit(next + read_i16(offset + 1, verifier), height, verifier) ||
+                   visit(next, height - 1, verifier);
+        }case OP_TRYO:{
+            // Throws restore the stack as it is here, plus the thrown value
+            size_t catch_offset = (size_t)read_i16(offset + 1, verifier);
+
+            if((size_t)height + 1 > verifier->stack_len){
+                verifier->stack_len = (size_t)height + 1;
+            }
+
+            return visit(catch_offset, height + 1, verifier) ||
+                   visit(next, new_height, verifier);
+        }case OP_TCALL:
+         case OP_RET:
+         case OP_THROW:
+         case OP_HLT:{
+            return 0;
+        }default:{
+            return visit(next, new_height, verifier);
+        }
+    }
+}
+//----------------------------------------------------------------//
+//                      PUBLIC IMPLEMENTATION                     //
+//----------------------------------------------------------------//
+size_t verifier_instruction_len(uint8_t opcode){
+    const OPCodeInfo *info = &opcodes_info[opcode];
+    return info->valid ? 1 + operands_len[info->operand] : 0;
+}
+
+int verifier_verify(const Allocator *allocator, Fn *fn, VerifierError *error){
+    size_t chunks_len = dynarr_len(fn->chunks);
+
+    if(chunks_len == 0){
+        error->offset = 0;
+        error->msg = "function without instructions";
+
+        return 1;
+    }
+
+    int32_t *heights = MEMORY_ALLOC(allocator, int32_t, chunks_len);
+    size_t *worklist = MEMORY_ALLOC(allocator, size_t, chunks_len);
+
+    if(!heights || !worklist){
+        MEMORY_DEALLOC(allocator, int32_t, chunks_len, heights);
+        MEMORY_DEALLOC(allocator, size_t, chunks_len, worklist);
+
+        error->offset = 0;
+        error->msg = "out of memory";
+
+        return 1;
+    }
+
+    Verifier verifier = {
+        .chunks_len = chunks_len,
+        .chunks = dynarr_get_raw(fn->chunks, 0),
+        .heights = heights,
+        .worklist_len = 0,
+        .worklist = worklist,
+        .stack_len = fn->arity,
+        .fn = fn,
+        .error = error
+    };
+
+    // Arguments are the first values of the stack of a function
+    int failed = decode(&verifier) || visit(0, fn->arity, &verifier);
+
+    while (!failed && verifier.worklist_len > 0){
+        failed = flow(worklist[--verifier.worklist_len], &verifier);
+    }
+
+    if(!failed){
+        fn->stack_len = verifier.stack_len;
+    }
+
+    MEMORY_DEALLOC(allocator, int32_t, chunks_len, heights);
+    MEMORY_DEALLOC(allocator, size_t, chunks_len, worklist);
+
+    return failed;
+}
@@ -2,6 +2,7 @@
 #include "module.h"
 #include "native/native.h"
 #include "native/native_nbarray.h"
+#include "native/native_parallel.h"
 #include "obj.h"
 #include "vmu.h"
 #include "opcode.h"
@@ -9,6 +10,7 @@
 #include "value.h"
 #include "utils.h"
 #include "types_utils.h"
+#include "jit.h"
 
 #include "native_module/native_module_str.h"
 #include "native_module/native_module_array.h"
@@ -17,9 +19,17 @@
 
 #include <stdio.h>
 #include <stdarg.h>
+#include <string.h>
 #include <assert.h>
 #include <setjmp.h>
 
+#ifdef __linux__
+    #include <unistd.h>
+    #include <sys/mman.h>
+#else
+    #include <stdlib.h>
+#endif
+
 static inline uint64_t next_pow2m1(uint64_t x) {
     x |= x >> 1;
 	x |= x >> 2;
@@ -42,24 +52,72 @@ static inline size_t min(size_t a, size_t b){
     return ((((size_t) 0) - (a <= b)) & a) | ((((size_t) 0) - (a > b)) & b);
 }
 
-void *vm_alloc(size_t size, void * ctx){
-    VM *vm = (VM *)ctx;
-    Allocator *allocator = vm->allocator;
-    size_t mem_use = vm->mem_use;
+#define INCREMENTAL_GC(_vm)((_vm)->gc_step_objs || (_vm)->gc_step_us)
+
+static inline void mark_step(VM *vm){
+    // Once everything is marked, the cycle is finished between
+    // instructions, where the roots can be scanned again (see VM_NEXT)
+    if(vmu_gc_step(vm)){
+        vm->gc_request = 1;
+    }
+}
+
+// Tells if the last major collection, once swept, left the heap too
+// full. If so, the limit grows instead of collecting again
+static inline int grow_limit(size_t size, VM *vm){
     size_t mem_use_limit = vm->mem_use_limit;
-    size_t new_mem_use = mem_use + size;
+    size_t live_mem = vm->gc_mem_use - vm->gc_freed_mem;
 
-    if(new_mem_use >= mem_use_limit){
-        vmu_gc(vm);
+    if(live_mem < mem_use_limit / GROW_ALLOCATE_LIMIT_FACTOR){
+        return 0;
+    }
+
+    vm->mem_use_limit = max(
+        mem_use_limit * GROW_ALLOCATE_LIMIT_FACTOR,
+        next_pow2(vm->mem_use + size)
+    );
+
+    return 1;
+}
+
+// Called when allocating 'size' bytes passes the limit
+static inline void reach_limit(size_t size, VM *vm){
+    if(vm->gc_phase == SWEEP_GC_PHASE){
+        // Garbage of the last collection goes first, a subpool
+        // each time, so the sweep is spread among allocations
+        if(vmu_gc_sweep_step(vm)){
+            return;
+        }
 
-        new_mem_use = vm->mem_use;
-        size_t freeded_mem = mem_use - new_mem_use;
+        vm->gc_phase = IDLE_GC_PHASE;
 
-        if(freeded_mem < size){
-            vm->mem_use_limit = next_pow2(mem_use_limit + size);
+        if(grow_limit(size, vm)){
+            return;
         }
     }
 
+    if(INCREMENTAL_GC(vm)){
+        vmu_gc_start(vm);
+    }else{
+        vmu_gc(vm);
+    }
+}
+
+static inline void grow_nursery(size_t size, VM *vm){
+    vm->nursery_mem_use += size;
+
+    // Minor collections wait while a major one is marking
+    if(vm->nursery_mem_use >= NURSERY_SIZE && vm->gc_phase != MARK_GC_PHASE){
+        vm->gc_request = 1;
+    }
+}
+
+void *vm_alloc(size_t size, void * ctx){
+    VM *vm = (VM *)ctx;
+    Allocator *allocator = vm->allocator;
+
+    vm_charge(size, vm);
+
     void *ptr = MEMORY_ALLOC(allocator, char, size);
 
     if(!ptr){
@@ -70,8 +128,6 @@ void *vm_alloc(size_t size, void * ctx){
         );
     }
 
-    vm->mem_use = new_mem_use;
-
     return ptr;
 }
 
@@ -84,19 +140,20 @@ void *vm_realloc(void *ptr, size_t old_size, size_t new_size, void *ctx){
     size_t size = max(old_size, new_size) - min(old_size, new_size);
     size_t new_mem_use = new_size == 0 ? mem_use - size : mem_use + size;
 
-    if(new_mem_use > mem_use_limit){
-        vmu_gc(vm);
-
-        new_mem_use = vm->mem_use;
-        size_t freeded_mem = mem_use - new_mem_use;
-
-        if(freeded_mem < size){
-            vm->mem_use_limit = next_pow2(mem_use_limit + size);
-        }
+    if(vm->gc_phase == MARK_GC_PHASE){
+        mark_step(vm);
+    }else if(new_mem_use > mem_use_limit){
+        reach_limit(size, vm);
+        // Sweeping could have freed memory
+        new_mem_use = new_size == 0 ? vm->mem_use - size : vm->mem_use + size;
     }
 
     void *new_ptr = MEMORY_REALLOC(allocator, char, old_size, new_size, ptr);
 
+    if(new_size > old_size){
+        grow_nursery(size, vm);
+    }
+
     if(!new_ptr){
         vmu_error(
             vm,
@@ -115,7 +172,26 @@ void vm_dealloc(void *ptr, size_t size, void *ctx){
     Allocator *allocator = vm->allocator;
 
     MEMORY_DEALLOC(allocator, char, size, ptr);
+    vm_discharge(size, vm);
+}
+
+void vm_charge(size_t size, VM *vm){
+    size_t new_mem_use = vm->mem_use + size;
 
+    if(vm->gc_phase == MARK_GC_PHASE){
+        mark_step(vm);
+    }else if(new_mem_use >= vm->mem_use_limit){
+        reach_limit(size, vm);
+        // Sweeping could have freed memory
+        new_mem_use = vm->mem_use + size;
+    }
+
+    grow_nursery(size, vm);
+
+    vm->mem_use = new_mem_use;
+}
+
+void vm_discharge(size_t size, VM *vm){
     size_t possible_new_mem_limit = vm->mem_use_limit / 2;
 
     if((vm->mem_use -= size) < (size_t)(possible_new_mem_limit * 0.50) &&
@@ -134,6 +210,9 @@ static inline int32_t read_i32(VM *vm);
 static inline int64_t read_i64_const(VM *vm);
 static double read_float_const(VM *vm);
 static inline char *read_str(VM *vm, size_t *out_len);
+static inline GlobalSlot *read_global_slot(VM *vm);
+static inline AccessCache *read_cache(VM *vm);
+static void gc_safepoint(VM *vm);
 static inline void *get_symbol(size_t index, SubModuleSymbolType type, Module *module, VM *vm);
 //----------     STACK RELATED FUNCTIONS     ----------//
 static inline Value peek(VM *vm);
@@ -159,15 +238,75 @@ static inline Frame *current_frame(VM *vm);
 #define VM_CURRENT_CLOSURE(_vm)(current_frame(vm)->closure)
 static inline uint8_t advance(VM *vm);
 static inline uint8_t advance_save(VM *vm);
+static inline uint8_t fetch(Frame *frame, const uint8_t *chunks, size_t chunks_len, VM *vm);
+static void profile(uint8_t chunk, Frame *frame, VM *vm);
+static void record(Frame *frame, VM *vm);
 static void add_out_value_to_current_frame(OutValue *value, VM *vm);
 static void remove_value_from_current_frame(OutValue *value, VM *vm);
-static Frame *push_frame(uint8_t argsc, VM *vm);
+static void init_frame(const Fn *fn, Value *locals, Frame *frame, VM *vm);
+static Frame *push_frame(uint8_t argsc, const Fn *fn, VM *vm);
+static inline void check_arity(uint8_t argsc, const Fn *fn, const char *kind, VM *vm);
 static inline void call_fn(uint8_t argsc, const Fn *fn, VM *vm);
 static inline void call_closure(uint8_t argsc, Closure *closure, VM *vm);
 static inline void pop_frame(VM *vm);
 static inline Value *frame_local(uint8_t which, VM *vm);
+static inline Value *frame_register(uint8_t which, VM *vm);
+static inline void quicken(uint8_t opcode, VM *vm);
+static inline void deoptimize(uint8_t opcode, VM *vm);
 // OTHERS
+static int numbers_as_floats(Value left_value, Value right_value, double *left, double *right);
+static Value arithmetic(uint8_t opcode, Value left_value, Value right_value, VM *vm);
+static int compare(uint8_t opcode, Value left_value, Value right_value, VM *vm);
+static NativeFn *builtin_method(ObjType type, size_t key_size, char *key, AccessCache *cache, VM *vm);
+static Value *record_attr(size_t key_size, char *key, RecordObj *record_obj, AccessCache *cache);
+static Value access_symbol(Obj *target_obj, size_t key_size, char *key, AccessCache *cache, VM *vm);
+static Value call_native(uint8_t argsc, NativeFn *native_fn, Value target, VM *vm);
+static int call_value(uint8_t argsc, VM *vm);
+static int tail_call(uint8_t argsc, VM *vm);
+static void enter_coroutine(CoroutineObj *coroutine_obj, VM *vm);
+static void leave_coroutine(CoroutineObj *coroutine_obj, VM *vm);
+static void end_coroutine(CoroutineObj *coroutine_obj);
+static Value resume_coroutine(CoroutineObj *coroutine_obj, uint8_t argsc, Value *args, VM *vm);
+static int iterate(uint8_t which, VM *vm);
+static inline int equals(uint8_t opcode, Value left_value, Value right_value, VM *vm);
+static void set_global(VM *vm);
+static void get_global(VM *vm);
+static void set_index(VM *vm);
+static void get_index(VM *vm);
+static void access_target(VM *vm);
+static int invoke(VM *vm);
+static int return_frame(VM *vm);
+static int jit_step(VM *vm);
+static int run_jit(VM *vm);
+static JitLoop *jit_loop(size_t header, const Fn *fn, VM *vm);
+static void stop_recording(VM *vm);
+static int run_trace(VM *vm);
 static int execute(VM *vm);
+static void enter(LZOHTable *native_fns, Module *module, VM *vm);
+static void catch_throw(VM *vm);
+static void start_import(VM *vm);
+static int resume(int jmp_value, VM *vm);
+//----------     DISPATCH     ----------//
+// THREADED_DISPATCH makes every handler jump directly to the next one through
+// a table of label addresses (GNU 'labels as values'). Otherwise, handlers go
+// back to the top of the loop and the switch dispatches the next opcode.
+// Either way, collections requested by allocations run before the next one
+#if defined(THREADED_DISPATCH) && defined(__GNUC__)
+    #define VM_CASE(_op) case _op: _op##_LABEL
+    #define VM_DEFAULT default: DEFAULT_LABEL
+    #define VM_NEXT()                                                   \
+        do{                                                             \
+            if(vm->gc_request){                                         \
+                gc_safepoint(vm);                                       \
+            }                                                           \
+                                                                        \
+            goto *dispatch_table[fetch(frame, chunks, chunks_len, vm)]; \
+        }while(0)
+#else
+    #define VM_CASE(_op) case _op
+    #define VM_DEFAULT default
+    #define VM_NEXT() break
+#endif
 //< PRIVATE INTERFACE
 //> PRIVATE IMPLEMENTATION
 inline int16_t compose_i16(uint8_t *bytes){
@@ -210,9 +349,11 @@ static char *read_str(VM *vm, size_t *out_len){
     DynArr *static_strs = MODULE_STRINGS(VM_CURRENT_MODULE(vm));
     size_t idx = (size_t)read_i16(vm);
 
+#ifndef UNCHECKED_BYTECODE
     if(idx >= dynarr_len(static_strs)){
         vmu_error(vm, "Illegal module static strings access index");
     }
+#endif
 
     DStr raw_str = DYNARR_GET_AS(static_strs, DStr, idx);
 
@@ -223,6 +364,45 @@ static char *read_str(VM *vm, size_t *out_len){
     return raw_str.buff;
 }
 
+static inline AccessCache *read_cache(VM *vm){
+    DynArr *caches = VM_CURRENT_FN(vm)->caches;
+    size_t idx = (size_t)read_i16(vm);
+
+#ifndef UNCHECKED_BYTECODE
+    if(idx >= dynarr_len(caches)){
+        vmu_error(vm, "Illegal access cache index");
+    }
+#endif
+
+    return &DYNARR_GET_AS(caches, AccessCache, idx);
+}
+
+static inline GlobalSlot *read_global_slot(VM *vm){
+    DynArr *global_slots = MODULE_GLOBAL_SLOTS(VM_CURRENT_MODULE(vm));
+    size_t idx = (size_t)read_i16(vm);
+
+#ifndef UNCHECKED_BYTECODE
+    if(idx >= dynarr_len(global_slots)){
+        vmu_error(vm, "Illegal module global slot index");
+    }
+#endif
+
+    return &DYNARR_GET_AS(global_slots, GlobalSlot, idx);
+}
+
+void gc_safepoint(VM *vm){
+    vm->gc_request = 0;
+
+    if(vm->gc_phase == MARK_GC_PHASE){
+        // Finishes the incremental cycle: the roots are scanned again,
+        // because the stack and globals are not guarded by barriers
+        vmu_gc(vm);
+        return;
+    }
+
+    vmu_minor_gc(vm);
+}
+
 static inline void *get_symbol(size_t index, SubModuleSymbolType type, Module *module, VM *vm){
     DynArr *symbols = MODULE_SYMBOLS(module);
 
@@ -240,14 +420,17 @@ static inline void *get_symbol(size_t index, SubModuleSymbolType type, Module *m
 }
 
 static inline Value peek(VM *vm){
+#ifndef UNCHECKED_BYTECODE
     if(vm->stack_top == vm->stack){
         vmu_error(vm, "Stack is empty");
     }
+#endif
 
     return *(vm->stack_top - 1);
 }
 
 static inline Value peek_at(uint16_t offset, VM *vm){
+#ifndef UNCHECKED_BYTECODE
     if(vm->stack == vm->stack_top){
         vmu_internal_error(vm, "Stack is empty");
     }
@@ -255,11 +438,13 @@ static inline Value peek_at(uint16_t offset, VM *vm){
     if(vm->stack_top - 1 - offset <= vm->stack){
         vmu_internal_error(vm, "Illegal stack peek offset");
     }
+#endif
 
     return *(vm->stack_top - 1 - offset);
 }
 
 static inline Value *peek_at_ptr(uint16_t offset, VM *vm){
+#ifndef UNCHECKED_BYTECODE
     if(vm->stack == vm->stack_top){
         vmu_internal_error(vm, "Stack is empty");
     }
@@ -267,14 +452,17 @@ static inline Value *peek_at_ptr(uint16_t offset, VM *vm){
     if(vm->stack_top - 1 - offset <= vm->stack){
         vmu_internal_error(vm, "Illegal stack peek offset");
     }
+#endif
 
     return vm->stack_top - 1 - offset;
 }
 
 static inline void push(Value value, VM *vm){
-    if(vm->stack_top >= vm->stack + STACK_LENGTH){
+#ifndef UNCHECKED_BYTECODE
+    if(vm->stack_top >= vm->stack_end){
         vmu_error(vm, "Stack over flow");
     }
+#endif
 
     *((vm->stack_top)++) = value;
 }
@@ -298,6 +486,12 @@ ClosureObj *init_closure(MetaClosure *meta, VM *vm){
 
         out_value->linked = 1;
         out_value->at = meta_out_value->at;
+
+        // The verifier does not see which locals closures capture
+        if(current_frame(vm)->locals + 1 + meta_out_value->at >= vm->stack_top){
+            vmu_internal_error(vm, "Closure captures a local past the stack top");
+        }
+
         out_value->value = *frame_local(meta_out_value->at, vm);
         out_value->prev = NULL;
         out_value->next = NULL;
@@ -317,17 +511,21 @@ Obj *push_module(Module *module, VM *vm){
 }
 
 inline Value pop(VM *vm){
+#ifndef UNCHECKED_BYTECODE
     if(vm->stack_top == vm->stack){
         vmu_error(vm, "Stack under flow");
     }
+#endif
 
     return *(--vm->stack_top);
 }
 
 static inline Frame *current_frame(VM *vm){
+#ifndef UNCHECKED_BYTECODE
     if(vm->frame_ptr == vm->frame_stack){
         vmu_error(vm, "Frame stack is empty");
     }
+#endif
 
     return vm->frame_ptr - 1;
 }
@@ -336,9 +534,11 @@ static inline uint8_t advance(VM *vm){
     Frame *frame = current_frame(vm);
     DynArr *chunks = frame->fn->chunks;
 
+#ifndef UNCHECKED_BYTECODE
     if(frame->ip >= dynarr_len(chunks)){
         vmu_error(vm, "IP excceded chunks length");
     }
+#endif
 
     return DYNARR_GET_AS(chunks, uint8_t, frame->ip++);
 }
@@ -347,16 +547,109 @@ static inline uint8_t advance_save(VM *vm){
     Frame *frame = current_frame(vm);
     DynArr *chunks = frame->fn->chunks;
 
+#ifndef UNCHECKED_BYTECODE
     if(frame->ip >= dynarr_len(chunks)){
         vmu_error(vm, "IP excceded chunks length");
     }
+#endif
 
     uint8_t chunk = DYNARR_GET_AS(chunks, uint8_t, frame->ip++);
     frame->last_offset = frame->ip - 1;
 
+    if(vm->profiler){
+        profile(chunk, frame, vm);
+    }
+
+    if(vm->recorder){
+        record(frame, vm);
+    }
+
+    return chunk;
+}
+
+static inline uint8_t fetch(Frame *frame, const uint8_t *chunks, size_t chunks_len, VM *vm){
+#ifndef UNCHECKED_BYTECODE
+    if(frame->ip >= chunks_len){
+        vmu_error(vm, "IP excceded chunks length");
+    }
+#endif
+
+    frame->last_offset = frame->ip;
+    uint8_t chunk = chunks[frame->ip++];
+
+    if(vm->profiler){
+        profile(chunk, frame, vm);
+    }
+
+    if(vm->recorder){
+        record(frame, vm);
+    }
+
     return chunk;
 }
 
+void profile(uint8_t chunk, Frame *frame, VM *vm){
+    Profiler *profiler = vm->profiler;
+    size_t depth = (size_t)(frame - vm->frame_stack);
+
+    // Deeper frames count in the deepest one the profiler follows
+    if(depth >= PROFILER_DEPTH_LENGTH){
+        depth = PROFILER_DEPTH_LENGTH - 1;
+        frame = vm->frame_stack + depth;
+    }
+
+    ProfileNode *node = profiler->nodes[depth];
+
+    if(depth != profiler->depth || !node || node->fn_profile->fn != frame->fn){
+        // Frames are pushed one at a time, but returns
+        // (and throws) could pop several of them
+        size_t from = depth;
+
+        if(!profiler->last_node){
+            from = 0;
+        }else if(depth > profiler->depth){
+            from = profiler->depth + 1;
+        }
+
+        for (size_t i = from; i <= depth; i++){
+            if(profiler_enter(i, vm->frame_stack[i].fn, profiler)){
+                vmu_internal_error(vm, "Failed to profile: out of memory");
+            }
+        }
+    }
+
+    profiler_count(chunk, frame->last_offset, profiler);
+}
+
+// Compiles the trace of the loop once its recording closes
+void record(Frame *frame, VM *vm){
+    JitRecorder *recorder = vm->recorder;
+    int status = jit_record(recorder, frame, vm);
+
+    if(status == RECORDING_RECORD_STATUS){
+        return;
+    }
+
+    JitCode *trace = NULL;
+
+    if(status == CLOSED_RECORD_STATUS){
+        trace = jit_compile_trace(recorder->fn, recorder->ops, jit_step, gc_safepoint, vm->allocator);
+    }
+
+    JitLoop *loop = jit_loop(recorder->header, recorder->fn, vm);
+
+    if(trace){
+        trace->next = vm->jit_codes;
+        vm->jit_codes = trace;
+        loop->trace = trace;
+    }else{
+        loop->hotness = 0;
+        loop->aborts++;
+    }
+
+    stop_recording(vm);
+}
+
 void add_out_value_to_current_frame(OutValue *value, VM *vm){
     Frame *frame = current_frame(vm);
 
@@ -388,8 +681,8 @@ void remove_value_from_current_frame(OutValue *value, VM *vm){
     }
 }
 
-static Frame *push_frame(uint8_t argsc, VM *vm){
-    if(vm->frame_ptr >= vm->frame_stack + FRAME_LENGTH){
+static Frame *push_frame(uint8_t argsc, const Fn *fn, VM *vm){
+    if(vm->frame_ptr >= vm->frame_stack_end){
         vmu_error(vm, "Frame stack is full");
     }
 
@@ -407,53 +700,63 @@ static Frame *push_frame(uint8_t argsc, VM *vm){
 
     Frame *frame = vm->frame_ptr++;
 
-    frame->ip = 0;
-    frame->last_offset = 0;
-    frame->fn = NULL;
-    frame->closure = NULL;
-    frame->locals = locals;
-    frame->outs_head = NULL;
-    frame->outs_tail = NULL;
+    init_frame(fn, locals, frame, vm);
 
     return frame;
 }
 
-static inline void call_fn(uint8_t argsc, const Fn *fn, VM *vm){
-    size_t params_count = fn->arity;
-
-    if(argsc != params_count){
-        vmu_error(vm, "Failed to call function '%s'. Declared with %d parameter(s), but got %d argument(s)", fn->name, params_count, argsc);
+// Starts 'frame' at the first instruction of 'fn'. Used by calls,
+// and by tail calls on the frame they reuse
+static void init_frame(const Fn *fn, Value *locals, Frame *frame, VM *vm){
+    // The only stack check the function needs: its verified height, plus
+    // the slot of a module entry function, pushed while importing
+    if(locals + 1 + fn->stack_len + 1 > vm->stack_end){
+        vmu_error(vm, "Stack over flow");
     }
 
-    Frame *frame = push_frame(argsc, vm);
-
+    frame->ip = 0;
+    frame->last_offset = 0;
     frame->fn = fn;
+    frame->closure = NULL;
+    frame->locals = locals;
+    frame->outs_head = NULL;
+    frame->outs_tail = NULL;
 }
 
-static inline void call_closure(uint8_t argsc, Closure *closure, VM *vm){
-    Fn *fn = closure->meta->fn;
-    size_t params_count = fn->arity;
-
-    if(argsc != params_count){
+static inline void check_arity(uint8_t argsc, const Fn *fn, const char *kind, VM *vm){
+    if(argsc != fn->arity){
         vmu_error(
             vm,
-            "Failed to call closure '%s'. Declared with %d parameter(s), but got %d argument(s)",
+            "Failed to call %s '%s'. Declared with %d parameter(s), but got %d argument(s)",
+            kind,
             fn->name,
-            params_count,
+            fn->arity,
             argsc
         );
     }
+}
 
-    Frame *frame = push_frame(argsc, vm);
+static inline void call_fn(uint8_t argsc, const Fn *fn, VM *vm){
+    check_arity(argsc, fn, "function", vm);
+    push_frame(argsc, fn, vm);
+}
+
+static inline void call_closure(uint8_t argsc, Closure *closure, VM *vm){
+    Fn *fn = closure->meta->fn;
+
+    check_arity(argsc, fn, "closure", vm);
+
+    Frame *frame = push_frame(argsc, fn, vm);
 
-    frame->fn = fn;
     frame->closure = closure;
 }
 
 static inline void pop_frame(VM *vm){
+#ifndef UNCHECKED_BYTECODE
     if(vm->frame_ptr == vm->frame_stack){
         vmu_error(vm, "Frame stack is empty");
     }
+#endif
 
     vm->frame_ptr--;
 }
@@ -463,148 +766,1576 @@ static inline Value *frame_local(uint8_t which, VM *vm){
     Value *locals = frame->locals;
     Value *local = locals + 1 + which;
 
+#ifndef UNCHECKED_BYTECODE
     if(local >= vm->stack_top){
         vmu_error(vm, "Index for frame local pass value stack top");
     }
+#endif
 
     return local;
 }
 
-static int execute(VM *vm){
-    for (;;){
-        uint8_t chunk = advance_save(vm);
+// Unlike locals, registers can be past the stack top
+static inline Value *frame_register(uint8_t which, VM *vm){
+    Frame *frame = current_frame(vm);
 
-        switch (chunk){
-            case OP_EMPTY:{
-                PUSH_EMPTY(vm);
-                break;
-            }case OP_FALSE:{
-                PUSH_BOOL(0, vm);
-                break;
-            }case OP_TRUE:{
-                PUSH_BOOL(1, vm);
-                break;
-            }case OP_CINT:{
-                int64_t i64 = (int64_t)advance(vm);
-                PUSH_INT(i64, vm);
-                break;
-            }case OP_INT:{
-                int64_t i64 = read_i64_const(vm);
-                PUSH_INT(i64, vm);
-                break;
-            }case OP_FLOAT:{
-                double value = read_float_const(vm);
-                PUSH_FLOAT(value, vm);
-                break;
-            }case OP_STRING:{
-                size_t len;
-                StrObj *str_obj = NULL;
-                char *str = read_str(vm, &len);
+#ifndef UNCHECKED_BYTECODE
+    if(which >= frame->fn->stack_len){
+        vmu_error(vm, "Register past the stack of the function");
+    }
+#endif
 
-                vmu_create_str(0, len, str, vm, &str_obj);
-                PUSH_OBJ(str_obj, vm);
+    return frame->locals + 1 + which;
+}
 
-                break;
-            }case OP_STTE:{
-                LZBStr *str = MEMORY_LZBSTR(vm->allocator);
-                Template *template = MEMORY_ALLOC(vm->allocator, Template, 1);
+// Rewrites the opcode of the instruction being executed. The
+// specialized opcodes take the same operands as the generic ones
+static inline void quicken(uint8_t opcode, VM *vm){
+    Frame *frame = current_frame(vm);
+    uint8_t *chunks = dynarr_get_raw(frame->fn->chunks, 0);
 
-                template->str = str;
-                template->prev = vm->templates;
-                vm->templates = template;
+    chunks[frame->last_offset] = opcode;
+}
 
-                break;
-            }case OP_ETTE:{
-                Template *template = vm->templates;
+// Puts back the generic opcode of the instruction being executed
+// and makes the dispatch loop execute it again
+static inline void deoptimize(uint8_t opcode, VM *vm){
+    Frame *frame = current_frame(vm);
 
-                if(template){
-                    LZBStr *str = template->str;
-                    size_t buff_len;
-                    char *buff = lzbstr_rclone_buff(
-                        (LZBStrAllocator *)&vm->front_allocator,
-                        str,
-                        &buff_len
-                    );
-                    StrObj *str_obj = NULL;
+    quicken(opcode, vm);
+    frame->ip = frame->last_offset;
+}
 
-                    if(vmu_create_str(1, buff_len, buff, vm, &str_obj)){
-                        MEMORY_DEALLOC(&vm->front_allocator, char, buff_len + 1, buff);
-                    }
+// Used by the superinstructions when their operands are not both integers.
+// Returns 1 if any of the values is not a number
+int numbers_as_floats(Value left_value, Value right_value, double *left, double *right){
+    if(!(IS_VALUE_INT(left_value) || IS_VALUE_FLOAT(left_value)) ||
+       !(IS_VALUE_INT(right_value) || IS_VALUE_FLOAT(right_value)))
+    {
+        return 1;
+    }
 
-                    PUSH_OBJ(str_obj, vm);
+    *left = IS_VALUE_FLOAT(left_value) ? VALUE_TO_FLOAT(left_value) : (double)VALUE_TO_INT(left_value);
+    *right = IS_VALUE_FLOAT(right_value) ? VALUE_TO_FLOAT(right_value) : (double)VALUE_TO_INT(right_value);
 
-                    vm->templates = template->prev;
+    return 0;
+}
 
-                    lzbstr_destroy(str);
-                    MEMORY_DEALLOC(vm->allocator, Template, 1, template);
+// Same semantics than the stack arithmetic opcodes, for the register ones
+Value arithmetic(uint8_t opcode, Value left_value, Value right_value, VM *vm){
+    if(IS_VALUE_INT(left_value) && IS_VALUE_INT(right_value)){
+        int64_t left = VALUE_TO_INT(left_value);
+        int64_t right = VALUE_TO_INT(right_value);
 
-                    break;
+        switch (opcode){
+            case OP_ADD:{
+                return INT_VALUE(left + right);
+            }case OP_SUB:{
+                return INT_VALUE(left - right);
+            }case OP_MUL:{
+                return INT_VALUE(left * right);
+            }case OP_DIV:{
+                if(right == 0){
+                    vmu_error(vm, "Division by zero is undefined");
                 }
 
-                vmu_internal_error(vm, "Template stack is empty");
-
-                break;
-            }case OP_ARRAY:{
-                Value len_value = pop(vm);
+                return INT_VALUE(left / right);
+            }default:{
+                return INT_VALUE(left % right);
+            }
+        }
+    }
 
-                if(!IS_VALUE_INT(len_value)){
-                    vmu_error(vm, "Expect 'INT' as array length");
-                }
+    const char *operator = "'mod'";
+
+    switch (opcode){
+        case OP_ADD:{
+            operator = "+";
+            break;
+        }case OP_SUB:{
+            operator = "-";
+            break;
+        }case OP_MUL:{
+            operator = "*";
+            break;
+        }case OP_DIV:{
+            operator = "/";
+            break;
+        }
+    }
 
-                int64_t array_len = VALUE_TO_INT(len_value);
-                ArrayObj *array_obj = vmu_create_array(array_len, vm);
+    double left;
+    double right;
 
-                PUSH_OBJ(array_obj, vm);
+    if(opcode == OP_MOD || numbers_as_floats(left_value, right_value, &left, &right)){
+        vmu_error(vm, "Unsuported types using %s operator", operator);
+    }
 
-                break;
-            }case OP_LIST:{
-                ListObj *list_obj = vmu_create_list(vm);
-                PUSH_OBJ(list_obj, vm);
-                break;
-            }case OP_DICT:{
-                DictObj *dict_obj = vmu_create_dict(vm);
-                PUSH_OBJ(dict_obj, vm);
-                break;
-            }case OP_RECORD:{
-                uint16_t len = (uint16_t)read_i16(vm);
-                RecordObj *record_obj = vmu_create_record(len, vm);
-                PUSH_OBJ(record_obj, vm);
-                break;
-            }case OP_WTTE:{
-                Template *template = vm->templates;
-                Value raw_value = pop(vm);
+    switch (opcode){
+        case OP_ADD:{
+            return FLOAT_VALUE(left + right);
+        }case OP_SUB:{
+            return FLOAT_VALUE(left - right);
+        }case OP_MUL:{
+            return FLOAT_VALUE(left * right);
+        }default:{
+            if(right == 0.0 && !(IS_VALUE_FLOAT(left_value) && IS_VALUE_FLOAT(right_value))){
+                vmu_error(vm, "Division by zero is undefined");
+            }
 
-                if(template){
-                    LZBStr *str = template->str;
-                    vmu_value_to_str_w(raw_value, str);
-                    break;
-                }
+            return FLOAT_VALUE(left / right);
+        }
+    }
+}
 
-                vmu_internal_error(vm, "Template stack is empty");
+// Same semantics than the stack comparison opcodes, for the register ones
+int compare(uint8_t opcode, Value left_value, Value right_value, VM *vm){
+    if(IS_VALUE_INT(left_value) && IS_VALUE_INT(right_value)){
+        int64_t left = VALUE_TO_INT(left_value);
+        int64_t right = VALUE_TO_INT(right_value);
 
-                break;
-            }case OP_IARRAY:{
-                int64_t idx = (int64_t)read_i16(vm);
-                Value value = pop(vm);
-                Value array_value = peek(vm);
-                ArrayObj *array_obj = VALUE_TO_ARRAY(array_value);
+        switch (opcode){
+            case OP_LT:{
+                return left < right;
+            }case OP_GT:{
+                return left > right;
+            }case OP_LE:{
+                return left <= right;
+            }default:{
+                return left >= right;
+            }
+        }
+    }
 
-                vmu_array_set_at(idx, value, array_obj, vm);
+    double left;
+    double right;
 
+    if(numbers_as_floats(left_value, right_value, &left, &right)){
+        switch (opcode){
+            case OP_LT:{
+                vmu_error(vm, "Unsuported types using < operator");
                 break;
-            }case OP_ILIST:{
-                Value value = peek_at(0, vm);
-                Value list_value = peek_at(1, vm);
-
-                if(!is_value_list(list_value)){
+            }case OP_GT:{
+                vmu_error(vm, "Unsuported types using > operator");
+                break;
+            }case OP_LE:{
+                vmu_error(vm, "Unsuported types using <= operator");
+                break;
+            }default:{
+                vmu_error(vm, "Unsuported types using >= operator");
+                break;
+            }
+        }
+    }
+
+    switch (opcode){
+        case OP_LT:{
+            return left < right;
+        }case OP_GT:{
+            return left > right;
+        }case OP_LE:{
+            return left <= right;
+        }default:{
+            return left >= right;
+        }
+    }
+}
+
+// Methods of built in types only depend on the type of the target,
+// so a site keeps the last one it found for each type
+NativeFn *builtin_method(ObjType type, size_t key_size, char *key, AccessCache *cache, VM *vm){
+    if(cache->native_fn && cache->type == (int)type){
+        return cache->native_fn;
+    }
+
+    NativeFn *native_fn = NULL;
+
+    switch (type){
+        case STR_OBJ_TYPE:{
+            native_fn = native_str_get(key_size, key, vm);
+            break;
+        }case ARRAY_OBJ_TYPE:{
+            native_fn = native_array_get(key_size, key, vm);
+            break;
+        }case LIST_OBJ_TYPE:{
+            native_fn = native_list_get(key_size, key, vm);
+            break;
+        }case DICT_OBJ_TYPE:{
+            native_fn = native_dict_get(key_size, key, vm);
+            break;
+        }default:{
+            assert(0 && "Illegal built in type");
+            break;
+        }
+    }
+
+    if(!native_fn){
+        vmu_error(vm, "Target does not contain symbol '%s'", key);
+        return NULL;
+    }
+
+    cache->type = (int)type;
+    cache->native_fn = native_fn;
+
+    return native_fn;
+}
+
+// Returns NULL if the record does not contain 'key'
+Value *record_attr(size_t key_size, char *key, RecordObj *record_obj, AccessCache *cache){
+    const Shape *shape = record_obj->shape;
+
+    if(cache->shape != shape){
+        size_t offset;
+
+        if(shape_find(key_size, key, shape, &offset)){
+            return NULL;
+        }
+
+        cache->shape = shape;
+        cache->offset = offset;
+    }
+
+    return &record_obj->values[cache->offset];
+}
+
+// Symbols of the targets which are not built in types
+Value access_symbol(Obj *target_obj, size_t key_size, char *key, AccessCache *cache, VM *vm){
+    switch (target_obj->type){
+        case RECORD_OBJ_TYPE:{
+            RecordObj *record_obj = OBJ_TO_RECORD(target_obj);
+            Value *value = record_attr(key_size, key, record_obj, cache);
+
+            if(!value){
+                vmu_error(
+                    vm,
+                    "Failed to get attribute: record does not contain attribute '%s'",
+                    key
+                );
+
+                return EMPTY_VALUE;
+            }
+
+            return *value;
+        }case NATIVE_MODULE_OBJ_TYPE:{
+            NativeModuleObj *native_module_obj = OBJ_TO_NATIVE_MODULE(target_obj);
+            NativeModule *native_module = native_module_obj->native_module;
+            Value *value = NULL;
+
+            if(!lzohtable_lookup(key_size, key, native_module->symbols, (void **)(&value))){
+                vmu_error(vm, "Native module '%s' does not contain symbol '%s'", native_module->name, key);
+            }
+
+            return *value;
+        }case MODULE_OBJ_TYPE:{
+            ModuleObj *module_obj = OBJ_TO_MODULE(target_obj);
+            Module *module = module_obj->module;
+            size_t *global_idx = NULL;
+            GlobalValue *global_value = NULL;
+
+            if(lzohtable_lookup(
+                key_size,
+                key,
+                MODULE_GLOBALS(module),
+                (void **)(&global_idx)
+            )){
+                global_value = &DYNARR_GET_AS(
+                    MODULE_GLOBAL_SLOTS(module),
+                    GlobalSlot,
+                    *global_idx
+                ).global_value;
+            }
+
+            if(!global_value || global_value->access == UNDEFINED_GLOBAL_VALUE_TYPE){
+                vmu_error(
+                    vm,
+                    "Module '%s' do not have '%s' symbol",
+                    module->name,
+                    key
+                );
+            }
+
+            if(global_value->access == PRIVATE_GLOVAL_VALUE_TYPE){
+                vmu_error(
+                    vm,
+                    "Symbol '%s' in module '%s' is private",
+                    key,
+                    module->name
+                );
+            }
+
+            return global_value->value;
+        }default:{
+            vmu_error(vm, "Illegal access target");
+            return EMPTY_VALUE;
+        }
+    }
+}
+
+// Calls 'native_fn' with the top 'argsc' values of the stack, leaving them there
+Value call_native(uint8_t argsc, NativeFn *native_fn, Value target, VM *vm){
+    if(native_fn->arity != argsc){
+        vmu_error(
+            vm,
+            "Failed to call native function '%s'. Declared with %d parameter(s), but got %d argument(s)",
+            native_fn->name,
+            native_fn->arity,
+            argsc
+        );
+    }
+
+    RawNativeFn raw_fn = native_fn->raw_fn;
+
+    if(argsc == 0){
+        return raw_fn(0, NULL, target, vm);
+    }
+
+    // The arguments are passed where they are in the stack, which
+    // keeps them reachable by the garbage collector during the call
+    return raw_fn(argsc, peek_at_ptr(argsc - 1, vm), target, vm);
+}
+
+// Calls the value under the top 'argsc' values of the stack. Returns 0 if
+// the callable was a pure native: its result is pushed and nothing the
+// dispatch loop checks between frames could have changed
+int call_value(uint8_t argsc, VM *vm){
+    Value callable_value = peek_at(argsc, vm);
+
+    if(!IS_VALUE_OBJ(callable_value)){
+        vmu_error(vm, "Target is not callable");
+    }
+
+    Obj *callable_obj = VALUE_TO_OBJ(callable_value);
+
+    switch (callable_obj->type){
+        case NATIVE_FN_OBJ_TYPE:{
+            NativeFnObj *native_fn_obj = VALUE_TO_NATIVE_FN(callable_value);
+            NativeFn *native_fn = native_fn_obj->native_fn;
+            Value return_value = call_native(argsc, native_fn, native_fn_obj->target, vm);
+
+            vm->stack_top = peek_at_ptr(argsc, vm);
+
+            push(return_value, vm);
+
+            return !native_fn->pure;
+        }case FN_OBJ_TYPE:{
+            FnObj *fn_obj = VALUE_TO_FN(callable_value);
+            const Fn *fn = fn_obj->fn;
+
+            call_fn(argsc, fn, vm);
+
+            return 1;
+        }case CLOSURE_OBJ_TYPE:{
+            ClosureObj *closure_obj = VALUE_TO_CLOSURE(callable_value);
+            Closure *closure = closure_obj->closure;
+
+            call_closure(argsc, closure, vm);
+
+            return 1;
+        }case COROUTINE_OBJ_TYPE:{
+            CoroutineObj *coroutine_obj = VALUE_TO_COROUTINE(callable_value);
+            Value *args = argsc == 0 ? NULL : peek_at_ptr(argsc - 1, vm);
+            Value return_value = resume_coroutine(coroutine_obj, argsc, args, vm);
+
+            vm->stack_top = peek_at_ptr(argsc, vm);
+
+            push(return_value, vm);
+
+            return 1;
+        }default:{
+            vmu_error(vm, "Target is not callable");
+            return 1;
+        }
+    }
+}
+
+// Does what OP_CALL followed by OP_RET would. Functions and closures
+// take the place of the current frame: the callable and its arguments
+// slide down to its locals. Returns 1 if the frame was the last one
+int tail_call(uint8_t argsc, VM *vm){
+    Value callable_value = peek_at(argsc, vm);
+    Obj *callable_obj = IS_VALUE_OBJ(callable_value) ? VALUE_TO_OBJ(callable_value) : NULL;
+    const Fn *fn = NULL;
+    Closure *closure = NULL;
+
+    if(callable_obj && callable_obj->type == FN_OBJ_TYPE){
+        fn = VALUE_TO_FN(callable_value)->fn;
+        check_arity(argsc, fn, "function", vm);
+    }else if(callable_obj && callable_obj->type == CLOSURE_OBJ_TYPE){
+        closure = VALUE_TO_CLOSURE(callable_value)->closure;
+        fn = closure->meta->fn;
+        check_arity(argsc, fn, "closure", vm);
+    }else{
+        // Natives have no frame to reuse
+        call_value(argsc, vm);
+        return return_frame(vm);
+    }
+
+    Frame *frame = current_frame(vm);
+    Value *locals = frame->locals;
+
+    memmove(locals, peek_at_ptr(argsc, vm), sizeof(Value) * (1 + argsc));
+    vm->stack_top = locals + 1 + argsc;
+
+    init_frame(fn, locals, frame, vm);
+
+    frame->closure = closure;
+
+    return 0;
+}
+
+// Sets aside the stacks and try blocks of the resumer, and swaps in those of the coroutine
+void enter_coroutine(CoroutineObj *coroutine_obj, VM *vm){
+    coroutine_obj->caller_stack = vm->stack;
+    coroutine_obj->caller_stack_top = vm->stack_top;
+    coroutine_obj->caller_stack_end = vm->stack_end;
+    coroutine_obj->caller_frame_stack = vm->frame_stack;
+    coroutine_obj->caller_frame_ptr = vm->frame_ptr;
+    coroutine_obj->caller_frame_stack_end = vm->frame_stack_end;
+    coroutine_obj->caller_exceptions = vm->exception_stack;
+    coroutine_obj->prev = vm->coroutine;
+    coroutine_obj->state = RUNNING_COROUTINE_STATE;
+
+    // Its try blocks are linked again on top of those of the resumer
+    Exception *exception = coroutine_obj->exceptions;
+
+    if(exception){
+        while(exception->prev){
+            exception = exception->prev;
+        }
+
+        exception->prev = vm->exception_stack;
+        vm->exception_stack = coroutine_obj->exceptions;
+        coroutine_obj->exceptions = NULL;
+    }
+
+    vm->stack = coroutine_obj->stack;
+    vm->stack_top = coroutine_obj->stack_top;
+    vm->stack_end = coroutine_obj->stack + COROUTINE_STACK_LENGTH;
+    vm->frame_stack = coroutine_obj->frame_stack;
+    vm->frame_ptr = coroutine_obj->frame_ptr;
+    vm->frame_stack_end = coroutine_obj->frame_stack + COROUTINE_FRAME_LENGTH;
+    vm->coroutine = coroutine_obj;
+    vm->coroutine_nesting++;
+}
+
+// Undoes enter_coroutine, keeping where the coroutine left its stacks
+void leave_coroutine(CoroutineObj *coroutine_obj, VM *vm){
+    Exception *caller_exceptions = coroutine_obj->caller_exceptions;
+    Exception *exception = vm->exception_stack;
+
+    coroutine_obj->stack_top = vm->stack_top;
+    coroutine_obj->frame_ptr = vm->frame_ptr;
+
+    if(exception != caller_exceptions){
+        coroutine_obj->exceptions = exception;
+
+        while(exception->prev != caller_exceptions){
+            exception = exception->prev;
+        }
+
+        exception->prev = NULL;
+    }
+
+    vm->exception_stack = caller_exceptions;
+    vm->stack = coroutine_obj->caller_stack;
+    vm->stack_top = coroutine_obj->caller_stack_top;
+    vm->stack_end = coroutine_obj->caller_stack_end;
+    vm->frame_stack = coroutine_obj->caller_frame_stack;
+    vm->frame_ptr = coroutine_obj->caller_frame_ptr;
+    vm->frame_stack_end = coroutine_obj->caller_frame_stack_end;
+    vm->coroutine = coroutine_obj->prev;
+    vm->coroutine_nesting--;
+
+    coroutine_obj->caller_stack = NULL;
+    coroutine_obj->caller_stack_top = NULL;
+    coroutine_obj->prev = NULL;
+}
+
+void end_coroutine(CoroutineObj *coroutine_obj){
+    coroutine_obj->state = DEAD_COROUTINE_STATE;
+    vmu_release_coroutine_stacks(coroutine_obj);
+}
+
+// Runs the coroutine until it yields or its function returns, and returns
+// the value it yielded or returned. The first resume passes 'args' to its
+// function. The next ones pass at most one value: the result of the yield
+// the coroutine stopped at. The dispatch loop of the coroutine nests in the
+// C stack, and returns when it yields
+Value resume_coroutine(CoroutineObj *coroutine_obj, uint8_t argsc, Value *args, VM *vm){
+    CoroutineState state = coroutine_obj->state;
+
+    if(state == RUNNING_COROUTINE_STATE){
+        vmu_error(vm, "Failed to resume coroutine: it is running");
+    }
+
+    if(state == DEAD_COROUTINE_STATE){
+        vmu_error(vm, "Failed to resume coroutine: it is done");
+    }
+
+    if(state == SUSPENDED_COROUTINE_STATE && argsc > 1){
+        vmu_error(vm, "Failed to resume coroutine: expect at most 1 argument, but got %d", argsc);
+    }
+
+    if(vm->coroutine_nesting >= COROUTINE_NESTING_LENGTH){
+        vmu_error(vm, "Failed to resume coroutine: too many nested coroutines");
+    }
+
+    jmp_buf outer_jmp;
+    size_t jit_nesting = vm->jit_nesting;
+
+    memcpy(outer_jmp, vm->exit_jmp, sizeof(jmp_buf));
+    enter_coroutine(coroutine_obj, vm);
+
+    int jmp_value = setjmp(vm->exit_jmp);
+
+    if(jmp_value == 2 && vm->exception_stack != coroutine_obj->caller_exceptions){
+        // Caught by a try block of the coroutine
+        catch_throw(vm);
+    }else if(jmp_value == 3){
+        start_import(vm);
+    }else if(jmp_value){
+        // Errors, and throws the coroutine does not catch, end it
+        leave_coroutine(coroutine_obj, vm);
+        end_coroutine(coroutine_obj);
+
+        vm->jit_nesting = jit_nesting;
+        memcpy(vm->exit_jmp, outer_jmp, sizeof(jmp_buf));
+        longjmp(vm->exit_jmp, jmp_value);
+    }else if(state == CREATED_COROUTINE_STATE){
+        // Called like the entry function: its stack has nothing below
+        Value fn = coroutine_obj->fn;
+
+        push(fn, vm);
+
+        for (uint8_t i = 0; i < argsc; i++){
+            push(args[i], vm);
+        }
+
+        if(is_value_fn(fn)){
+            call_fn(argsc, VALUE_TO_FN(fn)->fn, vm);
+        }else{
+            call_closure(argsc, VALUE_TO_CLOSURE(fn)->closure, vm);
+        }
+    }else{
+        push(argsc == 0 ? EMPTY_VALUE : args[0], vm);
+    }
+
+    execute(vm);
+
+    // Once the function returns, only its result is left
+    Value value = pop(vm);
+    int done = vm->frame_ptr == vm->frame_stack;
+
+    leave_coroutine(coroutine_obj, vm);
+
+    if(done){
+        end_coroutine(coroutine_obj);
+    }else{
+        const Value *stack_top = coroutine_obj->stack_top;
+
+        coroutine_obj->state = SUSPENDED_COROUTINE_STATE;
+
+        // From now on its values are only reachable through it
+        for (Value *stack_slot = coroutine_obj->stack; stack_slot < stack_top; stack_slot++){
+            vmu_write_barrier((Obj *)coroutine_obj, *stack_slot, vm);
+        }
+    }
+
+    vm->jit_nesting = jit_nesting;
+    memcpy(vm->exit_jmp, outer_jmp, sizeof(jmp_buf));
+
+    return value;
+}
+
+// Stores in the second local after 'which' the next value of the iterable
+// in 'which'. The local between them is the cursor. Arrays and lists give their
+// items, dictionaries their keys, and coroutines what they yield. Returns 0
+// once there are no values left
+int iterate(uint8_t which, VM *vm){
+    Value *iterable = frame_local(which, vm);
+    Value *cursor = frame_local(which + 1, vm);
+    Value *value = frame_local(which + 2, vm);
+    Obj *obj = IS_VALUE_OBJ(*iterable) ? VALUE_TO_OBJ(*iterable) : NULL;
+    int64_t at = VALUE_TO_INT(*cursor);
+
+    switch (obj ? obj->type : STR_OBJ_TYPE){
+        case ARRAY_OBJ_TYPE:{
+            ArrayObj *array_obj = OBJ_TO_ARRAY(obj);
+
+            if((size_t)at >= array_obj->len){
+                return 0;
+            }
+
+            *value = array_obj->values[at];
+
+            break;
+        }case LIST_OBJ_TYPE:{
+            // Items appended while iterating are seen too
+            DynArr *items = OBJ_TO_LIST(obj)->items;
+
+            if((size_t)at >= dynarr_len(items)){
+                return 0;
+            }
+
+            *value = DYNARR_GET_AS(items, Value, (size_t)at);
+
+            break;
+        }case DICT_OBJ_TYPE:{
+            LZOHTable *key_values = OBJ_TO_DICT(obj)->key_values;
+            size_t m = key_values->m;
+
+            while((size_t)at < m && !key_values->slots[at].used){
+                at++;
+            }
+
+            if((size_t)at >= m){
+                return 0;
+            }
+
+            *value = *(Value *)key_values->slots[at].key;
+
+            break;
+        }case COROUTINE_OBJ_TYPE:{
+            CoroutineObj *coroutine_obj = OBJ_TO_COROUTINE(obj);
+
+            if(coroutine_obj->state == DEAD_COROUTINE_STATE){
+                return 0;
+            }
+
+            // What its function returns is not one of its values
+            Value yield_value = resume_coroutine(coroutine_obj, 0, NULL, vm);
+
+            if(coroutine_obj->state == DEAD_COROUTINE_STATE){
+                return 0;
+            }
+
+            *value = yield_value;
+
+            break;
+        }default:{
+            vmu_error(vm, "Failed to iterate: expect array, list, dictionary or coroutine");
+            return 0;
+        }
+    }
+
+    *cursor = INT_VALUE(at + 1);
+
+    return 1;
+}
+
+// Same semantics than the == operator
+int equals(uint8_t opcode, Value left_value, Value right_value, VM *vm){
+    if(IS_VALUE_BOOL(left_value) && IS_VALUE_BOOL(right_value)){
+        return VALUE_TO_BOOL(left_value) == VALUE_TO_BOOL(right_value);
+    }
+
+    if(IS_VALUE_INT(left_value) && IS_VALUE_INT(right_value)){
+        return VALUE_TO_INT(left_value) == VALUE_TO_INT(right_value);
+    }
+
+    if(IS_VALUE_FLOAT(left_value) && IS_VALUE_FLOAT(right_value)){
+        return VALUE_TO_FLOAT(left_value) == VALUE_TO_FLOAT(right_value);
+    }
+
+    double left;
+    double right;
+
+    if(!numbers_as_floats(left_value, right_value, &left, &right)){
+        return left == right;
+    }
+
+    if(is_value_str(left_value) && is_value_str(right_value)){
+        return VALUE_TO_STR(left_value) == VALUE_TO_STR(right_value);
+    }
+
+    vmu_error(vm, "Unsuported types using %s operator", opcode == OP_EQ ? "==" : "!=");
+
+    return 0;
+}
+
+// The handlers below are shared by the dispatch loop and jit_step
+void set_global(VM *vm){
+    GlobalSlot *global_slot = read_global_slot(vm);
+    GlobalValue *global_value = &global_slot->global_value;
+
+    if(global_value->access == UNDEFINED_GLOBAL_VALUE_TYPE){
+        vmu_error(vm, "Global '%s' does not exists", global_slot->name);
+    }
+
+    Value value = peek(vm);
+
+    vmu_global_barrier(value, vm);
+    global_value->value = value;
+}
+
+void get_global(VM *vm){
+    GlobalSlot *global_slot = read_global_slot(vm);
+    GlobalValue *global_value = &global_slot->global_value;
+
+    if(global_value->access == UNDEFINED_GLOBAL_VALUE_TYPE){
+        vmu_error(
+            vm,
+            "Global symbol '%s' does not exists",
+            global_slot->name
+        );
+    }
+
+    Value value = global_value->value;
+
+    if(is_value_module(value)){
+        ModuleObj *module_obj = OBJ_TO_MODULE(VALUE_TO_OBJ(value));
+        Module *module = module_obj->module;
+
+        if(!module->submodule->resolved){
+            Frame *frame = current_frame(vm);
+
+            frame->ip = frame->last_offset;
+            module->prev = vm->modules_stack;
+            vm->modules_stack_len++;
+            vm->modules_stack = module;
+
+            longjmp(vm->exit_jmp, 3);
+        }
+    }
+
+    push(value, vm);
+}
+
+void set_index(VM *vm){
+    Value indexable_value = peek_at(0, vm);
+    Value idx_value = peek_at(1, vm);
+    Value value = peek_at(2, vm);
+
+    if(!IS_VALUE_OBJ(indexable_value)){
+        vmu_error(
+            vm,
+            "Illegal assignment target, expect: array, list, dict, nbarray"
+        );
+    }
+
+    Obj *target_obj = VALUE_TO_OBJ(indexable_value);
+
+    switch (target_obj->type){
+        case ARRAY_OBJ_TYPE:{
+            if(!IS_VALUE_INT(idx_value)){
+                vmu_error(vm, "Expect index value of type 'int'");
+            }
+
+            int64_t idx = VALUE_TO_INT(idx_value);
+            ArrayObj *array_obj = VALUE_TO_ARRAY(indexable_value);
+            vmu_array_set_at(idx, value, array_obj, vm);
+
+            break;
+        }case LIST_OBJ_TYPE:{
+            if(!IS_VALUE_INT(idx_value)){
+                vmu_error(vm, "Expect index value of type 'int'");
+            }
+
+            int64_t idx = VALUE_TO_INT(idx_value);
+            ListObj *list_obj = VALUE_TO_LIST(indexable_value);
+            vmu_list_set_at(idx, value, list_obj, vm);
+
+            break;
+        }case DICT_OBJ_TYPE:{
+            DictObj *dict_obj = VALUE_TO_DICT(indexable_value);
+            vmu_dict_put(idx_value, value, dict_obj, vm);
+
+            break;
+        }case NATIVE_OBJ_TYPE:{
+            NativeObj *native_obj = OBJ_TO_NATIVE(target_obj);
+            NativeHeader *native_header = native_obj->native;
+
+            switch (native_header->type) {
+                case NBARRAY_NATIVE_TYPE:{
+                    if(!IS_VALUE_INT(idx_value)){
+                        vmu_error(vm, "Expect index value of type 'int'");
+                    }
+
+                    if(!IS_VALUE_INT(value)){
+                        vmu_error(vm, "Expect assignment value of type 'int'");
+                    }
+
+                    NBArrayNative *nbarray_native = (NBArrayNative *)native_header;
+                    int64_t idx = VALUE_TO_INT(idx_value);
+                    int64_t assing_value = VALUE_TO_INT(value);
+
+                    if(idx < 0 || (size_t)idx >= nbarray_native->len){
+                        vmu_error(vm, "Index out of bounds");
+                    }
+
+                    nbarray_native->bytes[(size_t)idx] = (unsigned char)assing_value;
+
+                    break;
+                }default:{
+                    vmu_error(vm, "Illegal assignment target");
+                    break;
+                }
+            }
+
+            break;
+        }default:{
+            vmu_error(vm, "Illegal assignment target");
+        }
+    }
+
+    pop(vm);
+    pop(vm);
+}
+
+void get_index(VM *vm){
+    Value target_value = peek_at(0, vm);
+    Value idx_value = peek_at(1, vm);
+    Value out_value = {0};
+
+    if(!IS_VALUE_OBJ(target_value)){
+        vmu_error(vm, "Expect object");
+    }
+
+    Obj *target_obj = VALUE_TO_OBJ(target_value);
+
+    switch (target_obj->type) {
+        case ARRAY_OBJ_TYPE:{
+            if(!IS_VALUE_INT(idx_value)){
+                vmu_error(vm, "Expect 'INT' as index");
+            }
+
+            int64_t idx = VALUE_TO_INT(idx_value);
+            ArrayObj *array_obj = VALUE_TO_ARRAY(target_value);
+            out_value = vmu_array_get_at(idx, array_obj, vm);
+
+            break;
+        }case LIST_OBJ_TYPE:{
+            if(!IS_VALUE_INT(idx_value)){
+                vmu_error(vm, "Expect 'INT' as index");
+            }
+
+            int64_t idx = VALUE_TO_INT(idx_value);
+            ListObj *list_obj = VALUE_TO_LIST(target_value);
+            out_value = vmu_list_get_at(idx, list_obj, vm);
+
+            break;
+        }case DICT_OBJ_TYPE:{
+            DictObj *dict_obj = VALUE_TO_DICT(target_value);
+            out_value = vmu_dict_get(idx_value, dict_obj, vm);
+
+            break;
+        }case STR_OBJ_TYPE:{
+            if(!IS_VALUE_INT(idx_value)){
+                vmu_error(vm, "Expect 'INT' as index");
+            }
+
+            int64_t idx = VALUE_TO_INT(idx_value);
+            StrObj *old_str_obj = VALUE_TO_STR(target_value);
+            StrObj *new_str_obj = vmu_str_char(idx, old_str_obj, vm);
+            out_value = OBJ_VALUE(new_str_obj);
+
+            break;
+        }case NATIVE_OBJ_TYPE:{
+            NativeObj *native_obj = OBJ_TO_NATIVE(target_obj);
+            NativeHeader *native_header = native_obj->native;
+
+            switch (native_header->type) {
+                case NBARRAY_NATIVE_TYPE:{
+                    NBArrayNative *nbuff_native = (NBArrayNative *)native_header;
+
+                    if(!IS_VALUE_INT(idx_value)){
+                        vmu_error(vm, "Expect 'INT' as index");
+                    }
+
+                    int64_t idx = VALUE_TO_INT(idx_value);
+
+                    if(idx < 0 || (size_t)idx >= nbuff_native->len){
+                        vmu_error(vm, "Index out of bounds");
+                    }
+
+                    out_value = INT_VALUE(nbuff_native->bytes[(size_t)idx]);
+
+                    break;
+                }default:{
+                    vmu_error(vm, "Illegal native type");
+                    break;
+                }
+            }
+
+            break;
+        }default:{
+            vmu_error(vm, "Illegal target to index");
+        }
+    }
+
+    pop(vm);
+    pop(vm);
+    push(out_value, vm);
+}
+
+void access_target(VM *vm){
+    Value target_value = peek(vm);
+
+    if(!IS_VALUE_OBJ(target_value)){
+        vmu_error(vm, "Expect object as target of access");
+    }
+
+    size_t key_size;
+    char *key = read_str(vm, &key_size);
+    AccessCache *cache = read_cache(vm);
+    Obj *target_obj = VALUE_TO_OBJ(target_value);
+
+    switch (target_obj->type){
+        case STR_OBJ_TYPE:
+        case ARRAY_OBJ_TYPE:
+        case LIST_OBJ_TYPE:
+        case DICT_OBJ_TYPE:{
+            NativeFn *native_fn = builtin_method(target_obj->type, key_size, key, cache, vm);
+            NativeFnObj *native_fn_obj = vmu_create_native_fn(target_value, native_fn, vm);
+
+            pop(vm);
+            PUSH_OBJ(native_fn_obj, vm);
+
+            break;
+        }default:{
+            Value out_value = access_symbol(target_obj, key_size, key, cache, vm);
+
+            pop(vm);
+            push(out_value, vm);
+
+            break;
+        }
+    }
+}
+
+// Returns what call_value does if the method was called through it.
+// Otherwise its result is pushed and 0 is returned
+int invoke(VM *vm){
+    uint8_t args_count = advance(vm);
+    Value *target_ptr = peek_at_ptr(args_count, vm);
+    Value target_value = *target_ptr;
+
+    if(!IS_VALUE_OBJ(target_value)){
+        vmu_error(vm, "Expect object as target of access");
+    }
+
+    size_t key_size;
+    char *key = read_str(vm, &key_size);
+    AccessCache *cache = read_cache(vm);
+    Obj *target_obj = VALUE_TO_OBJ(target_value);
+
+    switch (target_obj->type){
+        case STR_OBJ_TYPE:
+        case ARRAY_OBJ_TYPE:
+        case LIST_OBJ_TYPE:
+        case DICT_OBJ_TYPE:{
+            NativeFn *native_fn = builtin_method(target_obj->type, key_size, key, cache, vm);
+            Value return_value = call_native(args_count, native_fn, target_value, vm);
+
+            vm->stack_top = target_ptr;
+
+            push(return_value, vm);
+
+            return 0;
+        }default:{
+            // The symbol takes the place of the target, as if it were accessed
+            *target_ptr = access_symbol(target_obj, key_size, key, cache, vm);
+            return call_value(args_count, vm);
+        }
+    }
+}
+
+// Returns 1 if the frame was the last one
+int return_frame(VM *vm){
+    OutValue *current_out = NULL;
+    OutValue *next_out = NULL;
+
+    while(current_out){
+        next_out = current_out->next;
+
+        current_out->linked = 0;
+        remove_value_from_current_frame(current_out, vm);
+
+        current_out = next_out;
+    }
+
+    Value result_value = pop(vm);
+    Frame *frame = current_frame(vm);
+
+    vm->stack_top = frame->locals;
+
+    pop_frame(vm);
+
+    if(vm->modules_stack_len > 1){
+        Module *module = vm->modules_stack;
+
+        vm->modules_stack_len--;
+        vm->modules_stack = module->prev;
+
+        module->prev = NULL;
+        module->submodule->resolved = 1;
+
+        return 0;
+    }
+
+    push(result_value, vm);
+
+    // The result of the last frame is left for vm_invoke
+    return vm->frame_ptr == vm->frame_stack;
+}
+
+// See JitStep. The instructions are executed with the generic semantics,
+// so the code does not care if the interpreter quickened them since
+int jit_step(VM *vm){
+    if(vm->gc_request){
+        gc_safepoint(vm);
+    }
+
+    uint8_t opcode = advance_save(vm);
+
+    switch (opcode){
+        case OP_ADD:
+        case OP_ADD_II:
+        case OP_ADD_FF:
+        case OP_SUB:
+        case OP_SUB_II:
+        case OP_SUB_FF:
+        case OP_MUL:
+        case OP_MUL_II:
+        case OP_MUL_FF:
+        case OP_DIV:
+        case OP_MOD:{
+            Value right_value = pop(vm);
+            Value left_value = pop(vm);
+
+            push(arithmetic(jit_generic_opcode(opcode), left_value, right_value, vm), vm);
+
+            return 0;
+        }case OP_LT:
+         case OP_LT_II:
+         case OP_LT_FF:
+         case OP_GT:
+         case OP_GT_II:
+         case OP_GT_FF:
+         case OP_LE:
+         case OP_LE_II:
+         case OP_LE_FF:
+         case OP_GE:
+         case OP_GE_II:
+         case OP_GE_FF:{
+            Value right_value = pop(vm);
+            Value left_value = pop(vm);
+
+            PUSH_BOOL(compare(jit_generic_opcode(opcode), left_value, right_value, vm), vm);
+
+            return 0;
+        }case OP_EQ:
+         case OP_NE:{
+            Value right_value = pop(vm);
+            Value left_value = pop(vm);
+            int result = equals(opcode, left_value, right_value, vm);
+
+            PUSH_BOOL(opcode == OP_EQ ? result : !result, vm);
+
+            return 0;
+        }case OP_INCL:{
+            Value *local = frame_local(advance(vm), vm);
+            *local = arithmetic(OP_ADD, *local, INT_VALUE(1), vm);
+            return 0;
+        }case OP_RADD:
+         case OP_RSUB:
+         case OP_RMUL:
+         case OP_RDIV:
+         case OP_RMOD:{
+            Value *dst = frame_register(advance(vm), vm);
+            Value left_value = *frame_register(advance(vm), vm);
+            Value right_value = *frame_register(advance(vm), vm);
+
+            *dst = arithmetic(jit_generic_opcode(opcode), left_value, right_value, vm);
+
+            return 0;
+        }case OP_RADDK:
+         case OP_RSUBK:{
+            Value *dst = frame_register(advance(vm), vm);
+            Value left_value = *frame_register(advance(vm), vm);
+            int64_t right = (int64_t)advance(vm);
+
+            *dst = arithmetic(jit_generic_opcode(opcode), left_value, INT_VALUE(right), vm);
+
+            return 0;
+        }case OP_GSET:{
+            set_global(vm);
+            return 0;
+        }case OP_GGET:{
+            get_global(vm);
+            return 0;
+        }case OP_ASET:{
+            set_index(vm);
+            return 0;
+        }case OP_INDEX:{
+            get_index(vm);
+            return 0;
+        }case OP_ACCESS:{
+            access_target(vm);
+            return 0;
+        }case OP_CALL:
+         case OP_INVOKE:{
+            Frame *frame = current_frame(vm);
+
+            if(opcode == OP_CALL){
+                call_value(advance(vm), vm);
+            }else{
+                invoke(vm);
+            }
+
+            if(current_frame(vm) == frame){
+                return 0;
+            }
+
+            // Deep recursion goes on in the interpreter, which does not grow the C stack
+            int status = vm->jit && vm->jit_nesting < JIT_NESTING_LENGTH ? run_jit(vm) : INTERPRET_JIT_STATUS;
+
+            return status == RETURNED_JIT_STATUS ? 0 : status;
+        }case OP_TCALL:{
+            Frame *frame = current_frame(vm);
+
+            if(tail_call(advance(vm), vm)){
+                return HALT_JIT_STATUS;
+            }
+
+            // A reused frame is left to the interpreter, which runs the code
+            // of its new function: entering it from here would nest the C
+            // stack once per tail call
+            return vm->frame_ptr - 1 == frame ? INTERPRET_JIT_STATUS : RETURNED_JIT_STATUS;
+        }case OP_RET:{
+            return return_frame(vm) ? HALT_JIT_STATUS : RETURNED_JIT_STATUS;
+        }case OP_NEXT:{
+            uint8_t which = advance(vm);
+            int16_t jmp_value = read_i16(vm);
+
+            if(iterate(which, vm)){
+                return 0;
+            }
+
+            // The end of the loop is left to the interpreter
+            current_frame(vm)->ip += jmp_value;
+
+            return INTERPRET_JIT_STATUS;
+        }default:{
+            vmu_internal_error(vm, "Unexpected opcode for the JIT");
+            return INTERPRET_JIT_STATUS;
+        }
+    }
+}
+
+// Runs the machine code of the current frame, compiling its function if it
+// got hot. Returns INTERPRET_JIT_STATUS if the function has no code
+int run_jit(VM *vm){
+    Frame *frame = current_frame(vm);
+    Fn *fn = (Fn *)frame->fn;
+
+    // The recorder must see every instruction
+    if(vm->recorder){
+        return INTERPRET_JIT_STATUS;
+    }
+
+    if(!fn->jit_code){
+        if(frame->ip == 0){
+            fn->hotness++;
+        }
+
+        if(fn->hotness < JIT_HOT_THRESHOLD || fn->jit_failed){
+            return INTERPRET_JIT_STATUS;
+        }
+
+        JitCode *jit_code = jit_compile(fn, jit_step, gc_safepoint, vm->allocator);
+
+        if(!jit_code){
+            fn->jit_failed = 1;
+            return INTERPRET_JIT_STATUS;
+        }
+
+        jit_code->next = vm->jit_codes;
+        vm->jit_codes = jit_code;
+        fn->jit_code = jit_code;
+    }
+
+    vm->jit_nesting++;
+
+    int status = jit_run(fn->jit_code, frame, vm);
+
+    vm->jit_nesting--;
+
+    return status;
+}
+
+// Of the loop of 'fn' whose header is at 'header', created the first time
+JitLoop *jit_loop(size_t header, const Fn *fn, VM *vm){
+    DynArr *loops = fn->jit_loops;
+
+    if(!loops){
+        loops = MEMORY_DYNARR_TYPE(vm->allocator, JitLoop);
+
+        if(!loops){
+            vmu_internal_error(vm, "Failed to trace loop: out of memory");
+        }
+
+        ((Fn *)fn)->jit_loops = loops;
+    }
+
+    size_t loops_len = dynarr_len(loops);
+
+    for (size_t i = 0; i < loops_len; i++){
+        JitLoop *loop = (JitLoop *)dynarr_get_raw(loops, i);
+
+        if(loop->header == header){
+            return loop;
+        }
+    }
+
+    JitLoop loop = {
+        .header = header,
+        .hotness = 0,
+        .aborts = 0,
+        .trace = NULL
+    };
+
+    if(dynarr_insert(loops, &loop)){
+        vmu_internal_error(vm, "Failed to trace loop: out of memory");
+    }
+
+    return (JitLoop *)dynarr_get_raw(loops, loops_len);
+}
+
+void stop_recording(VM *vm){
+    JitRecorder *recorder = vm->recorder;
+
+    if(!recorder){
+        return;
+    }
+
+    vm->recorder = NULL;
+
+    dynarr_destroy(recorder->ops);
+    MEMORY_DEALLOC(vm->allocator, JitRecorder, 1, recorder);
+}
+
+// Called after a backward jump of the interpreter, with the ip of the current
+// frame at the header of the loop. Runs the trace of the loop, or starts to
+// record it once it got hot. Returns 0 if the interpreter must just continue,
+// else the JitStatus of the trace
+int run_trace(VM *vm){
+    Frame *frame = current_frame(vm);
+    const Fn *fn = frame->fn;
+    JitLoop *loop = jit_loop(frame->ip, fn, vm);
+
+    if(loop->trace){
+        return jit_run_trace(loop->trace, frame, vm);
+    }
+
+    if(vm->recorder || loop->aborts >= JIT_TRACE_ATTEMPTS || ++loop->hotness < JIT_TRACE_THRESHOLD){
+        return 0;
+    }
+
+    JitRecorder *recorder = MEMORY_ALLOC(vm->allocator, JitRecorder, 1);
+    DynArr *ops = MEMORY_DYNARR_TYPE(vm->allocator, TraceOp);
+
+    if(!recorder || !ops){
+        MEMORY_DEALLOC(vm->allocator, JitRecorder, 1, recorder);
+        dynarr_destroy(ops);
+        vmu_internal_error(vm, "Failed to record loop: out of memory");
+    }
+
+    *recorder = (JitRecorder){
+        .fn = fn,
+        .frame = frame,
+        .header = frame->ip,
+        .ops = ops
+    };
+
+    vm->recorder = recorder;
+
+    return 0;
+}
+
+static int execute(VM *vm){
+#if defined(THREADED_DISPATCH) && defined(__GNUC__)
+    #pragma GCC diagnostic push
+    #pragma GCC diagnostic ignored "-Woverride-init"
+    static void *dispatch_table[256] = {
+        [0 ... 255] = &&DEFAULT_LABEL,
+        [OP_EMPTY] = &&OP_EMPTY_LABEL,
+        [OP_FALSE] = &&OP_FALSE_LABEL,
+        [OP_TRUE] = &&OP_TRUE_LABEL,
+        [OP_CINT] = &&OP_CINT_LABEL,
+        [OP_INT] = &&OP_INT_LABEL,
+        [OP_FLOAT] = &&OP_FLOAT_LABEL,
+        [OP_STRING] = &&OP_STRING_LABEL,
+        [OP_STTE] = &&OP_STTE_LABEL,
+        [OP_ETTE] = &&OP_ETTE_LABEL,
+        [OP_ARRAY] = &&OP_ARRAY_LABEL,
+        [OP_LIST] = &&OP_LIST_LABEL,
+        [OP_DICT] = &&OP_DICT_LABEL,
+        [OP_RECORD] = &&OP_RECORD_LABEL,
+        [OP_WTTE] = &&OP_WTTE_LABEL,
+        [OP_IARRAY] = &&OP_IARRAY_LABEL,
+        [OP_ILIST] = &&OP_ILIST_LABEL,
+        [OP_IDICT] = &&OP_IDICT_LABEL,
+        [OP_IRECORD] = &&OP_IRECORD_LABEL,
+        [OP_CONCAT] = &&OP_CONCAT_LABEL,
+        [OP_MULSTR] = &&OP_MULSTR_LABEL,
+        [OP_ADD] = &&OP_ADD_LABEL,
+        [OP_SUB] = &&OP_SUB_LABEL,
+        [OP_MUL] = &&OP_MUL_LABEL,
+        [OP_DIV] = &&OP_DIV_LABEL,
+        [OP_MOD] = &&OP_MOD_LABEL,
+        [OP_BNOT] = &&OP_BNOT_LABEL,
+        [OP_LSH] = &&OP_LSH_LABEL,
+        [OP_RSH] = &&OP_RSH_LABEL,
+        [OP_BAND] = &&OP_BAND_LABEL,
+        [OP_BXOR] = &&OP_BXOR_LABEL,
+        [OP_BOR] = &&OP_BOR_LABEL,
+        [OP_LT] = &&OP_LT_LABEL,
+        [OP_GT] = &&OP_GT_LABEL,
+        [OP_LE] = &&OP_LE_LABEL,
+        [OP_GE] = &&OP_GE_LABEL,
+        [OP_EQ] = &&OP_EQ_LABEL,
+        [OP_NE] = &&OP_NE_LABEL,
+        [OP_OR] = &&OP_OR_LABEL,
+        [OP_AND] = &&OP_AND_LABEL,
+        [OP_NOT] = &&OP_NOT_LABEL,
+        [OP_NNOT] = &&OP_NNOT_LABEL,
+        [OP_LSET] = &&OP_LSET_LABEL,
+        [OP_LGET] = &&OP_LGET_LABEL,
+        [OP_OSET] = &&OP_OSET_LABEL,
+        [OP_OGET] = &&OP_OGET_LABEL,
+        [OP_GDEF] = &&OP_GDEF_LABEL,
+        [OP_GASET] = &&OP_GASET_LABEL,
+        [OP_GSET] = &&OP_GSET_LABEL,
+        [OP_GGET] = &&OP_GGET_LABEL,
+        [OP_NGET] = &&OP_NGET_LABEL,
+        [OP_SGET] = &&OP_SGET_LABEL,
+        [OP_ASET] = &&OP_ASET_LABEL,
+        [OP_RSET] = &&OP_RSET_LABEL,
+        [OP_POP] = &&OP_POP_LABEL,
+        [OP_JMP] = &&OP_JMP_LABEL,
+        [OP_JIF] = &&OP_JIF_LABEL,
+        [OP_JIT] = &&OP_JIT_LABEL,
+        [OP_CALL] = &&OP_CALL_LABEL,
+        [OP_TCALL] = &&OP_TCALL_LABEL,
+        [OP_ACCESS] = &&OP_ACCESS_LABEL,
+        [OP_INVOKE] = &&OP_INVOKE_LABEL,
+        [OP_INDEX] = &&OP_INDEX_LABEL,
+        [OP_RET] = &&OP_RET_LABEL,
+        [OP_IS] = &&OP_IS_LABEL,
+        [OP_TRYO] = &&OP_TRYO_LABEL,
+        [OP_TRYC] = &&OP_TRYC_LABEL,
+        [OP_THROW] = &&OP_THROW_LABEL,
+        [OP_YIELD] = &&OP_YIELD_LABEL,
+        [OP_NEXT] = &&OP_NEXT_LABEL,
+        [OP_HLT] = &&OP_HLT_LABEL,
+        [OP_INCL] = &&OP_INCL_LABEL,
+        [OP_LGET2] = &&OP_LGET2_LABEL,
+        [OP_LT_LL_JIF] = &&OP_LT_LL_JIF_LABEL,
+        [OP_GE_LL_JIT] = &&OP_GE_LL_JIT_LABEL,
+        [OP_RMOV] = &&OP_RMOV_LABEL,
+        [OP_RCINT] = &&OP_RCINT_LABEL,
+        [OP_RINT] = &&OP_RINT_LABEL,
+        [OP_RFLOAT] = &&OP_RFLOAT_LABEL,
+        [OP_RADD] = &&OP_RADD_LABEL,
+        [OP_RSUB] = &&OP_RSUB_LABEL,
+        [OP_RMUL] = &&OP_RMUL_LABEL,
+        [OP_RDIV] = &&OP_RDIV_LABEL,
+        [OP_RMOD] = &&OP_RMOD_LABEL,
+        [OP_RADDK] = &&OP_RADDK_LABEL,
+        [OP_RSUBK] = &&OP_RSUBK_LABEL,
+        [OP_RJNLT] = &&OP_RJNLT_LABEL,
+        [OP_RJNGT] = &&OP_RJNGT_LABEL,
+        [OP_RJNLE] = &&OP_RJNLE_LABEL,
+        [OP_RJNGE] = &&OP_RJNGE_LABEL,
+        [OP_ADD_II] = &&OP_ADD_II_LABEL,
+        [OP_ADD_FF] = &&OP_ADD_FF_LABEL,
+        [OP_SUB_II] = &&OP_SUB_II_LABEL,
+        [OP_SUB_FF] = &&OP_SUB_FF_LABEL,
+        [OP_MUL_II] = &&OP_MUL_II_LABEL,
+        [OP_MUL_FF] = &&OP_MUL_FF_LABEL,
+        [OP_LT_II] = &&OP_LT_II_LABEL,
+        [OP_LT_FF] = &&OP_LT_FF_LABEL,
+        [OP_GT_II] = &&OP_GT_II_LABEL,
+        [OP_GT_FF] = &&OP_GT_FF_LABEL,
+        [OP_LE_II] = &&OP_LE_II_LABEL,
+        [OP_LE_FF] = &&OP_LE_FF_LABEL,
+        [OP_GE_II] = &&OP_GE_II_LABEL,
+        [OP_GE_FF] = &&OP_GE_FF_LABEL,
+    };
+    #pragma GCC diagnostic pop
+
+    Frame *frame;
+    const uint8_t *chunks;
+    size_t chunks_len;
+#endif
+
+    // Errors and throws leave the machine code through longjmp
+    vm->jit_nesting = 0;
+
+    for (;;){
+        // Between instructions every live object is reachable from the
+        // stack, the globals or the remembered set, so it is safe to
+        // sweep here and not in the middle of an allocation
+        if(vm->gc_request){
+            gc_safepoint(vm);
+        }
+
+        if(vm->jit){
+            int status = run_jit(vm);
+
+            if(status == HALT_JIT_STATUS){
+                return vm->exit_code;
+            }
+
+            if(status == RETURNED_JIT_STATUS){
+                continue;
+            }
+        }
+
+#if defined(THREADED_DISPATCH) && defined(__GNUC__)
+        // Handlers that change the current frame (calls and returns) 'break'
+        // back here, so the cached frame and chunks get reloaded.
+        frame = current_frame(vm);
+        chunks = dynarr_get_raw(frame->fn->chunks, 0);
+        chunks_len = dynarr_len(frame->fn->chunks);
+
+        uint8_t chunk = fetch(frame, chunks, chunks_len, vm);
+#else
+        uint8_t chunk = advance_save(vm);
+#endif
+
+        switch (chunk){
+            VM_CASE(OP_EMPTY):{
+                PUSH_EMPTY(vm);
+                VM_NEXT();
+            }VM_CASE(OP_FALSE):{
+                PUSH_BOOL(0, vm);
+                VM_NEXT();
+            }VM_CASE(OP_TRUE):{
+                PUSH_BOOL(1, vm);
+                VM_NEXT();
+            }VM_CASE(OP_CINT):{
+                int64_t i64 = (int64_t)advance(vm);
+                PUSH_INT(i64, vm);
+                VM_NEXT();
+            }VM_CASE(OP_INT):{
+                int64_t i64 = read_i64_const(vm);
+                PUSH_INT(i64, vm);
+                VM_NEXT();
+            }VM_CASE(OP_FLOAT):{
+                double value = read_float_const(vm);
+                PUSH_FLOAT(value, vm);
+                VM_NEXT();
+            }VM_CASE(OP_STRING):{
+                size_t len;
+                StrObj *str_obj = NULL;
+                char *str = read_str(vm, &len);
+
+                vmu_create_str(0, len, str, vm, &str_obj);
+                PUSH_OBJ(str_obj, vm);
+
+                VM_NEXT();
+            }VM_CASE(OP_STTE):{
+                LZBStr *str = MEMORY_LZBSTR(vm->allocator);
+                Template *template = MEMORY_ALLOC(vm->allocator, Template, 1);
+
+                template->str = str;
+                template->prev = vm->templates;
+                vm->templates = template;
+
+                VM_NEXT();
+            }VM_CASE(OP_ETTE):{
+                Template *template = vm->templates;
+
+                if(template){
+                    LZBStr *str = template->str;
+                    size_t buff_len;
+                    char *buff = lzbstr_rclone_buff(
+                        (LZBStrAllocator *)&vm->front_allocator,
+                        str,
+                        &buff_len
+                    );
+                    StrObj *str_obj = NULL;
+
+                    if(vmu_create_str(1, buff_len, buff, vm, &str_obj)){
+                        MEMORY_DEALLOC(&vm->front_allocator, char, buff_len + 1, buff);
+                    }
+
+                    PUSH_OBJ(str_obj, vm);
+
+                    vm->templates = template->prev;
+
+                    lzbstr_destroy(str);
+                    MEMORY_DEALLOC(vm->allocator, Template, 1, template);
+
+                    VM_NEXT();
+                }
+
+                vmu_internal_error(vm, "Template stack is empty");
+
+                VM_NEXT();
+            }VM_CASE(OP_ARRAY):{
+                Value len_value = pop(vm);
+
+                if(!IS_VALUE_INT(len_value)){
+                    vmu_error(vm, "Expect 'INT' as array length");
+                }
+
+                int64_t array_len = VALUE_TO_INT(len_value);
+                ArrayObj *array_obj = vmu_create_array(array_len, vm);
+
+                PUSH_OBJ(array_obj, vm);
+
+                VM_NEXT();
+            }VM_CASE(OP_LIST):{
+                ListObj *list_obj = vmu_create_list(vm);
+                PUSH_OBJ(list_obj, vm);
+                VM_NEXT();
+            }VM_CASE(OP_DICT):{
+                DictObj *dict_obj = vmu_create_dict(vm);
+                PUSH_OBJ(dict_obj, vm);
+                VM_NEXT();
+            }VM_CASE(OP_RECORD):{
+                uint16_t len = (uint16_t)read_i16(vm);
+                RecordObj *record_obj = vmu_create_record(len, vm);
+                PUSH_OBJ(record_obj, vm);
+                VM_NEXT();
+            }VM_CASE(OP_WTTE):{
+                Template *template = vm->templates;
+                Value raw_value = pop(vm);
+
+                if(template){
+                    LZBStr *str = template->str;
+                    vmu_value_to_str_w(raw_value, str);
+                    VM_NEXT();
+                }
+
+                vmu_internal_error(vm, "Template stack is empty");
+
+                VM_NEXT();
+            }VM_CASE(OP_IARRAY):{
+                int64_t idx = (int64_t)read_i16(vm);
+                Value value = pop(vm);
+                Value array_value = peek(vm);
+                ArrayObj *array_obj = VALUE_TO_ARRAY(array_value);
+
+                vmu_array_set_at(idx, value, array_obj, vm);
+
+                VM_NEXT();
+            }VM_CASE(OP_ILIST):{
+                Value value = peek_at(0, vm);
+                Value list_value = peek_at(1, vm);
+
+                if(!is_value_list(list_value)){
                     vmu_internal_error(vm, "Expect value of type 'dict', but got something else");
                 }
 
                 vmu_list_insert(value, VALUE_TO_LIST(list_value), vm);
                 pop(vm);
 
-                break;
-            }case OP_IDICT:{
+                VM_NEXT();
+            }VM_CASE(OP_IDICT):{
                 Value raw_value = peek_at(0, vm);
                 Value key_value = peek_at(1, vm);
                 Value dict_value = peek_at(2, vm);
@@ -617,10 +2348,11 @@ static int execute(VM *vm){
                 pop(vm);
                 pop(vm);
 
-                break;
-            }case OP_IRECORD:{
+                VM_NEXT();
+            }VM_CASE(OP_IRECORD):{
                 size_t key_size;
                 char *key = read_str(vm, &key_size);
+                AccessCache *cache = read_cache(vm);
                 Value raw_value = peek_at(0, vm);
                 Value record_value = peek_at(1, vm);
 
@@ -628,11 +2360,27 @@ static int execute(VM *vm){
                     vmu_internal_error(vm, "Expect value of type 'record', but got something else");
                 }
 
-                vmu_record_insert_attr(key_size, key, raw_value, VALUE_TO_RECORD(record_value), vm);
+                RecordObj *record_obj = VALUE_TO_RECORD(record_value);
+                Shape *shape = record_obj->shape;
+
+                // Literals insert their keys in the same order every time
+                if(cache->shape == shape && cache->offset < record_obj->len){
+                    record_obj->values[cache->offset] = raw_value;
+                    record_obj->shape = cache->next_shape;
+
+                    vmu_write_barrier((Obj *)record_obj, raw_value, vm);
+                }else{
+                    vmu_record_insert_attr(key_size, key, raw_value, record_obj, vm);
+                    shape_find(key_size, key, record_obj->shape, &cache->offset);
+
+                    cache->shape = shape;
+                    cache->next_shape = record_obj->shape;
+                }
+
                 pop(vm);
 
-                break;
-            }case OP_CONCAT:{
+                VM_NEXT();
+            }VM_CASE(OP_CONCAT):{
                 Value right_value = peek_at(0, vm);
                 Value left_value = peek_at(1, vm);
 
@@ -645,7 +2393,7 @@ static int execute(VM *vm){
                     pop(vm);
                     PUSH_OBJ(result_str_obj, vm);
 
-                    break;
+                    VM_NEXT();
                 }
 
                 if(is_value_array(left_value) && is_value_array(right_value)){
@@ -657,7 +2405,7 @@ static int execute(VM *vm){
                     pop(vm);
                     PUSH_OBJ(new_array_obj, vm);
 
-                    break;
+                    VM_NEXT();
                 }
 
                 if(is_value_list(left_value) && is_value_list(right_value)){
@@ -669,7 +2417,7 @@ static int execute(VM *vm){
                     pop(vm);
                     PUSH_OBJ(new_list_obj, vm);
 
-                    break;
+                    VM_NEXT();
                 }
 
                 if(is_value_array(left_value) || is_value_array(right_value)){
@@ -690,7 +2438,7 @@ static int execute(VM *vm){
                     pop(vm);
                     PUSH_OBJ(new_array_obj, vm);
 
-                    break;
+                    VM_NEXT();
                 }
 
                 if(is_value_list(left_value) || is_value_list(right_value)){
@@ -711,13 +2459,13 @@ static int execute(VM *vm){
                     pop(vm);
                     PUSH_OBJ(new_list_obj, vm);
 
-                    break;
+                    VM_NEXT();
                 }
 
                 vmu_error(vm, "Illegal operands for concatenation");
 
-                break;
-            }case OP_MULSTR:{
+                VM_NEXT();
+            }VM_CASE(OP_MULSTR):{
                 Value right_value = peek_at(0, vm);
                 Value left_value = peek_at(1, vm);
 
@@ -730,7 +2478,7 @@ static int execute(VM *vm){
                     pop(vm);
                     PUSH_OBJ(new_str_obj, vm);
 
-                    break;
+                    VM_NEXT();
                 }
 
                 if(is_value_str(left_value) && IS_VALUE_INT(right_value)){
@@ -742,13 +2490,13 @@ static int execute(VM *vm){
                     pop(vm);
                     PUSH_OBJ(new_str_obj, vm);
 
-                    break;
+                    VM_NEXT();
                 }
 
                 vmu_error(vm, "Illegal operands for string multiplication");
 
-                break;
-            }case OP_ADD:{
+                VM_NEXT();
+            }VM_CASE(OP_ADD):{
                 Value right_value = pop(vm);
                 Value left_value = pop(vm);
 
@@ -756,18 +2504,20 @@ static int execute(VM *vm){
                     int64_t left = VALUE_TO_INT(left_value);
                     int64_t right = VALUE_TO_INT(right_value);
 
+                    quicken(OP_ADD_II, vm);
                     push(INT_VALUE(left + right), vm);
 
-                    break;
+                    VM_NEXT();
                 }
 
                 if(IS_VALUE_FLOAT(left_value) && IS_VALUE_FLOAT(right_value)){
                     double left = VALUE_TO_FLOAT(left_value);
                     double right = VALUE_TO_FLOAT(right_value);
 
+                    quicken(OP_ADD_FF, vm);
                     push(FLOAT_VALUE(left + right), vm);
 
-                    break;
+                    VM_NEXT();
                 }
 
                 if((IS_VALUE_INT(left_value) || IS_VALUE_FLOAT(left_value)) &&
@@ -786,13 +2536,13 @@ static int execute(VM *vm){
 
                     push(FLOAT_VALUE(left + right), vm);
 
-                    break;
+                    VM_NEXT();
                 }
 
                 vmu_error(vm, "Unsuported types using + operator");
 
-                break;
-            }case OP_SUB:{
+                VM_NEXT();
+            }VM_CASE(OP_SUB):{
                 Value right_value = pop(vm);
                 Value left_value = pop(vm);
 
@@ -800,18 +2550,20 @@ static int execute(VM *vm){
                     int64_t left = VALUE_TO_INT(left_value);
                     int64_t right = VALUE_TO_INT(right_value);
 
+                    quicken(OP_SUB_II, vm);
                     push(INT_VALUE(left - right), vm);
 
-                    break;
+                    VM_NEXT();
                 }
 
                 if(IS_VALUE_FLOAT(left_value) && IS_VALUE_FLOAT(right_value)){
                     double left = VALUE_TO_FLOAT(left_value);
                     double right = VALUE_TO_FLOAT(right_value);
 
+                    quicken(OP_SUB_FF, vm);
                     push(FLOAT_VALUE(left - right), vm);
 
-                    break;
+                    VM_NEXT();
                 }
 
                 if((IS_VALUE_INT(left_value) || IS_VALUE_FLOAT(left_value)) &&
@@ -830,13 +2582,13 @@ static int execute(VM *vm){
 
                     push(FLOAT_VALUE(left - right), vm);
 
-                    break;
+                    VM_NEXT();
                 }
 
                 vmu_error(vm, "Unsuported types using - operator");
 
-                break;
-            }case OP_MUL:{
+                VM_NEXT();
+            }VM_CASE(OP_MUL):{
                 Value right_value = pop(vm);
                 Value left_value = pop(vm);
 
@@ -844,18 +2596,20 @@ static int execute(VM *vm){
                     int64_t left = VALUE_TO_INT(left_value);
                     int64_t right = VALUE_TO_INT(right_value);
 
+                    quicken(OP_MUL_II, vm);
                     push(INT_VALUE(left * right), vm);
 
-                    break;
+                    VM_NEXT();
                 }
 
                 if(IS_VALUE_FLOAT(left_value) && IS_VALUE_FLOAT(right_value)){
                     double left = VALUE_TO_FLOAT(left_value);
                     double right = VALUE_TO_FLOAT(right_value);
 
+                    quicken(OP_MUL_FF, vm);
                     push(FLOAT_VALUE(left * right), vm);
 
-                    break;
+                    VM_NEXT();
                 }
 
                 if((IS_VALUE_INT(left_value) || IS_VALUE_FLOAT(left_value)) &&
@@ -874,13 +2628,13 @@ static int execute(VM *vm){
 
                     push(FLOAT_VALUE(left * right), vm);
 
-                    break;
+                    VM_NEXT();
                 }
 
                 vmu_error(vm, "Unsuported types using * operator");
 
-                break;
-            }case OP_DIV:{
+                VM_NEXT();
+            }VM_CASE(OP_DIV):{
                 Value right_value = pop(vm);
                 Value left_value = pop(vm);
 
@@ -894,7 +2648,7 @@ static int execute(VM *vm){
 
                     push(INT_VALUE(left / right), vm);
 
-                    break;
+                    VM_NEXT();
                 }
 
                 if(IS_VALUE_FLOAT(left_value) && IS_VALUE_FLOAT(right_value)){
@@ -903,7 +2657,7 @@ static int execute(VM *vm){
 
                     push(FLOAT_VALUE(left / right), vm);
 
-                    break;
+                    VM_NEXT();
                 }
 
                 if((IS_VALUE_INT(left_value) || IS_VALUE_FLOAT(left_value)) &&
@@ -926,13 +2680,13 @@ static int execute(VM *vm){
 
                     push(FLOAT_VALUE(left / right), vm);
 
-                    break;
+                    VM_NEXT();
                 }
 
                 vmu_error(vm, "Unsuported types using / operator");
 
-                break;
-            }case OP_MOD:{
+                VM_NEXT();
+            }VM_CASE(OP_MOD):{
                 Value right_value = pop(vm);
                 Value left_value = pop(vm);
 
@@ -942,24 +2696,24 @@ static int execute(VM *vm){
 
                     push(INT_VALUE(left % right), vm);
 
-                    break;
+                    VM_NEXT();
                 }
 
                 vmu_error(vm, "Unsuported types using 'mod' operator");
 
-                break;
-            }case OP_BNOT:{
+                VM_NEXT();
+            }VM_CASE(OP_BNOT):{
                 Value value = pop(vm);
 
                 if(IS_VALUE_INT(value)){
                     PUSH_INT(~VALUE_TO_INT(value), vm);
-                    break;
+                    VM_NEXT();
                 }
 
                 vmu_error(vm, "Unsuported types using '~' operator");
 
-                break;
-            }case OP_LSH:{
+                VM_NEXT();
+            }VM_CASE(OP_LSH):{
                 Value right_value = pop(vm);
                 Value left_value = pop(vm);
 
@@ -969,13 +2723,13 @@ static int execute(VM *vm){
 
                     PUSH_INT(left << right, vm);
 
-                    break;
+                    VM_NEXT();
                 }
 
                 vmu_error(vm, "Unsuported types using '<<' operator");
 
-                break;
-            }case OP_RSH:{
+                VM_NEXT();
+            }VM_CASE(OP_RSH):{
                 Value right_value = pop(vm);
                 Value left_value = pop(vm);
 
@@ -985,13 +2739,13 @@ static int execute(VM *vm){
 
                     PUSH_INT(left >> right, vm);
 
-                    break;
+                    VM_NEXT();
                 }
 
                 vmu_error(vm, "Unsuported types using '>>' operator");
 
-                break;
-            }case OP_BAND:{
+                VM_NEXT();
+            }VM_CASE(OP_BAND):{
                 Value right_value = pop(vm);
                 Value left_value = pop(vm);
 
@@ -1001,13 +2755,13 @@ static int execute(VM *vm){
 
                     PUSH_INT(left & right, vm);
 
-                    break;
+                    VM_NEXT();
                 }
 
                 vmu_error(vm, "Unsuported types using '&' operator");
 
-                break;
-            }case OP_BXOR:{
+                VM_NEXT();
+            }VM_CASE(OP_BXOR):{
                 Value right_value = pop(vm);
                 Value left_value = pop(vm);
 
@@ -1017,13 +2771,13 @@ static int execute(VM *vm){
 
                     PUSH_INT(left ^ right, vm);
 
-                    break;
+                    VM_NEXT();
                 }
 
                 vmu_error(vm, "Unsuported types using '^' operator");
 
-                break;
-            }case OP_BOR:{
+                VM_NEXT();
+            }VM_CASE(OP_BOR):{
                 Value right_value = pop(vm);
                 Value left_value = pop(vm);
 
@@ -1033,13 +2787,13 @@ static int execute(VM *vm){
 
                     PUSH_INT(left | right, vm);
 
-                    break;
+                    VM_NEXT();
                 }
 
                 vmu_error(vm, "Unsuported types using '|' operator");
 
-                break;
-            }case OP_LT:{
+                VM_NEXT();
+            }VM_CASE(OP_LT):{
                 Value right_value = pop(vm);
                 Value left_value = pop(vm);
 
@@ -1047,18 +2801,20 @@ static int execute(VM *vm){
                     int64_t left = VALUE_TO_INT(left_value);
                     int64_t right = VALUE_TO_INT(right_value);
 
+                    quicken(OP_LT_II, vm);
                     PUSH_BOOL(left < right, vm);
 
-                    break;
+                    VM_NEXT();
                 }
 
                 if(IS_VALUE_FLOAT(left_value) && IS_VALUE_FLOAT(right_value)){
                     double left = VALUE_TO_FLOAT(left_value);
                     double right = VALUE_TO_FLOAT(right_value);
 
+                    quicken(OP_LT_FF, vm);
                     PUSH_BOOL(left < right, vm);
 
-                    break;
+                    VM_NEXT();
                 }
 
                 if((IS_VALUE_INT(left_value) || IS_VALUE_FLOAT(left_value)) &&
@@ -1077,13 +2833,13 @@ static int execute(VM *vm){
 
                     PUSH_BOOL(left < right, vm);
 
-                    break;
+                    VM_NEXT();
                 }
 
                 vmu_error(vm, "Unsuported types using < operator");
 
-                break;
-            }case OP_GT:{
+                VM_NEXT();
+            }VM_CASE(OP_GT):{
                 Value right_value = pop(vm);
                 Value left_value = pop(vm);
 
@@ -1091,18 +2847,20 @@ static int execute(VM *vm){
                     int64_t left = VALUE_TO_INT(left_value);
                     int64_t right = VALUE_TO_INT(right_value);
 
+                    quicken(OP_GT_II, vm);
                     PUSH_BOOL(left > right, vm);
 
-                    break;
+                    VM_NEXT();
                 }
 
                 if(IS_VALUE_FLOAT(left_value) && IS_VALUE_FLOAT(right_value)){
                     double left = VALUE_TO_FLOAT(left_value);
                     double right = VALUE_TO_FLOAT(right_value);
 
+                    quicken(OP_GT_FF, vm);
                     PUSH_BOOL(left > right, vm);
 
-                    break;
+                    VM_NEXT();
                 }
 
                 if((IS_VALUE_INT(left_value) || IS_VALUE_FLOAT(left_value)) &&
@@ -1121,13 +2879,13 @@ static int execute(VM *vm){
 
                     PUSH_BOOL(left > right, vm);
 
-                    break;
+                    VM_NEXT();
                 }
 
                 vmu_error(vm, "Unsuported types using > operator");
 
-                break;
-            }case OP_LE:{
+                VM_NEXT();
+            }VM_CASE(OP_LE):{
                 Value right_value = pop(vm);
                 Value left_value = pop(vm);
 
@@ -1135,18 +2893,20 @@ static int execute(VM *vm){
                     int64_t left = VALUE_TO_INT(left_value);
                     int64_t right = VALUE_TO_INT(right_value);
 
+                    quicken(OP_LE_II, vm);
                     PUSH_BOOL(left <= right, vm);
 
-                    break;
+                    VM_NEXT();
                 }
 
                 if(IS_VALUE_FLOAT(left_value) && IS_VALUE_FLOAT(right_value)){
                     double left = VALUE_TO_FLOAT(left_value);
                     double right = VALUE_TO_FLOAT(right_value);
 
+                    quicken(OP_LE_FF, vm);
                     PUSH_BOOL(left <= right, vm);
 
-                    break;
+                    VM_NEXT();
                 }
 
                 if((IS_VALUE_INT(left_value) || IS_VALUE_FLOAT(left_value)) &&
@@ -1165,147 +2925,34 @@ static int execute(VM *vm){
 
                     PUSH_BOOL(left <= right, vm);
 
-                    break;
+                    VM_NEXT();
                 }
 
                 vmu_error(vm, "Unsuported types using <= operator");
 
-                break;
-            }case OP_GE:{
-                Value right_value = pop(vm);
-                Value left_value = pop(vm);
-
-                if(IS_VALUE_INT(left_value) && IS_VALUE_INT(right_value)){
-                    int64_t left = VALUE_TO_INT(left_value);
-                    int64_t right = VALUE_TO_INT(right_value);
-
-                    PUSH_BOOL(left >= right, vm);
-
-                    break;
-                }
-
-                if(IS_VALUE_FLOAT(left_value) && IS_VALUE_FLOAT(right_value)){
-                    double left = VALUE_TO_FLOAT(left_value);
-                    double right = VALUE_TO_FLOAT(right_value);
-
-                    PUSH_BOOL(left >= right, vm);
-
-                    break;
-                }
-
-                if((IS_VALUE_INT(left_value) || IS_VALUE_FLOAT(left_value)) &&
-                   (IS_VALUE_INT(right_value) || IS_VALUE_FLOAT(right_value)))
-                {
-                    double left;
-                    double right;
-
-                    if(IS_VALUE_FLOAT(left_value)){
-                        left = VALUE_TO_FLOAT(left_value);
-                        right = (double)VALUE_TO_INT(right_value);
-                    }else{
-                        left = (double)VALUE_TO_INT(left_value);
-                        right = VALUE_TO_FLOAT(right_value);
-                    }
-
-                    PUSH_BOOL(left >= right, vm);
-
-                    break;
-                }
-
-                vmu_error(vm, "Unsuported types using >= operator");
-
-                break;
-            }case OP_EQ:{
-                Value right_value = pop(vm);
-                Value left_value = pop(vm);
-
-                if(IS_VALUE_BOOL(left_value) && IS_VALUE_BOOL(right_value)){
-                    uint8_t left = VALUE_TO_BOOL(left_value);
-                    uint8_t right = VALUE_TO_BOOL(right_value);
-
-                    PUSH_BOOL(left == right, vm);
-
-                    break;
-                }
-
-                if(IS_VALUE_INT(left_value) && IS_VALUE_INT(right_value)){
-                    int64_t left = VALUE_TO_INT(left_value);
-                    int64_t right = VALUE_TO_INT(right_value);
-
-                    PUSH_BOOL(left == right, vm);
-
-                    break;
-                }
-
-                if(IS_VALUE_FLOAT(left_value) && IS_VALUE_FLOAT(right_value)){
-                    double left = VALUE_TO_FLOAT(left_value);
-                    double right = VALUE_TO_FLOAT(right_value);
-
-                    PUSH_BOOL(left == right, vm);
-
-                    break;
-                }
-
-                if((IS_VALUE_INT(left_value) || IS_VALUE_FLOAT(left_value)) &&
-                   (IS_VALUE_INT(right_value) || IS_VALUE_FLOAT(right_value)))
-                {
-                    double left;
-                    double right;
-
-                    if(IS_VALUE_FLOAT(left_value)){
-                        left = VALUE_TO_FLOAT(left_value);
-                        right = (double)VALUE_TO_INT(right_value);
-                    }else{
-                        left = (double)VALUE_TO_INT(left_value);
-                        right = VALUE_TO_FLOAT(right_value);
-                    }
-
-                    PUSH_BOOL(left == right, vm);
-
-                    break;
-                }
-
-                if(is_value_str(left_value) && is_value_str(right_value)){
-                    StrObj *left = VALUE_TO_STR(left_value);
-                    StrObj *right = VALUE_TO_STR(right_value);
-
-                    PUSH_BOOL(left == right, vm);
-
-                    break;
-                }
-
-                vmu_error(vm, "Unsuported types using == operator");
-
-                break;
-            }case OP_NE:{
-                Value right_value = pop(vm);
-                Value left_value = pop(vm);
-
-                if(IS_VALUE_BOOL(left_value) && IS_VALUE_BOOL(right_value)){
-                    uint8_t left = VALUE_TO_BOOL(left_value);
-                    uint8_t right = VALUE_TO_BOOL(right_value);
-
-                    PUSH_BOOL(left != right, vm);
-
-                    break;
-                }
+                VM_NEXT();
+            }VM_CASE(OP_GE):{
+                Value right_value = pop(vm);
+                Value left_value = pop(vm);
 
                 if(IS_VALUE_INT(left_value) && IS_VALUE_INT(right_value)){
                     int64_t left = VALUE_TO_INT(left_value);
                     int64_t right = VALUE_TO_INT(right_value);
 
-                    PUSH_BOOL(left != right, vm);
+                    quicken(OP_GE_II, vm);
+                    PUSH_BOOL(left >= right, vm);
 
-                    break;
+                    VM_NEXT();
                 }
 
                 if(IS_VALUE_FLOAT(left_value) && IS_VALUE_FLOAT(right_value)){
                     double left = VALUE_TO_FLOAT(left_value);
                     double right = VALUE_TO_FLOAT(right_value);
 
-                    PUSH_BOOL(left != right, vm);
+                    quicken(OP_GE_FF, vm);
+                    PUSH_BOOL(left >= right, vm);
 
-                    break;
+                    VM_NEXT();
                 }
 
                 if((IS_VALUE_INT(left_value) || IS_VALUE_FLOAT(left_value)) &&
@@ -1322,24 +2969,29 @@ static int execute(VM *vm){
                         right = VALUE_TO_FLOAT(right_value);
                     }
 
-                    PUSH_BOOL(left != right, vm);
+                    PUSH_BOOL(left >= right, vm);
 
-                    break;
+                    VM_NEXT();
                 }
 
-                if(is_value_str(left_value) && is_value_str(right_value)){
-                    StrObj *left = VALUE_TO_STR(left_value);
-                    StrObj *right = VALUE_TO_STR(right_value);
+                vmu_error(vm, "Unsuported types using >= operator");
 
-                    PUSH_BOOL(left != right, vm);
+                VM_NEXT();
+            }VM_CASE(OP_EQ):{
+                Value right_value = pop(vm);
+                Value left_value = pop(vm);
 
-                    break;
-                }
+                PUSH_BOOL(equals(OP_EQ, left_value, right_value, vm), vm);
 
-                vmu_error(vm, "Unsuported types using != operator");
+                VM_NEXT();
+            }VM_CASE(OP_NE):{
+                Value right_value = pop(vm);
+                Value left_value = pop(vm);
 
-                break;
-            }case OP_OR:{
+                PUSH_BOOL(!equals(OP_NE, left_value, right_value, vm), vm);
+
+                VM_NEXT();
+            }VM_CASE(OP_OR):{
                 int16_t jmp_value = read_i16(vm);
                 Value value = peek(vm);
 
@@ -1349,13 +3001,13 @@ static int execute(VM *vm){
 
                 if(VALUE_TO_BOOL(value)){
                     current_frame(vm)->ip += jmp_value;
-                    break;
+                    VM_NEXT();
                 }
 
                 pop(vm);
 
-                break;
-            }case OP_AND:{
+                VM_NEXT();
+            }VM_CASE(OP_AND):{
                 int16_t jmp_value = read_i16(vm);
                 Value value = peek(vm);
 
@@ -1365,13 +3017,13 @@ static int execute(VM *vm){
 
                 if(!VALUE_TO_BOOL(value)){
                     current_frame(vm)->ip += jmp_value;
-                    break;
+                    VM_NEXT();
                 }
 
                 pop(vm);
 
-                break;
-            }case OP_NOT:{
+                VM_NEXT();
+            }VM_CASE(OP_NOT):{
                 Value value = pop(vm);
 
                 if(!IS_VALUE_BOOL(value)){
@@ -1380,38 +3032,38 @@ static int execute(VM *vm){
 
                 PUSH_BOOL(!VALUE_TO_BOOL(value), vm);
 
-                break;
-            }case OP_NNOT:{
+                VM_NEXT();
+            }VM_CASE(OP_NNOT):{
                 Value value = pop(vm);
 
                 if(IS_VALUE_INT(value)){
                     PUSH_INT(-VALUE_TO_INT(value), vm);
-                    break;
+                    VM_NEXT();
                 }
 
                 if(IS_VALUE_FLOAT(value)){
                     PUSH_FLOAT(-VALUE_TO_FLOAT(value), vm);
-                    break;
+                    VM_NEXT();
                 }
 
                 vmu_error(vm, "Expect integer or float at right side");
 
-                break;
-            }case OP_LSET:{
+                VM_NEXT();
+            }VM_CASE(OP_LSET):{
                 Value value = peek(vm);
                 uint8_t index = advance(vm);
 
                 *frame_local(index, vm) = value;
 
-                break;
-            }case OP_LGET:{
+                VM_NEXT();
+            }VM_CASE(OP_LGET):{
                 uint8_t index = advance(vm);
                 Value value = *frame_local(index, vm);
 
                 push(value, vm);
 
-                break;
-            }case OP_OSET:{
+                VM_NEXT();
+            }VM_CASE(OP_OSET):{
                 uint8_t index = advance(vm);
                 Value value = peek(vm);
                 Closure *closure = VM_CURRENT_CLOSURE(vm);
@@ -1424,14 +3076,13 @@ static int execute(VM *vm){
 
                     if(closure_value->at == index){
                         closure_value->value = value;
+                        vmu_write_barrier((Obj *)closure_value->closure_obj, value, vm);
                         break;
                     }
                 }
 
-                pop(vm);
-
-                break;
-            }case OP_OGET:{
+                VM_NEXT();
+            }VM_CASE(OP_OGET):{
                 uint8_t index = advance(vm);
                 Closure *closure = VM_CURRENT_CLOSURE(vm);
                 OutValue *out_values = closure->out_values;
@@ -1447,37 +3098,28 @@ static int execute(VM *vm){
                     }
                 }
 
-                break;
-            }case OP_GDEF:{
-                size_t key_size;
-                char *key = read_str(vm, &key_size);
+                VM_NEXT();
+            }VM_CASE(OP_GDEF):{
+                GlobalSlot *global_slot = read_global_slot(vm);
+                GlobalValue *global_value = &global_slot->global_value;
                 Value value = pop(vm);
-                LZOHTable *globals = MODULE_GLOBALS(VM_CURRENT_FN(vm)->module);
 
-                if(lzohtable_lookup(key_size, key, globals, NULL)){
-                    vmu_error(vm, "Cannot define global '%s': already exists", key);
+                if(global_value->access != UNDEFINED_GLOBAL_VALUE_TYPE){
+                    vmu_error(vm, "Cannot define global '%s': already exists", global_slot->name);
                 }
 
-                GlobalValue global_value = {0};
-
-                global_value.access = PRIVATE_GLOVAL_VALUE_TYPE;
-                global_value.value = value;
-
-                lzohtable_put_ckv(key_size, key, sizeof(GlobalValue), &global_value, globals, NULL);
-
-                break;
-            }case OP_GASET:{
-                Module *module = VM_CURRENT_MODULE(vm);
-                LZOHTable *globals = MODULE_GLOBALS(module);
+                vmu_global_barrier(value, vm);
 
-                char *key = read_str(vm, NULL);
-                size_t key_size = strlen(key);
+                global_value->access = PRIVATE_GLOVAL_VALUE_TYPE;
+                global_value->value = value;
 
-                GlobalValue *global_value = NULL;
+                VM_NEXT();
+            }VM_CASE(OP_GASET):{
+                GlobalSlot *global_slot = read_global_slot(vm);
+                GlobalValue *global_value = &global_slot->global_value;
 
-                if(!lzohtable_lookup(key_size, key, globals, (void **)(&global_value))){
-                    vmu_error(vm, "Global symbol '%s' does not exists", key);
-                    break;
+                if(global_value->access == UNDEFINED_GLOBAL_VALUE_TYPE){
+                    vmu_error(vm, "Global symbol '%s' does not exists", global_slot->name);
                 }
 
                 Value value = global_value->value;
@@ -1495,75 +3137,27 @@ static int execute(VM *vm){
                     vmu_error(vm, "Illegal access type: %d", access_type);
                 }
 
-                break;
-            }case OP_GSET:{
-                size_t key_size;
-                char *key = read_str(vm, &key_size);
-                Value value = peek(vm);
-                GlobalValue *global_value = NULL;
-                LZOHTable *globals = MODULE_GLOBALS(VM_CURRENT_FN(vm)->module);
-
-                if(lzohtable_lookup(key_size, key, globals, (void **)(&global_value))){
-                    global_value->value = value;
-                    break;
-                }
-
-                vmu_error(vm, "Global '%s' does not exists", key);
-
-                break;
-            }case OP_GGET:{
-                size_t key_size;
-                char *key = read_str(vm, &key_size);
-                GlobalValue *global_value = NULL;
-
-                if(!lzohtable_lookup(
-                	key_size,
-                 	key,
-                  	MODULE_GLOBALS(VM_CURRENT_FN(vm)->module),
-                   	(void **)(&global_value)
-                )){
-                    vmu_error(
-                    	vm,
-                     	"Global symbol '%s' does not exists",
-                      	key
-                    );
-                }
-
-                Value value = global_value->value;
-
-                if(is_value_module(value)){
-               		ModuleObj *module_obj = OBJ_TO_MODULE(VALUE_TO_OBJ(value));
-                	Module *module = module_obj->module;
-
-               		if(!module->submodule->resolved){
-	                    Frame *frame = current_frame(vm);
-
-	                    frame->ip = frame->last_offset;
-	                    module->prev = vm->modules_stack;
-	                    vm->modules_stack_len++;
-	                    vm->modules_stack = module;
-
-	                    longjmp(vm->exit_jmp, 3);
-	                }
-                }
-
-                push(value, vm);
-
-                break;
-            }case OP_NGET:{
+                VM_NEXT();
+            }VM_CASE(OP_GSET):{
+                set_global(vm);
+                VM_NEXT();
+            }VM_CASE(OP_GGET):{
+                get_global(vm);
+                VM_NEXT();
+            }VM_CASE(OP_NGET):{
                 size_t key_size;
                 char *key = read_str(vm, &key_size);
                 Value *out_value = NULL;
 
                 if(lzohtable_lookup(key_size, key, vm->native_fns, (void **)(&out_value))){
                     push(*out_value, vm);
-                    break;
+                    VM_NEXT();
                 }
 
                 vmu_internal_error(vm, "Unknown native symbol '%s'", key);
 
-                break;
-            }case OP_SGET:{
+                VM_NEXT();
+            }VM_CASE(OP_SGET):{
                 size_t index = (size_t)read_i32(vm);
                 Module *module = VM_CURRENT_MODULE(vm);
                 DynArr *symbols = MODULE_SYMBOLS(module);
@@ -1621,606 +3215,780 @@ static int execute(VM *vm){
                     }
                 }
 
-                break;
-            }case OP_ASET:{
-                Value indexable_value = peek_at(0, vm);
-                Value idx_value = peek_at(1, vm);
-                Value value = peek_at(2, vm);
+                VM_NEXT();
+            }VM_CASE(OP_ASET):{
+                set_index(vm);
+                VM_NEXT();
+            }VM_CASE(OP_RSET):{
+                size_t key_size;
+                char *key = read_str(vm, &key_size);
+                AccessCache *cache = read_cache(vm);
+                Value target_value = pop(vm);
+                Value raw_value = peek(vm);
+
+                if(!is_value_record(target_value)){
+                    vmu_error(vm, "Expect record in assignment");
+                }
 
-                if(!IS_VALUE_OBJ(indexable_value)){
+                RecordObj *record_obj = VALUE_TO_RECORD(target_value);
+                Value *value = record_attr(key_size, key, record_obj, cache);
+
+                if(!value){
                     vmu_error(
-                    	vm,
-                     	"Illegal assignment target, expect: array, list, dict, nbarray"
+                        vm,
+                        "Failed to update record: attribute '%s' does not exist",
+                        key
                     );
                 }
 
-                Obj *target_obj = VALUE_TO_OBJ(indexable_value);
+                *value = raw_value;
+                vmu_write_barrier((Obj *)record_obj, raw_value, vm);
 
-                switch (target_obj->type){
-                    case ARRAY_OBJ_TYPE:{
-                        if(!IS_VALUE_INT(idx_value)){
-                            vmu_error(vm, "Expect index value of type 'int'");
-                        }
+                VM_NEXT();
+            }VM_CASE(OP_POP):{
+                pop(vm);
+                VM_NEXT();
+            }VM_CASE(OP_JMP):{
+                int16_t jmp_value = read_i16(vm);
+                current_frame(vm)->ip += jmp_value;
 
-                        int64_t idx = VALUE_TO_INT(idx_value);
-                        ArrayObj *array_obj = VALUE_TO_ARRAY(indexable_value);
-                        vmu_array_set_at(idx, value, array_obj, vm);
+                // Loops enter the machine code of their function
+                // through the top of the dispatch loop
+                if(jmp_value < 0 && vm->jit){
+                    Fn *fn = (Fn *)current_frame(vm)->fn;
 
+                    if(fn->jit_code || (!fn->jit_failed && ++fn->hotness >= JIT_HOT_THRESHOLD)){
                         break;
-                    }case LIST_OBJ_TYPE:{
-                        if(!IS_VALUE_INT(idx_value)){
-                            vmu_error(vm, "Expect index value of type 'int'");
-                        }
+                    }
+                }
 
-                        int64_t idx = VALUE_TO_INT(idx_value);
-                        ListObj *list_obj = VALUE_TO_LIST(indexable_value);
-                        vmu_list_set_at(idx, value, list_obj, vm);
+                if(jmp_value < 0 && vm->trace){
+                    int status = run_trace(vm);
 
-                        break;
-                    }case DICT_OBJ_TYPE:{
-                        DictObj *dict_obj = VALUE_TO_DICT(indexable_value);
-                        vmu_dict_put(idx_value, value, dict_obj, vm);
+                    if(status == HALT_JIT_STATUS){
+                        return vm->exit_code;
+                    }
 
+                    // The trace could leave anywhere, even in another frame
+                    if(status){
                         break;
-                    }case NATIVE_OBJ_TYPE:{
-                   		NativeObj *native_obj = OBJ_TO_NATIVE(target_obj);
-                    	NativeHeader *native_header = native_obj->native;
+                    }
+                }
+
+                VM_NEXT();
+            }VM_CASE(OP_JIF):{
+                int16_t jmp_value = read_i16(vm);
+                Value value = pop(vm);
 
-                    	switch (native_header->type) {
-	                     	case NBARRAY_NATIVE_TYPE:{
-								if(!IS_VALUE_INT(idx_value)){
-                            		vmu_error(vm, "Expect index value of type 'int'");
-                        		}
+                if(!IS_VALUE_BOOL(value)){
+                    vmu_error(vm, "Expect boolean as conditional value");
+                }
 
-								if(!IS_VALUE_INT(value)){
-									vmu_error(vm, "Expect assignment value of type 'int'");
-								}
+                current_frame(vm)->ip += VALUE_TO_BOOL(value) ? 0 : jmp_value;
 
-								NBArrayNative *nbarray_native = (NBArrayNative *)native_header;
-                        		int64_t idx = VALUE_TO_INT(idx_value);
-                        		int64_t assing_value = VALUE_TO_INT(value);
+                VM_NEXT();
+            }VM_CASE(OP_JIT):{
+                int16_t jmp_value = read_i16(vm);
+                Value value = pop(vm);
 
-                          		if(idx < 0 || (size_t)idx >= nbarray_native->len){
-                            		vmu_error(vm, "Index out of bounds");
-                            	}
+                if(!IS_VALUE_BOOL(value)){
+                    vmu_error(vm, "Expect boolean as conditional value");
+                }
 
-                           		nbarray_native->bytes[(size_t)idx] = (unsigned char)assing_value;
+                current_frame(vm)->ip += VALUE_TO_BOOL(value) ? jmp_value : 0;
 
-								break;
-							}default:{
-								vmu_error(vm, "Illegal assignment target");
-								break;
-							}
-	                    }
+                VM_NEXT();
+            }VM_CASE(OP_CALL):{
+                uint8_t args_count = advance(vm);
 
-                        break;
-                    }default:{
-                        vmu_error(vm, "Illegal assignment target");
-                    }
+                if(call_value(args_count, vm)){
+                    break;
                 }
 
-                pop(vm);
-                pop(vm);
+                VM_NEXT();
+            }VM_CASE(OP_TCALL):{
+                if(tail_call(advance(vm), vm)){
+                    return vm->exit_code;
+                }
 
                 break;
-            }case OP_RSET:{
-                size_t key_size;
-                char *key = read_str(vm, &key_size);
-                Value target_value = pop(vm);
-                Value raw_value = peek(vm);
-
-                if(!is_value_record(target_value)){
-                    vmu_error(vm, "Expect record in assignment");
+            }VM_CASE(OP_ACCESS):{
+                access_target(vm);
+                VM_NEXT();
+            }VM_CASE(OP_INVOKE):{
+                if(invoke(vm)){
+                    break;
                 }
 
-                RecordObj *record_obj = VALUE_TO_RECORD(target_value);
-
-                vmu_record_set_attr(key_size, key, raw_value, record_obj, vm);
+                VM_NEXT();
+            }VM_CASE(OP_INDEX):{
+                get_index(vm);
+                VM_NEXT();
+            }VM_CASE(OP_RET):{
+                if(return_frame(vm)){
+                    return vm->exit_code;
+                }
 
                 break;
-            }case OP_POP:{
-                pop(vm);
-                break;
-            }case OP_JMP:{
-                int16_t jmp_value = read_i16(vm);
-                current_frame(vm)->ip += jmp_value;
-                break;
-            }case OP_JIF:{
-                int16_t jmp_value = read_i16(vm);
+            }VM_CASE(OP_IS):{
                 Value value = pop(vm);
+                uint8_t type = advance(vm);
 
-                if(!IS_VALUE_BOOL(value)){
-                    vmu_error(vm, "Expect boolean as conditional value");
+                if(IS_VALUE_OBJ(value)){
+                    Obj *obj = VALUE_TO_OBJ(value);
+
+                    switch(obj->type){
+                        case STR_OBJ_TYPE:{
+                            push(BOOL_VALUE(type == 4), vm);
+                            break;
+                        }case ARRAY_OBJ_TYPE:{
+                            push(BOOL_VALUE(type == 5), vm);
+                            break;
+                        }case LIST_OBJ_TYPE:{
+                            push(BOOL_VALUE(type == 6), vm);
+                            break;
+                        }case DICT_OBJ_TYPE:{
+                            push(BOOL_VALUE(type == 7), vm);
+                            break;
+                        }case RECORD_OBJ_TYPE:{
+                            push(BOOL_VALUE(type == 8), vm);
+                            break;
+                        }case NATIVE_FN_OBJ_TYPE:
+                         case FN_OBJ_TYPE:
+                         case CLOSURE_OBJ_TYPE:
+                         case COROUTINE_OBJ_TYPE:{
+                            push(BOOL_VALUE(type == 9), vm);
+                            break;
+                        }default:{
+                            vmu_internal_error(vm, "Illegal object type");
+                            break;
+                        }
+                    }
+                }else{
+                    switch(value_type(value)){
+                        case EMPTY_VALUE_TYPE:{
+                            push(BOOL_VALUE(type == 0), vm);
+                            break;
+                        }case BOOL_VALUE_TYPE:{
+                            push(BOOL_VALUE(type == 1), vm);
+                            break;
+                        }case INT_VALUE_TYPE:{
+                            push(BOOL_VALUE(type == 2), vm);
+                            break;
+                        }case FLOAT_VALUE_TYPE:{
+                            push(BOOL_VALUE(type == 3), vm);
+                            break;
+                        }default:{
+                            vmu_internal_error(vm, "Illegal value type");
+                            break;
+                        }
+                    }
                 }
 
-                current_frame(vm)->ip += VALUE_TO_BOOL(value) ? 0 : jmp_value;
+                VM_NEXT();
+            }VM_CASE(OP_TRYO):{
+                size_t catch_ip = (size_t)read_i16(vm);
+                Exception *exception = lzpool_alloc_x(64, &vm->exceptions_pool);
 
-                break;
-            }case OP_JIT:{
-                int16_t jmp_value = read_i16(vm);
-                Value value = pop(vm);
+                exception->catch_ip = catch_ip;
+                exception->stack_top = vm->stack_top;
+                exception->frame = current_frame(vm);
+                exception->prev = vm->exception_stack;
+                vm->exception_stack = exception;
 
-                if(!IS_VALUE_BOOL(value)){
-                    vmu_error(vm, "Expect boolean as conditional value");
+                VM_NEXT();
+            }VM_CASE(OP_TRYC):{
+                Exception *exception = vm->exception_stack;
+
+                if(exception){
+                    vm->exception_stack = exception->prev;
+                    lzpool_dealloc(exception);
+                    VM_NEXT();
                 }
 
-                current_frame(vm)->ip += VALUE_TO_BOOL(value) ? jmp_value : 0;
+                vmu_internal_error(vm, "Exception stack is empty");
 
-                break;
-            }case OP_CALL:{
-                uint8_t args_count = advance(vm);
-                Value callable_value = peek_at(args_count, vm);
+                VM_NEXT();
+            }VM_CASE(OP_THROW):{
+                uint8_t has_value = advance(vm);
+                Value raw_value = {0};
 
-                if(!IS_VALUE_OBJ(callable_value)){
-                    vmu_error(vm, "Target is not callable");
+                if(has_value){
+                    raw_value = pop(vm);
                 }
 
-                Obj *callable_obj = VALUE_TO_OBJ(callable_value);
+                vmu_throw(raw_value, vm);
 
-                switch (callable_obj->type){
-                    case NATIVE_FN_OBJ_TYPE:{
-                        NativeFnObj *native_fn_obj = VALUE_TO_NATIVE_FN(callable_value);
-                        NativeFn *native_fn = native_fn_obj->native_fn;
-                        Value target = native_fn_obj->target;
-                        RawNativeFn raw_fn = native_fn->raw_fn;
+                VM_NEXT();
+            }VM_CASE(OP_YIELD):{
+                if(!vm->coroutine){
+                    vmu_error(vm, "Failed to yield: not inside a coroutine");
+                }
 
-                        if(native_fn->arity != args_count){
-                            vmu_error(
-                                vm,
-                                "Failed to call native function '%s'. Declared with %d parameter(s), but got %d argument(s)",
-                                native_fn->name,
-                                native_fn->arity,
-                                args_count
-                            );
-                        }
+                // resume_coroutine takes the value at the top of the stack
+                return vm->exit_code;
+            }VM_CASE(OP_NEXT):{
+                uint8_t which = advance(vm);
+                int16_t jmp_value = read_i16(vm);
 
-                        Value return_value;
+                if(!iterate(which, vm)){
+                    current_frame(vm)->ip += jmp_value;
+                }
 
-                        if(args_count > 0){
-                            Value args[args_count];
+                VM_NEXT();
+            }VM_CASE(OP_HLT):{
+                return 0;
+            }VM_CASE(OP_INCL):{
+                Value *local = frame_local(advance(vm), vm);
 
-                            for (int16_t i = args_count; i > 0; i--){
-                                args[i - 1] = peek_at(args_count - i, vm);
-                            }
+                if(IS_VALUE_INT(*local)){
+                    *local = INT_VALUE(VALUE_TO_INT(*local) + 1);
+                    VM_NEXT();
+                }
 
-                            return_value = raw_fn(args_count, args, target, vm);
-                        }else{
-                            return_value = raw_fn(0, NULL, target, vm);
-                        }
+                if(IS_VALUE_FLOAT(*local)){
+                    *local = FLOAT_VALUE(VALUE_TO_FLOAT(*local) + 1.0);
+                    VM_NEXT();
+                }
 
-                        vm->stack_top = peek_at_ptr(args_count, vm);
+                vmu_error(vm, "Unsuported types using + operator");
 
-                        push(return_value, vm);
+                VM_NEXT();
+            }VM_CASE(OP_LGET2):{
+                // Like two OP_LGET: the second local can be the value the
+                // first pushes, when it initialized a new local
+                push(*frame_local(advance(vm), vm), vm);
+                push(*frame_local(advance(vm), vm), vm);
+
+                VM_NEXT();
+            }VM_CASE(OP_LT_LL_JIF):{
+                Value left_value = *frame_local(advance(vm), vm);
+                Value right_value = *frame_local(advance(vm), vm);
+                int16_t jmp_value = read_i16(vm);
+                int less;
 
-                        break;
-                    }case FN_OBJ_TYPE:{
-                        FnObj *fn_obj = VALUE_TO_FN(callable_value);
-                        const Fn *fn = fn_obj->fn;
+                if(IS_VALUE_INT(left_value) && IS_VALUE_INT(right_value)){
+                    less = VALUE_TO_INT(left_value) < VALUE_TO_INT(right_value);
+                }else{
+                    double left;
+                    double right;
 
-                        call_fn(args_count, fn, vm);
+                    if(numbers_as_floats(left_value, right_value, &left, &right)){
+                        vmu_error(vm, "Unsuported types using < operator");
+                    }
 
-                        break;
-                    }case CLOSURE_OBJ_TYPE:{
-                        ClosureObj *closure_obj = VALUE_TO_CLOSURE(callable_value);
-                        Closure *closure = closure_obj->closure;
+                    less = left < right;
+                }
 
-                        call_closure(args_count, closure, vm);
+                current_frame(vm)->ip += less ? 0 : jmp_value;
 
-                        break;
-                    }default:{
-                        vmu_error(vm, "Target is not callable");
-                        break;
+                VM_NEXT();
+            }VM_CASE(OP_GE_LL_JIT):{
+                Value left_value = *frame_local(advance(vm), vm);
+                Value right_value = *frame_local(advance(vm), vm);
+                int16_t jmp_value = read_i16(vm);
+                int greater_equals;
+
+                if(IS_VALUE_INT(left_value) && IS_VALUE_INT(right_value)){
+                    greater_equals = VALUE_TO_INT(left_value) >= VALUE_TO_INT(right_value);
+                }else{
+                    double left;
+                    double right;
+
+                    if(numbers_as_floats(left_value, right_value, &left, &right)){
+                        vmu_error(vm, "Unsuported types using >= operator");
                     }
+
+                    greater_equals = left >= right;
+                }
+
+                current_frame(vm)->ip += greater_equals ? jmp_value : 0;
+
+                VM_NEXT();
+            }VM_CASE(OP_RMOV):{
+                Value *dst = frame_register(advance(vm), vm);
+                *dst = *frame_register(advance(vm), vm);
+                VM_NEXT();
+            }VM_CASE(OP_RCINT):{
+                Value *dst = frame_register(advance(vm), vm);
+                *dst = INT_VALUE((int64_t)advance(vm));
+                VM_NEXT();
+            }VM_CASE(OP_RINT):{
+                Value *dst = frame_register(advance(vm), vm);
+                *dst = INT_VALUE(read_i64_const(vm));
+                VM_NEXT();
+            }VM_CASE(OP_RFLOAT):{
+                Value *dst = frame_register(advance(vm), vm);
+                *dst = FLOAT_VALUE(read_float_const(vm));
+                VM_NEXT();
+            }VM_CASE(OP_RADD):{
+                Value *dst = frame_register(advance(vm), vm);
+                Value left_value = *frame_register(advance(vm), vm);
+                Value right_value = *frame_register(advance(vm), vm);
+
+                if(IS_VALUE_INT(left_value) && IS_VALUE_INT(right_value)){
+                    *dst = INT_VALUE(VALUE_TO_INT(left_value) + VALUE_TO_INT(right_value));
+                    VM_NEXT();
+                }
+
+                *dst = arithmetic(OP_ADD, left_value, right_value, vm);
+
+                VM_NEXT();
+            }VM_CASE(OP_RSUB):{
+                Value *dst = frame_register(advance(vm), vm);
+                Value left_value = *frame_register(advance(vm), vm);
+                Value right_value = *frame_register(advance(vm), vm);
+
+                if(IS_VALUE_INT(left_value) && IS_VALUE_INT(right_value)){
+                    *dst = INT_VALUE(VALUE_TO_INT(left_value) - VALUE_TO_INT(right_value));
+                    VM_NEXT();
+                }
+
+                *dst = arithmetic(OP_SUB, left_value, right_value, vm);
+
+                VM_NEXT();
+            }VM_CASE(OP_RMUL):{
+                Value *dst = frame_register(advance(vm), vm);
+                Value left_value = *frame_register(advance(vm), vm);
+                Value right_value = *frame_register(advance(vm), vm);
+
+                if(IS_VALUE_INT(left_value) && IS_VALUE_INT(right_value)){
+                    *dst = INT_VALUE(VALUE_TO_INT(left_value) * VALUE_TO_INT(right_value));
+                    VM_NEXT();
                 }
 
-                break;
-            }case OP_ACCESS:{
-                Value target_value = peek(vm);
+                *dst = arithmetic(OP_MUL, left_value, right_value, vm);
+
+                VM_NEXT();
+            }VM_CASE(OP_RDIV):{
+                Value *dst = frame_register(advance(vm), vm);
+                Value left_value = *frame_register(advance(vm), vm);
+                Value right_value = *frame_register(advance(vm), vm);
+
+                *dst = arithmetic(OP_DIV, left_value, right_value, vm);
+
+                VM_NEXT();
+            }VM_CASE(OP_RMOD):{
+                Value *dst = frame_register(advance(vm), vm);
+                Value left_value = *frame_register(advance(vm), vm);
+                Value right_value = *frame_register(advance(vm), vm);
+
+                *dst = arithmetic(OP_MOD, left_value, right_value, vm);
+
+                VM_NEXT();
+            }VM_CASE(OP_RADDK):{
+                Value *dst = frame_register(advance(vm), vm);
+                Value left_value = *frame_register(advance(vm), vm);
+                int64_t right = (int64_t)advance(vm);
 
-                if(!IS_VALUE_OBJ(target_value)){
-                    vmu_error(vm, "Expect object as target of access");
+                if(IS_VALUE_INT(left_value)){
+                    *dst = INT_VALUE(VALUE_TO_INT(left_value) + right);
+                    VM_NEXT();
                 }
 
-                size_t key_size;
-                char *key = read_str(vm, &key_size);
-                Obj *target_obj = VALUE_TO_OBJ(target_value);
+                *dst = arithmetic(OP_ADD, left_value, INT_VALUE(right), vm);
 
-                switch (target_obj->type){
-                    case STR_OBJ_TYPE:{
-                        NativeFn *native_fn = native_str_get(key_size, key, vm);
+                VM_NEXT();
+            }VM_CASE(OP_RSUBK):{
+                Value *dst = frame_register(advance(vm), vm);
+                Value left_value = *frame_register(advance(vm), vm);
+                int64_t right = (int64_t)advance(vm);
 
-                        if(native_fn){
-                            NativeFnObj *native_fn_obj = vmu_create_native_fn(target_value, native_fn, vm);
+                if(IS_VALUE_INT(left_value)){
+                    *dst = INT_VALUE(VALUE_TO_INT(left_value) - right);
+                    VM_NEXT();
+                }
 
-                            pop(vm);
-                            PUSH_OBJ(native_fn_obj, vm);
+                *dst = arithmetic(OP_SUB, left_value, INT_VALUE(right), vm);
 
-                            break;
-                        }
+                VM_NEXT();
+            }VM_CASE(OP_RJNLT):{
+                Value left_value = *frame_register(advance(vm), vm);
+                Value right_value = *frame_register(advance(vm), vm);
+                int16_t jmp_value = read_i16(vm);
+                int result;
 
-                        vmu_error(vm, "Target does not contain symbol '%s'", key);
+                if(IS_VALUE_INT(left_value) && IS_VALUE_INT(right_value)){
+                    result = VALUE_TO_INT(left_value) < VALUE_TO_INT(right_value);
+                }else{
+                    result = compare(OP_LT, left_value, right_value, vm);
+                }
 
-                        break;
-                    }case ARRAY_OBJ_TYPE:{
-                        NativeFn *native_fn = native_array_get(key_size, key, vm);
+                current_frame(vm)->ip += result ? 0 : jmp_value;
 
-                        if(native_fn){
-                            NativeFnObj *native_fn_obj = vmu_create_native_fn(target_value, native_fn, vm);
+                VM_NEXT();
+            }VM_CASE(OP_RJNGT):{
+                Value left_value = *frame_register(advance(vm), vm);
+                Value right_value = *frame_register(advance(vm), vm);
+                int16_t jmp_value = read_i16(vm);
+                int result;
 
-                            pop(vm);
-                            PUSH_OBJ(native_fn_obj, vm);
+                if(IS_VALUE_INT(left_value) && IS_VALUE_INT(right_value)){
+                    result = VALUE_TO_INT(left_value) > VALUE_TO_INT(right_value);
+                }else{
+                    result = compare(OP_GT, left_value, right_value, vm);
+                }
 
-                            break;
-                        }
+                current_frame(vm)->ip += result ? 0 : jmp_value;
 
-                        vmu_error(vm, "Target does not contain symbol '%s'", key);
+                VM_NEXT();
+            }VM_CASE(OP_RJNLE):{
+                Value left_value = *frame_register(advance(vm), vm);
+                Value right_value = *frame_register(advance(vm), vm);
+                int16_t jmp_value = read_i16(vm);
+                int result;
 
-                        break;
-                    }case LIST_OBJ_TYPE:{
-                        NativeFn *native_fn = native_list_get(key_size, key, vm);
+                if(IS_VALUE_INT(left_value) && IS_VALUE_INT(right_value)){
+                    result = VALUE_TO_INT(left_value) <= VALUE_TO_INT(right_value);
+                }else{
+                    result = compare(OP_LE, left_value, right_value, vm);
+                }
 
-                        if(native_fn){
-                            NativeFnObj *native_fn_obj = vmu_create_native_fn(target_value, native_fn, vm);
+                current_frame(vm)->ip += result ? 0 : jmp_value;
 
-                            pop(vm);
-                            PUSH_OBJ(native_fn_obj, vm);
+                VM_NEXT();
+            }VM_CASE(OP_RJNGE):{
+                Value left_value = *frame_register(advance(vm), vm);
+                Value right_value = *frame_register(advance(vm), vm);
+                int16_t jmp_value = read_i16(vm);
+                int result;
 
-                            break;
-                        }
+                if(IS_VALUE_INT(left_value) && IS_VALUE_INT(right_value)){
+                    result = VALUE_TO_INT(left_value) >= VALUE_TO_INT(right_value);
+                }else{
+                    result = compare(OP_GE, left_value, right_value, vm);
+                }
 
-                        vmu_error(vm, "Target does not contain symbol '%s'", key);
+                current_frame(vm)->ip += result ? 0 : jmp_value;
 
-                        break;
-                    }case DICT_OBJ_TYPE:{
-                        NativeFn *native_fn = native_dict_get(key_size, key, vm);
+                VM_NEXT();
+            }VM_CASE(OP_ADD_II):{
+                Value right_value = peek_at(0, vm);
+                Value left_value = peek_at(1, vm);
 
-                        if(native_fn){
-                            NativeFnObj *native_fn_obj = vmu_create_native_fn(target_value, native_fn, vm);
+                if(!IS_VALUE_INT(left_value) || !IS_VALUE_INT(right_value)){
+                    deoptimize(OP_ADD, vm);
+                    VM_NEXT();
+                }
 
-                            pop(vm);
-                            PUSH_OBJ(native_fn_obj, vm);
+                pop(vm);
+                pop(vm);
+                push(INT_VALUE(VALUE_TO_INT(left_value) + VALUE_TO_INT(right_value)), vm);
 
-                            break;
-                        }
+                VM_NEXT();
+            }VM_CASE(OP_ADD_FF):{
+                Value right_value = peek_at(0, vm);
+                Value left_value = peek_at(1, vm);
 
-                        vmu_error(vm, "Target does not contain symbol '%s'", key);
+                if(!IS_VALUE_FLOAT(left_value) || !IS_VALUE_FLOAT(right_value)){
+                    deoptimize(OP_ADD, vm);
+                    VM_NEXT();
+                }
 
-                        break;
-                    }case RECORD_OBJ_TYPE:{
-                        RecordObj *record_obj = OBJ_TO_RECORD(target_obj);
-                        Value out_value = vmu_record_get_attr(key_size, key, record_obj, vm);
+                pop(vm);
+                pop(vm);
+                push(FLOAT_VALUE(VALUE_TO_FLOAT(left_value) + VALUE_TO_FLOAT(right_value)), vm);
 
-                        pop(vm);
-                        push(out_value, vm);
+                VM_NEXT();
+            }VM_CASE(OP_SUB_II):{
+                Value right_value = peek_at(0, vm);
+                Value left_value = peek_at(1, vm);
 
-                        break;
-                    }case NATIVE_MODULE_OBJ_TYPE:{
-                        NativeModuleObj *native_module_obj = OBJ_TO_NATIVE_MODULE(target_obj);
-                        NativeModule *native_module = native_module_obj->native_module;
-                        Value *value = NULL;
+                if(!IS_VALUE_INT(left_value) || !IS_VALUE_INT(right_value)){
+                    deoptimize(OP_SUB, vm);
+                    VM_NEXT();
+                }
 
-                        if(!lzohtable_lookup(key_size, key, native_module->symbols, (void **)(&value))){
-                            vmu_error(vm, "Native module '%s' does not contain symbol '%s'", native_module->name, key);
-                        }
+                pop(vm);
+                pop(vm);
+                push(INT_VALUE(VALUE_TO_INT(left_value) - VALUE_TO_INT(right_value)), vm);
 
-                        pop(vm);
-                        push(*value, vm);
+                VM_NEXT();
+            }VM_CASE(OP_SUB_FF):{
+                Value right_value = peek_at(0, vm);
+                Value left_value = peek_at(1, vm);
 
-                        break;
-                    }case MODULE_OBJ_TYPE:{
-                        ModuleObj *module_obj = OBJ_TO_MODULE(target_obj);
-                        Module *module = module_obj->module;
-                        GlobalValue *global_value = NULL;
-
-                        if(!lzohtable_lookup(
-                            key_size,
-                            key,
-                            module->submodule->globals,
-                            (void **)(&global_value)
-                        )){
-                            vmu_error(
-                                vm,
-                                "Module '%s' do not have '%s' symbol",
-                                module->name,
-                                key
-                            );
-                        }
+                if(!IS_VALUE_FLOAT(left_value) || !IS_VALUE_FLOAT(right_value)){
+                    deoptimize(OP_SUB, vm);
+                    VM_NEXT();
+                }
 
-                        if(global_value->access == PRIVATE_GLOVAL_VALUE_TYPE){
-                            vmu_error(
-                                vm,
-                                "Symbol '%s' in module '%s' is private",
-                                key,
-                                module->name
-                            );
-                        }
+                pop(vm);
+                pop(vm);
+                push(FLOAT_VALUE(VALUE_TO_FLOAT(left_value) - VALUE_TO_FLOAT(right_value)), vm);
 
-                        pop(vm);
-                        push(global_value->value, vm);
+                VM_NEXT();
+            }VM_CASE(OP_MUL_II):{
+                Value right_value = peek_at(0, vm);
+                Value left_value = peek_at(1, vm);
 
-                        break;
-                    }default:{
-                        vmu_error(vm, "Illegal access target");
-                        break;
-                    }
+                if(!IS_VALUE_INT(left_value) || !IS_VALUE_INT(right_value)){
+                    deoptimize(OP_MUL, vm);
+                    VM_NEXT();
                 }
 
-                break;
-            }case OP_INDEX:{
-                Value target_value = peek_at(0, vm);
-                Value idx_value = peek_at(1, vm);
-                Value out_value = {0};
-
-                if(!IS_VALUE_OBJ(target_value)){
-                	vmu_error(vm, "Expect object");
-                }
-
-                Obj *target_obj = VALUE_TO_OBJ(target_value);
-
-                switch (target_obj->type) {
-                	case ARRAY_OBJ_TYPE:{
-		                if(!IS_VALUE_INT(idx_value)){
-		                    vmu_error(vm, "Expect 'INT' as index");
-		                }
-
-		                int64_t idx = VALUE_TO_INT(idx_value);
-		                ArrayObj *array_obj = VALUE_TO_ARRAY(target_value);
-		                out_value = vmu_array_get_at(idx, array_obj, vm);
-
-               			break;
-                 	}case LIST_OBJ_TYPE:{
-		                if(!IS_VALUE_INT(idx_value)){
-			                vmu_error(vm, "Expect 'INT' as index");
-		                }
-
-		                int64_t idx = VALUE_TO_INT(idx_value);
-		                ListObj *list_obj = VALUE_TO_LIST(target_value);
-		                out_value = vmu_list_get_at(idx, list_obj, vm);
-
-                  		break;
-                  	}case DICT_OBJ_TYPE:{
-	                    DictObj *dict_obj = VALUE_TO_DICT(target_value);
-	                    out_value = vmu_dict_get(idx_value, dict_obj, vm);
-
-                   		break;
-                   	}case STR_OBJ_TYPE:{
-	                    if(!IS_VALUE_INT(idx_value)){
-	                        vmu_error(vm, "Expect 'INT' as index");
-	                    }
-
-	                    int64_t idx = VALUE_TO_INT(idx_value);
-	                    StrObj *old_str_obj = VALUE_TO_STR(target_value);
-	                    StrObj *new_str_obj = vmu_str_char(idx, old_str_obj, vm);
-	                    out_value = OBJ_VALUE(new_str_obj);
-
-                  		break;
-                    }case NATIVE_OBJ_TYPE:{
-                   		NativeObj *native_obj = OBJ_TO_NATIVE(target_obj);
-                    	NativeHeader *native_header = native_obj->native;
-
-                    	switch (native_header->type) {
-                     		case NBARRAY_NATIVE_TYPE:{
-		                       NBArrayNative *nbuff_native = (NBArrayNative *)native_header;
-
-	                     		if(!IS_VALUE_INT(idx_value)){
-		                        	vmu_error(vm, "Expect 'INT' as index");
-	                       		}
-
-	                       		int64_t idx = VALUE_TO_INT(idx_value);
-
-	                         	if(idx < 0 || (size_t)idx >= nbuff_native->len){
-	                        		vmu_error(vm, "Index out of bounds");
-	                          	}
-
-	                         	out_value = INT_VALUE(nbuff_native->bytes[(size_t)idx]);
-
-                    			break;
-                       		}default:{
-                         		vmu_error(vm, "Illegal native type");
-                       			break;
-                         	}
-                     	}
-
-                  		break;
-                    }default:{
-                    	vmu_error(vm, "Illegal target to index");
-                    }
+                pop(vm);
+                pop(vm);
+                push(INT_VALUE(VALUE_TO_INT(left_value) * VALUE_TO_INT(right_value)), vm);
+
+                VM_NEXT();
+            }VM_CASE(OP_MUL_FF):{
+                Value right_value = peek_at(0, vm);
+                Value left_value = peek_at(1, vm);
+
+                if(!IS_VALUE_FLOAT(left_value) || !IS_VALUE_FLOAT(right_value)){
+                    deoptimize(OP_MUL, vm);
+                    VM_NEXT();
                 }
 
                 pop(vm);
                 pop(vm);
-                push(out_value, vm);
+                push(FLOAT_VALUE(VALUE_TO_FLOAT(left_value) * VALUE_TO_FLOAT(right_value)), vm);
 
-                break;
-            }case OP_RET:{
-                OutValue *current_out = NULL;
-                OutValue *next_out = NULL;
+                VM_NEXT();
+            }VM_CASE(OP_LT_II):{
+                Value right_value = peek_at(0, vm);
+                Value left_value = peek_at(1, vm);
 
-                while(current_out){
-                    next_out = current_out->next;
+                if(!IS_VALUE_INT(left_value) || !IS_VALUE_INT(right_value)){
+                    deoptimize(OP_LT, vm);
+                    VM_NEXT();
+                }
 
-                    current_out->linked = 0;
-                    remove_value_from_current_frame(current_out, vm);
+                pop(vm);
+                pop(vm);
+                PUSH_BOOL(VALUE_TO_INT(left_value) < VALUE_TO_INT(right_value), vm);
 
-                    current_out = next_out;
-                }
+                VM_NEXT();
+            }VM_CASE(OP_LT_FF):{
+                Value right_value = peek_at(0, vm);
+                Value left_value = peek_at(1, vm);
 
-                Value result_value = pop(vm);
-                Frame *frame = current_frame(vm);
+                if(!IS_VALUE_FLOAT(left_value) || !IS_VALUE_FLOAT(right_value)){
+                    deoptimize(OP_LT, vm);
+                    VM_NEXT();
+                }
 
-                vm->stack_top = frame->locals;
+                pop(vm);
+                pop(vm);
+                PUSH_BOOL(VALUE_TO_FLOAT(left_value) < VALUE_TO_FLOAT(right_value), vm);
 
-                pop_frame(vm);
+                VM_NEXT();
+            }VM_CASE(OP_GT_II):{
+                Value right_value = peek_at(0, vm);
+                Value left_value = peek_at(1, vm);
 
-                if(vm->modules_stack_len > 1){
-                    Module *module = vm->modules_stack;
+                if(!IS_VALUE_INT(left_value) || !IS_VALUE_INT(right_value)){
+                    deoptimize(OP_GT, vm);
+                    VM_NEXT();
+                }
 
-                    vm->modules_stack_len--;
-                    vm->modules_stack = module->prev;
+                pop(vm);
+                pop(vm);
+                PUSH_BOOL(VALUE_TO_INT(left_value) > VALUE_TO_INT(right_value), vm);
 
-                    module->prev = NULL;
-                    module->submodule->resolved = 1;
+                VM_NEXT();
+            }VM_CASE(OP_GT_FF):{
+                Value right_value = peek_at(0, vm);
+                Value left_value = peek_at(1, vm);
 
-                    break;
+                if(!IS_VALUE_FLOAT(left_value) || !IS_VALUE_FLOAT(right_value)){
+                    deoptimize(OP_GT, vm);
+                    VM_NEXT();
                 }
 
-                if(vm->frame_ptr == vm->frame_stack){
-                    return vm->exit_code;
-                }
+                pop(vm);
+                pop(vm);
+                PUSH_BOOL(VALUE_TO_FLOAT(left_value) > VALUE_TO_FLOAT(right_value), vm);
 
-                push(result_value, vm);
+                VM_NEXT();
+            }VM_CASE(OP_LE_II):{
+                Value right_value = peek_at(0, vm);
+                Value left_value = peek_at(1, vm);
 
-                break;
-            }case OP_IS:{
-                Value value = pop(vm);
-                uint8_t type = advance(vm);
+                if(!IS_VALUE_INT(left_value) || !IS_VALUE_INT(right_value)){
+                    deoptimize(OP_LE, vm);
+                    VM_NEXT();
+                }
 
-                if(IS_VALUE_OBJ(value)){
-                    Obj *obj = VALUE_TO_OBJ(value);
+                pop(vm);
+                pop(vm);
+                PUSH_BOOL(VALUE_TO_INT(left_value) <= VALUE_TO_INT(right_value), vm);
 
-                    switch(obj->type){
-                        case STR_OBJ_TYPE:{
-                            push(BOOL_VALUE(type == 4), vm);
-                            break;
-                        }case ARRAY_OBJ_TYPE:{
-                            push(BOOL_VALUE(type == 5), vm);
-                            break;
-                        }case LIST_OBJ_TYPE:{
-                            push(BOOL_VALUE(type == 6), vm);
-                            break;
-                        }case DICT_OBJ_TYPE:{
-                            push(BOOL_VALUE(type == 7), vm);
-                            break;
-                        }case RECORD_OBJ_TYPE:{
-                            push(BOOL_VALUE(type == 8), vm);
-                            break;
-                        }case NATIVE_FN_OBJ_TYPE:
-                         case FN_OBJ_TYPE:
-                         case CLOSURE_OBJ_TYPE:{
-                            push(BOOL_VALUE(type == 9), vm);
-                            break;
-                        }default:{
-                            vmu_internal_error(vm, "Illegal object type");
-                            break;
-                        }
-                    }
-                }else{
-                    switch(value.type){
-                        case EMPTY_VALUE_TYPE:{
-                            push(BOOL_VALUE(type == 0), vm);
-                            break;
-                        }case BOOL_VALUE_TYPE:{
-                            push(BOOL_VALUE(type == 1), vm);
-                            break;
-                        }case INT_VALUE_TYPE:{
-                            push(BOOL_VALUE(type == 2), vm);
-                            break;
-                        }case FLOAT_VALUE_TYPE:{
-                            push(BOOL_VALUE(type == 3), vm);
-                            break;
-                        }default:{
-                            vmu_internal_error(vm, "Illegal value type");
-                            break;
-                        }
-                    }
-                }
+                VM_NEXT();
+            }VM_CASE(OP_LE_FF):{
+                Value right_value = peek_at(0, vm);
+                Value left_value = peek_at(1, vm);
 
-                break;
-            }case OP_TRYO:{
-                size_t catch_ip = (size_t)read_i16(vm);
-                Exception *exception = lzpool_alloc_x(64, &vm->exceptions_pool);
+                if(!IS_VALUE_FLOAT(left_value) || !IS_VALUE_FLOAT(right_value)){
+                    deoptimize(OP_LE, vm);
+                    VM_NEXT();
+                }
 
-                exception->catch_ip = catch_ip;
-                exception->stack_top = vm->stack_top;
-                exception->frame = current_frame(vm);
-                exception->prev = vm->exception_stack;
-                vm->exception_stack = exception;
+                pop(vm);
+                pop(vm);
+                PUSH_BOOL(VALUE_TO_FLOAT(left_value) <= VALUE_TO_FLOAT(right_value), vm);
 
-                break;
-            }case OP_TRYC:{
-                Exception *exception = vm->exception_stack;
+                VM_NEXT();
+            }VM_CASE(OP_GE_II):{
+                Value right_value = peek_at(0, vm);
+                Value left_value = peek_at(1, vm);
 
-                if(exception){
-                    vm->exception_stack = exception->prev;
-                    MEMORY_DEALLOC(vm->allocator, Exception, 1, exception);
-                    break;
+                if(!IS_VALUE_INT(left_value) || !IS_VALUE_INT(right_value)){
+                    deoptimize(OP_GE, vm);
+                    VM_NEXT();
                 }
 
-                vmu_internal_error(vm, "Exception stack is empty");
+                pop(vm);
+                pop(vm);
+                PUSH_BOOL(VALUE_TO_INT(left_value) >= VALUE_TO_INT(right_value), vm);
 
-                break;
-            }case OP_THROW:{
-                uint8_t has_value = advance(vm);
-                Value raw_value = {0};
-                StrObj *throw_msg = NULL;
+                VM_NEXT();
+            }VM_CASE(OP_GE_FF):{
+                Value right_value = peek_at(0, vm);
+                Value left_value = peek_at(1, vm);
 
-                if(has_value){
-                    raw_value = pop(vm);
+                if(!IS_VALUE_FLOAT(left_value) || !IS_VALUE_FLOAT(right_value)){
+                    deoptimize(OP_GE, vm);
+                    VM_NEXT();
+                }
 
-                    if(is_value_str(raw_value)){
-                        throw_msg = VALUE_TO_STR(raw_value);
-                    }else if(is_value_record(raw_value)){
-                        RecordObj *record = VALUE_TO_RECORD(raw_value);
-                        LZOHTable *attrs = record->attrs;
+                pop(vm);
+                pop(vm);
+                PUSH_BOOL(VALUE_TO_FLOAT(left_value) >= VALUE_TO_FLOAT(right_value), vm);
 
-                        if(attrs){
-                            char *raw_key = "msg";
-                            size_t key_size = 3;
-                            Value *msg_ptr_value = NULL;
+                VM_NEXT();
+            }VM_DEFAULT:{
+                vmu_internal_error(vm, "Illegal opcode");
+            }
+        }
+    }
 
-                            if(lzohtable_lookup(key_size, raw_key, attrs, (void **)(&msg_ptr_value))){
-                                Value msg_value = *msg_ptr_value;
+    return vm->exit_code;
+}
 
-                                if(!is_value_str(msg_value)){
-                                    vmu_error(vm, "Expect record attribute 'msg' to be of type 'str'");
-                                }
+// Prepares the VM to run code of 'module' from an empty frame stack
+void enter(LZOHTable *native_fns, Module *module, VM *vm){
+    module->submodule->resolved = 1;
 
-                                throw_msg = VALUE_TO_STR(msg_value);
-                            }
-                        }
-                    }
-                }
+#ifdef NAN_BOXING
+    vmu_set_boxing_vm(vm);
+#endif
+    vm->exit_code = OK_VMRESULT;
+    vm->frame_ptr = vm->frame_stack;
 
-                Exception *exception = vm->exception_stack;
+    vm->native_fns = native_fns;
 
-                if(exception){
-                    exception->throw_value = raw_value;
-                    longjmp(vm->exit_jmp, 2);
-                }
+    vm->modules_stack_len = 1;
+    vm->modules_stack = module;
+}
 
-                char *raw_throw_msg = throw_msg ? throw_msg->buff : "";
+// Unwinds to the catch of the innermost try block, with the thrown value pushed
+void catch_throw(VM *vm){
+    Exception *exception = vm->exception_stack;
+    Value throw_value = exception->throw_value;
+    Frame *frame = exception->frame;
 
-                vmu_error(vm, raw_throw_msg);
+    frame->ip = exception->catch_ip;
+    vm->stack_top = exception->stack_top;
+    vm->frame_ptr = frame + 1;
+    vm->exception_stack = exception->prev;
 
-                break;
-            }case OP_HLT:{
-                return 0;
-            }default:{
-                assert("Illegal opcode");
-            }
+    lzpool_dealloc(exception);
+    push(throw_value, vm);
+}
+
+// Calls the function which runs the code of the module being imported
+void start_import(VM *vm){
+    Fn *import_fn = (Fn *)get_symbol(
+        0,
+        FUNCTION_SUBMODULE_SYM_TYPE,
+        vm->modules_stack,
+        vm
+    );
+
+    push_fn(import_fn, vm);
+    call_fn(0, import_fn, vm);
+}
+
+// Continues after the VM jumped to 'exit_jmp' with 'jmp_value'
+int resume(int jmp_value, VM *vm){
+    switch (jmp_value){
+        case 1:{
+            // In case of error
+            return vm->exit_code;
+        }case 2:{
+            // In case of throws
+            catch_throw(vm);
+            return execute(vm);
+        }case 3:{
+            start_import(vm);
+            return execute(vm);
+        }default:{
+            assert(0 && "Illegal jump value");
         }
     }
 
-    return vm->exit_code;
+    return -1;
 }
 //> PRIVATE IMPLEMENTATION
 //> PUBLIC IMPLEMENTATION
 VM *vm_create(Allocator *allocator){
     LZOHTable *runtime_strs = MEMORY_LZOHTABLE(allocator);
     DynArr *native_symbols = MEMORY_DYNARR_PTR(allocator);
+    DynArr *young_objs = MEMORY_DYNARR_PTR(allocator);
+    DynArr *gray_objs = MEMORY_DYNARR_PTR(allocator);
+    DynArr *remembered_objs = MEMORY_DYNARR_PTR(allocator);
+    Shape *empty_shape = shape_create(allocator);
+    Value *stack = vm_reserve_stack(sizeof(Value) * STACK_LENGTH);
+    Frame *frame_stack = vm_reserve_stack(sizeof(Frame) * FRAME_LENGTH);
     VM *vm = MEMORY_ALLOC(allocator, VM, 1);
 
-    if(!runtime_strs || !native_symbols || !vm){
+    if(!runtime_strs || !native_symbols || !young_objs || !gray_objs || !remembered_objs || !empty_shape || !stack || !frame_stack || !vm){
         LZOHTABLE_DESTROY(runtime_strs);
         dynarr_destroy(native_symbols);
+        dynarr_destroy(young_objs);
+        dynarr_destroy(gray_objs);
+        dynarr_destroy(remembered_objs);
+        shape_destroy(empty_shape);
+        vm_release_stack(stack, sizeof(Value) * STACK_LENGTH);
+        vm_release_stack(frame_stack, sizeof(Frame) * FRAME_LENGTH);
         MEMORY_DEALLOC(allocator, VM, 1, vm);
 
         return NULL;
     }
 
     memset(vm, 0, sizeof(VM));
+    vm->stack = stack;
+    vm->stack_top = stack;
+    vm->stack_end = stack + STACK_LENGTH;
+    vm->frame_stack = frame_stack;
+    vm->frame_ptr = frame_stack;
+    vm->frame_stack_end = frame_stack + FRAME_LENGTH;
     vm->runtime_strs = runtime_strs;
+    vm->empty_shape = empty_shape;
     vm->native_symbols = native_symbols;
+    vm->young_objs = young_objs;
+    vm->gray_objs = gray_objs;
+    vm->remembered_objs = remembered_objs;
+    vm->isolates_len = 1;
+#ifdef NAN_BOXING
+    vm->boxed_ints = MEMORY_LZOHTABLE(allocator);
+
+    if(!vm->boxed_ints){
+        LZOHTABLE_DESTROY(runtime_strs);
+        dynarr_destroy(native_symbols);
+        dynarr_destroy(young_objs);
+        dynarr_destroy(gray_objs);
+        dynarr_destroy(remembered_objs);
+        shape_destroy(empty_shape);
+        vm_release_stack(stack, sizeof(Value) * STACK_LENGTH);
+        vm_release_stack(frame_stack, sizeof(Frame) * FRAME_LENGTH);
+        MEMORY_DEALLOC(allocator, VM, 1, vm);
+
+        return NULL;
+    }
+#endif
     vm->mem_use_limit = ALLOCATE_START_LIMIT;
     vm->allocator = allocator;
 
@@ -2232,6 +4000,8 @@ void vm_destroy(VM *vm){
         return;
     }
 
+    // Its threads could be running code that reads the program
+    parallel_pool_destroy(vm->parallel_pool);
     vmu_clean_up(vm);
 
     DynArr *native_symbols = vm->native_symbols;
@@ -2243,7 +4013,26 @@ void vm_destroy(VM *vm){
     }
 
     LZOHTABLE_DESTROY(vm->runtime_strs);
+#ifdef NAN_BOXING
+    LZOHTABLE_DESTROY(vm->boxed_ints);
+#endif
     dynarr_destroy(native_symbols);
+    dynarr_destroy(vm->young_objs);
+    dynarr_destroy(vm->gray_objs);
+    dynarr_destroy(vm->remembered_objs);
+    shape_destroy(vm->empty_shape);
+    vm_release_stack(vm->stack, sizeof(Value) * STACK_LENGTH);
+    vm_release_stack(vm->frame_stack, sizeof(Frame) * FRAME_LENGTH);
+
+    stop_recording(vm);
+
+    JitCode *jit_code = vm->jit_codes;
+
+    while(jit_code){
+        JitCode *next = jit_code->next;
+        jit_destroy(jit_code);
+        jit_code = next;
+    }
 
     lzpool_destroy_deinit(&vm->exceptions_pool);
     lzpool_destroy_deinit(&vm->str_objs_pool);
@@ -2251,95 +4040,143 @@ void vm_destroy(VM *vm){
     lzpool_destroy_deinit(&vm->list_objs_pool);
     lzpool_destroy_deinit(&vm->dict_objs_pool);
     lzpool_destroy_deinit(&vm->record_objs_pool);
+    lzpool_destroy_deinit(&vm->native_objs_pool);
     lzpool_destroy_deinit(&vm->native_fn_objs_pool);
     lzpool_destroy_deinit(&vm->fn_objs_pool);
     lzpool_destroy_deinit(&vm->closures_pool);
     lzpool_destroy_deinit(&vm->closure_objs_pool);
     lzpool_destroy_deinit(&vm->native_module_objs_pool);
     lzpool_destroy_deinit(&vm->module_objs_pool);
+    lzpool_destroy_deinit(&vm->coroutine_objs_pool);
+#ifdef NAN_BOXING
+    lzpool_destroy_deinit(&vm->int_objs_pool);
+#endif
 
     MEMORY_DEALLOC(vm->allocator, VM, 1, vm);
 }
 
 void vm_initialize(VM *vm){
-    vm->white_objs = (ObjList){0};
-    vm->gray_objs = (ObjList){0};
-    vm->black_objs = (ObjList){0};
+    vm->nursery_mem_use = 0;
+    vm->minor_gc = 0;
+    vm->gc_request = 0;
+    vm->profiler = NULL;
+    vm->gc_phase = IDLE_GC_PHASE;
+    vm->gc_mem_use = 0;
+    vm->gc_freed_mem = 0;
+    vm->mark_obj = NULL;
+    vm->mark_cursor = 0;
     vm->templates = NULL;
     vm->exception_stack = NULL;
+    vm->coroutine = NULL;
+    vm->coroutine_nesting = 0;
 
     lzpool_init(sizeof(Exception), (LZPoolAllocator *)VMU_FRONT_ALLOCATOR, &vm->exceptions_pool);
     lzpool_init(sizeof(Value), (LZPoolAllocator *)VMU_FRONT_ALLOCATOR, &vm->values_pool);
-    lzpool_init(sizeof(StrObj), (LZPoolAllocator *)VMU_FRONT_ALLOCATOR, &vm->str_objs_pool);
-    lzpool_init(sizeof(ArrayObj), (LZPoolAllocator *)VMU_FRONT_ALLOCATOR, &vm->array_objs_pool);
-    lzpool_init(sizeof(ListObj), (LZPoolAllocator *)VMU_FRONT_ALLOCATOR, &vm->list_objs_pool);
-    lzpool_init(sizeof(DictObj), (LZPoolAllocator *)VMU_FRONT_ALLOCATOR, &vm->dict_objs_pool);
-    lzpool_init(sizeof(RecordObj), (LZPoolAllocator *)VMU_FRONT_ALLOCATOR, &vm->record_objs_pool);
-    lzpool_init(sizeof(FnObj), (LZPoolAllocator *)VMU_FRONT_ALLOCATOR, &vm->fn_objs_pool);
-    lzpool_init(sizeof(NativeFnObj), (LZPoolAllocator *)VMU_FRONT_ALLOCATOR, &vm->native_fn_objs_pool);
+    lzpool_init_bitmaps(sizeof(StrObj), (LZPoolAllocator *)VMU_FRONT_ALLOCATOR, &vm->str_objs_pool);
+    lzpool_init_bitmaps(sizeof(ArrayObj), (LZPoolAllocator *)VMU_FRONT_ALLOCATOR, &vm->array_objs_pool);
+    lzpool_init_bitmaps(sizeof(ListObj), (LZPoolAllocator *)VMU_FRONT_ALLOCATOR, &vm->list_objs_pool);
+    lzpool_init_bitmaps(sizeof(DictObj), (LZPoolAllocator *)VMU_FRONT_ALLOCATOR, &vm->dict_objs_pool);
+    lzpool_init_bitmaps(sizeof(RecordObj), (LZPoolAllocator *)VMU_FRONT_ALLOCATOR, &vm->record_objs_pool);
+    lzpool_init_bitmaps(sizeof(NativeObj), (LZPoolAllocator *)VMU_FRONT_ALLOCATOR, &vm->native_objs_pool);
+    lzpool_init_bitmaps(sizeof(FnObj), (LZPoolAllocator *)VMU_FRONT_ALLOCATOR, &vm->fn_objs_pool);
+    lzpool_init_bitmaps(sizeof(NativeFnObj), (LZPoolAllocator *)VMU_FRONT_ALLOCATOR, &vm->native_fn_objs_pool);
     lzpool_init(sizeof(Closure), (LZPoolAllocator *)VMU_FRONT_ALLOCATOR, &vm->closures_pool);
-    lzpool_init(sizeof(ClosureObj), (LZPoolAllocator *)VMU_FRONT_ALLOCATOR, &vm->closure_objs_pool);
-    lzpool_init(sizeof(NativeModuleObj), (LZPoolAllocator *)VMU_FRONT_ALLOCATOR, &vm->native_module_objs_pool);
-    lzpool_init(sizeof(ModuleObj), (LZPoolAllocator *)VMU_FRONT_ALLOCATOR, &vm->module_objs_pool);
+    lzpool_init_bitmaps(sizeof(ClosureObj), (LZPoolAllocator *)VMU_FRONT_ALLOCATOR, &vm->closure_objs_pool);
+    lzpool_init_bitmaps(sizeof(NativeModuleObj), (LZPoolAllocator *)VMU_FRONT_ALLOCATOR, &vm->native_module_objs_pool);
+    lzpool_init_bitmaps(sizeof(ModuleObj), (LZPoolAllocator *)VMU_FRONT_ALLOCATOR, &vm->module_objs_pool);
+    lzpool_init_bitmaps(sizeof(CoroutineObj), (LZPoolAllocator *)VMU_FRONT_ALLOCATOR, &vm->coroutine_objs_pool);
+#ifdef NAN_BOXING
+    lzpool_init_bitmaps(sizeof(IntObj), (LZPoolAllocator *)VMU_FRONT_ALLOCATOR, &vm->int_objs_pool);
+#endif
 
     MEMORY_INIT_ALLOCATOR(vm, vm_alloc, vm_realloc, vm_dealloc, VMU_FRONT_ALLOCATOR);
 }
 
 int vm_execute(LZOHTable *native_fns, Module *module, VM *vm){
-    switch (setjmp(vm->exit_jmp)){
-        case 0:{
-            module->submodule->resolved = 1;
+    int jmp_value = setjmp(vm->exit_jmp);
 
-            vm->exit_code = OK_VMRESULT;
-            vm->stack_top = vm->stack;
-            vm->frame_ptr = vm->frame_stack;
+    if(jmp_value){
+        return resume(jmp_value, vm);
+    }
 
-            vm->native_fns = native_fns;
+    enter(native_fns, module, vm);
 
-            vm->modules_stack_len = 1;
-            vm->modules_stack = module;
+    vm->stack_top = vm->stack;
 
-            Fn *main_fn = module->entry_fn;
+    Fn *main_fn = module->entry_fn;
 
-            push_fn(main_fn, vm);
-            call_fn(0, main_fn, vm);
+    push_fn(main_fn, vm);
+    call_fn(0, main_fn, vm);
 
-            return execute(vm);
-        }case 1:{
-            // In case of error
-            return vm->exit_code;
-        }case 2:{
-            // In case of throws
-            Exception *exception = vm->exception_stack;
-            Value throw_value = exception->throw_value;
-            Frame *frame = exception->frame;
+    return execute(vm);
+}
 
-            frame->ip = exception->catch_ip;
-            vm->stack_top = exception->stack_top;
-            vm->frame_ptr = frame + 1;
-            vm->exception_stack = exception->prev;
+int vm_invoke(LZOHTable *native_fns, Module *module, uint8_t argsc, VM *vm){
+    jmp_buf outer_jmp;
+    int result;
 
-            lzpool_dealloc(exception);
-            push(throw_value, vm);
+    memcpy(outer_jmp, vm->exit_jmp, sizeof(jmp_buf));
 
-            return execute(vm);
-        }case 3:{
-            Fn *import_fn = (Fn *)get_symbol(
-                0,
-                FUNCTION_SUBMODULE_SYM_TYPE,
-                vm->modules_stack,
-                vm
-            );
+    int jmp_value = setjmp(vm->exit_jmp);
 
-            push_fn(import_fn, vm);
-            call_fn(0, import_fn, vm);
+    if(jmp_value){
+        result = resume(jmp_value, vm);
+    }else{
+        enter(native_fns, module, vm);
+        call_value(argsc, vm);
 
-            return execute(vm);
-        }default:{
-            assert(0 && "Illegal jump value");
-        }
+        // Natives push their result without a frame
+        result = vm->frame_ptr > vm->frame_stack ? execute(vm) : vm->exit_code;
     }
 
-    return -1;
+    memcpy(vm->exit_jmp, outer_jmp, sizeof(jmp_buf));
+
+    return result;
+}
+
+void *vm_reserve_stack(size_t size){
+#ifdef __linux__
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    size_t len = (size + page_size - 1) / page_size * page_size;
+    uint8_t *region = mmap(
+        NULL,
+        len + page_size,
+        PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+        -1,
+        0
+    );
+
+    if(region == MAP_FAILED){
+        return NULL;
+    }
+
+    if(mprotect(region + len, page_size, PROT_NONE)){
+        munmap(region, len + page_size);
+        return NULL;
+    }
+
+    // The stack ends right where the guard page starts
+    return region + (len - size);
+#else
+    // Allocated whole: FRAME_LENGTH and COROUTINE_FRAME_LENGTH are
+    // smaller on these hosts, so this is at most the old inline stack
+    return malloc(size);
+#endif
+}
+
+void vm_release_stack(void *stack, size_t size){
+    if(!stack){
+        return;
+    }
+
+#ifdef __linux__
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    size_t len = (size + page_size - 1) / page_size * page_size;
+
+    munmap((uint8_t *)stack - (len - size), len + page_size);
+#else
+    free(stack);
+#endif
 }
 //< PUBLIC IMPLEMENTATION
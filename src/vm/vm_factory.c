@@ -4,6 +4,7 @@
 
 #include "vm_types.h"
 #include "obj.h"
+#include "types_utils.h"
 
 NativeFn *vm_factory_native_fn_create(
     const Allocator *allocator,
@@ -24,6 +25,7 @@ NativeFn *vm_factory_native_fn_create(
 
     native_fn->core = core;
     native_fn->arity = arity;
+    native_fn->pure = 0;
     native_fn->name = cloned_name;
     native_fn->raw_fn = raw_native;
     native_fn->allocator = allocator;
@@ -49,6 +51,7 @@ Fn *vm_factory_fn_create(const Allocator *allocator, const char *name, uint8_t a
     DynArr *iconsts = MEMORY_DYNARR_TYPE(allocator, int64_t);
     DynArr *fconsts = MEMORY_DYNARR_TYPE(allocator, double);
     DynArr *locations = MEMORY_DYNARR_TYPE(allocator, OPCodeLocation);
+    DynArr *caches = MEMORY_DYNARR_TYPE(allocator, AccessCache);
     Fn *fn = MEMORY_ALLOC(allocator, Fn, 1);
 
     MEMORY_CHECK(cloned_name);
@@ -56,6 +59,7 @@ Fn *vm_factory_fn_create(const Allocator *allocator, const char *name, uint8_t a
     MEMORY_CHECK(iconsts);
     MEMORY_CHECK(fconsts);
     MEMORY_CHECK(locations);
+    MEMORY_CHECK(caches);
     MEMORY_CHECK(fn);
 
     *fn = (Fn){
@@ -65,6 +69,12 @@ Fn *vm_factory_fn_create(const Allocator *allocator, const char *name, uint8_t a
         .iconsts = iconsts,
         .fconsts = fconsts,
         .locations = locations,
+        .caches = caches,
+        .stack_len = 0,
+        .hotness = 0,
+        .jit_code = NULL,
+        .jit_failed = 0,
+        .jit_loops = NULL,
         .module = NULL,
         .allocator = allocator
     };
@@ -77,6 +87,7 @@ ERROR:
     dynarr_destroy(iconsts);
     dynarr_destroy(fconsts);
     dynarr_destroy(locations);
+    dynarr_destroy(caches);
     MEMORY_DEALLOC(allocator, Fn, 1, fn);
 
     return NULL;
@@ -97,16 +108,20 @@ void vm_factory_fn_destroy(Fn *fn){
     dynarr_destroy(fn->iconsts);
     dynarr_destroy(fn->fconsts);
     dynarr_destroy(fn->locations);
+    dynarr_destroy(fn->caches);
+    dynarr_destroy(fn->jit_loops);
     MEMORY_DEALLOC(allocator, Fn, 1, fn);
 }
 
 SubModule *vm_factory_submodule_create(const Allocator *allocator){
     LZOHTable *globals = MEMORY_LZOHTABLE_LEN(allocator, 64);
+    DynArr *global_slots = MEMORY_DYNARR_TYPE(allocator, GlobalSlot);
     DynArr *static_strs = MEMORY_DYNARR_TYPE(allocator, VmStaticStr);
     DynArr *symbols = MEMORY_DYNARR_TYPE(allocator, SubModuleSymbol);
     SubModule *submodule = MEMORY_ALLOC(allocator, SubModule, 1);
 
     MEMORY_CHECK(globals);
+    MEMORY_CHECK(global_slots);
     MEMORY_CHECK(static_strs);
     MEMORY_CHECK(symbols);
     MEMORY_CHECK(submodule);
@@ -114,6 +129,7 @@ SubModule *vm_factory_submodule_create(const Allocator *allocator){
     *submodule = (SubModule){
         .resolved = 0,
         .globals = globals,
+        .global_slots = global_slots,
         .static_strs = static_strs,
         .symbols = symbols,
         .allocator = allocator
@@ -123,6 +139,7 @@ SubModule *vm_factory_submodule_create(const Allocator *allocator){
 
 ERROR:
     LZOHTABLE_DESTROY(globals);
+    dynarr_destroy(global_slots);
     dynarr_destroy(static_strs);
     dynarr_destroy(symbols);
     MEMORY_DEALLOC(allocator, SubModule, 1, submodule);
@@ -138,7 +155,16 @@ void vm_factory_submodule_destroy(SubModule *submodule){
         return;
     }
 
+    DynArr *global_slots = submodule->global_slots;
+    size_t global_slots_len = dynarr_len(global_slots);
+
+    for (size_t i = 0; i < global_slots_len; i++){
+        GlobalSlot *global_slot = &DYNARR_GET_AS(global_slots, GlobalSlot, i);
+        memory_destroy_cstr(submodule->allocator, global_slot->name);
+    }
+
     LZOHTABLE_DESTROY(submodule->globals);
+    dynarr_destroy(global_slots);
     dynarr_destroy(submodule->static_strs);
     dynarr_destroy(submodule->symbols);
     MEMORY_DEALLOC(submodule->allocator, SubModule, 1, submodule);
@@ -246,26 +272,75 @@ int vm_factory_module_add_module(Module *target_module, Module *module){
     return 0;
 }
 
+int vm_factory_module_globals_slot(Module *module, const char *name, size_t *out_idx){
+    SubModule *submodule = module->submodule;
+    LZOHTable *globals = submodule->globals;
+    DynArr *global_slots = submodule->global_slots;
+    size_t name_len = strlen(name);
+    size_t *idx = NULL;
+
+    if(lzohtable_lookup(name_len, name, globals, (void **)(&idx))){
+        if(out_idx){
+            *out_idx = *idx;
+        }
+
+        return 0;
+    }
+
+    size_t new_idx = dynarr_len(global_slots);
+    char *cloned_name = memory_clone_cstr(submodule->allocator, name, NULL);
+
+    if(!cloned_name){
+        return 1;
+    }
+
+    GlobalSlot global_slot = {
+        .name = cloned_name,
+        .global_value = {
+            .access = UNDEFINED_GLOBAL_VALUE_TYPE,
+            .value = {0}
+        }
+    };
+
+    if(dynarr_insert(global_slots, &global_slot)){
+        memory_destroy_cstr(submodule->allocator, cloned_name);
+        return 1;
+    }
+
+    if(lzohtable_put_ckv(name_len, name, sizeof(size_t), &new_idx, globals, NULL)){
+        dynarr_remove_index(global_slots, new_idx);
+        memory_destroy_cstr(submodule->allocator, cloned_name);
+
+        return 1;
+    }
+
+    if(out_idx){
+        *out_idx = new_idx;
+    }
+
+    return 0;
+}
+
 int vm_factory_module_globals_add_obj(
 	Module *module,
 	Obj *obj,
 	const char *name,
 	GlobalValueAccessType access_type
 ){
-	return lzohtable_put_ckv(
-        strlen(name),
-        name,
-        sizeof(GlobalValue),
-        &((GlobalValue){
-            .access = PRIVATE_GLOVAL_VALUE_TYPE,
-            .value = {
-                .type = OBJ_VALUE_TYPE,
-                .content.obj_val = obj
-            }
-        }),
-        module->submodule->globals,
-        NULL
-    );
+    size_t idx;
+
+    if(vm_factory_module_globals_slot(module, name, &idx)){
+        return 1;
+    }
+
+    GlobalSlot *global_slot = &DYNARR_GET_AS(module->submodule->global_slots, GlobalSlot, idx);
+
+    global_slot->global_value = (GlobalValue){
+        .access = access_type,
+        .value = OBJ_VALUE(obj)
+    };
+
+    return 0;
 }
 
 NativeModule *vm_factory_native_module_create(const Allocator *allocator, const char *name){
@@ -319,10 +394,11 @@ inline int vm_factory_native_module_add_value(
     return 0;
 }
 
-int vm_factory_native_module_add_native_fn(
+static int add_native_fn(
     NativeModule *module,
     const char *name,
     uint8_t arity,
+    uint8_t pure,
     RawNativeFn raw_native
 ){
     const Allocator *allocator = module->allocator;
@@ -337,22 +413,19 @@ int vm_factory_native_module_add_native_fn(
         return 1;
     }
 
+    native_fn->pure = pure;
+
     Obj *obj = (Obj *)native_fn_obj;
 
     obj->type = NATIVE_FN_OBJ_TYPE;
     obj->marked = 0;
-    obj->color = TRANSPARENT_OBJ_COLOR;
-    obj->prev = NULL;
-    obj->next = NULL;
-    obj->list = NULL;
+    obj->generation = NONE_OBJ_GENERATION;
+    obj->remembered = 0;
 
     native_fn_obj->target = (Value){0};
     native_fn_obj->native_fn = native_fn;
 
-    Value value = {
-        .type = OBJ_VALUE_TYPE,
-        .content.obj_val = native_fn_obj
-    };
+    Value value = OBJ_VALUE(native_fn_obj);
 
     if(vm_factory_native_module_add_value(module, name, value)){
         vm_factory_native_fn_destroy(native_fn);
@@ -365,11 +438,30 @@ int vm_factory_native_module_add_native_fn(
 
 }
 
-int vm_factory_native_fn_add_info(
+int vm_factory_native_module_add_native_fn(
+    NativeModule *module,
+    const char *name,
+    uint8_t arity,
+    RawNativeFn raw_native
+){
+    return add_native_fn(module, name, arity, 0, raw_native);
+}
+
+int vm_factory_native_module_add_pure_native_fn(
+    NativeModule *module,
+    const char *name,
+    uint8_t arity,
+    RawNativeFn raw_native
+){
+    return add_native_fn(module, name, arity, 1, raw_native);
+}
+
+static int add_info(
     LZOHTable *natives,
     const Allocator *allocator,
     const char *name,
     uint8_t arity,
+    uint8_t pure,
     RawNativeFn raw_native
 ){
     size_t name_len;
@@ -385,6 +477,7 @@ int vm_factory_native_fn_add_info(
 
     native_fn->core = 0;
     native_fn->arity = arity;
+    native_fn->pure = pure;
     native_fn->name = cloned_name;
     native_fn->raw_fn = raw_native;
 
@@ -392,6 +485,26 @@ int vm_factory_native_fn_add_info(
 
 }
 
+int vm_factory_native_fn_add_info(
+    LZOHTable *natives,
+    const Allocator *allocator,
+    const char *name,
+    uint8_t arity,
+    RawNativeFn raw_native
+){
+    return add_info(natives, allocator, name, arity, 0, raw_native);
+}
+
+int vm_factory_native_fn_add_pure_info(
+    LZOHTable *natives,
+    const Allocator *allocator,
+    const char *name,
+    uint8_t arity,
+    RawNativeFn raw_native
+){
+    return add_info(natives, allocator, name, arity, 1, raw_native);
+}
+
 FnObj *vm_factory_fn_obj_create(const Allocator *allocator, Fn *fn){
     FnObj *fn_obj = MEMORY_ALLOC(allocator, FnObj, 1);
     Obj *obj = (Obj *)fn_obj;
@@ -402,10 +515,8 @@ FnObj *vm_factory_fn_obj_create(const Allocator *allocator, Fn *fn){
 
     obj->type = FN_OBJ_TYPE;
     obj->marked = 0;
-    obj->color = TRANSPARENT_OBJ_COLOR;
-    obj->prev = NULL;
-    obj->next = NULL;
-    obj->list = NULL;
+    obj->generation = NONE_OBJ_GENERATION;
+    obj->remembered = 0;
     fn_obj->fn = fn;
 
     return fn_obj;
@@ -421,10 +532,8 @@ NativeFnObj *vm_factory_native_fn_obj_create(const Allocator *allocator, NativeF
 
     obj->type = NATIVE_FN_OBJ_TYPE;
     obj->marked = 0;
-    obj->color = TRANSPARENT_OBJ_COLOR;
-    obj->prev = NULL;
-    obj->next = NULL;
-    obj->list = NULL;
+    obj->generation = NONE_OBJ_GENERATION;
+    obj->remembered = 0;
     native_fn_obj->target = (Value){0};
     native_fn_obj->native_fn = native_fn;
 
@@ -441,10 +550,8 @@ NativeModuleObj *vm_factory_native_module_obj_create(const Allocator *allocator,
 
     obj->type = NATIVE_MODULE_OBJ_TYPE;
     obj->marked = 0;
-    obj->color = TRANSPARENT_OBJ_COLOR;
-    obj->prev = NULL;
-    obj->next = NULL;
-    obj->list = NULL;
+    obj->generation = NONE_OBJ_GENERATION;
+    obj->remembered = 0;
     native_module_obj->native_module = native_module;
 
     return native_module_obj;
@@ -460,10 +567,8 @@ ModuleObj *vm_factory_module_obj_create(const Allocator *allocator, Module *modu
 
     obj->type = MODULE_OBJ_TYPE;
     obj->marked = 0;
-    obj->color = TRANSPARENT_OBJ_COLOR;
-    obj->prev = NULL;
-    obj->next = NULL;
-    obj->list = NULL;
+    obj->generation = NONE_OBJ_GENERATION;
+    obj->remembered = 0;
     module_obj->module = module;
 
     return module_obj;
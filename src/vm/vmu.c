@@ -15,8 +15,13 @@
 #include <assert.h>
 #include <limits.h>
 #include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
 
 #define POOL_DEFAULT_ALLOC_LEN 1024
+#define MARK_STEP_CLOCK_INTERVAL 64
+#define MARK_QUEUE_BATCH 32
 
 #define ALLOC_VALUE()(lzpool_alloc_x(POOL_DEFAULT_ALLOC_LEN, VMU_VALUES_POOL))
 #define DEALLOC_VALUE(_ptr)(lzpool_dealloc(_ptr))
@@ -36,6 +41,9 @@
 #define ALLOC_RECORD_OBJ()(lzpool_alloc_x(POOL_DEFAULT_ALLOC_LEN, VMU_RECORD_OBJS_POOL))
 #define DEALLOC_RECORD_OBJ(_ptr)(lzpool_dealloc(_ptr))
 
+#define ALLOC_NATIVE_OBJ()(lzpool_alloc_x(POOL_DEFAULT_ALLOC_LEN, VMU_NATIVE_OBJS_POOL))
+#define DEALLOC_NATIVE_OBJ(_ptr)(lzpool_dealloc(_ptr))
+
 #define ALLOC_FN_OBJ()(lzpool_alloc_x(POOL_DEFAULT_ALLOC_LEN, VMU_FN_OBJS_POOL))
 #define DEALLOC_FN_OBJ(_ptr)(lzpool_dealloc(_ptr))
 
@@ -54,8 +62,59 @@
 #define ALLOC_MODULE_OBJ()(lzpool_alloc_x(POOL_DEFAULT_ALLOC_LEN, VMU_MODULE_OBJS_POOL))
 #define DEALLOC_MODULE_OBJ(_ptr)(lzpool_dealloc(_ptr))
 
+#define ALLOC_COROUTINE_OBJ()(lzpool_alloc_x(POOL_DEFAULT_ALLOC_LEN, VMU_COROUTINE_OBJS_POOL))
+#define DEALLOC_COROUTINE_OBJ(_ptr)(lzpool_dealloc(_ptr))
+
+#ifdef NAN_BOXING
+#define ALLOC_INT_OBJ()(lzpool_alloc_x(POOL_DEFAULT_ALLOC_LEN, VMU_INT_OBJS_POOL))
+#define DEALLOC_INT_OBJ(_ptr)(lzpool_dealloc(_ptr))
+#endif
+
+#ifdef NAN_BOXING
+#define GC_POOLS_LENGTH 13
+#else
+#define GC_POOLS_LENGTH 12
+#endif
+// What coroutines count against the heap for their stacks,
+// whose pages only take memory once touched
+#define COROUTINE_STACKS_CHARGE MEMORY_KIBIBYTES(8)
+
 #define FIND_LOCATION(index, arr)(dynarr_find(arr, &((OPCodeLocation){.offset = index, .line = -1}), compare_locations))
 #define FRAME_AT(at, vm)(&vm->frame_stack[at])
+// Frames shown from each end of the stack by the traces of deep ones
+#define STACKTRACE_EDGE_LENGTH 32
+
+typedef void (*GrayValue)(Value value, void *ctx);
+
+// Parallel marking (see par_mark_objs). Each worker traces objects
+// from its own stack and shares part of them through its queue,
+// from where idle workers steal
+typedef struct mark_queue{
+    pthread_mutex_t lock;
+    // Items in [top, bottom). Thieves take from the top
+    size_t top;
+    size_t bottom;
+    size_t cap;
+    Obj **objs;
+}MarkQueue;
+
+typedef struct mark_worker{
+    pthread_t thread;
+    size_t len;
+    size_t cap;
+    Obj **objs;
+    MarkQueue queue;
+    struct parallel_marker *marker;
+}MarkWorker;
+
+typedef struct parallel_marker{
+    size_t workers_len;
+    MarkWorker *workers;
+    pthread_mutex_t alloc_lock;
+    size_t idle;
+    char failed;
+    VM *vm;
+}ParallelMarker;
 
 typedef struct pass_value{
     Obj *obj;
@@ -75,14 +134,46 @@ static void clean_up_dict(void *key, void *value, void *extra){
 //                       PRIVATE INTERFACE                        //
 //----------------------------------------------------------------//
 //---------------------  GARBAGE COLLECTOR  ----------------------//
+static inline uint64_t now_us();
+static inline size_t gc_pools(LZPool **pools, VM *vm);
+static inline void push_gray_obj(Obj *obj, VM *vm);
+static inline Obj *pop_gray_obj(VM *vm);
+static inline void gray_value(Value value, VM *vm);
+static inline void remember_obj(Obj *obj, VM *vm);
 void prepare_module_globals(Module *module, VM *vm);
+void prepare_root(Value value, VM *vm);
 void prepare_worklist(VM *vm);
+void prepare_minor_worklist(VM *vm);
+void forget_remembered_objs(VM *vm);
+static inline void trace_obj(Obj *current, GrayValue gray, void *ctx);
+static inline void serial_gray_value(Value value, void *ctx);
+void mark_obj(Obj *current, VM *vm);
 void mark_objs(VM *vm);
+size_t mark_values_step(Obj *current, size_t len, Value *values, size_t budget, VM *vm);
+int mark_objs_step(VM *vm);
+static inline void par_gray_value(Value value, void *ctx);
+int grow_mark_objs(size_t *cap, Obj ***objs, ParallelMarker *marker);
+int mark_queue_push(size_t len, Obj **objs, MarkQueue *queue, ParallelMarker *marker);
+size_t mark_queue_take(int steal, MarkQueue *queue, MarkWorker *worker);
+static inline int mark_queue_is_empty(MarkQueue *queue);
+void share_mark_objs(MarkWorker *worker);
+int steal_mark_objs(MarkWorker *worker);
+int wait_mark_objs(MarkWorker *worker);
+void *run_mark_worker(void *arg);
+void par_mark_objs(VM *vm);
+static inline void revive_obj(Obj *obj, VM *vm);
+void sweep_obj(void *ptr, void *extra);
+void sweep_garbage(void *ptr, void *extra);
+void sweep_young_objs(VM *vm);
+void promote_young_objs(VM *vm);
+void flip_marks(VM *vm);
+int sweep_objs_step(VM *vm);
 void sweep_objs(VM *vm);
-void normalize_objs(VM *vm);
 //---------------------------  OTHERS  ---------------------------//
 static void init_obj(ObjType type, Obj *obj, VM *vm);
 static int compare_locations(const void *a, const void *b);
+static int prepare_frames(unsigned int spaces, LZBStr *str, Frame *frame_stack, Frame *frame_ptr);
+static int prepare_resumers(unsigned int spaces, LZBStr *str, CoroutineObj *coroutine_obj);
 static int prepare_stacktrace_new(unsigned int spaces, LZBStr *str, VM *vm);
 static void obj_to_str(PassValue pass, Obj *obj, LZBStr *str);
 static void value_to_str(PassValue pass, Value value, LZBStr *str);
@@ -105,266 +196,843 @@ static void value_to_json(
 //----------------------------------------------------------------//
 //                     PRIVATE IMPLEMENTATION                     //
 //----------------------------------------------------------------//
+inline uint64_t now_us(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+inline size_t gc_pools(LZPool **pools, VM *vm){
+    size_t len = 0;
+
+    pools[len++] = VMU_STR_OBJS_POOL;
+    pools[len++] = VMU_ARRAY_OBJS_POOL;
+    pools[len++] = VMU_LIST_OBJS_POOL;
+    pools[len++] = VMU_DICT_OBJS_POOL;
+    pools[len++] = VMU_RECORD_OBJS_POOL;
+    pools[len++] = VMU_NATIVE_OBJS_POOL;
+    pools[len++] = VMU_NATIVE_FN_OBJS_POOL;
+    pools[len++] = VMU_FN_OBJS_POOL;
+    pools[len++] = VMU_CLOSURE_OBJS_POOL;
+    pools[len++] = VMU_NATIVE_MODULE_OBJS_POOL;
+    pools[len++] = VMU_MODULE_OBJS_POOL;
+    pools[len++] = VMU_COROUTINE_OBJS_POOL;
+#ifdef NAN_BOXING
+    pools[len++] = VMU_INT_OBJS_POOL;
+#endif
+
+    assert(len <= GC_POOLS_LENGTH);
+
+    return len;
+}
+
+inline void push_gray_obj(Obj *obj, VM *vm){
+    if(dynarr_insert_ptr(vm->gray_objs, obj)){
+        vmu_internal_error(vm, "Failed to insert object into gray stack: out of memory");
+    }
+}
+
+inline Obj *pop_gray_obj(VM *vm){
+    DynArr *gray_objs = vm->gray_objs;
+    size_t len = dynarr_len(gray_objs);
+    Obj *obj = (Obj *)dynarr_get_ptr(gray_objs, len - 1);
+
+    dynarr_remove_index(gray_objs, len - 1);
+
+    return obj;
+}
+
+inline void gray_value(Value value, VM *vm){
+    if(!IS_VALUE_GC_OBJ(value)){
+        return;
+    }
+
+    Obj *obj = VALUE_TO_GC_OBJ(value);
+    ObjGeneration generation = obj->generation;
+
+    // Minor collections only trace the nursery
+    if(generation == NONE_OBJ_GENERATION ||
+       (vm->minor_gc && generation == OLD_OBJ_GENERATION) ||
+       lzpool_mark(obj))
+    {
+        return;
+    }
+
+    push_gray_obj(obj, vm);
+}
+
+inline void remember_obj(Obj *obj, VM *vm){
+    obj->remembered = 1;
+
+    if(dynarr_insert_ptr(vm->remembered_objs, obj)){
+        vmu_internal_error(vm, "Failed to insert object into remembered set: out of memory");
+    }
+}
+
 void prepare_module_globals(Module *module, VM *vm){
-    LZOHTable *globals = MODULE_GLOBALS(module);
+    DynArr *global_slots = MODULE_GLOBAL_SLOTS(module);
+    size_t global_slots_len = dynarr_len(global_slots);
 
-    for (size_t i = 0; i < globals->m; i++){
-        LZOHTableSlot *slot = &globals->slots[i];
+    for (size_t i = 0; i < global_slots_len; i++){
+        GlobalSlot *global_slot = &DYNARR_GET_AS(global_slots, GlobalSlot, i);
+        GlobalValue *global_value = &global_slot->global_value;
 
-        if(!slot->used){
+        if(global_value->access == UNDEFINED_GLOBAL_VALUE_TYPE){
             continue;
         }
 
-        GlobalValue *global_value = (GlobalValue *)slot->value;
         Value value = global_value->value;
 
-        if(IS_VALUE_OBJ(value) && VALUE_TO_OBJ(value)->color == WHITE_OBJ_COLOR){
-            Obj *obj = VALUE_TO_OBJ(value);
-            obj->color = GRAY_OBJ_COLOR;
-            obj_list_remove(obj);
-            obj_list_insert(obj, &vm->gray_objs);
+        if(!IS_VALUE_GC_OBJ(value)){
+            continue;
+        }
 
-            if(obj->type == MODULE_OBJ_TYPE){
-                Module *module = OBJ_TO_MODULE(obj)->module;
-                prepare_module_globals(module, vm);
-            }
+        Obj *obj = VALUE_TO_GC_OBJ(value);
+
+        if(obj->generation == NONE_OBJ_GENERATION || lzpool_mark(obj)){
+            continue;
+        }
+
+        push_gray_obj(obj, vm);
+
+        if(obj->type == MODULE_OBJ_TYPE){
+            Module *module = OBJ_TO_MODULE(obj)->module;
+            prepare_module_globals(module, vm);
         }
     }
 }
 
+void prepare_root(Value value, VM *vm){
+    if(!IS_VALUE_GC_OBJ(value)){
+        return;
+    }
+
+    Obj *obj = VALUE_TO_GC_OBJ(value);
+
+    if(obj->generation == NONE_OBJ_GENERATION || lzpool_mark(obj)){
+        return;
+    }
+
+    push_gray_obj(obj, vm);
+
+    if(obj->type == MODULE_OBJ_TYPE){
+        Module *module = OBJ_TO_MODULE(obj)->module;
+        prepare_module_globals(module, vm);
+    }
+}
+
 void prepare_worklist(VM *vm){
     prepare_module_globals(vm->modules_stack, vm);
 
     const Value *stack_top = vm->stack_top;
 
     for (Value *stack_slot = vm->stack; stack_slot < stack_top; stack_slot++){
-        Value value = *stack_slot;
+        prepare_root(*stack_slot, vm);
+    }
 
-        if(IS_VALUE_OBJ(value) && VALUE_TO_OBJ(value)->color == WHITE_OBJ_COLOR){
-            Obj *obj = VALUE_TO_OBJ(value);
-            obj->color = GRAY_OBJ_COLOR;
-            obj_list_remove(obj);
-            obj_list_insert(obj, &vm->gray_objs);
+    // The stacks of whoever resumed the running coroutines are set aside
+    for (CoroutineObj *coroutine = vm->coroutine; coroutine; coroutine = coroutine->prev){
+        prepare_root(OBJ_VALUE(coroutine), vm);
 
-            if(obj->type == MODULE_OBJ_TYPE){
-                Module *module = OBJ_TO_MODULE(obj)->module;
-                prepare_module_globals(module, vm);
-            }
+        stack_top = coroutine->caller_stack_top;
+
+        for (Value *stack_slot = coroutine->caller_stack; stack_slot < stack_top; stack_slot++){
+            prepare_root(*stack_slot, vm);
         }
     }
 }
 
-void mark_objs(VM *vm){
-    ObjList *gray_objs = &vm->gray_objs;
+void prepare_minor_worklist(VM *vm){
+    const Value *stack_top = vm->stack_top;
 
-    while (gray_objs->head){
-        Obj *current = gray_objs->head;
+    for (Value *stack_slot = vm->stack; stack_slot < stack_top; stack_slot++){
+        gray_value(*stack_slot, vm);
+    }
 
-        switch (current->type){
-            case STR_OBJ_TYPE:{
-                break;
-            }case ARRAY_OBJ_TYPE:{
-                ArrayObj *array_obj = OBJ_TO_ARRAY(current);
-                size_t len = array_obj->len;
-                Value *values = array_obj->values;
-
-                for (size_t i = 0; i < len; i++){
-                    Value raw_value = values[i];
-
-                    if(IS_VALUE_OBJ(raw_value) && VALUE_TO_OBJ(raw_value)->color == WHITE_OBJ_COLOR){
-                        Obj *obj = VALUE_TO_OBJ(raw_value);
-                        obj->color = GRAY_OBJ_COLOR;
-                        obj_list_remove(obj);
-                        obj_list_insert(obj, &vm->gray_objs);
-                    }
-                }
+    for (CoroutineObj *coroutine = vm->coroutine; coroutine; coroutine = coroutine->prev){
+        gray_value(OBJ_VALUE(coroutine), vm);
 
-                break;
-            }case LIST_OBJ_TYPE:{
-                ListObj *list_obj = OBJ_TO_LIST(current);
-                DynArr *items = list_obj->items;
-                size_t len = dynarr_len(items);
-
-                for (size_t i = 0; i < len; i++){
-                    Value raw_value = DYNARR_GET_AS(items, Value, i);
-
-                    if(IS_VALUE_OBJ(raw_value) && VALUE_TO_OBJ(raw_value)->color == WHITE_OBJ_COLOR){
-                        Obj *obj = VALUE_TO_OBJ(raw_value);
-                        obj->color = GRAY_OBJ_COLOR;
-                        obj_list_remove(obj);
-                        obj_list_insert(obj, &vm->gray_objs);
-                    }
-                }
+        stack_top = coroutine->caller_stack_top;
 
-                break;
-            }case DICT_OBJ_TYPE:{
-                DictObj *dict_obj = OBJ_TO_DICT(current);
-                LZOHTable *key_values = dict_obj->key_values;
-                size_t m = key_values->m;
-
-                for (size_t i = 0; i < m; i++){
-                    LZOHTableSlot slot = key_values->slots[i];
-
-                    if(!slot.used){
-                        continue;
-                    }
-
-                    Value raw_key = *(Value *)(slot.key);
-                    Value raw_value = *(Value *)(slot.value);
-
-                    if(IS_VALUE_OBJ(raw_key) && VALUE_TO_OBJ(raw_key)->color == WHITE_OBJ_COLOR){
-                        Obj *obj = VALUE_TO_OBJ(raw_key);
-                        obj->color = GRAY_OBJ_COLOR;
-                        obj_list_remove(obj);
-                        obj_list_insert(obj, &vm->gray_objs);
-                    }
-
-                    if(IS_VALUE_OBJ(raw_value) && VALUE_TO_OBJ(raw_value)->color == WHITE_OBJ_COLOR){
-                        Obj *obj = VALUE_TO_OBJ(raw_value);
-                        obj->color = GRAY_OBJ_COLOR;
-                        obj_list_remove(obj);
-                        obj_list_insert(obj, &vm->gray_objs);
-                    }
-                }
+        for (Value *stack_slot = coroutine->caller_stack; stack_slot < stack_top; stack_slot++){
+            gray_value(*stack_slot, vm);
+        }
+    }
 
-                break;
-            }case RECORD_OBJ_TYPE:{
-                RecordObj *record_obj = OBJ_TO_RECORD(current);
-                LZOHTable *attrs = record_obj->attrs;
-                LZOHTableSlot *slots = attrs->slots;
-                size_t m = attrs->m;
-
-                for (size_t i = 0; i < m; i++){
-                    LZOHTableSlot slot = slots[i];
-
-                    if(!slot.used){
-                        continue;
-                    }
-
-                    Value raw_value = *(Value *)(slot.value);
-
-                    if(IS_VALUE_OBJ(raw_value) && VALUE_TO_OBJ(raw_value)->color == WHITE_OBJ_COLOR){
-                        Obj *obj = VALUE_TO_OBJ(raw_value);
-                        obj->color = GRAY_OBJ_COLOR;
-                        obj_list_remove(obj);
-                        obj_list_insert(obj, &vm->gray_objs);
-                    }
-                }
+    DynArr *remembered_objs = vm->remembered_objs;
+    size_t remembered_objs_len = dynarr_len(remembered_objs);
 
-                break;
-            }case NATIVE_OBJ_TYPE:{
-           		break;
-            }case NATIVE_FN_OBJ_TYPE:{
-                NativeFnObj *native_fn_obj = OBJ_TO_NATIVE_FN(current);
-                Value target = native_fn_obj->target;
-
-                if(IS_VALUE_OBJ(target) && VALUE_TO_OBJ(target)->color == WHITE_OBJ_COLOR){
-                    Obj *obj = VALUE_TO_OBJ(target);
-                    obj->color = GRAY_OBJ_COLOR;
-                    obj_list_remove(obj);
-                    obj_list_insert(obj, &vm->gray_objs);
+    // Old objects are not traced by minor collections, except those
+    // that could point to young ones. They are traced without being
+    // marked: only the marks of young objects mean something here
+    for (size_t i = 0; i < remembered_objs_len; i++){
+        Obj *obj = (Obj *)dynarr_get_ptr(remembered_objs, i);
+
+        obj->remembered = 0;
+        push_gray_obj(obj, vm);
+    }
+
+    dynarr_remove_all(remembered_objs);
+}
+
+void forget_remembered_objs(VM *vm){
+    DynArr *remembered_objs = vm->remembered_objs;
+    size_t remembered_objs_len = dynarr_len(remembered_objs);
+
+    for (size_t i = 0; i < remembered_objs_len; i++){
+        Obj *obj = (Obj *)dynarr_get_ptr(remembered_objs, i);
+        obj->remembered = 0;
+    }
+
+    dynarr_remove_all(remembered_objs);
+}
+
+inline void trace_obj(Obj *current, GrayValue gray, void *ctx){
+    switch (current->type){
+        case STR_OBJ_TYPE:{
+            break;
+        }case ARRAY_OBJ_TYPE:{
+            ArrayObj *array_obj = OBJ_TO_ARRAY(current);
+            size_t len = array_obj->len;
+            Value *values = array_obj->values;
+
+            for (size_t i = 0; i < len; i++){
+                Value raw_value = values[i];
+
+                gray(raw_value, ctx);
+            }
+
+            break;
+        }case LIST_OBJ_TYPE:{
+            ListObj *list_obj = OBJ_TO_LIST(current);
+            DynArr *items = list_obj->items;
+            size_t len = dynarr_len(items);
+
+            for (size_t i = 0; i < len; i++){
+                Value raw_value = DYNARR_GET_AS(items, Value, i);
+
+                gray(raw_value, ctx);
+            }
+
+            break;
+        }case DICT_OBJ_TYPE:{
+            DictObj *dict_obj = OBJ_TO_DICT(current);
+            LZOHTable *key_values = dict_obj->key_values;
+            size_t m = key_values->m;
+
+            for (size_t i = 0; i < m; i++){
+                LZOHTableSlot slot = key_values->slots[i];
+
+                if(!slot.used){
+                    continue;
                 }
 
+                Value raw_key = *(Value *)(slot.key);
+                Value raw_value = *(Value *)(slot.value);
+
+                gray(raw_key, ctx);
+
+                gray(raw_value, ctx);
+            }
+
+            break;
+        }case RECORD_OBJ_TYPE:{
+            RecordObj *record_obj = OBJ_TO_RECORD(current);
+            Value *values = record_obj->values;
+            size_t len = record_obj->shape->len;
+
+            for (size_t i = 0; i < len; i++){
+                gray(values[i], ctx);
+            }
+
+            break;
+        }case NATIVE_OBJ_TYPE:{
+       		break;
+        }case NATIVE_FN_OBJ_TYPE:{
+            NativeFnObj *native_fn_obj = OBJ_TO_NATIVE_FN(current);
+            Value target = native_fn_obj->target;
+
+            gray(target, ctx);
+
+            break;
+        }case FN_OBJ_TYPE:{
+            break;
+        }case CLOSURE_OBJ_TYPE:{
+            Closure *closure = OBJ_TO_CLOSURE(current)->closure;
+            OutValue *out_values = closure->out_values;
+            size_t len = closure->meta->meta_out_values_len;
+
+            for (size_t i = 0; i < len; i++){
+                gray(out_values[i].value, ctx);
+            }
+
+            break;
+        }case NATIVE_MODULE_OBJ_TYPE:{
+            break;
+        }case MODULE_OBJ_TYPE:{
+            break;
+        }case INT_OBJ_TYPE:{
+            break;
+        }case COROUTINE_OBJ_TYPE:{
+            CoroutineObj *coroutine_obj = OBJ_TO_COROUTINE(current);
+
+            gray(coroutine_obj->fn, ctx);
+
+            // Running coroutines have their values in the
+            // stack of the VM, or set aside by the next one
+            if(coroutine_obj->state != SUSPENDED_COROUTINE_STATE){
                 break;
-            }case FN_OBJ_TYPE:{
-                break;
-            }case CLOSURE_OBJ_TYPE:{
-                break;
-            }case NATIVE_MODULE_OBJ_TYPE:{
-                break;
-            }case MODULE_OBJ_TYPE:{
-                break;
-            }default:{
-            	assert(0 && "Illegal object type");
             }
+
+            const Value *stack_top = coroutine_obj->stack_top;
+
+            for (Value *stack_slot = coroutine_obj->stack; stack_slot < stack_top; stack_slot++){
+                gray(*stack_slot, ctx);
+            }
+
+            break;
+        }default:{
+        	assert(0 && "Illegal object type");
         }
+    }
+}
+
+inline void serial_gray_value(Value value, void *ctx){
+    gray_value(value, (VM *)ctx);
+}
 
-        current->color = BLACK_OBJ_COLOR;
+void mark_obj(Obj *current, VM *vm){
+    trace_obj(current, serial_gray_value, vm);
+}
+
+void mark_objs(VM *vm){
+    DynArr *gray_objs = vm->gray_objs;
 
-        obj_list_remove(current);
-        obj_list_insert(current, &vm->black_objs);
+    // Traced again from the start. Values already traced are marked,
+    // so that is cheap
+    if(vm->mark_obj){
+        mark_obj(vm->mark_obj, vm);
     }
+
+    while (dynarr_len(gray_objs) > 0){
+        mark_obj(pop_gray_obj(vm), vm);
+    }
+
+    vm->mark_obj = NULL;
+    vm->mark_cursor = 0;
 }
 
-void sweep_objs(VM *vm){
-    ObjList *white_objs = &vm->white_objs;
-    Obj *current = white_objs->head;
-    Obj *next = NULL;
+size_t mark_values_step(Obj *current, size_t len, Value *values, size_t budget, VM *vm){
+    size_t from = vm->mark_cursor < len ? vm->mark_cursor : len;
+    size_t to = len - from > budget ? from + budget : len;
 
-    while (current){
-        next = current->next;
+    for (size_t i = from; i < to; i++){
+        gray_value(values[i], vm);
+    }
 
-        switch(current->type){
-            case STR_OBJ_TYPE:{
-                vmu_destroy_str(OBJ_TO_STR(current), vm);
-                break;
-            }case ARRAY_OBJ_TYPE:{
-                vmu_destroy_array(OBJ_TO_ARRAY(current), vm);
-                break;
-            }case LIST_OBJ_TYPE:{
-                vmu_destroy_list(OBJ_TO_LIST(current), vm);
-                break;
-            }case DICT_OBJ_TYPE:{
-                vmu_destroy_dict(OBJ_TO_DICT(current), vm);
-                break;
-            }case RECORD_OBJ_TYPE:{
-                vmu_destroy_record(OBJ_TO_RECORD(current), vm);
-                break;
-            }case NATIVE_OBJ_TYPE:{
-           		vmu_destroy_native(OBJ_TO_NATIVE(current), vm);
-           		break;
-            }case NATIVE_FN_OBJ_TYPE:{
-                vmu_destroy_native_fn(OBJ_TO_NATIVE_FN(current), vm);
-                break;
-            }case FN_OBJ_TYPE:{
-                vmu_destroy_fn(OBJ_TO_FN(current), vm);
-                break;
-            }case CLOSURE_OBJ_TYPE:{
-                vmu_destroy_closure(OBJ_TO_CLOSURE(current), vm);
-                break;
-            }case NATIVE_MODULE_OBJ_TYPE:{
-                vmu_destroy_native_module_obj(OBJ_TO_NATIVE_MODULE(current), vm);
-                break;
-            }case MODULE_OBJ_TYPE:{
-                vmu_destroy_module_obj(OBJ_TO_MODULE(current), vm);
+    if(to < len){
+        vm->mark_obj = current;
+        vm->mark_cursor = to;
+        return to - from;
+    }
+
+    vm->mark_obj = NULL;
+    vm->mark_cursor = 0;
+
+    return to - from + 1;
+}
+
+int mark_objs_step(VM *vm){
+    DynArr *gray_objs = vm->gray_objs;
+    size_t step_objs = vm->gc_step_objs;
+    size_t step_us = vm->gc_step_us;
+    uint64_t start_us = step_us ? now_us() : 0;
+    size_t marked = 0;
+    size_t clock_marked = 0;
+
+    while (vm->mark_obj || dynarr_len(gray_objs) > 0){
+        Obj *current = vm->mark_obj ? vm->mark_obj : pop_gray_obj(vm);
+        size_t budget = step_objs ? step_objs - marked : MARK_STEP_CLOCK_INTERVAL;
+
+        // Arrays and lists can be big, so they are traced in chunks
+        // (see vm->mark_obj and vm->mark_cursor)
+        if(current->type == ARRAY_OBJ_TYPE){
+            ArrayObj *array_obj = OBJ_TO_ARRAY(current);
+            marked += mark_values_step(current, array_obj->len, array_obj->values, budget, vm);
+        }else if(current->type == LIST_OBJ_TYPE){
+            DynArr *items = OBJ_TO_LIST(current)->items;
+            size_t len = dynarr_len(items);
+            Value *values = len == 0 ? NULL : (Value *)dynarr_get_raw(items, 0);
+
+            marked += mark_values_step(current, len, values, budget, vm);
+        }else{
+            mark_obj(current, vm);
+            marked++;
+        }
+
+        if(step_objs && marked >= step_objs){
+            break;
+        }
+
+        // Reading the clock is not free, so it is only done from time to time
+        if(step_us && marked - clock_marked >= MARK_STEP_CLOCK_INTERVAL){
+            if(now_us() - start_us >= step_us){
                 break;
-            }default:{
-                assert(0 && "Illegal object type");
             }
+
+            clock_marked = marked;
+        }
+    }
+
+    return vm->mark_obj == NULL && dynarr_len(gray_objs) == 0;
+}
+
+inline void par_gray_value(Value value, void *ctx){
+    if(!IS_VALUE_GC_OBJ(value)){
+        return;
+    }
+
+    Obj *obj = VALUE_TO_GC_OBJ(value);
+
+    // Several workers could reach the same object, but only
+    // the one that sets its mark bit traces it
+    if(obj->generation == NONE_OBJ_GENERATION || lzpool_mark_atomic(obj)){
+        return;
+    }
+
+    MarkWorker *worker = (MarkWorker *)ctx;
+
+    if(worker->len == worker->cap && grow_mark_objs(&worker->cap, &worker->objs, worker->marker)){
+        __atomic_store_n(&worker->marker->failed, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    worker->objs[worker->len++] = obj;
+}
+
+int grow_mark_objs(size_t *cap, Obj ***objs, ParallelMarker *marker){
+    Allocator *allocator = marker->vm->allocator;
+    size_t old_cap = *cap;
+    size_t new_cap = old_cap == 0 ? MARK_QUEUE_BATCH * 4 : old_cap * 2;
+
+    // The runtime allocator is not thread safe
+    pthread_mutex_lock(&marker->alloc_lock);
+    Obj **new_objs = old_cap == 0 ?
+        MEMORY_ALLOC(allocator, Obj *, new_cap) :
+        MEMORY_REALLOC(allocator, Obj *, old_cap, new_cap, *objs);
+    pthread_mutex_unlock(&marker->alloc_lock);
+
+    if(!new_objs){
+        return 1;
+    }
+
+    *cap = new_cap;
+    *objs = new_objs;
+
+    return 0;
+}
+
+int mark_queue_push(size_t len, Obj **objs, MarkQueue *queue, ParallelMarker *marker){
+    pthread_mutex_lock(&queue->lock);
+
+    // Items already stolen leave room at the front
+    if(queue->top > 0){
+        size_t queue_len = queue->bottom - queue->top;
+
+        memmove(queue->objs, queue->objs + queue->top, sizeof(Obj *) * queue_len);
+
+        __atomic_store_n(&queue->top, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&queue->bottom, queue_len, __ATOMIC_RELAXED);
+    }
+
+    while (queue->bottom + len > queue->cap){
+        if(grow_mark_objs(&queue->cap, &queue->objs, marker)){
+            pthread_mutex_unlock(&queue->lock);
+            return 1;
+        }
+    }
+
+    memcpy(queue->objs + queue->bottom, objs, sizeof(Obj *) * len);
+    __atomic_store_n(&queue->bottom, queue->bottom + len, __ATOMIC_RELAXED);
+
+    pthread_mutex_unlock(&queue->lock);
+
+    return 0;
+}
+
+size_t mark_queue_take(int steal, MarkQueue *queue, MarkWorker *worker){
+    pthread_mutex_lock(&queue->lock);
+
+    size_t queue_len = queue->bottom - queue->top;
+    size_t len = steal ? (queue_len + 1) / 2 : queue_len;
+
+    if(len > MARK_QUEUE_BATCH){
+        len = MARK_QUEUE_BATCH;
+    }
+
+    if(len == 0){
+        pthread_mutex_unlock(&queue->lock);
+        return 0;
+    }
+
+    while (worker->len + len > worker->cap){
+        if(grow_mark_objs(&worker->cap, &worker->objs, worker->marker)){
+            pthread_mutex_unlock(&queue->lock);
+            __atomic_store_n(&worker->marker->failed, 1, __ATOMIC_RELAXED);
+            return 0;
+        }
+    }
+
+    // Thieves take the oldest items, the owner the newest
+    if(steal){
+        memcpy(worker->objs + worker->len, queue->objs + queue->top, sizeof(Obj *) * len);
+        __atomic_store_n(&queue->top, queue->top + len, __ATOMIC_RELAXED);
+    }else{
+        memcpy(worker->objs + worker->len, queue->objs + queue->bottom - len, sizeof(Obj *) * len);
+        __atomic_store_n(&queue->bottom, queue->bottom - len, __ATOMIC_RELAXED);
+    }
+
+    pthread_mutex_unlock(&queue->lock);
+
+    worker->len += len;
+
+    return len;
+}
+
+inline int mark_queue_is_empty(MarkQueue *queue){
+    return __atomic_load_n(&queue->top, __ATOMIC_RELAXED) ==
+           __atomic_load_n(&queue->bottom, __ATOMIC_RELAXED);
+}
+
+void share_mark_objs(MarkWorker *worker){
+    size_t len = worker->len / 2;
+
+    if(len < MARK_QUEUE_BATCH || !mark_queue_is_empty(&worker->queue)){
+        return;
+    }
+
+    // The oldest half of the stack, it tends to hold the biggest subgraphs
+    if(mark_queue_push(len, worker->objs, &worker->queue, worker->marker)){
+        __atomic_store_n(&worker->marker->failed, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    memmove(worker->objs, worker->objs + len, sizeof(Obj *) * (worker->len - len));
+    worker->len -= len;
+}
+
+int steal_mark_objs(MarkWorker *worker){
+    ParallelMarker *marker = worker->marker;
+    size_t workers_len = marker->workers_len;
+    size_t id = (size_t)(worker - marker->workers);
+
+    for (size_t i = 1; i < workers_len; i++){
+        MarkQueue *queue = &marker->workers[(id + i) % workers_len].queue;
+
+        if(!mark_queue_is_empty(queue) && mark_queue_take(1, queue, worker) > 0){
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+int wait_mark_objs(MarkWorker *worker){
+    ParallelMarker *marker = worker->marker;
+    size_t workers_len = marker->workers_len;
+
+    __atomic_add_fetch(&marker->idle, 1, __ATOMIC_SEQ_CST);
+
+    // An idle worker has nothing in its queue, and only the owner
+    // fills a queue. So, once every worker is idle, marking is done
+    while (__atomic_load_n(&marker->idle, __ATOMIC_SEQ_CST) < workers_len){
+        if(__atomic_load_n(&marker->failed, __ATOMIC_RELAXED)){
+            return 0;
+        }
+
+        for (size_t i = 0; i < workers_len; i++){
+            if(mark_queue_is_empty(&marker->workers[i].queue)){
+                continue;
+            }
+
+            __atomic_sub_fetch(&marker->idle, 1, __ATOMIC_SEQ_CST);
+
+            if(steal_mark_objs(worker)){
+                return 1;
+            }
+
+            __atomic_add_fetch(&marker->idle, 1, __ATOMIC_SEQ_CST);
+
+            break;
+        }
+
+        sched_yield();
+    }
+
+    return 0;
+}
+
+void *run_mark_worker(void *arg){
+    MarkWorker *worker = (MarkWorker *)arg;
+    ParallelMarker *marker = worker->marker;
+
+    do{
+        while (worker->len > 0 || mark_queue_take(0, &worker->queue, worker) > 0){
+            if(__atomic_load_n(&marker->failed, __ATOMIC_RELAXED)){
+                return NULL;
+            }
+
+            trace_obj(worker->objs[--worker->len], par_gray_value, worker);
+            share_mark_objs(worker);
+        }
+    }while (steal_mark_objs(worker) || wait_mark_objs(worker));
+
+    return NULL;
+}
+
+void par_mark_objs(VM *vm){
+    Allocator *allocator = vm->allocator;
+    size_t workers_len = vm->gc_threads;
+    MarkWorker *workers = MEMORY_ALLOC(allocator, MarkWorker, workers_len);
+
+    if(!workers){
+        vmu_internal_error(vm, "Failed to start parallel marking: out of memory");
+    }
+
+    ParallelMarker marker = {
+        .workers_len = workers_len,
+        .workers = workers,
+        .idle = 0,
+        .failed = 0,
+        .vm = vm
+    };
+
+    pthread_mutex_init(&marker.alloc_lock, NULL);
+    memset(workers, 0, sizeof(MarkWorker) * workers_len);
+
+    for (size_t i = 0; i < workers_len; i++){
+        workers[i].marker = &marker;
+        pthread_mutex_init(&workers[i].queue.lock, NULL);
+    }
+
+    // A partially traced object is traced again from the start
+    if(vm->mark_obj){
+        push_gray_obj(vm->mark_obj, vm);
+
+        vm->mark_obj = NULL;
+        vm->mark_cursor = 0;
+    }
+
+    // Roots are spread in the queues, so any worker can pick them
+    DynArr *gray_objs = vm->gray_objs;
+    size_t gray_objs_len = dynarr_len(gray_objs);
+
+    for (size_t i = 0; i < gray_objs_len && !marker.failed; i++){
+        Obj *obj = (Obj *)dynarr_get_ptr(gray_objs, i);
+        marker.failed = (char)mark_queue_push(1, &obj, &workers[i % workers_len].queue, &marker);
+    }
+
+    dynarr_remove_all(gray_objs);
+
+    // The calling thread works as the first worker
+    size_t started = 1;
+
+    for (; started < workers_len && !marker.failed; started++){
+        if(pthread_create(&workers[started].thread, NULL, run_mark_worker, &workers[started])){
+            break;
+        }
+    }
+
+    // Workers that could not start count as idle. Their queues
+    // get emptied by the others
+    __atomic_add_fetch(&marker.idle, workers_len - started, __ATOMIC_SEQ_CST);
+
+    if(!marker.failed){
+        run_mark_worker(&workers[0]);
+    }
+
+    for (size_t i = 1; i < started; i++){
+        pthread_join(workers[i].thread, NULL);
+    }
+
+    for (size_t i = 0; i < workers_len; i++){
+        MarkWorker *worker = &workers[i];
+
+        pthread_mutex_destroy(&worker->queue.lock);
+        MEMORY_DEALLOC(allocator, Obj *, worker->cap, worker->objs);
+        MEMORY_DEALLOC(allocator, Obj *, worker->queue.cap, worker->queue.objs);
+    }
+
+    pthread_mutex_destroy(&marker.alloc_lock);
+    MEMORY_DEALLOC(allocator, MarkWorker, workers_len, workers);
+
+    if(marker.failed){
+        vmu_internal_error(vm, "Failed to mark objects: out of memory");
+    }
+}
+
+inline void revive_obj(Obj *obj, VM *vm){
+    // Interned objects are reachable from their tables until swept.
+    // Handing out garbage not swept yet is fine, as long as it stops
+    // being garbage
+    if(vm->gc_phase == SWEEP_GC_PHASE && lzpool_is_marked(obj)){
+        lzpool_unmark(obj);
+    }
+}
+
+void sweep_obj(void *ptr, void *extra){
+    Obj *obj = (Obj *)ptr;
+    VM *vm = (VM *)extra;
+
+    switch(obj->type){
+        case STR_OBJ_TYPE:{
+            vmu_destroy_str(OBJ_TO_STR(obj), vm);
+            break;
+        }case ARRAY_OBJ_TYPE:{
+            vmu_destroy_array(OBJ_TO_ARRAY(obj), vm);
+            break;
+        }case LIST_OBJ_TYPE:{
+            vmu_destroy_list(OBJ_TO_LIST(obj), vm);
+            break;
+        }case DICT_OBJ_TYPE:{
+            vmu_destroy_dict(OBJ_TO_DICT(obj), vm);
+            break;
+        }case RECORD_OBJ_TYPE:{
+            vmu_destroy_record(OBJ_TO_RECORD(obj), vm);
+            break;
+        }case NATIVE_OBJ_TYPE:{
+       		vmu_destroy_native(OBJ_TO_NATIVE(obj), vm);
+       		break;
+        }case NATIVE_FN_OBJ_TYPE:{
+            vmu_destroy_native_fn(OBJ_TO_NATIVE_FN(obj), vm);
+            break;
+        }case FN_OBJ_TYPE:{
+            vmu_destroy_fn(OBJ_TO_FN(obj), vm);
+            break;
+        }case CLOSURE_OBJ_TYPE:{
+            vmu_destroy_closure(OBJ_TO_CLOSURE(obj), vm);
+            break;
+        }case NATIVE_MODULE_OBJ_TYPE:{
+            vmu_destroy_native_module_obj(OBJ_TO_NATIVE_MODULE(obj), vm);
+            break;
+        }case MODULE_OBJ_TYPE:{
+            vmu_destroy_module_obj(OBJ_TO_MODULE(obj), vm);
+            break;
+        }case COROUTINE_OBJ_TYPE:{
+            vmu_destroy_coroutine(OBJ_TO_COROUTINE(obj), vm);
+            break;
+#ifdef NAN_BOXING
+        }case INT_OBJ_TYPE:{
+            vmu_destroy_int(OBJ_TO_INT(obj), vm);
+            break;
+#endif
+        }default:{
+            assert(0 && "Illegal object type");
+        }
+    }
+}
+
+void sweep_garbage(void *ptr, void *extra){
+    VM *vm = (VM *)extra;
+    size_t mem_use = vm->mem_use;
+
+    sweep_obj(ptr, vm);
+
+    vm->gc_freed_mem += mem_use - vm->mem_use;
+}
+
+void sweep_young_objs(VM *vm){
+    DynArr *young_objs = vm->young_objs;
+    size_t young_objs_len = dynarr_len(young_objs);
+
+    for (size_t i = 0; i < young_objs_len; i++){
+        Obj *obj = (Obj *)dynarr_get_ptr(young_objs, i);
+
+        // Already promoted by vmu_global_barrier
+        if(obj->generation == OLD_OBJ_GENERATION){
+            continue;
+        }
+
+        if(lzpool_is_marked(obj)){
+            lzpool_unmark(obj);
+            obj->generation = OLD_OBJ_GENERATION;
+            continue;
         }
 
-        current = next;
+        sweep_obj(obj, vm);
+    }
+
+    dynarr_remove_all(young_objs);
+}
+
+void promote_young_objs(VM *vm){
+    DynArr *young_objs = vm->young_objs;
+    size_t young_objs_len = dynarr_len(young_objs);
+
+    // Must happen before sweeping: objects not marked are about to be released
+    for (size_t i = 0; i < young_objs_len; i++){
+        Obj *obj = (Obj *)dynarr_get_ptr(young_objs, i);
+        obj->generation = OLD_OBJ_GENERATION;
+    }
+
+    dynarr_remove_all(young_objs);
+}
+
+void flip_marks(VM *vm){
+    LZPool *pools[GC_POOLS_LENGTH];
+    size_t pools_len = gc_pools(pools, vm);
+
+    for (size_t i = 0; i < pools_len; i++){
+        lzpool_flip_marks(sweep_garbage, vm, pools[i]);
     }
 
-    white_objs->len = 0;
-    white_objs->head = NULL;
-    white_objs->tail = NULL;
+    vm->gc_mem_use = vm->mem_use;
+    vm->gc_freed_mem = 0;
 }
 
-void normalize_objs(VM *vm){
-    ObjList *white_objs = &vm->white_objs;
-    ObjList *black_objs = &vm->black_objs;
-    Obj *current = black_objs->head;
-    Obj *next = NULL;
+int sweep_objs_step(VM *vm){
+    LZPool *pools[GC_POOLS_LENGTH];
+    size_t pools_len = gc_pools(pools, vm);
+
+    for (size_t i = 0; i < pools_len; i++){
+        if(lzpool_sweep_step(pools[i])){
+            return 1;
+        }
+    }
 
-    while (current){
-        next = current->next;
+    return 0;
+}
 
-        current->color = WHITE_OBJ_COLOR;
-        obj_list_remove(current);
-        obj_list_insert(current, white_objs);
+void sweep_objs(VM *vm){
+    LZPool *pools[GC_POOLS_LENGTH];
+    size_t pools_len = gc_pools(pools, vm);
 
-        current = next;
+    for (size_t i = 0; i < pools_len; i++){
+        lzpool_sweep(pools[i]);
     }
 }
 
 inline void init_obj(ObjType type, Obj *obj, VM *vm){
     obj->type = type;
     obj->marked = 0;
-    obj->color = WHITE_OBJ_COLOR;
-    obj->prev = NULL;
-    obj->next = NULL;
-    obj_list_insert(obj, &vm->white_objs);
+    obj->generation = YOUNG_OBJ_GENERATION;
+    obj->remembered = 0;
+
+    // Until now, the object was not visible to the sweeper: a collection
+    // could happen between its allocation and its initialization
+    lzpool_set_live(obj);
+
+    if(dynarr_insert_ptr(vm->young_objs, obj)){
+        vmu_internal_error(vm, "Failed to insert object into nursery: out of memory");
+    }
+
+    // Objects created while marking could hold values copied from
+    // objects not traced yet, so they are traced as well
+    if(vm->gc_phase == MARK_GC_PHASE){
+        lzpool_mark(obj);
+        push_gray_obj(obj, vm);
+    }
 }
 
 int compare_locations(const void *a, const void *b){
@@ -380,8 +1048,22 @@ int compare_locations(const void *a, const void *b){
     }
 }
 
-int prepare_stacktrace_new(unsigned int spaces, LZBStr *str, VM *vm){
-    for(Frame *frame = vm->frame_stack; frame < vm->frame_ptr; frame++){
+int prepare_frames(unsigned int spaces, LZBStr *str, Frame *frame_stack, Frame *frame_ptr){
+    size_t depth = (size_t)(frame_ptr - frame_stack);
+
+    for(Frame *frame = frame_stack; frame < frame_ptr; frame++){
+        if(depth > 2 * STACKTRACE_EDGE_LENGTH && frame == frame_stack + STACKTRACE_EDGE_LENGTH){
+            size_t omitted = depth - 2 * STACKTRACE_EDGE_LENGTH;
+
+            if(lzbstr_append_args(str, "%*s... %zu frame(s) omitted\n", spaces, "", omitted)){
+                return 1;
+            }
+
+            frame += omitted - 1;
+
+            continue;
+        }
+
         const Fn *fn = frame->fn;
 		DynArr *locations = fn->locations;
 		int idx = FIND_LOCATION(frame->last_offset, locations);
@@ -409,6 +1091,32 @@ int prepare_stacktrace_new(unsigned int spaces, LZBStr *str, VM *vm){
     return 0;
 }
 
+// The frames of those which resumed the running coroutines, outermost first
+int prepare_resumers(unsigned int spaces, LZBStr *str, CoroutineObj *coroutine_obj){
+    if(!coroutine_obj){
+        return 0;
+    }
+
+    if(prepare_resumers(spaces, str, coroutine_obj->prev)){
+        return 1;
+    }
+
+    return prepare_frames(
+        spaces,
+        str,
+        coroutine_obj->caller_frame_stack,
+        coroutine_obj->caller_frame_ptr
+    );
+}
+
+int prepare_stacktrace_new(unsigned int spaces, LZBStr *str, VM *vm){
+    if(prepare_resumers(spaces, str, vm->coroutine)){
+        return 1;
+    }
+
+    return prepare_frames(spaces, str, vm->frame_stack, vm->frame_ptr);
+}
+
 void obj_to_str(PassValue pass, Obj *obj, LZBStr *str){
     PassValue *current = &pass;
     PassValue *prev = NULL;
@@ -531,24 +1239,14 @@ void obj_to_str(PassValue pass, Obj *obj, LZBStr *str){
             break;
         }case RECORD_OBJ_TYPE:{
             RecordObj *record_obj = OBJ_TO_RECORD(obj);
-            LZOHTable *attrs = record_obj->attrs;
-
-            size_t count = 0;
-            size_t n = attrs->n;
-            size_t m = attrs->m;
-            LZOHTableSlot *slots = attrs->slots;
+            Shape *shape = record_obj->shape;
+            size_t n = shape->len;
 
             lzbstr_append("{", str);
 
-            for (size_t i = 0; i < m; i++){
-                LZOHTableSlot slot = slots[i];
-
-                if(!slot.used){
-                    continue;
-                }
-
-                char *key = (char *)slot.key;
-                Value value = *(Value *)slot.value;
+            for (size_t count = 0; count < n; count++){
+                char *key = shape->keys[count];
+                Value value = record_obj->values[count];
 
                 lzbstr_append_args(str, "%s: ", key);
 
@@ -563,8 +1261,6 @@ void obj_to_str(PassValue pass, Obj *obj, LZBStr *str){
                 if(count + 1 < n){
                     lzbstr_append(", ", str);
                 }
-
-                count++;
             }
 
             lzbstr_append("}", str);
@@ -595,6 +1291,10 @@ void obj_to_str(PassValue pass, Obj *obj, LZBStr *str){
             ClosureObj *closure_obj = OBJ_TO_CLOSURE(obj);
             lzbstr_append_args(str, "<closure %p>", closure_obj);
             break;
+        }case COROUTINE_OBJ_TYPE:{
+            CoroutineObj *coroutine_obj = OBJ_TO_COROUTINE(obj);
+            lzbstr_append_args(str, "<coroutine %p>", coroutine_obj);
+            break;
         }case NATIVE_MODULE_OBJ_TYPE:{
             NativeModuleObj *native_module_obj = OBJ_TO_NATIVE_MODULE(obj);
             NativeModule *native_module = native_module_obj->native_module;
@@ -632,37 +1332,27 @@ void obj_to_str(PassValue pass, Obj *obj, LZBStr *str){
         }case MODULE_OBJ_TYPE:{
             ModuleObj *module_obj = OBJ_TO_MODULE(obj);
             Module *module = module_obj->module;
-            SubModule *submodule = module->submodule;
-            LZOHTable *globals = submodule->globals;
-            LZOHTableSlot *slots = globals->slots;
-            size_t n = globals->n;
-            size_t m = globals->m;
+            DynArr *global_slots = MODULE_GLOBAL_SLOTS(module);
+            size_t global_slots_len = dynarr_len(global_slots);
+            size_t count = 0;
 
             lzbstr_append("{", str);
 
-            for (size_t i = 0, u = 0; i < m && u < n; i++){
-                LZOHTableSlot slot = slots[i];
-
-                if(!slot.used){
-                    continue;
-                }
-
-                u++;
-
-                char *global_name = slot.key;
-                GlobalValue *global_value = slot.value;
+            for (size_t i = 0; i < global_slots_len; i++){
+                GlobalSlot *global_slot = &DYNARR_GET_AS(global_slots, GlobalSlot, i);
+                GlobalValue *global_value = &global_slot->global_value;
                 Value value = global_value->value;
 
-                if(global_value->access == PRIVATE_GLOVAL_VALUE_TYPE){
+                if(global_value->access != PUBLIC_GLOBAL_VALUE_TYPE){
                     continue;
                 }
 
-                lzbstr_append_args(str, "%s: ", global_name);
-                value_to_str(pass, value, str);
-
-                if(u + 1 < n){
+                if(count++ > 0){
                 	lzbstr_append(", ", str);
                 }
+
+                lzbstr_append_args(str, "%s: ", global_slot->name);
+                value_to_str(pass, value, str);
             }
 
             lzbstr_append("}", str);
@@ -675,7 +1365,7 @@ void obj_to_str(PassValue pass, Obj *obj, LZBStr *str){
 }
 
 void value_to_str(PassValue pass, Value value, LZBStr *str){
-    switch (value.type){
+    switch (value_type(value)){
         case EMPTY_VALUE_TYPE:{
             lzbstr_append("empty", str);
             break;
@@ -844,24 +1534,14 @@ void obj_to_json(
             break;
         }case RECORD_OBJ_TYPE:{
             RecordObj *record_obj = OBJ_TO_RECORD(obj);
-            LZOHTable *attrs = record_obj->attrs;
-
-            size_t count = 0;
-            size_t n = attrs->n;
-            size_t m = attrs->m;
-            LZOHTableSlot *slots = attrs->slots;
+            Shape *shape = record_obj->shape;
+            size_t n = shape->len;
 
             lzbstr_append("{\n", str);
 
-            for (size_t i = 0; i < m; i++){
-                LZOHTableSlot slot = slots[i];
-
-                if(!slot.used){
-                    continue;
-                }
-
-                char *key = (char *)slot.key;
-                Value value = *(Value *)slot.value;
+            for (size_t count = 0; count < n; count++){
+                char *key = shape->keys[count];
+                Value value = record_obj->values[count];
 
                 lzbstr_append_args(str, "%*s\"%s\": ", spaces + default_spaces, "", key);
 
@@ -876,8 +1556,6 @@ void obj_to_json(
                 if(count + 1 < n){
                     lzbstr_append(",\n", str);
                 }
-
-                count++;
             }
 
             lzbstr_append_args(str, "\n%*s}", spaces, "");
@@ -912,6 +1590,9 @@ void obj_to_json(
 
             lzbstr_append_args(str, "<closure %zu>", fn->arity);
 
+            break;
+        }case COROUTINE_OBJ_TYPE:{
+            lzbstr_append("<coroutine>", str);
             break;
         }case NATIVE_MODULE_OBJ_TYPE:{
             NativeModuleObj *native_module_obj = OBJ_TO_NATIVE_MODULE(obj);
@@ -950,25 +1631,18 @@ void obj_to_json(
         }case MODULE_OBJ_TYPE:{
             ModuleObj *module_obj = OBJ_TO_MODULE(obj);
             Module *module = module_obj->module;
-            SubModule *submodule = module->submodule;
-            LZOHTable *globals = submodule->globals;
-            LZOHTableSlot *slots = globals->slots;
-            size_t m = globals->m;
+            DynArr *global_slots = MODULE_GLOBAL_SLOTS(module);
+            size_t global_slots_len = dynarr_len(global_slots);
 
             lzbstr_append("{\n", str);
 
-            for (size_t i = 0; i < m; i++){
-                LZOHTableSlot slot = slots[i];
-
-                if(!slot.used){
-                    continue;
-                }
-
-                char *name = (char *)slot.key;
-                GlobalValue global_value = *(GlobalValue *)slot.value;
+            for (size_t i = 0; i < global_slots_len; i++){
+                GlobalSlot *global_slot = &DYNARR_GET_AS(global_slots, GlobalSlot, i);
+                char *name = global_slot->name;
+                GlobalValue global_value = global_slot->global_value;
                 Value value = global_value.value;
 
-                if(global_value.access == PRIVATE_GLOVAL_VALUE_TYPE){
+                if(global_value.access != PUBLIC_GLOBAL_VALUE_TYPE){
                     continue;
                 }
 
@@ -995,7 +1669,7 @@ void value_to_json(
     LZBStr *str,
     VM *vm
 ){
-    switch (value.type){
+    switch (value_type(value)){
         case EMPTY_VALUE_TYPE:{
             lzbstr_append("null", str);
             break;
@@ -1043,59 +1717,109 @@ void value_to_json(
 //                     PUBLIC IMPLEMENTATION                      //
 //----------------------------------------------------------------//
 int vmu_error(VM *vm, char *msg, ...){
-    LZBStr *stacktrace_lzbstr = MEMORY_LZBSTR(vm->allocator);
-    char print_stacktrace = stacktrace_lzbstr && !prepare_stacktrace_new(4, stacktrace_lzbstr, vm);
-
     va_list args;
+    va_list print_args;
 	va_start(args, msg);
+    va_copy(print_args, args);
+	vsnprintf(vm->error_msg, ERROR_MSG_LENGTH, msg, args);
+    va_end(args);
+
+    vm->exit_code = ERR_VMRESULT;
+
+    if(vm->quiet_errors){
+        va_end(print_args);
+        longjmp(vm->exit_jmp, 1);
+    }
+
+    LZBStr *stacktrace_lzbstr = MEMORY_LZBSTR(vm->allocator);
+    char print_stacktrace = stacktrace_lzbstr && !prepare_stacktrace_new(4, stacktrace_lzbstr, vm);
 
     fprintf(stderr, "Runtime error: ");
-	vfprintf(stderr, msg, args);
+	vfprintf(stderr, msg, print_args);
     fprintf(stderr, "\n");
 
-    va_end(args);
+    va_end(print_args);
 
     if(print_stacktrace){
-        fprintf(stderr, "%s", stacktrace_lzbstr->buff);
+        // Natives can fail with no frames, out of any call
+        if(stacktrace_lzbstr->buff){
+            fprintf(stderr, "%s", stacktrace_lzbstr->buff);
+        }
     }else{
         fprintf(stderr, "    **** Failed to create stacktrace ****\n");
     }
 
     lzbstr_destroy(stacktrace_lzbstr);
 
-    vm->exit_code = ERR_VMRESULT;
-
     longjmp(vm->exit_jmp, 1);
-
-    return 0;
 }
 
 int vmu_internal_error(VM *vm, char *msg, ...){
-    LZBStr *stacktrace_lzbstr = MEMORY_LZBSTR(vm->allocator);
-    char print_stacktrace = stacktrace_lzbstr && !prepare_stacktrace_new(4, stacktrace_lzbstr, vm);
-
     va_list args;
+    va_list print_args;
 	va_start(args, msg);
+    va_copy(print_args, args);
+	vsnprintf(vm->error_msg, ERROR_MSG_LENGTH, msg, args);
+    va_end(args);
+
+    vm->exit_code = ERR_VMRESULT;
+
+    if(vm->quiet_errors){
+        va_end(print_args);
+        longjmp(vm->exit_jmp, 1);
+    }
+
+    LZBStr *stacktrace_lzbstr = MEMORY_LZBSTR(vm->allocator);
+    char print_stacktrace = stacktrace_lzbstr && !prepare_stacktrace_new(4, stacktrace_lzbstr, vm);
 
     fprintf(stderr, "FATAL RUNTIME ERROR: ");
-	vfprintf(stderr, msg, args);
+	vfprintf(stderr, msg, print_args);
     fprintf(stderr, "\n");
 
-    va_end(args);
+    va_end(print_args);
 
     if(print_stacktrace){
-        fprintf(stderr, "%s", stacktrace_lzbstr->buff);
+        // Natives can fail with no frames, out of any call
+        if(stacktrace_lzbstr->buff){
+            fprintf(stderr, "%s", stacktrace_lzbstr->buff);
+        }
     }else{
         fprintf(stderr, "    **** Failed to create stacktrace ****\n");
     }
 
     lzbstr_destroy(stacktrace_lzbstr);
 
-    vm->exit_code = ERR_VMRESULT;
-
     longjmp(vm->exit_jmp, 1);
+}
 
-    return 0;
+int vmu_throw(Value value, VM *vm){
+    StrObj *throw_msg = NULL;
+
+    if(is_value_str(value)){
+        throw_msg = VALUE_TO_STR(value);
+    }else if(is_value_record(value)){
+        RecordObj *record = VALUE_TO_RECORD(value);
+        size_t offset;
+
+        if(shape_find(3, "msg", record->shape, &offset) == 0){
+            Value msg_value = record->values[offset];
+
+            if(!is_value_str(msg_value)){
+                vmu_error(vm, "Expect record attribute 'msg' to be of type 'str'");
+            }
+
+            throw_msg = VALUE_TO_STR(msg_value);
+        }
+    }
+
+    Exception *exception = vm->exception_stack;
+
+    if(exception){
+        exception->throw_value = value;
+        longjmp(vm->exit_jmp, 2);
+    }
+
+    vmu_error(vm, "%s", throw_msg ? throw_msg->buff : "");
 }
 
 size_t validate_idx(VM *vm, size_t len, int64_t idx){
@@ -1355,62 +2079,117 @@ inline RecordObj *validate_value_record_arg(Value value, uint8_t param, const ch
 }
 
 void vmu_clean_up(VM *vm){
-    ObjList *white_objs = &vm->white_objs;
-    Obj *current = white_objs->head;
-    Obj *next = NULL;
+    LZPool *pools[GC_POOLS_LENGTH];
+    size_t pools_len = gc_pools(pools, vm);
 
-    while (current){
-        next = current->next;
-        obj_list_remove(current);
-
-        switch(current->type){
-            case STR_OBJ_TYPE:{
-                vmu_destroy_str(OBJ_TO_STR(current), vm);
-                break;
-            }case ARRAY_OBJ_TYPE:{
-                vmu_destroy_array(OBJ_TO_ARRAY(current), vm);
-                break;
-            }case LIST_OBJ_TYPE:{
-                vmu_destroy_list(OBJ_TO_LIST(current), vm);
-                break;
-            }case DICT_OBJ_TYPE:{
-                vmu_destroy_dict(OBJ_TO_DICT(current), vm);
-                break;
-            }case RECORD_OBJ_TYPE:{
-                vmu_destroy_record(OBJ_TO_RECORD(current), vm);
-                break;
-            }case NATIVE_OBJ_TYPE:{
-                vmu_destroy_native(OBJ_TO_NATIVE(current), vm);
-                break;
-            }case NATIVE_FN_OBJ_TYPE:{
-                vmu_destroy_native_fn(OBJ_TO_NATIVE_FN(current), vm);
-                break;
-            }case FN_OBJ_TYPE:{
-                vmu_destroy_fn(OBJ_TO_FN(current), vm);
-                break;
-            }case CLOSURE_OBJ_TYPE:{
-                vmu_destroy_closure(OBJ_TO_CLOSURE(current), vm);
-                break;
-            }case NATIVE_MODULE_OBJ_TYPE:{
-                vmu_destroy_native_module_obj(OBJ_TO_NATIVE_MODULE(current), vm);
-                break;
-            }case MODULE_OBJ_TYPE:{
-                vmu_destroy_module_obj(OBJ_TO_MODULE(current), vm);
-                break;
-            }default:{
-                assert(0 && "Illegal object type");
-            }
-        }
+    forget_remembered_objs(vm);
+    dynarr_remove_all(vm->young_objs);
+    dynarr_remove_all(vm->gray_objs);
+    vm->mark_obj = NULL;
 
-        current = next;
+    for (size_t i = 0; i < pools_len; i++){
+        lzpool_sweep_all(sweep_obj, vm, pools[i]);
     }
 }
 
 void vmu_gc(VM *vm){
+    // Every survivor ends in the old generation,
+    // so there is nothing left to remember
+    forget_remembered_objs(vm);
+
+    // Garbage not swept yet reads as marked. Already
+    // done if the cycle started with vmu_gc_start()
+    sweep_objs(vm);
     prepare_worklist(vm);
-    mark_objs(vm);
+
+    if(vm->gc_threads > 1){
+        par_mark_objs(vm);
+    }else{
+        mark_objs(vm);
+    }
+
+    promote_young_objs(vm);
+    flip_marks(vm);
+
+    vm->gc_phase = SWEEP_GC_PHASE;
+    vm->nursery_mem_use = 0;
+}
+
+void vmu_gc_start(VM *vm){
+    sweep_objs(vm);
+    prepare_worklist(vm);
+    vm->gc_phase = MARK_GC_PHASE;
+}
+
+int vmu_gc_step(VM *vm){
+    return mark_objs_step(vm);
+}
+
+int vmu_gc_sweep_step(VM *vm){
+    return sweep_objs_step(vm);
+}
+
+void vmu_gc_sweep(VM *vm){
     sweep_objs(vm);
-    normalize_objs(vm);
+}
+
+void vmu_minor_gc(VM *vm){
+    vm->minor_gc = 1;
+
+    prepare_minor_worklist(vm);
+    mark_objs(vm);
+    sweep_young_objs(vm);
+
+    vm->minor_gc = 0;
+    vm->nursery_mem_use = 0;
+}
+
+inline void vmu_write_barrier(Obj *obj, Value value, VM *vm){
+    if(!IS_VALUE_GC_OBJ(value)){
+        return;
+    }
+
+    // Marked objects could be already traced (or partially traced, see
+    // vm->mark_obj). They are not traced again, so the stored value must be
+    if(vm->gc_phase == MARK_GC_PHASE && lzpool_is_marked(obj)){
+        gray_value(value, vm);
+    }
+
+    if(obj->generation == OLD_OBJ_GENERATION &&
+       !obj->remembered &&
+       VALUE_TO_GC_OBJ(value)->generation == YOUNG_OBJ_GENERATION)
+    {
+        remember_obj(obj, vm);
+    }
+}
+
+inline void vmu_global_barrier(Value value, VM *vm){
+    if(!IS_VALUE_GC_OBJ(value)){
+        return;
+    }
+
+    Obj *obj = VALUE_TO_GC_OBJ(value);
+
+    if(obj->generation != YOUNG_OBJ_GENERATION){
+        return;
+    }
+
+    // Globals are not scanned by minor collections. Values stored in
+    // them are expected to live long, so they are promoted right away
+    obj->generation = OLD_OBJ_GENERATION;
+    remember_obj(obj, vm);
+}
+
+void vmu_push_root(Value value, VM *vm){
+    if(vm->stack_top >= vm->stack_end){
+        vmu_error(vm, "Stack over flow");
+    }
+
+    *(vm->stack_top++) = value;
+}
+
+inline void vmu_pop_root(VM *vm){
+    vm->stack_top--;
 }
 
 inline Frame *vmu_current_frame(VM *vm){
@@ -1465,7 +2244,7 @@ void vmu_print_obj(FILE *stream, Obj *object){
             break;
         }case RECORD_OBJ_TYPE:{
 			RecordObj *record_obj = OBJ_TO_RECORD(object);
-            fprintf(stream, "<record %zu at %p>", record_obj->attrs ? record_obj->attrs->n : 0, record_obj);
+            fprintf(stream, "<record %zu at %p>", record_obj->shape->len, record_obj);
 			break;
 		}case NATIVE_OBJ_TYPE:{
 			NativeObj *native_obj = OBJ_TO_NATIVE(object);
@@ -1490,6 +2269,9 @@ void vmu_print_obj(FILE *stream, Obj *object){
             Fn *fn = closure->meta->fn;
             fprintf(stream, "<closure '%s' - %d at %p>", fn->name, fn->arity, fn);
             break;
+        }case COROUTINE_OBJ_TYPE:{
+            fprintf(stream, "<coroutine at %p>", object);
+            break;
         }case NATIVE_MODULE_OBJ_TYPE:{
             NativeModuleObj *native_module_obj = OBJ_TO_NATIVE_MODULE(object);
             NativeModule *module = native_module_obj->native_module;
@@ -1507,7 +2289,7 @@ void vmu_print_obj(FILE *stream, Obj *object){
 }
 
 void vmu_print_value(FILE *stream, Value value){
-    switch (value.type){
+    switch (value_type(value)){
         case EMPTY_VALUE_TYPE:{
             fprintf(stream, "empty");
             break;
@@ -1546,6 +2328,7 @@ inline int vmu_create_str(char runtime, size_t raw_str_len, char *raw_str, VM *v
     StrObj *str_obj = NULL;
 
     if(lzohtable_lookup(len, raw_str, runtime_strs, (void **)&str_obj)){
+        revive_obj((Obj *)str_obj, vm);
         *out_str_obj = str_obj;
         return 1;
     }
@@ -1652,6 +2435,7 @@ inline StrObj *vmu_str_char(int64_t idx, StrObj *str_obj, VM *vm){
     new_buff[1] = 0;
 
     if(lzohtable_lookup(1, new_buff, vm->runtime_strs, (void **)(&char_str_obj))){
+        revive_obj((Obj *)char_str_obj, vm);
         MEMORY_DEALLOC(VMU_FRONT_ALLOCATOR, char, 2, new_buff);
         return char_str_obj;
     }
@@ -1749,6 +2533,7 @@ StrObj *vmu_str_insert_at(int64_t idx, StrObj *a_str_obj, StrObj *b_str_obj, VM
     c_buff[c_len] = 0;
 
     if(lzohtable_lookup(c_len, c_buff, vm->runtime_strs, (void **)(&c_str_obj))){
+        revive_obj((Obj *)c_str_obj, vm);
         MEMORY_DEALLOC(VMU_FRONT_ALLOCATOR, char, c_len + 1, c_buff);
         return c_str_obj;
     }
@@ -1787,6 +2572,7 @@ StrObj *vmu_str_remove(int64_t from, int64_t to, StrObj *str_obj, VM *vm){
     new_buff[new_len] = 0;
 
     if(lzohtable_lookup(new_len, new_buff, vm->runtime_strs, (void **)(&str_obj))){
+        revive_obj((Obj *)str_obj, vm);
         MEMORY_DEALLOC(VMU_FRONT_ALLOCATOR, char, new_len + 1, new_buff);
         return str_obj;
     }
@@ -1822,6 +2608,7 @@ StrObj *vmu_str_sub_str(int64_t from, int64_t to, StrObj *str_obj, VM *vm){
     new_buff[new_len] = 0;
 
     if(lzohtable_lookup(new_len, new_buff, vm->runtime_strs, (void **)(&str_obj))){
+        revive_obj((Obj *)str_obj, vm);
         MEMORY_DEALLOC(VMU_FRONT_ALLOCATOR, char, new_len + 1, new_buff);
         return str_obj;
     }
@@ -1869,6 +2656,7 @@ inline void vmu_array_set_at(int64_t idx, Value value, ArrayObj *array_obj, VM *
     Value *values = array_obj->values;
 
     values[validate_idx(vm, len, idx)] = value;
+    vmu_write_barrier((Obj *)array_obj, value, vm);
 }
 
 inline Value vmu_array_first(ArrayObj *array_obj, VM *vm){
@@ -2005,7 +2793,9 @@ inline Value vmu_list_get_at(int64_t idx, ListObj *list_obj, VM *vm){
 
 inline void vmu_list_insert(Value value, ListObj *list_obj, VM *vm){
     DynArr *items = list_obj->items;
+
     dynarr_insert(items, &value);
+    vmu_write_barrier((Obj *)list_obj, value, vm);
 }
 
 inline ListObj *vmu_list_insert_new(Value value, ListObj *list_obj, VM *vm){
@@ -2041,6 +2831,7 @@ void vmu_list_insert_at(int64_t idx, Value value, ListObj *list_obj, VM *vm){
     }
 
     dynarr_insert_at(items, at, &value);
+    vmu_write_barrier((Obj *)list_obj, value, vm);
 }
 
 inline Value vmu_list_set_at(int64_t idx, Value value, ListObj *list_obj, VM *vm){
@@ -2059,6 +2850,7 @@ inline Value vmu_list_set_at(int64_t idx, Value value, ListObj *list_obj, VM *vm
     Value out_value = DYNARR_GET_AS(items, Value, at);
 
     dynarr_set_at(items, idx, &value);
+    vmu_write_barrier((Obj *)list_obj, value, vm);
 
     return out_value;
 }
@@ -2078,6 +2870,11 @@ inline Value vmu_list_remove_at(int64_t idx, ListObj *list_obj, VM *vm){
 
     Value value = DYNARR_GET_AS(items, Value, at);
 
+    // Keeps the items not traced yet in front of the mark cursor
+    if((Obj *)list_obj == vm->mark_obj && at < vm->mark_cursor){
+        vm->mark_cursor--;
+    }
+
     dynarr_remove_index(items, at);
     dynarr_reduce(items);
 
@@ -2124,6 +2921,9 @@ inline void vmu_dict_put(Value key, Value value, DictObj *dict_obj, VM *vm){
     if(out_value){
         vmu_destroy_value(out_value);
     }
+
+    vmu_write_barrier((Obj *)dict_obj, key, vm);
+    vmu_write_barrier((Obj *)dict_obj, value, vm);
 }
 
 inline void vmu_dict_put_cstr_value(const char *str, Value value, DictObj *dict_obj, VM *vm){
@@ -2149,6 +2949,9 @@ inline void vmu_dict_put_cstr_value(const char *str, Value value, DictObj *dict_
     if(out_value){
         vmu_destroy_value(out_value);
     }
+
+    vmu_write_barrier((Obj *)dict_obj, OBJ_VALUE(key_str_obj), vm);
+    vmu_write_barrier((Obj *)dict_obj, value, vm);
 }
 
 inline int vmu_dict_contains(Value key, DictObj *dict_obj){
@@ -2177,11 +2980,14 @@ inline void vmu_dict_remove(Value key, DictObj *dict_obj){
 }
 
 inline RecordObj *vmu_create_record(uint16_t length, VM *vm){
-    LZOHTable *attrs = length == 0 ? NULL : MEMORY_LZOHTABLE(VMU_FRONT_ALLOCATOR);
+    size_t len = (size_t)length;
+    Value *values = len == 0 ? NULL : MEMORY_ALLOC(VMU_FRONT_ALLOCATOR, Value, len);
     RecordObj *record_obj = ALLOC_RECORD_OBJ();
 
     init_obj(RECORD_OBJ_TYPE, (Obj*)record_obj, vm);
-    record_obj->attrs = attrs;
+    record_obj->shape = vm->empty_shape;
+    record_obj->len = len;
+    record_obj->values = values;
 
 	return record_obj;
 }
@@ -2191,38 +2997,48 @@ inline void vmu_destroy_record(RecordObj *record_obj, VM *vm){
         return;
     }
 
-    lzohtable_destroy_help(NULL, clean_up_dict, record_obj->attrs);
+    MEMORY_DEALLOC(VMU_FRONT_ALLOCATOR, Value, record_obj->len, record_obj->values);
     DEALLOC_RECORD_OBJ(record_obj);
 }
 
 inline void vmu_record_insert_attr(size_t key_size, char *key, Value value, RecordObj *record_obj, VM *vm){
-    Value *attr_value = NULL;
-    LZOHTable *attrs = record_obj->attrs;
+    Shape *shape = record_obj->shape;
+    size_t offset;
 
-    if(!attrs){
+    if(record_obj->len == 0){
         vmu_internal_error(vm, "Cannot set attributes on an empty record");
     }
 
-    if(lzohtable_lookup(key_size, key, attrs, (void **)(&attr_value))){
-        *attr_value = value;
+    if(shape_find(key_size, key, shape, &offset) == 0){
+        record_obj->values[offset] = value;
+        vmu_write_barrier((Obj *)record_obj, value, vm);
+
         return;
     }
 
-    lzohtable_put_ck(
-        key_size,
-        key,
-        vmu_clone_value(vm, value),
-        attrs,
-        NULL
-    );
+    if(shape->len >= record_obj->len){
+        vmu_internal_error(vm, "Record has no room for attribute '%s'", key);
+    }
+
+    Shape *next_shape = shape_transition(key_size, key, shape);
+
+    if(!next_shape){
+        vmu_internal_error(vm, "Failed to create shape of record");
+    }
+
+    record_obj->values[shape->len] = value;
+    record_obj->shape = next_shape;
+
+    vmu_write_barrier((Obj *)record_obj, value, vm);
 }
 
 inline void vmu_record_set_attr(size_t key_size, char *key, Value value, RecordObj *record_obj, VM *vm){
-    Value *attr_value = NULL;
-    LZOHTable *attrs = record_obj->attrs;
+    size_t offset;
+
+    if(shape_find(key_size, key, record_obj->shape, &offset) == 0){
+        record_obj->values[offset] = value;
+        vmu_write_barrier((Obj *)record_obj, value, vm);
 
-    if(attrs && lzohtable_lookup(key_size, key, attrs, (void **)(&attr_value))){
-        *attr_value = value;
         return;
     }
 
@@ -2234,11 +3050,10 @@ inline void vmu_record_set_attr(size_t key_size, char *key, Value value, RecordO
 }
 
 inline Value vmu_record_get_attr(size_t key_size, char *key, RecordObj *record_obj, VM *vm){
-    LZOHTable *attrs = record_obj->attrs;
-    Value *out_value = NULL;
+    size_t offset;
 
-    if(attrs && lzohtable_lookup(key_size, key, attrs, (void **)(&out_value))){
-        return *out_value;
+    if(shape_find(key_size, key, record_obj->shape, &offset) == 0){
+        return record_obj->values[offset];
     }
 
     vmu_error(
@@ -2251,7 +3066,7 @@ inline Value vmu_record_get_attr(size_t key_size, char *key, RecordObj *record_o
 }
 
 NativeObj *vmu_create_native(void *native, VM *vm){
-	NativeObj *native_obj = MEMORY_ALLOC(VMU_FRONT_ALLOCATOR, NativeObj, 1);
+	NativeObj *native_obj = ALLOC_NATIVE_OBJ();
 
 	init_obj(NATIVE_OBJ_TYPE, (Obj *)native_obj, vm);
 	native_obj->native = native;
@@ -2272,7 +3087,7 @@ void vmu_destroy_native(NativeObj *native_obj, VM *vm){
 	MEMORY_DEALLOC(VMU_FRONT_ALLOCATOR, char, name_len + 1, name);
 
 	naitve_header->destroy_helper(native, VMU_FRONT_ALLOCATOR);
-	MEMORY_DEALLOC(VMU_FRONT_ALLOCATOR, NativeObj, 1, native_obj);
+	DEALLOC_NATIVE_OBJ(native_obj);
 }
 
 inline NativeFnObj *vmu_create_native_fn(Value target, NativeFn *native_fn, VM *vm){
@@ -2383,3 +3198,114 @@ inline void vmu_destroy_module_obj(ModuleObj *module_obj, VM *vm){
 
     DEALLOC_MODULE_OBJ(module_obj);
 }
+
+CoroutineObj *vmu_create_coroutine(Value fn, VM *vm){
+    if(!is_value_fn(fn) && !is_value_closure(fn)){
+        vmu_error(vm, "Failed to create coroutine: expect a function or a closure");
+    }
+
+    // Charged first: collecting garbage is only safe before the reservation
+    vm_charge(COROUTINE_STACKS_CHARGE, vm);
+
+    void *stacks = vm_reserve_stack(COROUTINE_STACKS_SIZE);
+
+    if(!stacks){
+        vm_discharge(COROUTINE_STACKS_CHARGE, vm);
+        vmu_error(vm, "Failed to create coroutine: out of memory");
+    }
+
+    CoroutineObj *coroutine_obj = ALLOC_COROUTINE_OBJ();
+    Obj *obj = (Obj *)coroutine_obj;
+    Frame *frame_stack = (Frame *)stacks;
+    Value *stack = (Value *)(frame_stack + COROUTINE_FRAME_LENGTH);
+
+    coroutine_obj->state = CREATED_COROUTINE_STATE;
+    coroutine_obj->fn = fn;
+    coroutine_obj->stacks = stacks;
+    coroutine_obj->stack = stack;
+    coroutine_obj->stack_top = stack;
+    coroutine_obj->frame_stack = frame_stack;
+    coroutine_obj->frame_ptr = frame_stack;
+    coroutine_obj->exceptions = NULL;
+    coroutine_obj->prev = NULL;
+    init_obj(COROUTINE_OBJ_TYPE, obj, vm);
+
+    return coroutine_obj;
+}
+
+void vmu_release_coroutine_stacks(CoroutineObj *coroutine_obj){
+    Exception *exception = coroutine_obj->exceptions;
+
+    while(exception){
+        Exception *prev = exception->prev;
+        lzpool_dealloc(exception);
+        exception = prev;
+    }
+
+    vm_release_stack(coroutine_obj->stacks, COROUTINE_STACKS_SIZE);
+
+    coroutine_obj->exceptions = NULL;
+    coroutine_obj->stacks = NULL;
+    coroutine_obj->stack = NULL;
+    coroutine_obj->stack_top = NULL;
+    coroutine_obj->frame_stack = NULL;
+    coroutine_obj->frame_ptr = NULL;
+}
+
+inline void vmu_destroy_coroutine(CoroutineObj *coroutine_obj, VM *vm){
+    if(!coroutine_obj){
+        return;
+    }
+
+    vmu_release_coroutine_stacks(coroutine_obj);
+    vm_discharge(COROUTINE_STACKS_CHARGE, vm);
+    DEALLOC_COROUTINE_OBJ(coroutine_obj);
+}
+#ifdef NAN_BOXING
+static __thread VM *boxing_vm = NULL;
+
+inline void vmu_set_boxing_vm(VM *vm){
+    boxing_vm = vm;
+}
+
+Value vmu_box_int(int64_t value){
+    VM *vm = boxing_vm;
+
+    assert(vm && "Integers can only be boxed while a VM is running");
+
+    IntObj *int_obj = vmu_create_int(value, vm);
+
+    return (Value){.bits = NAN_BOXING_BOXED_INT_TAG | (uint64_t)(uintptr_t)int_obj};
+}
+
+IntObj *vmu_create_int(int64_t value, VM *vm){
+    LZOHTable *boxed_ints = vm->boxed_ints;
+    IntObj *int_obj = NULL;
+
+    // Boxed integers are unique by value, so values can still be
+    // compared and hashed by its bits
+    if(lzohtable_lookup(sizeof(int64_t), &value, boxed_ints, (void **)&int_obj)){
+        revive_obj((Obj *)int_obj, vm);
+        return int_obj;
+    }
+
+    int_obj = ALLOC_INT_OBJ();
+    Obj *obj = (Obj *)int_obj;
+
+    init_obj(INT_OBJ_TYPE, obj, vm);
+    int_obj->value = value;
+
+    lzohtable_put(sizeof(int64_t), &int_obj->value, int_obj, boxed_ints, NULL);
+
+    return int_obj;
+}
+
+void vmu_destroy_int(IntObj *int_obj, VM *vm){
+    if(!int_obj){
+        return;
+    }
+
+    LZOHTABLE_REMOVE(sizeof(int64_t), &int_obj->value, vm->boxed_ints);
+    DEALLOC_INT_OBJ(int_obj);
+}
+#endif
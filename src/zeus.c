@@ -14,8 +14,12 @@
 #include "vm/vm_factory.h"
 #include "vm/vmu.h"
 #include "vm/vm.h"
+#include "vm/profiler.h"
+#include "vm/sampler.h"
+#include "vm/isolate.h"
 
 #include <stdio.h>
+#include <inttypes.h>
 #include <unistd.h>
 #include <sys/stat.h>
 
@@ -33,6 +37,17 @@ typedef struct args{
     uint8_t exclusives;
     char    *search_paths;
     char    *source_pathname;
+    size_t  gc_step_objs;
+    size_t  gc_step_us;
+    size_t  gc_threads;
+    uint8_t profile;
+    char    *profile_stacks;
+    char    *sample_stacks;
+    size_t  sample_hz;
+    uint8_t registers;
+    uint8_t jit;
+    uint8_t trace;
+    size_t  isolates;
 }Args;
 
 #define ARGS_LEX     0b00000001
@@ -82,6 +97,23 @@ void lzdealloc_link_arena(void *ptr, size_t size, void *ctx){
     // nothing to be done
 }
 
+static size_t get_positive_arg(int *i, int argc, const char *argv[], const char *name){
+    const char *flag = argv[*i];
+    int64_t value = 0;
+
+    if(*i + 1 >= argc){
+        fprintf(stderr, "ERROR: expect '%s' after '%s' flag\n", name, flag);
+        exit(EXIT_FAILURE);
+    }
+
+    if(utils_decimal_str_to_i64((char *)argv[++(*i)], &value) || value <= 0){
+        fprintf(stderr, "ERROR: expect a positive integer as '%s' of '%s' flag\n", name, flag);
+        exit(EXIT_FAILURE);
+    }
+
+    return (size_t)value;
+}
+
 static void get_args(int argc, const char *argv[], Args *args){
     for(int i = 1; i < argc; i++){
 		const char *arg = argv[i];
@@ -153,6 +185,83 @@ static void get_args(int argc, const char *argv[], Args *args){
             }
 
             args->search_paths = (char *)argv[++i];
+        }else if(strcmp("--gc-step-objs", arg) == 0){
+            args->gc_step_objs = get_positive_arg(&i, argc, argv, "budget");
+        }else if(strcmp("--gc-step-us", arg) == 0){
+            args->gc_step_us = get_positive_arg(&i, argc, argv, "budget");
+        }else if(strcmp("--gc-threads", arg) == 0){
+            args->gc_threads = get_positive_arg(&i, argc, argv, "count");
+
+            if(args->gc_threads > GC_MAX_THREADS){
+                fprintf(stderr, "ERROR: '--gc-threads' accepts at most %d threads\n", GC_MAX_THREADS);
+                exit(EXIT_FAILURE);
+            }
+        }else if(strcmp("--profile", arg) == 0){
+            if(args->profile){
+                fprintf(stderr, "ERROR: '--profile' flag already used\n");
+                exit(EXIT_FAILURE);
+            }
+
+            args->profile = 1;
+        }else if(strcmp("--profile-stacks", arg) == 0){
+            if(args->profile_stacks){
+                fprintf(stderr, "ERROR: 'stacks pathname' already set\n");
+                exit(EXIT_FAILURE);
+            }
+
+            if(i + 1 >= argc){
+                fprintf(stderr, "ERROR: expect 'stacks pathname' after '--profile-stacks' flag\n");
+                exit(EXIT_FAILURE);
+            }
+
+            args->profile_stacks = (char *)argv[++i];
+        }else if(strcmp("--sample", arg) == 0){
+            if(args->sample_stacks){
+                fprintf(stderr, "ERROR: 'samples pathname' already set\n");
+                exit(EXIT_FAILURE);
+            }
+
+            if(i + 1 >= argc){
+                fprintf(stderr, "ERROR: expect 'samples pathname' after '--sample' flag\n");
+                exit(EXIT_FAILURE);
+            }
+
+            args->sample_stacks = (char *)argv[++i];
+        }else if(strcmp("--sample-hz", arg) == 0){
+            args->sample_hz = get_positive_arg(&i, argc, argv, "frequency");
+
+            if(args->sample_hz > SAMPLER_MAX_FREQUENCY){
+                fprintf(stderr, "ERROR: '--sample-hz' accepts at most %d samples per second\n", SAMPLER_MAX_FREQUENCY);
+                exit(EXIT_FAILURE);
+            }
+        }else if(strcmp("--registers", arg) == 0){
+            if(args->registers){
+                fprintf(stderr, "ERROR: '--registers' flag already used\n");
+                exit(EXIT_FAILURE);
+            }
+
+            args->registers = 1;
+        }else if(strcmp("--jit", arg) == 0){
+            if(args->jit){
+                fprintf(stderr, "ERROR: '--jit' flag already used\n");
+                exit(EXIT_FAILURE);
+            }
+
+            args->jit = 1;
+        }else if(strcmp("--trace", arg) == 0){
+            if(args->trace){
+                fprintf(stderr, "ERROR: '--trace' flag already used\n");
+                exit(EXIT_FAILURE);
+            }
+
+            args->trace = 1;
+        }else if(strcmp("--isolates", arg) == 0){
+            args->isolates = get_positive_arg(&i, argc, argv, "count");
+
+            if(args->isolates > ISOLATES_LENGTH){
+                fprintf(stderr, "ERROR: '--isolates' accepts at most %d isolates\n", ISOLATES_LENGTH);
+                exit(EXIT_FAILURE);
+            }
         }else{
             if(args->source_pathname){
                 fprintf(stderr, "ERROR: 'Source pathname' already set\n");
@@ -163,7 +272,13 @@ static void get_args(int argc, const char *argv[], Args *args){
         }
 	}
 
-    if(args->help && (args->exclusives || args->search_paths || args->source_pathname)){
+    size_t gc_step = args->gc_step_objs || args->gc_step_us;
+
+    size_t profile = args->profile || args->profile_stacks;
+
+    size_t sample = args->sample_stacks || args->sample_hz;
+
+    if(args->help && (args->exclusives || args->search_paths || args->source_pathname || gc_step || args->gc_threads || profile || sample || args->registers || args->jit || args->trace || args->isolates)){
         fprintf(stderr, "ERROR: flag '-h' must be used alone\n");
         exit(EXIT_FAILURE);
     }
@@ -183,6 +298,90 @@ static void get_args(int argc, const char *argv[], Args *args){
         );
         exit(EXIT_FAILURE);
     }
+
+    if(gc_step && !args->source_pathname){
+        fprintf(
+            stderr,
+            "ERROR: expect 'source pathname' with flags '--gc-step-objs' and '--gc-step-us'\n"
+        );
+        exit(EXIT_FAILURE);
+    }
+
+    if(args->gc_threads && !args->source_pathname){
+        fprintf(
+            stderr,
+            "ERROR: expect 'source pathname' with flag '--gc-threads'\n"
+        );
+        exit(EXIT_FAILURE);
+    }
+
+    if(profile && !args->source_pathname){
+        fprintf(
+            stderr,
+            "ERROR: expect 'source pathname' with flags '--profile' and '--profile-stacks'\n"
+        );
+        exit(EXIT_FAILURE);
+    }
+
+    if(sample && !args->source_pathname){
+        fprintf(
+            stderr,
+            "ERROR: expect 'source pathname' with flags '--sample' and '--sample-hz'\n"
+        );
+        exit(EXIT_FAILURE);
+    }
+
+    if(args->sample_hz && !args->sample_stacks){
+        fprintf(stderr, "ERROR: expect '--sample' with flag '--sample-hz'\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if(args->registers && !args->source_pathname){
+        fprintf(
+            stderr,
+            "ERROR: expect 'source pathname' with flag '--registers'\n"
+        );
+        exit(EXIT_FAILURE);
+    }
+
+    if(args->jit && !args->source_pathname){
+        fprintf(
+            stderr,
+            "ERROR: expect 'source pathname' with flag '--jit'\n"
+        );
+        exit(EXIT_FAILURE);
+    }
+
+    if(args->jit && profile){
+        fprintf(stderr, "ERROR: flag '--jit' cannot be used with '--profile' and '--profile-stacks'\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if(args->trace && !args->source_pathname){
+        fprintf(
+            stderr,
+            "ERROR: expect 'source pathname' with flag '--trace'\n"
+        );
+        exit(EXIT_FAILURE);
+    }
+
+    if(args->trace && profile){
+        fprintf(stderr, "ERROR: flag '--trace' cannot be used with '--profile' and '--profile-stacks'\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if(args->isolates && !args->source_pathname){
+        fprintf(
+            stderr,
+            "ERROR: expect 'source pathname' with flag '--isolates'\n"
+        );
+        exit(EXIT_FAILURE);
+    }
+
+    if(args->isolates && (profile || sample)){
+        fprintf(stderr, "ERROR: flag '--isolates' cannot be used with '--profile', '--profile-stacks' and '--sample'\n");
+        exit(EXIT_FAILURE);
+    }
 }
 
 DStr get_cwd(Allocator *allocator){
@@ -315,6 +514,8 @@ LZOHTable *create_keywords_table(const Allocator *allocator){
     add_keyword("catch", CATCH_TOKTYPE, keywords, allocator);
     add_keyword("throw", THROW_TOKTYPE, keywords, allocator);
     add_keyword("export", EXPORT_TOKTYPE, keywords, allocator);
+    add_keyword("in", IN_TOKTYPE, keywords, allocator);
+    add_keyword("yield", YIELD_TOKTYPE, keywords, allocator);
 
     return keywords;
 }
@@ -348,6 +549,52 @@ static void print_help(){
     fprintf(stderr, "                          Linux:\n");
     fprintf(stderr, "                              /path/a:path/b:path/c\n");
 
+    fprintf(stderr, "    --gc-step-objs <count>\n");
+    fprintf(stderr, "                      Make major garbage collections incremental, marking at most\n");
+    fprintf(stderr, "                      <count> objects at each step.\n");
+
+    fprintf(stderr, "    --gc-step-us <microseconds>\n");
+    fprintf(stderr, "                      Make major garbage collections incremental, marking for at most\n");
+    fprintf(stderr, "                      <microseconds> at each step. Can be combined with '--gc-step-objs'.\n");
+
+    fprintf(stderr, "    --gc-threads <count>\n");
+    fprintf(stderr, "                      Mark with <count> threads during the pause of major garbage\n");
+    fprintf(stderr, "                      collections. At most %d.\n", GC_MAX_THREADS);
+
+    fprintf(stderr, "    --profile\n");
+    fprintf(stderr, "                      Count the executions and %s of every opcode, function and\n", PROFILER_TICKS_NAME);
+    fprintf(stderr, "                      source line. The report is printed to stderr at exit.\n");
+
+    fprintf(stderr, "    --profile-stacks <pathname>\n");
+    fprintf(stderr, "                      Like '--profile', but writes the %s of every call stack to\n", PROFILER_TICKS_NAME);
+    fprintf(stderr, "                      <pathname> in the folded format of flame graph tools.\n");
+
+    fprintf(stderr, "    --sample <pathname>\n");
+    fprintf(stderr, "                      Sample the call stack on a CPU time timer and write the count\n");
+    fprintf(stderr, "                      of every stack to <pathname> in the folded format of flame\n");
+    fprintf(stderr, "                      graph tools. Cheap enough for release builds.\n");
+
+    fprintf(stderr, "    --sample-hz <frequency>\n");
+    fprintf(stderr, "                      Samples taken per second by '--sample'. By default %d, at most %d.\n", SAMPLER_DEFAULT_FREQUENCY, SAMPLER_MAX_FREQUENCY);
+
+    fprintf(stderr, "    --registers\n");
+    fprintf(stderr, "                      Compile arithmetic on locals and numeric comparisons of\n");
+    fprintf(stderr, "                      conditions to register instructions.\n");
+
+    fprintf(stderr, "    --jit\n");
+    fprintf(stderr, "                      Compile hot functions to machine code. Only on Linux x86-64,\n");
+    fprintf(stderr, "                      elsewhere it does nothing.\n");
+
+    fprintf(stderr, "    --trace\n");
+    fprintf(stderr, "                      Record hot loops and compile the path they take to machine\n");
+    fprintf(stderr, "                      code specialized on the types seen. Only on Linux x86-64,\n");
+    fprintf(stderr, "                      elsewhere it does nothing.\n");
+
+    fprintf(stderr, "    --isolates <count>\n");
+    fprintf(stderr, "                      Run the program <count> times at once, each in its own thread\n");
+    fprintf(stderr, "                      and VM. The isolates share no values: 'os.isolate()' tells each\n");
+    fprintf(stderr, "                      its index. At most %d.\n", ISOLATES_LENGTH);
+
     exit(EXIT_FAILURE);
 }
 
@@ -401,7 +648,7 @@ static void add_native_fn_obj(
         strlen(name),
         name,
         sizeof(Value),
-        &((Value){.type = OBJ_VALUE_TYPE, .content.obj_val = native_fn_obj}),
+        &OBJ_VALUE(native_fn_obj),
         natives,
         NULL
     );
@@ -431,6 +678,48 @@ static LZOHTable *create_default_native_fns(Allocator *allocator){
     return default_natives;
 }
 
+static int run_isolates(const Args *args, LZOHTable *native_fns, Module *module){
+    int result = 0;
+    size_t len = args->isolates;
+    Isolate *isolates[ISOLATES_LENGTH];
+
+    for (size_t i = 0; i < len; i++){
+        Isolate *isolate = isolate_create(i, len, native_fns, module);
+
+        if(!isolate){
+            fprintf(stderr, "Failed to init isolate");
+            exit(EXIT_FAILURE);
+        }
+
+        isolate->vm->gc_step_objs = args->gc_step_objs;
+        isolate->vm->gc_step_us = args->gc_step_us;
+        isolate->vm->gc_threads = args->gc_threads;
+        isolate->vm->jit = args->jit;
+        isolate->vm->trace = args->trace;
+
+        isolates[i] = isolate;
+    }
+
+    for (size_t i = 0; i < len; i++){
+        if(isolate_start(isolates[i])){
+            fprintf(stderr, "Failed to start isolate");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    for (size_t i = 0; i < len; i++){
+        int isolate_result = isolate_join(isolates[i]);
+
+        if(isolate_result && !result){
+            result = isolate_result;
+        }
+
+        isolate_destroy(isolates[i]);
+    }
+
+    return result;
+}
+
 static void print_size(size_t size){
     if(size < 1024){
         printf("%zu B", size);
@@ -500,6 +789,8 @@ int main(int argc, const char *argv[]){
     Compiler *compiler = compiler_create(&ctallocator, &rtallocator);
     Dumpper *dumpper = dumpper_create(&ctallocator);
 
+    compiler->registers = args.registers;
+
     Module *main_module = NULL;
     VM *vm = vm_create(&rtallocator);
 
@@ -612,10 +903,74 @@ int main(int argc, const char *argv[]){
                 }
 
                 lzflist_destroy(ctflist);
+
+                if(args.isolates){
+                    result = run_isolates(&args, default_native, main_module);
+                    goto CLEAN_UP_RUNTIME;
+                }
+
                 vm_initialize(vm);
 
+                vm->gc_step_objs = args.gc_step_objs;
+                vm->gc_step_us = args.gc_step_us;
+                vm->gc_threads = args.gc_threads;
+                vm->jit = args.jit;
+                vm->trace = args.trace;
+
+                if(args.profile || args.profile_stacks){
+                    vm->profiler = profiler_create(&rtallocator);
+
+                    if(!vm->profiler){
+                        fprintf(stderr, "Failed to init profiler");
+                        exit(EXIT_FAILURE);
+                    }
+                }
+
+                Sampler *sampler = NULL;
+
+                if(args.sample_stacks){
+                    sampler = sampler_start(args.sample_hz ? (unsigned int)args.sample_hz : SAMPLER_DEFAULT_FREQUENCY, vm);
+
+                    if(!sampler){
+                        fprintf(stderr, "Failed to init sampler");
+                        exit(EXIT_FAILURE);
+                    }
+                }
+
                 result = vm_execute(default_native, main_module, vm);
 
+                if(sampler){
+                    sampler_stop(sampler);
+
+                    if(sampler->dropped > 0){
+                        fprintf(stderr, "Sampler dropped %" PRIu64 " of %" PRIu64 " samples\n", sampler->dropped, sampler->taken + sampler->dropped);
+                    }
+
+                    if(sampler_write_stacks(args.sample_stacks, sampler)){
+                        fprintf(stderr, "Failed to write sampled stacks to '%s'\n", args.sample_stacks);
+                        result = 1;
+                    }
+
+                    sampler_destroy(sampler);
+                }
+
+                if(vm->profiler){
+                    if(args.profile){
+                        profiler_report(stderr, vm->profiler);
+                    }
+
+                    if(args.profile_stacks && profiler_write_stacks(args.profile_stacks, vm->profiler)){
+                        fprintf(stderr, "Failed to write profiled stacks to '%s'\n", args.profile_stacks);
+                        result = 1;
+                    }
+
+                    profiler_destroy(vm->profiler);
+                    vm->profiler = NULL;
+                }
+
+                // Objects can own memory out of the runtime heap, like the bytes of the nbarrays
+                vm_destroy(vm);
+
                 goto CLEAN_UP_RUNTIME;
             }
 